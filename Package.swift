@@ -16,7 +16,10 @@ let package = Package(
       targets: ["ISDBTestSupport"]),
     .executable(
       name: "tibs",
-      targets: ["tibs"])
+      targets: ["tibs"]),
+    .executable(
+      name: "isdb-benchmark",
+      targets: ["isdb-benchmark"])
   ],
   dependencies: [],
   targets: [
@@ -59,6 +62,21 @@ let package = Package(
         .linkedFramework("XCTest", .when(platforms: [.iOS, .macOS, .tvOS, .watchOS]))
       ]),
 
+    // MARK: Benchmarking
+
+    // Measures import and query performance over a synthetic index store.
+    .executableTarget(
+      name: "isdb-benchmark",
+      dependencies: ["IndexStoreDB_SyntheticStore"],
+      exclude: ["CMakeLists.txt"]),
+
+    // In-memory implementation of the indexstore library over generated data.
+    .target(
+      name: "IndexStoreDB_SyntheticStore",
+      dependencies: ["IndexStoreDB_Index"],
+      path: "lib/SyntheticStore",
+      exclude: ["CMakeLists.txt"]),
+
     // MARK: C++ interface
 
     // Primary C++ interface.
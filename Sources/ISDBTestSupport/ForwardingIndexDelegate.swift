@@ -46,4 +46,8 @@ final class ForwardingIndexDelegate: IndexDelegate {
       synchronous: synchronous
     )
   }
+
+  func unitsAreOutOfDate(_ units: [OutOfDateUnitInfo], synchronous: Bool) {
+    delegate?.unitsAreOutOfDate(units, synchronous: synchronous)
+  }
 }
@@ -175,6 +175,8 @@ public final class TibsTestWorkspace {
     enableOutOfDateFileWatching: Bool = false,
     listenToUnitEvents: Bool = false,
     prefixMappings: [PathMapping] = [],
+    recordOccurrenceCounts: Bool = false,
+    delegateBatchInterval: TimeInterval = 0,
     toolchain: TibsToolchain? = nil
   ) throws {
     let toolchain = toolchain ?? TibsToolchain.testDefault
@@ -188,7 +190,9 @@ public final class TibsTestWorkspace {
       waitUntilDoneInitializing: waitUntilDoneInitializing,
       enableOutOfDateFileWatching: enableOutOfDateFileWatching,
       listenToUnitEvents: listenToUnitEvents,
-      prefixMappings: prefixMappings)
+      prefixMappings: prefixMappings,
+      recordOccurrenceCounts: recordOccurrenceCounts,
+      delegateBatchInterval: delegateBatchInterval)
   }
 
   deinit {
@@ -17,6 +17,15 @@ public struct StoreUnitInfo {
   public let unitName: String
 }
 
+/// An out-of-date unit, see `IndexDelegate.unitIsOutOfDate`.
+public struct OutOfDateUnitInfo {
+  public let unitInfo: StoreUnitInfo
+  /// Number of nanoseconds since clock's epoch.
+  public let outOfDateModTime: UInt64
+  public let triggerHintFile: String
+  public let triggerHintDescription: String
+}
+
 /// Delegate for index events.
 public protocol IndexDelegate: AnyObject {
 
@@ -39,6 +48,10 @@ public protocol IndexDelegate: AnyObject {
     triggerHintDescription: String,
     synchronous: Bool
   )
+
+  /// Notification about the units found out-of-date together, or during the `delegateBatchInterval` of the index.
+  /// Calls `unitIsOutOfDate` for each of them by default.
+  func unitsAreOutOfDate(_ units: [OutOfDateUnitInfo], synchronous: Bool)
 }
 
 extension IndexDelegate {
@@ -50,6 +63,18 @@ extension IndexDelegate {
     synchronous: Bool
   ) {
   }
+
+  public func unitsAreOutOfDate(_ units: [OutOfDateUnitInfo], synchronous: Bool) {
+    for unit in units {
+      self.unitIsOutOfDate(
+        unit.unitInfo,
+        outOfDateModTime: unit.outOfDateModTime,
+        triggerHintFile: unit.triggerHintFile,
+        triggerHintDescription: unit.triggerHintDescription,
+        synchronous: synchronous
+      )
+    }
+  }
 }
 
 extension IndexDelegate {
@@ -63,20 +88,36 @@ extension IndexDelegate {
       let count = indexstoredb_delegate_event_get_count(event)
       self.processingCompleted(Int(count))
     case INDEXSTOREDB_EVENT_UNIT_OUT_OF_DATE:
-      let c_unitInfo = indexstoredb_delegate_event_get_outofdate_unit_info(event)!
-      let unitInfo = StoreUnitInfo(
-        mainFilePath: String(cString: indexstoredb_unit_info_main_file_path(c_unitInfo)),
-        unitName: String(cString: indexstoredb_unit_info_unit_name(c_unitInfo))
-      )
+      let unit = outOfDateUnitInfo(event)
       self.unitIsOutOfDate(
-        unitInfo,
-        outOfDateModTime: indexstoredb_delegate_event_get_outofdate_modtime(event),
-        triggerHintFile: String(cString: indexstoredb_delegate_event_get_outofdate_trigger_original_file(event)!),
-        triggerHintDescription: String(cString: indexstoredb_delegate_event_get_outofdate_trigger_description(event)!),
+        unit.unitInfo,
+        outOfDateModTime: unit.outOfDateModTime,
+        triggerHintFile: unit.triggerHintFile,
+        triggerHintDescription: unit.triggerHintDescription,
         synchronous: indexstoredb_delegate_event_get_outofdate_is_synchronous(event)
       )
+    case INDEXSTOREDB_EVENT_UNITS_OUT_OF_DATE:
+      let count = Int(indexstoredb_delegate_event_get_count(event))
+      let units = (0..<count).map {
+        outOfDateUnitInfo(indexstoredb_delegate_event_get_outofdate_event(event, $0)!)
+      }
+      self.unitsAreOutOfDate(units, synchronous: indexstoredb_delegate_event_get_outofdate_is_synchronous(event))
     default:
       return
     }
   }
 }
+
+private func outOfDateUnitInfo(_ event: indexstoredb_delegate_event_t) -> OutOfDateUnitInfo {
+  let c_unitInfo = indexstoredb_delegate_event_get_outofdate_unit_info(event)!
+  let unitInfo = StoreUnitInfo(
+    mainFilePath: String(cString: indexstoredb_unit_info_main_file_path(c_unitInfo)),
+    unitName: String(cString: indexstoredb_unit_info_unit_name(c_unitInfo))
+  )
+  return OutOfDateUnitInfo(
+    unitInfo: unitInfo,
+    outOfDateModTime: indexstoredb_delegate_event_get_outofdate_modtime(event),
+    triggerHintFile: String(cString: indexstoredb_delegate_event_get_outofdate_trigger_original_file(event)!),
+    triggerHintDescription: String(cString: indexstoredb_delegate_event_get_outofdate_trigger_description(event)!)
+  )
+}
@@ -52,6 +52,45 @@ public enum SymbolProviderKind {
   }
 }
 
+/// How much memory `IndexStoreDB.trimMemory(_:)` releases.
+public enum MemoryTrimLevel {
+  /// Drop the caches of lookups, which fill up again as they are used.
+  case moderate
+  /// Also drop the data that can be reloaded from the database.
+  case critical
+
+  var cLevel: indexstoredb_memory_trim_level_t {
+    switch self {
+    case .moderate:
+      return INDEXSTOREDB_MEMORY_TRIM_LEVEL_MODERATE
+    case .critical:
+      return INDEXSTOREDB_MEMORY_TRIM_LEVEL_CRITICAL
+    }
+  }
+}
+
+/// Counts for a symbol occurrence query, computed without reading any record data.
+public struct SymbolOccurrenceCount: Equatable {
+  /// Number of records that contain the symbol with any of the requested roles.
+  public var providerCount: Int
+
+  /// Number of distinct source files of those records.
+  public var fileCount: Int
+
+  /// Number of occurrences, or `nil` if the index was not created with `recordOccurrenceCounts`.
+  public var occurrenceCount: Int?
+
+  /// If `false`, `occurrenceCount` is an upper bound.
+  public var isExact: Bool
+
+  public init(providerCount: Int, fileCount: Int, occurrenceCount: Int?, isExact: Bool) {
+    self.providerCount = providerCount
+    self.fileCount = fileCount
+    self.occurrenceCount = occurrenceCount
+    self.isExact = isExact
+  }
+}
+
 /// IndexStoreDB index.
 public final class IndexStoreDB {
 
@@ -74,6 +113,21 @@ public final class IndexStoreDB {
   ///     disables reading or updating from the index store unless `pollForUnitChangesAndWait()`
   ///     is called.
   ///   * prefixMappings: Path mappings to use (if supported) to remap paths in the index data to paths on the local machine.
+  ///   * recordOccurrenceCounts: If `true`, record the number of occurrences of each symbol when
+  ///     importing index data, so that `occurrenceCount(ofUSR:roles:)` can report it.
+  ///   * memoryBudget: Number of bytes that the caches of the index may use, see `memoryUsage()`. They are
+  ///     trimmed to fit when the pending units are imported. 0 means no limit.
+  ///   * snapshotPath: Snapshot written by `exportSnapshot(to:prefixMappings:)` to create the database from, if
+  ///     there is none at `databasePath` yet. Only the units that are out of date with the snapshot get imported.
+  ///   * snapshotPrefixMappings: Path mappings from the prefixes written in the snapshot to paths on the local machine.
+  ///   * shareDatabase: If `true`, open the database in place so that other processes can use it at the same time.
+  ///     Only one of them imports the units, the others see its imports and take over when it exits. All the
+  ///     processes that use `databasePath` need to pass `true`.
+  ///   * delegateBatchInterval: Number of seconds during which the delegate events are collected and then delivered
+  ///     together, the out-of-date units through `IndexDelegate.unitsAreOutOfDate` and the completed units as one
+  ///     count. 0 delivers them as soon as possible.
+  ///   * unitProcessingWeight: Share of the unit processing time that the index gets while other indexes of the
+  ///     process have units to process as well, see `setUnitProcessingConcurrency(_:)`.
   public init(
     storePath: String,
     databasePath: String,
@@ -84,7 +138,14 @@ public final class IndexStoreDB {
     readonly: Bool = false,
     enableOutOfDateFileWatching: Bool = false,
     listenToUnitEvents: Bool = true,
-    prefixMappings: [PathMapping] = []
+    prefixMappings: [PathMapping] = [],
+    recordOccurrenceCounts: Bool = false,
+    memoryBudget: Int = 0,
+    snapshotPath: String? = nil,
+    snapshotPrefixMappings: [PathMapping] = [],
+    shareDatabase: Bool = false,
+    delegateBatchInterval: TimeInterval = 0,
+    unitProcessingWeight: Int = 1
   ) throws {
     self.delegate = delegate
 
@@ -102,6 +163,13 @@ public final class IndexStoreDB {
     indexstoredb_creation_options_readonly(options, readonly)
     indexstoredb_creation_options_enable_out_of_date_file_watching(options, enableOutOfDateFileWatching)
     indexstoredb_creation_options_listen_to_unit_events(options, listenToUnitEvents)
+    indexstoredb_creation_options_record_occurrence_counts(options, recordOccurrenceCounts)
+    indexstoredb_creation_options_memory_budget(options, memoryBudget)
+    indexstoredb_creation_options_share_database(options, shareDatabase)
+    indexstoredb_creation_options_delegate_batch_interval(options, UInt64(max(delegateBatchInterval, 0) * 1000))
+    // `IndexDelegate.unitsAreOutOfDate` splits the batches for the delegates that handle each unit.
+    indexstoredb_creation_options_batch_out_of_date_units(options, true)
+    indexstoredb_creation_options_unit_processing_weight(options, UInt32(clamping: max(unitProcessingWeight, 1)))
     for mapping in prefixMappings {
       mapping.original.withCString { origCStr in
         mapping.replacement.withCString { remappedCStr in
@@ -109,6 +177,16 @@ public final class IndexStoreDB {
         }
       }
     }
+    if let snapshotPath = snapshotPath {
+      indexstoredb_creation_options_snapshot(options, snapshotPath)
+    }
+    for mapping in snapshotPrefixMappings {
+      mapping.original.withCString { origCStr in
+        mapping.replacement.withCString { remappedCStr in
+          indexstoredb_creation_options_add_snapshot_prefix_mapping(options, origCStr, remappedCStr)
+        }
+      }
+    }
 
     var error: indexstoredb_error_t? = nil
     guard let index = indexstoredb_index_create(
@@ -165,19 +243,97 @@ public final class IndexStoreDB {
     return indexstoredb_index_remove_unit_out_file_paths(impl, cPaths, cPaths.count, waitForProcessing)
   }
 
+  /// Replace the set of output filepaths of the unit files that index data should be loaded from. Only the units of
+  /// the filepaths that were added or removed since the previous set get loaded or removed.
+  /// Only has an effect if `useExplicitOutputUnits` was set to true at initialization.
+  public func setUnitOutFilePaths(_ paths: [String], waitForProcessing: Bool) {
+    let cPaths: [UnsafePointer<CChar>] = paths.map { UnsafePointer($0.withCString(strdup)!) }
+    defer { for cPath in cPaths { free(UnsafeMutablePointer(mutating: cPath)) } }
+    return indexstoredb_index_set_unit_out_file_paths(impl, cPaths, cPaths.count, waitForProcessing)
+  }
+
+  /// Import the pending units of the given files, main source files or unit output files, ahead of the other pending
+  /// units.
+  public func prioritizeFiles(_ paths: [String]) {
+    let cPaths: [UnsafePointer<CChar>] = paths.map { UnsafePointer($0.withCString(strdup)!) }
+    defer { for cPath in cPaths { free(UnsafeMutablePointer(mutating: cPath)) } }
+    return indexstoredb_index_prioritize_files(impl, cPaths, cPaths.count)
+  }
+
+  /// Releases memory held by the caches of the index, for instance when the system reports memory pressure.
+  public func trimMemory(_ level: MemoryTrimLevel) {
+    indexstoredb_index_trim_memory(impl, level.cLevel)
+  }
+
+  /// Writes a compacted copy of the database into the new directory `path`, to seed the database of another machine
+  /// with the `snapshotPath` parameter of `init`. `prefixMappings` replace the path prefixes that are specific to this
+  /// machine, for instance the root of the sources with a placeholder.
+  public func exportSnapshot(to path: String, prefixMappings: [PathMapping] = []) throws {
+    let cPrefixes: [UnsafePointer<CChar>] = prefixMappings.map { UnsafePointer($0.original.withCString(strdup)!) }
+    let cReplacements: [UnsafePointer<CChar>] = prefixMappings.map { UnsafePointer($0.replacement.withCString(strdup)!) }
+    defer {
+      for cPath in cPrefixes + cReplacements { free(UnsafeMutablePointer(mutating: cPath)) }
+    }
+    var error: indexstoredb_error_t? = nil
+    if !indexstoredb_index_export_snapshot(impl, path, cPrefixes, cReplacements, prefixMappings.count, &error) {
+      defer { indexstoredb_error_dispose(error) }
+      throw IndexStoreDBError.exportSnapshot(error?.description ?? "unknown")
+    }
+  }
+
+  /// Returns the approximate number of bytes used by each of the caches of the index, by cache name.
+  public func memoryUsage() -> [String: Int] {
+    var result: [String: Int] = [:]
+    indexstoredb_index_memory_usage(impl) { name, bytes in
+      result[String(cString: name)] = bytes
+      return true
+    }
+    return result
+  }
+
   /// Invoke `body` with every occurrance of `usr` in one of the specified roles.
   ///
   /// Stop iteration if `body` returns `false`.
   /// - Returns: `false` if iteration was terminated by `body` returning `true` or `true` if iteration finished.
   @discardableResult
-  public func forEachSymbolOccurrence(byUSR usr: String, roles: SymbolRole, _ body: (SymbolOccurrence) -> Bool) -> Bool {
+  public func forEachSymbolOccurrence(
+    byUSR usr: String,
+    roles: SymbolRole,
+    cancellationToken: CancellationToken? = nil,
+    _ body: (SymbolOccurrence) -> Bool
+  ) -> Bool {
     return withoutActuallyEscaping(body) { body in
-      return indexstoredb_index_symbol_occurrences_by_usr(impl, usr, roles.rawValue) { occur in
+      return indexstoredb_index_symbol_occurrences_by_usr_cancellable(
+        impl, usr, roles.rawValue, cancellationToken?.token
+      ) { occur in
         return body(SymbolOccurrence(occur))
       }
     }
   }
 
+  /// Asynchronous variant of `forEachSymbolOccurrence(byUSR:roles:cancellationToken:_:)`.
+  ///
+  /// The query runs on the query executor at `priority` and passes the occurrences to `receiver` in
+  /// batches of `batchSize`, on a thread of the executor. `completion` is called after the last
+  /// batch, with `false` if `receiver` returned `false` or the query was cancelled.
+  @discardableResult
+  public func forEachSymbolOccurrenceAsync(
+    byUSR usr: String,
+    roles: SymbolRole,
+    priority: QueryPriority = .default,
+    batchSize: Int = 128,
+    cancellationToken: CancellationToken? = nil,
+    receiver: @escaping ([SymbolOccurrence]) -> Bool,
+    completion: @escaping (Bool) -> Void = { _ in }
+  ) -> AsyncQuery {
+    return AsyncQuery(indexstoredb_index_symbol_occurrences_by_usr_async(
+      impl, usr, roles.rawValue, priority.cPriority, max(batchSize, 1), cancellationToken?.token,
+      { occurs, count in
+        return receiver(UnsafeBufferPointer(start: occurs, count: count).map { SymbolOccurrence($0) })
+      },
+      completion))
+  }
+
   /// Returns all occurrences of `usr` in one of the specified roles.
   public func occurrences(ofUSR usr: String, roles: SymbolRole) -> [SymbolOccurrence] {
     var result: [SymbolOccurrence] = []
@@ -188,16 +344,58 @@ public final class IndexStoreDB {
     return result
   }
 
+  /// Returns the number of occurrences that `occurrences(ofUSR:roles:)` would return, without
+  /// reading any record data.
+  public func occurrenceCount(ofUSR usr: String, roles: SymbolRole) -> SymbolOccurrenceCount {
+    var providerCount: UInt64 = 0
+    var fileCount: UInt64 = 0
+    var occurrenceCount: UInt64 = 0
+    var isExact: Bool = true
+    let hasOccurrenceCount = indexstoredb_index_symbol_occurrence_count_by_usr(
+      impl, usr, roles.rawValue, &providerCount, &fileCount, &occurrenceCount, &isExact)
+    return SymbolOccurrenceCount(
+      providerCount: Int(providerCount),
+      fileCount: Int(fileCount),
+      occurrenceCount: hasOccurrenceCount ? Int(occurrenceCount) : nil,
+      isExact: isExact)
+  }
+
   @discardableResult
-  public func forEachRelatedSymbolOccurrence(byUSR usr: String, roles: SymbolRole, _ body: (SymbolOccurrence) -> Bool) -> Bool {
+  public func forEachRelatedSymbolOccurrence(
+    byUSR usr: String,
+    roles: SymbolRole,
+    cancellationToken: CancellationToken? = nil,
+    _ body: (SymbolOccurrence) -> Bool
+  ) -> Bool {
     return withoutActuallyEscaping(body) { body in
-      return indexstoredb_index_related_symbol_occurrences_by_usr(impl, usr, roles.rawValue) {
-        occur in
+      return indexstoredb_index_related_symbol_occurrences_by_usr_cancellable(
+        impl, usr, roles.rawValue, cancellationToken?.token
+      ) { occur in
         return body(SymbolOccurrence(occur))
       }
     }
   }
 
+  /// Asynchronous variant of `forEachRelatedSymbolOccurrence(byUSR:roles:cancellationToken:_:)`, see
+  /// `forEachSymbolOccurrenceAsync(byUSR:roles:priority:batchSize:cancellationToken:receiver:completion:)`.
+  @discardableResult
+  public func forEachRelatedSymbolOccurrenceAsync(
+    byUSR usr: String,
+    roles: SymbolRole,
+    priority: QueryPriority = .default,
+    batchSize: Int = 128,
+    cancellationToken: CancellationToken? = nil,
+    receiver: @escaping ([SymbolOccurrence]) -> Bool,
+    completion: @escaping (Bool) -> Void = { _ in }
+  ) -> AsyncQuery {
+    return AsyncQuery(indexstoredb_index_related_symbol_occurrences_by_usr_async(
+      impl, usr, roles.rawValue, priority.cPriority, max(batchSize, 1), cancellationToken?.token,
+      { occurs, count in
+        return receiver(UnsafeBufferPointer(start: occurs, count: count).map { SymbolOccurrence($0) })
+      },
+      completion))
+  }
+
   public func occurrences(relatedToUSR usr: String, roles: SymbolRole) -> [SymbolOccurrence] {
     var result: [SymbolOccurrence] = []
     forEachRelatedSymbolOccurrence(byUSR: usr, roles: roles) { occur in
@@ -207,14 +405,55 @@ public final class IndexStoreDB {
     return result
   }
 
-  @discardableResult public func forEachCanonicalSymbolOccurrence(byName: String, body: (SymbolOccurrence) -> Bool) -> Bool {
+  /// Returns the number of occurrences that `occurrences(relatedToUSR:roles:)` would return,
+  /// without reading any record data.
+  public func occurrenceCount(relatedToUSR usr: String, roles: SymbolRole) -> SymbolOccurrenceCount {
+    var providerCount: UInt64 = 0
+    var fileCount: UInt64 = 0
+    var occurrenceCount: UInt64 = 0
+    var isExact: Bool = true
+    let hasOccurrenceCount = indexstoredb_index_related_symbol_occurrence_count_by_usr(
+      impl, usr, roles.rawValue, &providerCount, &fileCount, &occurrenceCount, &isExact)
+    return SymbolOccurrenceCount(
+      providerCount: Int(providerCount),
+      fileCount: Int(fileCount),
+      occurrenceCount: hasOccurrenceCount ? Int(occurrenceCount) : nil,
+      isExact: isExact)
+  }
+
+  @discardableResult public func forEachCanonicalSymbolOccurrence(
+    byName: String,
+    cancellationToken: CancellationToken? = nil,
+    body: (SymbolOccurrence) -> Bool
+  ) -> Bool {
     return withoutActuallyEscaping(body) { body in
-      return indexstoredb_index_canonical_symbol_occurences_by_name(impl, byName) { occur in
+      return indexstoredb_index_canonical_symbol_occurences_by_name_cancellable(
+        impl, byName, cancellationToken?.token
+      ) { occur in
         return body(SymbolOccurrence(occur))
       }
     }
   }
 
+  /// Asynchronous variant of `forEachCanonicalSymbolOccurrence(byName:cancellationToken:body:)`, see
+  /// `forEachSymbolOccurrenceAsync(byUSR:roles:priority:batchSize:cancellationToken:receiver:completion:)`.
+  @discardableResult
+  public func forEachCanonicalSymbolOccurrenceAsync(
+    byName: String,
+    priority: QueryPriority = .default,
+    batchSize: Int = 128,
+    cancellationToken: CancellationToken? = nil,
+    receiver: @escaping ([SymbolOccurrence]) -> Bool,
+    completion: @escaping (Bool) -> Void = { _ in }
+  ) -> AsyncQuery {
+    return AsyncQuery(indexstoredb_index_canonical_symbol_occurences_by_name_async(
+      impl, byName, priority.cPriority, max(batchSize, 1), cancellationToken?.token,
+      { occurs, count in
+        return receiver(UnsafeBufferPointer(start: occurs, count: count).map { SymbolOccurrence($0) })
+      },
+      completion))
+  }
+
   public func canonicalOccurrences(ofName name: String) -> [SymbolOccurrence] {
     var result: [SymbolOccurrence] = []
     forEachCanonicalSymbolOccurrence(byName: name) { occur in
@@ -230,22 +469,56 @@ public final class IndexStoreDB {
     anchorEnd: Bool,
     subsequence: Bool,
     ignoreCase: Bool,
+    cancellationToken: CancellationToken? = nil,
     body: (SymbolOccurrence) -> Bool
   ) -> Bool {
     return withoutActuallyEscaping(body) { body in
-      return indexstoredb_index_canonical_symbol_occurences_containing_pattern(
+      return indexstoredb_index_canonical_symbol_occurences_containing_pattern_cancellable(
         impl,
         pattern,
         anchorStart,
         anchorEnd,
         subsequence,
-        ignoreCase
+        ignoreCase,
+        cancellationToken?.token
       ) { occur in
         body(SymbolOccurrence(occur))
       }
     }
   }
 
+  /// Asynchronous variant of
+  /// `forEachCanonicalSymbolOccurrence(containing:anchorStart:anchorEnd:subsequence:ignoreCase:cancellationToken:body:)`,
+  /// see `forEachSymbolOccurrenceAsync(byUSR:roles:priority:batchSize:cancellationToken:receiver:completion:)`.
+  @discardableResult
+  public func forEachCanonicalSymbolOccurrenceAsync(
+    containing pattern: String,
+    anchorStart: Bool,
+    anchorEnd: Bool,
+    subsequence: Bool,
+    ignoreCase: Bool,
+    priority: QueryPriority = .default,
+    batchSize: Int = 128,
+    cancellationToken: CancellationToken? = nil,
+    receiver: @escaping ([SymbolOccurrence]) -> Bool,
+    completion: @escaping (Bool) -> Void = { _ in }
+  ) -> AsyncQuery {
+    return AsyncQuery(indexstoredb_index_canonical_symbol_occurences_containing_pattern_async(
+      impl,
+      pattern,
+      anchorStart,
+      anchorEnd,
+      subsequence,
+      ignoreCase,
+      priority.cPriority,
+      max(batchSize, 1),
+      cancellationToken?.token,
+      { occurs, count in
+        return receiver(UnsafeBufferPointer(start: occurs, count: count).map { SymbolOccurrence($0) })
+      },
+      completion))
+  }
+
   public func canonicalOccurrences(
     containing pattern: String,
     anchorStart: Bool,
@@ -391,12 +664,13 @@ public final class IndexStoreDB {
 
   /// Iterates over the name of every symbol in the index.
   ///
+  /// - Parameter cancellationToken: If cancelled, iteration stops and `false` is returned.
   /// - Parameter body: A closure to be called for each symbol. The closure should return true to
   /// continue iterating.
   @discardableResult
-  public func forEachSymbolName(body: (String) -> Bool) -> Bool {
+  public func forEachSymbolName(cancellationToken: CancellationToken? = nil, body: (String) -> Bool) -> Bool {
     return withoutActuallyEscaping(body) { body in
-      return indexstoredb_index_symbol_names(impl) { name in
+      return indexstoredb_index_symbol_names_cancellable(impl, cancellationToken?.token) { name in
         body(String(cString: name))
       }
     }
@@ -484,6 +758,190 @@ public final class IndexStoreDB {
   }
 }
 
+/// Where the work of the queries executed inside `IndexStoreDB.profileQueries` went.
+public struct QueryProfile: Equatable {
+  /// Database read transactions that were opened.
+  public var readTransactions: Int
+  /// Keyed database lookups.
+  public var databaseLookups: Int
+  /// Database cursor steps.
+  public var databaseCursorSteps: Int
+  /// Records that were resolved from the database.
+  public var providersResolved: Int
+  /// Record files that were opened and decoded.
+  public var recordsOpened: Int
+  /// Symbol occurrences decoded from the opened records.
+  public var occurrencesDecoded: Int
+  /// Unit visibility checks.
+  public var visibilityChecks: Int
+  /// Unit visibility checks answered from the visibility cache.
+  public var visibilityCacheHits: Int
+
+  /// Wall time spent finding the records that match the queries.
+  public var lookupProvidersTime: TimeInterval
+  /// Wall time spent resolving the matching records, including visibility checks.
+  public var resolveProvidersTime: TimeInterval
+  /// Wall time spent reading records and passing their occurrences to the query bodies.
+  public var readRecordsTime: TimeInterval
+  /// Wall time of the whole profiled closure.
+  public var totalTime: TimeInterval
+
+  init(_ profile: indexstoredb_query_profile_t) {
+    func count(_ counter: indexstoredb_query_profile_counter_t) -> Int {
+      return Int(indexstoredb_query_profile_get_count(profile, counter))
+    }
+    func time(_ phase: indexstoredb_query_profile_phase_t) -> TimeInterval {
+      return Double(indexstoredb_query_profile_get_phase_nanoseconds(profile, phase)) / 1_000_000_000
+    }
+    readTransactions = count(INDEXSTOREDB_QUERY_PROFILE_COUNTER_READ_TRANSACTIONS)
+    databaseLookups = count(INDEXSTOREDB_QUERY_PROFILE_COUNTER_DB_LOOKUPS)
+    databaseCursorSteps = count(INDEXSTOREDB_QUERY_PROFILE_COUNTER_DB_CURSOR_STEPS)
+    providersResolved = count(INDEXSTOREDB_QUERY_PROFILE_COUNTER_PROVIDERS_RESOLVED)
+    recordsOpened = count(INDEXSTOREDB_QUERY_PROFILE_COUNTER_RECORDS_OPENED)
+    occurrencesDecoded = count(INDEXSTOREDB_QUERY_PROFILE_COUNTER_OCCURRENCES_DECODED)
+    visibilityChecks = count(INDEXSTOREDB_QUERY_PROFILE_COUNTER_VISIBILITY_CHECKS)
+    visibilityCacheHits = count(INDEXSTOREDB_QUERY_PROFILE_COUNTER_VISIBILITY_CACHE_HITS)
+    lookupProvidersTime = time(INDEXSTOREDB_QUERY_PROFILE_PHASE_LOOKUP_PROVIDERS)
+    resolveProvidersTime = time(INDEXSTOREDB_QUERY_PROFILE_PHASE_RESOLVE_PROVIDERS)
+    readRecordsTime = time(INDEXSTOREDB_QUERY_PROFILE_PHASE_READ_RECORDS)
+    totalTime = Double(indexstoredb_query_profile_get_total_nanoseconds(profile)) / 1_000_000_000
+  }
+}
+
+extension IndexStoreDB {
+  /// Calls `body` and profiles the queries it executes on the current thread.
+  ///
+  /// - Returns: The result of `body` and the profile of the queries it executed.
+  public static func profileQueries<T>(_ body: () -> T) -> (result: T, profile: QueryProfile) {
+    let profile = indexstoredb_query_profile_create()
+    defer { indexstoredb_release(profile) }
+    var result: T? = nil
+    withoutActuallyEscaping(body) { body in
+      indexstoredb_query_profile_collect(profile) {
+        result = body()
+      }
+    }
+    return (result!, QueryProfile(profile))
+  }
+
+  /// Enables or disables the collection of the process-wide index metrics: counters and latency
+  /// histograms of the import, the database, record reads, visibility checks, the path cache and
+  /// the queries. Collection is disabled by default.
+  public static func setMetricsEnabled(_ enabled: Bool) {
+    indexstoredb_metrics_set_enabled(enabled)
+  }
+
+  /// Zeroes the process-wide counters and latency histograms.
+  public static func resetMetrics() {
+    indexstoredb_metrics_reset()
+  }
+
+  /// Sets how many indexes of the process may process units at the same time, 1 by default. Each
+  /// index processes its units in order, and the indexes with units to process take turns by their
+  /// `unitProcessingWeight`.
+  public static func setUnitProcessingConcurrency(_ concurrency: Int) {
+    indexstoredb_set_unit_processing_concurrency(UInt32(clamping: max(concurrency, 1)))
+  }
+
+  /// Sets how many asynchronous queries of the process may run at the same time, the number of
+  /// cores by default.
+  public static func setAsyncQueryConcurrency(_ concurrency: Int) {
+    indexstoredb_set_async_query_concurrency(UInt32(clamping: max(concurrency, 1)))
+  }
+
+  /// The process-wide metrics, the storage statistics of this index's database and the statistics
+  /// of its unit processing queue, as a JSON object with `counters`, `gauges`, `histograms`,
+  /// `database` and `unit_processing` members.
+  public func metricsJSON() -> String {
+    var result: String = ""
+    indexstoredb_index_metrics_json(impl) { json in
+      result = String(cString: json)
+    }
+    return result
+  }
+}
+
+/// Stops the queries it is passed to, either when `cancel()` is called or once the timeout passes.
+///
+/// A cancelled query stops within a bounded amount of work and returns `false`, as if the body
+/// had returned `false`.
+public final class CancellationToken {
+  let token: UnsafeMutableRawPointer // indexstoredb_cancellation_token_t
+
+  /// - Parameter timeout: If non-nil, the token is also considered cancelled this many seconds
+  ///   after its creation.
+  public init(timeout: TimeInterval? = nil) {
+    let nanoseconds = timeout.map { UInt64(max($0, 1e-9) * 1_000_000_000) } ?? 0
+    self.token = indexstoredb_cancellation_token_create(nanoseconds)
+  }
+
+  public func cancel() {
+    indexstoredb_cancellation_token_cancel(token)
+  }
+
+  public var isCancelled: Bool {
+    return indexstoredb_cancellation_token_is_cancelled(token)
+  }
+
+  deinit {
+    indexstoredb_release(token)
+  }
+}
+
+/// The priority of an asynchronous query. While the query executor is busy, the pending queries of
+/// higher priority start first.
+public enum QueryPriority {
+  case high
+  case `default`
+  case low
+  case background
+
+  var cPriority: indexstoredb_query_priority_t {
+    switch self {
+    case .high:
+      return INDEXSTOREDB_QUERY_PRIORITY_HIGH
+    case .default:
+      return INDEXSTOREDB_QUERY_PRIORITY_DEFAULT
+    case .low:
+      return INDEXSTOREDB_QUERY_PRIORITY_LOW
+    case .background:
+      return INDEXSTOREDB_QUERY_PRIORITY_BACKGROUND
+    }
+  }
+}
+
+/// A query that runs on the query executor, see
+/// `IndexStoreDB.forEachSymbolOccurrenceAsync(byUSR:roles:priority:batchSize:cancellationToken:receiver:completion:)`.
+///
+/// Releasing it doesn't cancel the query.
+public final class AsyncQuery {
+  let query: UnsafeMutableRawPointer // indexstoredb_async_query_t
+
+  init(_ query: UnsafeMutableRawPointer) {
+    self.query = query
+  }
+
+  /// Stops the query within a bounded amount of work. A query that didn't start yet doesn't run;
+  /// its completion is called either way.
+  public func cancel() {
+    indexstoredb_async_query_cancel(query)
+  }
+
+  /// Whether the completion of the query has returned.
+  public var isFinished: Bool {
+    return indexstoredb_async_query_is_finished(query)
+  }
+
+  /// Blocks until the completion of the query has returned.
+  public func wait() {
+    indexstoredb_async_query_wait(query)
+  }
+
+  deinit {
+    indexstoredb_release(query)
+  }
+}
+
 public protocol IndexStoreLibraryProvider {
   func library(forStorePath: String) -> IndexStoreLibrary?
 }
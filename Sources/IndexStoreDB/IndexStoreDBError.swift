@@ -18,6 +18,7 @@ import protocol Foundation.LocalizedError
 public enum IndexStoreDBError: Error {
   case create(String)
   case loadIndexStore(String)
+  case exportSnapshot(String)
 }
 
 extension IndexStoreDBError: LocalizedError {
@@ -27,6 +28,8 @@ extension IndexStoreDBError: LocalizedError {
       return "indexstoredb_index_create error: \(msg)"
     case .loadIndexStore(let msg):
       return "indexstoredb_load_indexstore_library error: \(msg)"
+    case .exportSnapshot(let msg):
+      return "indexstoredb_index_export_snapshot error: \(msg)"
     }
   }
 }
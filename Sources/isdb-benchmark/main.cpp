@@ -0,0 +1,409 @@
+//===--- main.cpp - IndexStoreDB benchmark driver -------------------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2018 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://swift.org/LICENSE.txt for license information
+// See https://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+//
+// Measures import throughput and query latency of IndexSystem over a
+// SyntheticIndexStore, so that it runs without a compiler toolchain.
+//
+//===----------------------------------------------------------------------===//
+
+#include "IndexStoreDB/Core/Symbol.h"
+#include "IndexStoreDB/Index/IndexSystem.h"
+#include "IndexStoreDB/Index/IndexSystemDelegate.h"
+#include "IndexStoreDB/Index/StoreUnitInfo.h"
+#include "IndexStoreDB/Index/SymbolOccurrenceCount.h"
+#include "IndexStoreDB/Index/SymbolOccurrenceView.h"
+#include "IndexStoreDB/Support/Concurrency.h"
+#include "IndexStoreDB/Support/Metrics.h"
+#include "IndexStoreDB/Support/Path.h"
+#include "IndexStoreDB/SyntheticStore/SyntheticIndexStore.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+using namespace IndexStoreDB;
+using namespace IndexStoreDB::index;
+using namespace llvm;
+
+static cl::OptionCategory BenchmarkCategory("Synthetic store options");
+
+static cl::opt<unsigned> NumUnits("units", cl::desc("Number of units"),
+                                  cl::init(1000), cl::cat(BenchmarkCategory));
+static cl::opt<unsigned> RecordsPerUnit("records-per-unit",
+                                        cl::desc("Records per unit, including the main file record"),
+                                        cl::init(8), cl::cat(BenchmarkCategory));
+static cl::opt<unsigned> NumHeaders("headers", cl::desc("Size of the shared header pool"),
+                                    cl::init(200), cl::cat(BenchmarkCategory));
+static cl::opt<unsigned> SymbolsPerRecord("symbols-per-record",
+                                          cl::desc("Distinct symbols per record"),
+                                          cl::init(40), cl::cat(BenchmarkCategory));
+static cl::opt<unsigned> OccurrencesPerSymbol("occurrences-per-symbol",
+                                              cl::desc("Occurrences of each symbol in a record"),
+                                              cl::init(3), cl::cat(BenchmarkCategory));
+static cl::opt<unsigned> NumUSRs("usrs", cl::desc("Number of distinct USRs"),
+                                 cl::init(50000), cl::cat(BenchmarkCategory));
+static cl::opt<double> ZipfExponent("zipf", cl::desc("Exponent of the USR and header reuse distributions"),
+                                    cl::init(1.0), cl::cat(BenchmarkCategory));
+static cl::opt<unsigned> Seed("seed", cl::desc("Random seed"),
+                              cl::init(1), cl::cat(BenchmarkCategory));
+
+static cl::opt<unsigned> ModifiedUnits("modified-units",
+                                       cl::desc("Units to modify for the incremental re-import"),
+                                       cl::init(10));
+static cl::opt<unsigned> QueryIterations("query-iterations",
+                                         cl::desc("Samples taken for each query"),
+                                         cl::init(200));
+static cl::opt<unsigned> DispatchTasks("dispatch-tasks",
+                                       cl::desc("Tasks dispatched to measure the overhead of the work queues"),
+                                       cl::init(100000));
+static cl::opt<std::string> DBPath("db-path",
+                                   cl::desc("Database directory, a temporary one by default"));
+static cl::opt<bool> ShowProfiles("profile",
+                                  cl::desc("Print the aggregated query profile of each query"));
+static cl::opt<std::string> MetricsPath("metrics",
+                                        cl::desc("Collect the index metrics and write them as JSON to this file"));
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+class BenchmarkDelegate : public IndexSystemDelegate {};
+
+struct QueryResult {
+  std::string Name;
+  std::vector<double> LatenciesUs;
+  uint64_t Results = 0;
+  QueryProfile Profile;
+};
+
+class Benchmark {
+  SyntheticIndexStoreRef Store;
+  std::string StorePath;
+  std::string DBasePath;
+  std::mt19937_64 RNG;
+  std::unique_ptr<ZipfDistribution> SymbolDistribution;
+
+public:
+  Benchmark(SyntheticIndexStoreRef store, StringRef storePath, StringRef dbasePath)
+    : Store(std::move(store)), StorePath(storePath), DBasePath(dbasePath), RNG(Seed) {
+    SymbolDistribution.reset(new ZipfDistribution(std::max(Store->getOptions().numUSRs, 1u),
+                                                  Store->getOptions().zipfExponent));
+  }
+
+  std::shared_ptr<IndexSystem> openIndex(std::string &error) {
+    CreationOptions options;
+    options.wait = true;
+    options.listenToUnitEvents = false;
+    return IndexSystem::create(StorePath, DBasePath,
+                               std::make_shared<SyntheticIndexStoreLibraryProvider>(),
+                               std::make_shared<BenchmarkDelegate>(),
+                               options, /*initialDBSize=*/None, error);
+  }
+
+  unsigned sampleSymbol() { return (*SymbolDistribution)(RNG); }
+  unsigned sampleUnit() {
+    return std::uniform_int_distribution<unsigned>(0, Store->getOptions().numUnits - 1)(RNG);
+  }
+  unsigned sampleHeader() {
+    return std::uniform_int_distribution<unsigned>(0, Store->getOptions().numHeaders - 1)(RNG);
+  }
+
+  QueryResult measure(StringRef name, function_ref<uint64_t()> query) {
+    QueryResult result;
+    result.Name = name.str();
+    for (unsigned i = 0; i != QueryIterations; ++i) {
+      QueryProfile::Scope profileScope(result.Profile);
+      auto start = Clock::now();
+      result.Results += query();
+      result.LatenciesUs.push_back(secondsSince(start) * 1e6);
+    }
+    std::sort(result.LatenciesUs.begin(), result.LatenciesUs.end());
+    return result;
+  }
+
+  std::vector<QueryResult> measureQueries(IndexSystem &index);
+  /// Runs \p count queries concurrently. \returns the elapsed seconds.
+  double measureQueryFanOut(IndexSystem &index, unsigned count);
+  std::vector<unsigned> modifyUnits(unsigned count) { return Store->modifyUnits(count, RNG); }
+};
+
+} // anonymous namespace
+
+std::vector<QueryResult> Benchmark::measureQueries(IndexSystem &index) {
+  const SymbolRoleSet allRoles = SymbolRoleSet(SymbolRole::Declaration) |
+    SymbolRole::Definition | SymbolRole::Reference;
+  const SymbolRoleSet callerRoles = SymbolRoleSet(SymbolRole::RelationCalledBy) |
+    SymbolRole::RelationContainedBy;
+  std::vector<QueryResult> results;
+
+  auto countOccurrences = [](uint64_t &count) {
+    return [&count](SymbolOccurrenceRef) -> bool { ++count; return true; };
+  };
+
+  results.push_back(measure("foreachSymbolOccurrenceByUSR", [&]() -> uint64_t {
+    uint64_t count = 0;
+    index.foreachSymbolOccurrenceByUSR(Store->getSymbolUSR(sampleSymbol()), allRoles,
+                                       countOccurrences(count));
+    return count;
+  }));
+  results.push_back(measure("foreachRelatedSymbolOccurrenceByUSR", [&]() -> uint64_t {
+    uint64_t count = 0;
+    index.foreachRelatedSymbolOccurrenceByUSR(Store->getSymbolUSR(sampleSymbol()), callerRoles,
+                                              countOccurrences(count));
+    return count;
+  }));
+  results.push_back(measure("foreachSymbolOccurrenceViewByUSR", [&]() -> uint64_t {
+    uint64_t count = 0;
+    index.foreachSymbolOccurrenceViewByUSR(Store->getSymbolUSR(sampleSymbol()), allRoles,
+                                           [&](const SymbolOccurrenceView &) -> bool { ++count; return true; });
+    return count;
+  }));
+  results.push_back(measure("foreachRelatedSymbolOccurrenceViewByUSR", [&]() -> uint64_t {
+    uint64_t count = 0;
+    index.foreachRelatedSymbolOccurrenceViewByUSR(Store->getSymbolUSR(sampleSymbol()), callerRoles,
+                                                  [&](const SymbolOccurrenceView &) -> bool { ++count; return true; });
+    return count;
+  }));
+  results.push_back(measure("countSymbolOccurrencesByUSR", [&]() -> uint64_t {
+    return index.countSymbolOccurrencesByUSR(Store->getSymbolUSR(sampleSymbol()), allRoles).ProviderCount;
+  }));
+  results.push_back(measure("foreachCanonicalSymbolOccurrenceByUSR", [&]() -> uint64_t {
+    uint64_t count = 0;
+    index.foreachCanonicalSymbolOccurrenceByUSR(Store->getSymbolUSR(sampleSymbol()),
+                                                countOccurrences(count));
+    return count;
+  }));
+  results.push_back(measure("foreachCanonicalSymbolOccurrenceByName", [&]() -> uint64_t {
+    uint64_t count = 0;
+    index.foreachCanonicalSymbolOccurrenceByName(Store->getSymbolName(sampleSymbol()),
+                                                 countOccurrences(count));
+    return count;
+  }));
+  results.push_back(measure("foreachCanonicalSymbolOccurrenceContainingPattern", [&]() -> uint64_t {
+    uint64_t count = 0;
+    // The trailing digits make the pattern match a handful of symbols.
+    StringRef name = Store->getSymbolName(sampleSymbol());
+    index.foreachCanonicalSymbolOccurrenceContainingPattern(name.take_back(std::min<size_t>(name.size(), 6)),
+                                                           /*AnchorStart=*/false, /*AnchorEnd=*/true,
+                                                           /*Subsequence=*/false, /*IgnoreCase=*/true,
+                                                           countOccurrences(count));
+    return count;
+  }));
+  results.push_back(measure("foreachSymbolOccurrenceInFilePath", [&]() -> uint64_t {
+    uint64_t count = 0;
+    index.foreachSymbolOccurrenceInFilePath(Store->getMainFilePath(sampleUnit()),
+                                            countOccurrences(count));
+    return count;
+  }));
+  if (Store->getOptions().numHeaders) {
+    results.push_back(measure("foreachMainUnitContainingFile", [&]() -> uint64_t {
+      uint64_t count = 0;
+      index.foreachMainUnitContainingFile(Store->getHeaderPath(sampleHeader()),
+                                          [&](const StoreUnitInfo &) -> bool { ++count; return true; });
+      return count;
+    }));
+  }
+  results.push_back(measure("foreachFileIncludedByFile", [&]() -> uint64_t {
+    uint64_t count = 0;
+    index.foreachFileIncludedByFile(Store->getMainFilePath(sampleUnit()),
+                                    [&](CanonicalFilePathRef, unsigned) -> bool { ++count; return true; });
+    return count;
+  }));
+  results.push_back(measure("foreachUnitTestSymbol", [&]() -> uint64_t {
+    uint64_t count = 0;
+    index.foreachUnitTestSymbol(countOccurrences(count));
+    return count;
+  }));
+  return results;
+}
+
+double Benchmark::measureQueryFanOut(IndexSystem &index, unsigned count) {
+  const SymbolRoleSet allRoles = SymbolRoleSet(SymbolRole::Declaration) |
+    SymbolRole::Definition | SymbolRole::Reference;
+  // The random number generator is not thread-safe, sample up front.
+  std::vector<unsigned> symbols;
+  for (unsigned i = 0; i != count; ++i)
+    symbols.push_back(sampleSymbol());
+
+  auto start = Clock::now();
+  WorkQueue::concurrentPerform(count, [&](size_t i) {
+    index.foreachSymbolOccurrenceByUSR(Store->getSymbolUSR(symbols[i]), allRoles,
+                                       [](SymbolOccurrenceRef) -> bool { return true; });
+  });
+  return secondsSince(start);
+}
+
+/// Measures the per-task cost of the work queues, with tasks that do nothing.
+static void measureDispatchOverhead(raw_ostream &OS, unsigned numTasks) {
+  numTasks = std::max(numTasks, 1u);
+  auto nsPerTask = [&](Clock::time_point start) { return secondsSince(start) * 1e9 / numTasks; };
+
+  std::mutex doneMtx;
+  std::condition_variable doneCV;
+  std::atomic<unsigned> numDone{0};
+  auto start = Clock::now();
+  for (unsigned i = 0; i != numTasks; ++i) {
+    WorkQueue::dispatchConcurrent([&] {
+      if (numDone.fetch_add(1) + 1 == numTasks) {
+        std::lock_guard<std::mutex> L(doneMtx);
+        doneCV.notify_one();
+      }
+    });
+  }
+  {
+    std::unique_lock<std::mutex> L(doneMtx);
+    doneCV.wait(L, [&] { return numDone.load() == numTasks; });
+  }
+  OS << format("dispatchConcurrent:    %8.1f ns/task\n", nsPerTask(start));
+
+  WorkQueue serialQueue(WorkQueue::Dequeuing::Serial, "isdb-benchmark.serial");
+  unsigned serialCount = 0;
+  start = Clock::now();
+  for (unsigned i = 0; i != numTasks; ++i)
+    serialQueue.dispatch([&serialCount] { ++serialCount; });
+  serialQueue.dispatchSync([] {});
+  OS << format("serial queue dispatch: %8.1f ns/task\n", nsPerTask(start));
+
+  std::atomic<unsigned> performCount{0};
+  start = Clock::now();
+  WorkQueue::concurrentPerform(numTasks, [&](size_t) { performCount.fetch_add(1, std::memory_order_relaxed); });
+  OS << format("concurrentPerform:     %8.1f ns/iteration\n", nsPerTask(start));
+}
+
+static double percentile(ArrayRef<double> sorted, double p) {
+  if (sorted.empty())
+    return 0;
+  size_t idx = std::min(sorted.size() - 1, size_t(p * (sorted.size() - 1) + 0.5));
+  return sorted[idx];
+}
+
+int main(int argc, const char **argv) {
+  cl::ParseCommandLineOptions(argc, argv, "IndexStoreDB benchmark over a synthetic index store\n");
+  raw_ostream &OS = outs();
+  if (!MetricsPath.empty())
+    metrics::Registry::setEnabled(true);
+
+  SmallString<128> workDir;
+  if (DBPath.empty()) {
+    if (std::error_code EC = sys::fs::createUniqueDirectory("isdb-benchmark", workDir)) {
+      errs() << "error: could not create a temporary directory: " << EC.message() << '\n';
+      return 1;
+    }
+  } else {
+    workDir = DBPath;
+  }
+  SmallString<128> storePath = workDir;
+  sys::path::append(storePath, "store");
+  SmallString<128> dbasePath = workDir;
+  sys::path::append(dbasePath, "db");
+
+  SyntheticStoreOptions storeOptions;
+  storeOptions.numUnits = std::max(NumUnits.getValue(), 1u);
+  storeOptions.recordsPerUnit = RecordsPerUnit;
+  storeOptions.numHeaders = NumHeaders;
+  storeOptions.symbolsPerRecord = SymbolsPerRecord;
+  storeOptions.occurrencesPerSymbol = OccurrencesPerSymbol;
+  storeOptions.numUSRs = NumUSRs;
+  storeOptions.zipfExponent = ZipfExponent;
+  storeOptions.seed = Seed;
+
+  auto start = Clock::now();
+  auto store = SyntheticIndexStore::create(storePath, storeOptions);
+  OS << "generated " << storeOptions.numUnits << " units, " << store->getNumRecords()
+     << " records, " << store->getNumOccurrences() << " occurrences in "
+     << format("%.2fs", secondsSince(start)) << '\n';
+  OS << "database: " << dbasePath << '\n';
+  OS << "work queue executor: " << WorkQueue::getExecutorName() << "\n\n";
+
+  Benchmark bench(store, storePath, dbasePath);
+  std::string error;
+
+  start = Clock::now();
+  auto index = bench.openIndex(error);
+  if (!index) {
+    errs() << "error: " << error << '\n';
+    return 1;
+  }
+  double coldImport = secondsSince(start);
+  OS << format("cold import:           %8.3fs  %10.0f units/s  %12.0f occurrences/s\n",
+               coldImport, storeOptions.numUnits / coldImport,
+               store->getNumOccurrences() / coldImport);
+
+  unsigned modifiedCount = bench.modifyUnits(ModifiedUnits).size();
+  start = Clock::now();
+  index->pollForUnitChangesAndWait(/*isInitialScan=*/false);
+  double incremental = secondsSince(start);
+  OS << format("incremental re-import: %8.3fs  %10.0f units/s  (%u modified units)\n",
+               incremental, modifiedCount / std::max(incremental, 1e-9), modifiedCount);
+
+  index.reset();
+  start = Clock::now();
+  index = bench.openIndex(error);
+  if (!index) {
+    errs() << "error: " << error << '\n';
+    return 1;
+  }
+  double reopen = secondsSince(start);
+  OS << format("up-to-date reopen:     %8.3fs  %10.0f units/s\n\n",
+               reopen, storeOptions.numUnits / reopen);
+
+  measureDispatchOverhead(OS, DispatchTasks);
+  unsigned fanOutQueries = std::max(QueryIterations.getValue(), 1u) * 10;
+  double fanOut = bench.measureQueryFanOut(*index, fanOutQueries);
+  OS << format("query fan-out:         %8.3fs  %10.0f queries/s  (%u queries)\n\n",
+               fanOut, fanOutQueries / std::max(fanOut, 1e-9), fanOutQueries);
+
+  auto results = bench.measureQueries(*index);
+  OS << left_justify("query (us)", 50) << ' ' << right_justify("p50", 10) << ' '
+     << right_justify("p99", 10) << ' ' << right_justify("max", 10) << ' '
+     << right_justify("avg results", 12) << '\n';
+  for (const auto &result : results) {
+    OS << format("%-50s %10.1f %10.1f %10.1f %12.1f\n", result.Name.c_str(),
+                 percentile(result.LatenciesUs, 0.5), percentile(result.LatenciesUs, 0.99),
+                 result.LatenciesUs.empty() ? 0.0 : result.LatenciesUs.back(),
+                 double(result.Results) / std::max(QueryIterations.getValue(), 1u));
+  }
+
+  if (ShowProfiles) {
+    for (const auto &result : results) {
+      OS << '\n' << result.Name << ":\n";
+      result.Profile.print(OS);
+    }
+  }
+
+  if (!MetricsPath.empty()) {
+    std::error_code EC;
+    raw_fd_ostream metricsOS(MetricsPath, EC, sys::fs::OF_Text);
+    if (EC) {
+      errs() << "error: could not write " << MetricsPath << ": " << EC.message() << '\n';
+      return 1;
+    }
+    index->writeMetricsJSON(metricsOS);
+  }
+
+  index.reset();
+  if (DBPath.empty())
+    sys::fs::remove_directories(workDir);
+  return 0;
+}
@@ -10,8 +10,10 @@
 //
 //===----------------------------------------------------------------------===//
 
+import CIndexStoreDB
 import IndexStoreDB
 import ISDBTestSupport
+import ISDBTibs
 import XCTest
 
 let defaultTimeout: TimeInterval = 30
@@ -340,6 +342,218 @@ final class IndexTests: XCTestCase {
     ])
   }
 
+  func testOccurrenceCounts() throws {
+    guard let ws = try mutableTibsTestWorkspace(name: "proj1") else { return }
+    let usr = "s:4main1cyyF"
+
+    try ws.buildAndIndex()
+    XCTAssertEqual(ws.index.occurrenceCount(ofUSR: usr, roles: .all),
+                   SymbolOccurrenceCount(providerCount: 2, fileCount: 2, occurrenceCount: nil, isExact: true))
+
+    try ws.reinitIndexStore(recordOccurrenceCounts: true)
+
+    try ws.edit(rebuild: true) { editor, files in
+      let url = ws.testLoc("c:call").url
+      let new = try files.get(url).appending("""
+
+        func anotherOne() {
+          /*c:anotherOne*/c()
+        }
+        """)
+
+      editor.write(new, to: url)
+    }
+
+    // Only the record that was imported after enabling occurrence counts has them.
+    XCTAssertNil(ws.index.occurrenceCount(ofUSR: usr, roles: .all).occurrenceCount)
+    XCTAssertEqual(ws.index.occurrenceCount(ofUSR: usr, roles: .call),
+                   SymbolOccurrenceCount(providerCount: 1, fileCount: 1, occurrenceCount: 2, isExact: false))
+    XCTAssertEqual(ws.index.occurrences(ofUSR: usr, roles: .call).count, 2)
+
+    XCTAssertEqual(ws.index.occurrenceCount(ofUSR: "s:4main7missingyyF", roles: .all),
+                   SymbolOccurrenceCount(providerCount: 0, fileCount: 0, occurrenceCount: 0, isExact: true))
+  }
+
+  func testCancellation() throws {
+    guard let ws = try staticTibsTestWorkspace(name: "proj1") else { return }
+    try ws.buildAndIndex()
+    let usr = "s:4main1cyyF"
+
+    let token = CancellationToken()
+    var count = 0
+    XCTAssertTrue(ws.index.forEachSymbolOccurrence(byUSR: usr, roles: .all, cancellationToken: token) { _ in
+      count += 1
+      return true
+    })
+    XCTAssertEqual(count, ws.index.occurrences(ofUSR: usr, roles: .all).count)
+
+    token.cancel()
+    XCTAssertTrue(token.isCancelled)
+    XCTAssertFalse(ws.index.forEachSymbolOccurrence(byUSR: usr, roles: .all, cancellationToken: token) { _ in
+      XCTFail("unexpected occurrence after cancellation")
+      return true
+    })
+    XCTAssertFalse(ws.index.forEachRelatedSymbolOccurrence(byUSR: usr, roles: .calledBy, cancellationToken: token) { _ in
+      XCTFail("unexpected occurrence after cancellation")
+      return true
+    })
+    // The lookup finds no provider to check the token against.
+    XCTAssertFalse(ws.index.forEachSymbolOccurrence(byUSR: "s:4main7missingyyF", roles: .all, cancellationToken: token) { _ in
+      return true
+    })
+    XCTAssertFalse(ws.index.forEachCanonicalSymbolOccurrence(
+      containing: "c", anchorStart: false, anchorEnd: false, subsequence: true, ignoreCase: true,
+      cancellationToken: token
+    ) { _ in
+      XCTFail("unexpected occurrence after cancellation")
+      return true
+    })
+    XCTAssertFalse(ws.index.forEachSymbolName(cancellationToken: token) { _ in
+      XCTFail("unexpected symbol name after cancellation")
+      return true
+    })
+
+    let expired = CancellationToken(timeout: 0)
+    XCTAssertTrue(expired.isCancelled)
+    XCTAssertFalse(ws.index.forEachCanonicalSymbolOccurrence(byName: "c", cancellationToken: expired) { _ in
+      return true
+    })
+  }
+
+  func testAsyncQuery() throws {
+    guard let ws = try staticTibsTestWorkspace(name: "proj1") else { return }
+    try ws.buildAndIndex()
+    let usr = "s:4main1cyyF"
+    let expected = ws.index.occurrences(ofUSR: usr, roles: .all)
+    XCTAssertGreaterThan(expected.count, 1)
+
+    var batches: [[SymbolOccurrence]] = []
+    var result: Bool? = nil
+    let query = ws.index.forEachSymbolOccurrenceAsync(
+      byUSR: usr, roles: .all, priority: .high, batchSize: 1,
+      receiver: { occurs in
+        batches.append(occurs)
+        return true
+      },
+      completion: { finished in
+        result = finished
+      })
+    query.wait()
+    XCTAssertTrue(query.isFinished)
+    XCTAssertEqual(result, true)
+    XCTAssertEqual(batches.map { $0.count }, Array(repeating: 1, count: expected.count))
+    XCTAssertEqual(Array(batches.joined()), expected)
+
+    var stopped: [SymbolOccurrence] = []
+    result = nil
+    ws.index.forEachSymbolOccurrenceAsync(
+      byUSR: usr, roles: .all,
+      receiver: { occurs in
+        stopped += occurs
+        return false
+      },
+      completion: { finished in
+        result = finished
+      }).wait()
+    XCTAssertEqual(result, false)
+    XCTAssertEqual(stopped, expected)
+
+    result = nil
+    ws.index.forEachSymbolOccurrenceAsync(
+      byUSR: usr, roles: .all, cancellationToken: CancellationToken(timeout: 0),
+      receiver: { _ in
+        XCTFail("unexpected occurrences after cancellation")
+        return true
+      },
+      completion: { finished in
+        result = finished
+      }).wait()
+    XCTAssertEqual(result, false)
+
+    /// Runs the query that `start` makes and returns all the occurrences it delivered.
+    func collect(
+      _ start: (@escaping ([SymbolOccurrence]) -> Bool, @escaping (Bool) -> Void) -> AsyncQuery
+    ) -> [SymbolOccurrence] {
+      var occurs: [SymbolOccurrence] = []
+      var finished: Bool? = nil
+      start({ occurs += $0; return true }, { finished = $0 }).wait()
+      XCTAssertEqual(finished, true)
+      return occurs
+    }
+
+    let expectedRelated = ws.index.occurrences(relatedToUSR: "s:4main1ayyF", roles: .all)
+    XCTAssertFalse(expectedRelated.isEmpty)
+    XCTAssertEqual(collect {
+      ws.index.forEachRelatedSymbolOccurrenceAsync(
+        byUSR: "s:4main1ayyF", roles: .all, batchSize: 1, receiver: $0, completion: $1)
+    }, expectedRelated)
+
+    let expectedByName = ws.index.canonicalOccurrences(ofName: "c")
+    XCTAssertFalse(expectedByName.isEmpty)
+    XCTAssertEqual(collect {
+      ws.index.forEachCanonicalSymbolOccurrenceAsync(byName: "c", receiver: $0, completion: $1)
+    }, expectedByName)
+
+    let expectedPattern = ws.index.canonicalOccurrences(
+      containing: "c", anchorStart: true, anchorEnd: false, subsequence: false, ignoreCase: false)
+    XCTAssertFalse(expectedPattern.isEmpty)
+    XCTAssertEqual(collect {
+      ws.index.forEachCanonicalSymbolOccurrenceAsync(
+        containing: "c", anchorStart: true, anchorEnd: false, subsequence: false, ignoreCase: false,
+        receiver: $0, completion: $1)
+    }, expectedPattern)
+  }
+
+  func testQueryProfile() throws {
+    guard let ws = try staticTibsTestWorkspace(name: "proj1") else { return }
+    try ws.buildAndIndex()
+    let usr = "s:4main1cyyF"
+
+    let (occurrences, profile) = IndexStoreDB.profileQueries {
+      ws.index.occurrences(ofUSR: usr, roles: .all)
+    }
+    XCTAssertEqual(occurrences.count, ws.index.occurrences(ofUSR: usr, roles: .all).count)
+    XCTAssertGreaterThan(profile.readTransactions, 0)
+    XCTAssertGreaterThan(profile.databaseLookups, 0)
+    XCTAssertEqual(profile.providersResolved, 2)
+    XCTAssertEqual(profile.recordsOpened, 2)
+    XCTAssertGreaterThan(profile.occurrencesDecoded, 0)
+    XCTAssertGreaterThan(profile.totalTime, 0)
+    XCTAssertLessThanOrEqual(
+      profile.lookupProvidersTime + profile.resolveProvidersTime + profile.readRecordsTime,
+      profile.totalTime)
+
+    let (_, emptyProfile) = IndexStoreDB.profileQueries { () -> Void in }
+    XCTAssertEqual(emptyProfile.readTransactions, 0)
+    XCTAssertEqual(emptyProfile.recordsOpened, 0)
+  }
+
+  func testMetrics() throws {
+    guard let ws = try staticTibsTestWorkspace(name: "proj1") else { return }
+    IndexStoreDB.setMetricsEnabled(true)
+    defer { IndexStoreDB.setMetricsEnabled(false) }
+    IndexStoreDB.resetMetrics()
+    try ws.buildAndIndex()
+    _ = ws.index.occurrences(ofUSR: "s:4main1cyyF", roles: .all)
+
+    let json = try JSONSerialization.jsonObject(with: Data(ws.index.metricsJSON().utf8)) as! [String: Any]
+    XCTAssertEqual(json["enabled"] as? Bool, true)
+    let counters = json["counters"] as! [String: Int]
+    XCTAssertGreaterThan(counters["import.units_imported"]!, 0)
+    XCTAssertGreaterThan(counters["database.import_transactions"]!, 0)
+    XCTAssertGreaterThan(counters["database.read_transactions"]!, 0)
+    XCTAssertGreaterThanOrEqual(counters["records.opened"]!, 2)
+    let histograms = json["histograms"] as! [String: [String: Any]]
+    XCTAssertGreaterThanOrEqual(histograms["query.symbol_occurrences_by_usr"]?["count"] as! Int, 1)
+    let database = json["database"] as! [String: Any]
+    XCTAssertGreaterThan(database["map_size"] as! Int, 0)
+    XCTAssertFalse((database["tables"] as! [Any]).isEmpty)
+    let unitProcessing = json["unit_processing"] as! [String: Int]
+    XCTAssertEqual(unitProcessing["weight"], 1)
+    XCTAssertEqual(unitProcessing["queued_work"], 0)
+    XCTAssertGreaterThan(unitProcessing["scheduled_work"]!, 0)
+  }
+
   func testWaitUntilDoneInitializing() throws {
     guard let ws = try staticTibsTestWorkspace(name: "proj1") else { return }
     try ws.builder.build()
@@ -366,6 +580,224 @@ final class IndexTests: XCTestCase {
     ])
   }
 
+  func testReopenUpToDateStore() throws {
+    guard let ws = try staticTibsTestWorkspace(name: "proj1") else { return }
+    try ws.builder.build()
+    let libIndexStore = try IndexStoreLibrary(dylibPath: ws.builder.toolchain.libIndexStore.path)
+    let databasePath = ws.tmpDir.appendingPathComponent("reopen", isDirectory: true).path
+    func openIndex() throws -> IndexStoreDB {
+      return try IndexStoreDB(
+        storePath: ws.builder.indexstore.path,
+        databasePath: databasePath,
+        library: libIndexStore,
+        waitUntilDoneInitializing: true,
+        listenToUnitEvents: true)
+    }
+
+    let csym = Symbol(usr: "s:4main1cyyF", name: "c()", kind: .function, language: .swift)
+    var index: IndexStoreDB? = try openIndex()
+    let initialOccs = index!.occurrences(ofUSR: csym.usr, roles: [.reference, .definition])
+    XCTAssertEqual(initialOccs.count, 2)
+    index = nil
+
+    // All the units are up-to-date, the initial scan of the reopened index
+    // doesn't go through the import path.
+    IndexStoreDB.setMetricsEnabled(true)
+    defer { IndexStoreDB.setMetricsEnabled(false) }
+    IndexStoreDB.resetMetrics()
+    index = try openIndex()
+    let reopenedOccs = index!.occurrences(ofUSR: csym.usr, roles: [.reference, .definition])
+    checkOccurrences(reopenedOccs, expected: initialOccs)
+
+    let json = try JSONSerialization.jsonObject(with: index!.metricsJSON().data(using: .utf8)!) as! [String: Any]
+    let counters = json["counters"] as! [String: Any]
+    XCTAssertEqual(counters["import.units_imported"] as! Int, 0)
+    XCTAssertGreaterThan(counters["import.units_up_to_date"] as! Int, 0)
+  }
+
+  func testPollAfterReopen() throws {
+    class Delegate: IndexDelegate {
+      let queue: DispatchQueue = DispatchQueue(label: "testPollAfterReopen mutex")
+      var _added: Int = 0
+      var added: Int { queue.sync { _added } }
+
+      func processingAddedPending(_ count: Int) {
+        queue.sync {
+          _added += count
+        }
+      }
+      func processingCompleted(_ count: Int) {}
+    }
+
+    guard let ws = try staticTibsTestWorkspace(name: "proj1") else { return }
+    try ws.builder.build()
+    let libIndexStore = try IndexStoreLibrary(dylibPath: ws.builder.toolchain.libIndexStore.path)
+    let databasePath = ws.tmpDir.appendingPathComponent("poll", isDirectory: true).path
+    func openIndex(delegate: IndexDelegate) throws -> IndexStoreDB {
+      return try IndexStoreDB(
+        storePath: ws.builder.indexstore.path,
+        databasePath: databasePath,
+        library: libIndexStore,
+        delegate: delegate,
+        listenToUnitEvents: false)
+    }
+
+    let firstDelegate = Delegate()
+    var index: IndexStoreDB? = try openIndex(delegate: firstDelegate)
+    index!.pollForUnitChangesAndWait()
+    XCTAssertEqual(firstDelegate.added, 3)
+    index = nil
+
+    // The units found by the previous poll were recorded in the database, a
+    // poll of the reopened index only reports the changes since then.
+    let reopenDelegate = Delegate()
+    index = try openIndex(delegate: reopenDelegate)
+    index!.pollForUnitChangesAndWait()
+    XCTAssertEqual(reopenDelegate.added, 0)
+
+    let csym = Symbol(usr: "s:4main1cyyF", name: "c()", kind: .function, language: .swift)
+    XCTAssertEqual(index!.occurrences(ofUSR: csym.usr, roles: [.reference, .definition]).count, 2)
+  }
+
+  func testSnapshot() throws {
+    guard let ws = try staticTibsTestWorkspace(name: "proj1") else { return }
+    try ws.buildAndIndex()
+    let csym = Symbol(usr: "s:4main1cyyF", name: "c()", kind: .function, language: .swift)
+    let expectedPaths = Set(ws.index.occurrences(ofUSR: csym.usr, roles: [.reference, .definition]).map(\.location.path))
+    XCTAssertEqual(expectedPaths.count, 2)
+    // The directory of the sources, as recorded in the database.
+    let definition = ws.index.occurrences(ofUSR: csym.usr, roles: .definition)[0]
+    let rootPath = URL(fileURLWithPath: definition.location.path).deletingLastPathComponent().path
+
+    let snapshotPath = ws.tmpDir.appendingPathComponent("snapshot", isDirectory: true).path
+    try ws.index.exportSnapshot(to: snapshotPath, prefixMappings: [
+      PathMapping(original: rootPath, replacement: "/SRC_ROOT"),
+    ])
+    XCTAssertThrowsError(try ws.index.exportSnapshot(to: snapshotPath))
+
+    // The seeded database has the data of the snapshot, with the local paths,
+    // before anything is imported from the store.
+    let libIndexStore = try IndexStoreLibrary(dylibPath: ws.builder.toolchain.libIndexStore.path)
+    let index = try IndexStoreDB(
+      storePath: ws.builder.indexstore.path,
+      databasePath: ws.tmpDir.appendingPathComponent("seeded", isDirectory: true).path,
+      library: libIndexStore,
+      listenToUnitEvents: false,
+      snapshotPath: snapshotPath,
+      snapshotPrefixMappings: [PathMapping(original: "/SRC_ROOT", replacement: rootPath)])
+    XCTAssertEqual(Set(index.occurrences(ofUSR: csym.usr, roles: [.reference, .definition]).map(\.location.path)),
+                   expectedPaths)
+
+    index.pollForUnitChangesAndWait(isInitialScan: true)
+    XCTAssertEqual(Set(index.occurrences(ofUSR: csym.usr, roles: [.reference, .definition]).map(\.location.path)),
+                   expectedPaths)
+  }
+
+  func testSharedDatabase() throws {
+    guard let ws = try staticTibsTestWorkspace(name: "proj1") else { return }
+    try ws.builder.build()
+    let csym = Symbol(usr: "s:4main1cyyF", name: "c()", kind: .function, language: .swift)
+    let libIndexStore = try IndexStoreLibrary(dylibPath: ws.builder.toolchain.libIndexStore.path)
+    let databasePath = ws.tmpDir.appendingPathComponent("shared", isDirectory: true).path
+
+    func openIndex() throws -> IndexStoreDB {
+      return try IndexStoreDB(
+        storePath: ws.builder.indexstore.path,
+        databasePath: databasePath,
+        library: libIndexStore,
+        listenToUnitEvents: false,
+        shareDatabase: true)
+    }
+
+    var index: IndexStoreDB? = try openIndex()
+    index!.pollForUnitChangesAndWait(isInitialScan: true)
+    XCTAssertEqual(index!.occurrences(ofUSR: csym.usr, roles: [.reference, .definition]).count, 2)
+    index = nil
+
+    // The next process opens the same database in place, before importing
+    // anything.
+    index = try openIndex()
+    XCTAssertEqual(index!.occurrences(ofUSR: csym.usr, roles: [.reference, .definition]).count, 2)
+  }
+
+  func testBulkLoad() throws {
+    IndexStoreDB.setMetricsEnabled(true)
+    defer { IndexStoreDB.setMetricsEnabled(false) }
+    func bulkLoadCounters(_ index: IndexStoreDB) throws -> (loads: Int, entries: Int) {
+      let json = try JSONSerialization.jsonObject(with: Data(index.metricsJSON().utf8)) as! [String: Any]
+      let counters = json["counters"] as! [String: Int]
+      return (counters["database.bulk_loads"] ?? 0, counters["database.bulk_load_entries"] ?? 0)
+    }
+
+    // proj1 has USRs with several providers, MainFiles has a header that is
+    // part of several units; both go in DUPSORT tables.
+    for project in ["proj1", "MainFiles"] {
+      guard let ws = try staticTibsTestWorkspace(name: project) else { return }
+      try ws.builder.build()
+      let libIndexStore = try IndexStoreLibrary(dylibPath: ws.builder.toolchain.libIndexStore.path)
+      func openIndex(_ name: String) throws -> IndexStoreDB {
+        return try IndexStoreDB(
+          storePath: ws.builder.indexstore.path,
+          databasePath: ws.tmpDir.appendingPathComponent(name, isDirectory: true).path,
+          library: libIndexStore,
+          listenToUnitEvents: false)
+      }
+
+      // The initial scan of an empty database is bulk loaded, a poll that is
+      // not an initial scan imports the units one at a time.
+      IndexStoreDB.resetMetrics()
+      let bulk = try openIndex("bulk")
+      bulk.pollForUnitChangesAndWait(isInitialScan: true)
+      let bulkCounters = try bulkLoadCounters(bulk)
+      XCTAssertEqual(bulkCounters.loads, 1)
+      XCTAssertGreaterThan(bulkCounters.entries, 0)
+
+      IndexStoreDB.resetMetrics()
+      let regular = try openIndex("regular")
+      regular.pollForUnitChangesAndWait(isInitialScan: false)
+      XCTAssertEqual(try bulkLoadCounters(regular).loads, 0)
+
+      let names = regular.allSymbolNames().sorted()
+      XCTAssertFalse(names.isEmpty)
+      XCTAssertEqual(bulk.allSymbolNames().sorted(), names)
+
+      var usrs: Set<String> = []
+      var paths: Set<String> = []
+      var hasSeveralProviders = false
+      for name in names {
+        let canonicals = regular.canonicalOccurrences(ofName: name)
+        checkOccurrences(bulk.canonicalOccurrences(ofName: name), ignoreRelations: false,
+                         allowAdditionalRoles: false, expected: canonicals)
+        usrs.formUnion(canonicals.map(\.symbol.usr))
+      }
+      for usr in usrs {
+        let occurs = regular.occurrences(ofUSR: usr, roles: .all)
+        checkOccurrences(bulk.occurrences(ofUSR: usr, roles: .all), ignoreRelations: false,
+                         allowAdditionalRoles: false, expected: occurs)
+        checkOccurrences(bulk.occurrences(relatedToUSR: usr, roles: .all), ignoreRelations: false,
+                         allowAdditionalRoles: false, expected: regular.occurrences(relatedToUSR: usr, roles: .all))
+        XCTAssertEqual(bulk.occurrenceCount(ofUSR: usr, roles: .all), regular.occurrenceCount(ofUSR: usr, roles: .all))
+        let occurPaths = Set(occurs.map(\.location.path))
+        hasSeveralProviders = hasSeveralProviders || occurPaths.count > 1
+        paths.formUnion(occurPaths)
+      }
+      XCTAssertTrue(hasSeveralProviders || project != "proj1")
+
+      var hasSeveralUnits = false
+      for path in paths {
+        let mainFiles = Set(regular.mainFilesContainingFile(path: path))
+        XCTAssertEqual(Set(bulk.mainFilesContainingFile(path: path)), mainFiles)
+        XCTAssertEqual(Set(bulk.unitNamesContainingFile(path: path)), Set(regular.unitNamesContainingFile(path: path)))
+        XCTAssertEqual(bulk.filesIncludedByFile(path: path).sorted(), regular.filesIncludedByFile(path: path).sorted())
+        XCTAssertEqual(bulk.filesIncludingFile(path: path).sorted(), regular.filesIncludingFile(path: path).sorted())
+        checkOccurrences(bulk.symbolOccurrences(inFilePath: path), ignoreRelations: false,
+                         allowAdditionalRoles: false, expected: regular.symbolOccurrences(inFilePath: path))
+        hasSeveralUnits = hasSeveralUnits || mainFiles.count > 1
+      }
+      XCTAssertTrue(hasSeveralUnits || project != "MainFiles")
+    }
+  }
+
   func testDelegate() throws {
     class Delegate: IndexDelegate {
       let queue: DispatchQueue = DispatchQueue(label: "testDelegate mutex")
@@ -471,6 +903,145 @@ final class IndexTests: XCTestCase {
     XCTAssertNil(delegate.outOfDateInfo)
   }
 
+  func testOutOfDateFileWatching() throws {
+    class Delegate: IndexDelegate {
+      let queue: DispatchQueue = DispatchQueue(label: "testDelegate mutex")
+      private var _triggerHintFiles: [String] = []
+      var triggerHintFiles: [String] { queue.sync { _triggerHintFiles } }
+
+      func processingAddedPending(_ count: Int) {}
+      func processingCompleted(_ count: Int) {}
+
+      func unitIsOutOfDate(
+        _ unitInfo: StoreUnitInfo,
+        outOfDateModTime: UInt64,
+        triggerHintFile: String,
+        triggerHintDescription: String,
+        synchronous: Bool
+      ) {
+        queue.sync {
+          _triggerHintFiles.append(triggerHintFile)
+        }
+      }
+    }
+
+    guard let ws = try mutableTibsTestWorkspace(name: "proj1") else { return }
+    try ws.buildAndIndex()
+    let delegate = Delegate()
+    ws.delegate = delegate
+    try ws.reinitIndexStore(
+      waitUntilDoneInitializing: true,
+      enableOutOfDateFileWatching: true,
+      listenToUnitEvents: true
+    )
+    XCTAssertEqual(delegate.triggerHintFiles, [])
+
+    // The change is only seen by watching the directory of the file.
+    let fileToChange = ws.testLoc("c").url
+    let modTime = try XCTUnwrap(Calendar.current.date(byAdding: .day, value: 1, to: Date()))
+    try FileManager.default.setAttributes([.modificationDate: modTime], ofItemAtPath: fileToChange.path)
+
+    waitForBlock({ !delegate.triggerHintFiles.isEmpty })
+    XCTAssertEqual(delegate.triggerHintFiles.first, fileToChange.path)
+  }
+
+  func testOutOfDateBatchedEvents() throws {
+    class Delegate: IndexDelegate {
+      let queue: DispatchQueue = DispatchQueue(label: "testDelegate mutex")
+      private var _batches: [[OutOfDateUnitInfo]] = []
+      var batches: [[OutOfDateUnitInfo]] { queue.sync { _batches } }
+
+      func processingAddedPending(_ count: Int) {}
+      func processingCompleted(_ count: Int) {}
+
+      func unitsAreOutOfDate(_ units: [OutOfDateUnitInfo], synchronous: Bool) {
+        queue.sync {
+          _batches.append(units)
+        }
+      }
+    }
+
+    guard let ws = try mutableTibsTestWorkspace(name: "proj1") else { return }
+    try ws.buildAndIndex()
+
+    let filesToChange = [ws.testLoc("a:def").url, ws.testLoc("c").url]
+    let modTime = try XCTUnwrap(Calendar.current.date(byAdding: .day, value: 1, to: Date()))
+    for file in filesToChange {
+      try FileManager.default.setAttributes([.modificationDate: modTime], ofItemAtPath: file.path)
+    }
+    let delegate = Delegate()
+    ws.delegate = delegate
+    try ws.reinitIndexStore(
+      waitUntilDoneInitializing: true,
+      enableOutOfDateFileWatching: true,
+      listenToUnitEvents: true,
+      delegateBatchInterval: 1
+    )
+
+    // The units found out-of-date by the initial scan are delivered together.
+    waitForBlock({ !delegate.batches.isEmpty })
+    XCTAssertEqual(delegate.batches.count, 1)
+    let mainFiles = Set(delegate.batches.joined().map { $0.unitInfo.mainFilePath })
+    XCTAssertTrue(mainFiles.isSuperset(of: filesToChange.map { $0.path }))
+  }
+
+  func testOutOfDateEventsOfCDelegate() throws {
+    class Events {
+      let queue: DispatchQueue = DispatchQueue(label: "testDelegate mutex")
+      private var _kinds: [indexstoredb_delegate_event_kind_t] = []
+      private var _mainFiles: Set<String> = []
+      var kinds: [indexstoredb_delegate_event_kind_t] { queue.sync { _kinds } }
+      var mainFiles: Set<String> { queue.sync { _mainFiles } }
+
+      func add(_ event: indexstoredb_delegate_event_t) {
+        let kind = indexstoredb_delegate_event_get_kind(event)
+        var mainFile: String? = nil
+        if kind == INDEXSTOREDB_EVENT_UNIT_OUT_OF_DATE {
+          let unitInfo = indexstoredb_delegate_event_get_outofdate_unit_info(event)!
+          mainFile = String(cString: indexstoredb_unit_info_main_file_path(unitInfo))
+        }
+        queue.sync {
+          _kinds.append(kind)
+          if let mainFile = mainFile {
+            _mainFiles.insert(mainFile)
+          }
+        }
+      }
+    }
+
+    guard let ws = try mutableTibsTestWorkspace(name: "proj1") else { return }
+    try ws.buildAndIndex()
+
+    let filesToChange = [ws.testLoc("a:def").url, ws.testLoc("c").url]
+    let modTime = try XCTUnwrap(Calendar.current.date(byAdding: .day, value: 1, to: Date()))
+    for file in filesToChange {
+      try FileManager.default.setAttributes([.modificationDate: modTime], ofItemAtPath: file.path)
+    }
+
+    var error: indexstoredb_error_t? = nil
+    let library = try XCTUnwrap(indexstoredb_load_indexstore_library(TibsToolchain.testDefault.libIndexStore.path, &error))
+    defer { indexstoredb_release(library) }
+    let events = Events()
+    let options = indexstoredb_creation_options_create()
+    defer { indexstoredb_creation_options_dispose(options) }
+    indexstoredb_creation_options_wait(options, true)
+    indexstoredb_creation_options_enable_out_of_date_file_watching(options, true)
+    indexstoredb_creation_options_listen_to_unit_events(options, true)
+    // Collecting the events doesn't batch the out-of-date units of a client that didn't opt into it.
+    indexstoredb_creation_options_delegate_batch_interval(options, 1000)
+
+    let index = try XCTUnwrap(indexstoredb_index_create(
+      ws.builder.indexstore.path,
+      ws.tmpDir.appendingPathComponent("c-db", isDirectory: true).path,
+      { _ in library },
+      { events.add($0) },
+      options, &error))
+    defer { indexstoredb_release(index) }
+
+    waitForBlock({ events.mainFiles.isSuperset(of: filesToChange.map { $0.path }) })
+    XCTAssertFalse(events.kinds.contains(INDEXSTOREDB_EVENT_UNITS_OUT_OF_DATE))
+  }
+
   func testMainFilesContainingFile() throws {
     guard let ws = try staticTibsTestWorkspace(name: "MainFiles") else { return }
     try ws.buildAndIndex()
@@ -571,6 +1142,19 @@ final class IndexTests: XCTestCase {
       ddecl.at(ws.testLoc("D:ref"), roles: .reference, symbolProvider: .clang),
     ])
 
+    // Setting the whole set adds back the missing unit.
+    index.setUnitOutFilePaths(indexOutputPaths, waitForProcessing: true)
+    checkOccurrences(getOccs(), expected: [
+      ddecl.at(ws.testLoc("D:def"), roles: .definition, symbolProvider: .clang),
+      ddecl.at(ws.testLoc("D:ref"), roles: .reference, symbolProvider: .clang),
+      ddecl.at(ws.testLoc("D:ref:e.mm"), roles: .reference, symbolProvider: .clang),
+    ])
+    index.setUnitOutFilePaths(indexOutputPaths.filter { $0 != outUnitEMM }, waitForProcessing: true)
+    checkOccurrences(getOccs(), expected: [
+      ddecl.at(ws.testLoc("D:def"), roles: .definition, symbolProvider: .clang),
+      ddecl.at(ws.testLoc("D:ref"), roles: .reference, symbolProvider: .clang),
+    ])
+
     // The bridging header is referenced as a PCH unit dependency, make sure we can see the data.
     let bhdecl = Symbol(usr: "c:@F@bridgingHeader", name: "bridgingHeader", kind: .function, language: .c)
     let bridgingHeaderOccs = index.occurrences(ofUSR: bhdecl.usr, roles: .all)
@@ -624,6 +1208,38 @@ final class IndexTests: XCTestCase {
     testSymbolsInFilePath(with: inputs, usingIndex: ws.index)
   }
 
+  func testPrioritizeFiles() throws {
+    guard let ws = try staticTibsTestWorkspace(name: "proj1") else { return }
+    let csym = Symbol(usr: "s:4main1cyyF", name: "c()", kind: .function, language: .swift)
+    let cPath = ws.testLoc("c").url.path
+
+    // Nothing is pending yet; prioritizing is a no-op.
+    ws.index.prioritizeFiles([cPath])
+    try ws.buildAndIndex()
+    ws.index.prioritizeFiles([cPath, ws.testLoc("c:call").url.path])
+
+    XCTAssertEqual(ws.index.occurrences(ofUSR: csym.usr, roles: [.reference, .definition]).count, 2)
+  }
+
+  func testTrimMemory() throws {
+    guard let ws = try staticTibsTestWorkspace(name: "proj1") else { return }
+    let csym = Symbol(usr: "s:4main1cyyF", name: "c()", kind: .function, language: .swift)
+    try ws.buildAndIndex()
+
+    XCTAssertEqual(ws.index.occurrences(ofUSR: csym.usr, roles: [.reference, .definition]).count, 2)
+    let usage = ws.index.memoryUsage()
+    XCTAssertEqual(Set(usage.keys), ["canonical_paths", "unit_visibility", "unit_monitors", "polled_units"])
+    XCTAssertGreaterThan(usage["canonical_paths"] ?? 0, 0)
+
+    ws.index.trimMemory(.critical)
+    XCTAssertEqual(ws.index.memoryUsage()["canonical_paths"], 0)
+    XCTAssertEqual(ws.index.memoryUsage()["polled_units"], 0)
+
+    // The index fills the caches again as needed.
+    ws.index.pollForUnitChangesAndWait()
+    XCTAssertEqual(ws.index.occurrences(ofUSR: csym.usr, roles: [.reference, .definition]).count, 2)
+  }
+
   func testSymbolsInFilePath(with inputs: [(path: String, expectedSymbolNames: [String])], usingIndex subject: IndexStoreDB) {
     for (path, expectedSymbolNames) in inputs {
       let actualSymbolNames = subject.symbols(inFilePath: path).map(\.name)
@@ -51,6 +51,9 @@ INDEXSTOREDB_BEGIN_DECLS
 typedef void *indexstoredb_object_t;
 typedef indexstoredb_object_t indexstoredb_index_t;
 typedef indexstoredb_object_t indexstoredb_indexstore_library_t;
+typedef indexstoredb_object_t indexstoredb_cancellation_token_t;
+typedef indexstoredb_object_t indexstoredb_query_profile_t;
+typedef indexstoredb_object_t indexstoredb_async_query_t;
 
 typedef void *indexstoredb_symbol_t;
 typedef void *indexstoredb_symbol_occurrence_t;
@@ -135,6 +138,9 @@ typedef enum {
   INDEXSTOREDB_EVENT_PROCESSING_ADDED_PENDING = 0,
   INDEXSTOREDB_EVENT_PROCESSING_COMPLETED = 1,
   INDEXSTOREDB_EVENT_UNIT_OUT_OF_DATE = 2,
+  /// The units that were found out-of-date together, see \c indexstoredb_delegate_event_get_outofdate_event.
+  /// Only delivered with \c indexstoredb_creation_options_batch_out_of_date_units.
+  INDEXSTOREDB_EVENT_UNITS_OUT_OF_DATE = 3,
 } indexstoredb_delegate_event_kind_t;
 
 typedef enum {
@@ -150,6 +156,37 @@ typedef enum {
   INDEXSTOREDB_SYMBOL_PROVIDER_KIND_UNKNOWN,
 } indexstoredb_symbol_provider_kind_t;
 
+typedef enum {
+  /// Drop the caches of lookups.
+  INDEXSTOREDB_MEMORY_TRIM_LEVEL_MODERATE = 0,
+  /// Also drop the data that can be reloaded from the database.
+  INDEXSTOREDB_MEMORY_TRIM_LEVEL_CRITICAL = 1,
+} indexstoredb_memory_trim_level_t;
+
+typedef enum {
+  INDEXSTOREDB_QUERY_PROFILE_COUNTER_READ_TRANSACTIONS = 0,
+  INDEXSTOREDB_QUERY_PROFILE_COUNTER_DB_LOOKUPS = 1,
+  INDEXSTOREDB_QUERY_PROFILE_COUNTER_DB_CURSOR_STEPS = 2,
+  INDEXSTOREDB_QUERY_PROFILE_COUNTER_PROVIDERS_RESOLVED = 3,
+  INDEXSTOREDB_QUERY_PROFILE_COUNTER_RECORDS_OPENED = 4,
+  INDEXSTOREDB_QUERY_PROFILE_COUNTER_OCCURRENCES_DECODED = 5,
+  INDEXSTOREDB_QUERY_PROFILE_COUNTER_VISIBILITY_CHECKS = 6,
+  INDEXSTOREDB_QUERY_PROFILE_COUNTER_VISIBILITY_CACHE_HITS = 7,
+} indexstoredb_query_profile_counter_t;
+
+typedef enum {
+  INDEXSTOREDB_QUERY_PROFILE_PHASE_LOOKUP_PROVIDERS = 0,
+  INDEXSTOREDB_QUERY_PROFILE_PHASE_RESOLVE_PROVIDERS = 1,
+  INDEXSTOREDB_QUERY_PROFILE_PHASE_READ_RECORDS = 2,
+} indexstoredb_query_profile_phase_t;
+
+typedef enum {
+  INDEXSTOREDB_QUERY_PRIORITY_HIGH = 0,
+  INDEXSTOREDB_QUERY_PRIORITY_DEFAULT = 1,
+  INDEXSTOREDB_QUERY_PRIORITY_LOW = 2,
+  INDEXSTOREDB_QUERY_PRIORITY_BACKGROUND = 3,
+} indexstoredb_query_priority_t;
+
 typedef void *indexstoredb_delegate_event_t;
 
 /// Returns true on success.
@@ -173,8 +210,19 @@ typedef bool(^indexstoredb_unit_info_receiver)(_Nonnull indexstoredb_unit_info_t
 typedef bool(^indexstoredb_file_includes_receiver)(const char *_Nonnull sourcePath, size_t line);
 
 /// Returns true to continue.
+typedef bool(^indexstoredb_memory_usage_receiver)(const char *_Nonnull name, size_t bytes);
+
 typedef bool(^indexstoredb_unit_includes_receiver)(const char *_Nonnull sourcePath, const char *_Nonnull targetPath, size_t line);
 
+/// Receives a batch of \p count occurrences of an asynchronous query. The occurrences are valid only for the duration
+/// of the call. Returns true to continue.
+typedef bool(^indexstoredb_symbol_occurrence_batch_receiver_t)(_Nonnull indexstoredb_symbol_occurrence_t const *_Nonnull occurrences,
+                                                                size_t count);
+
+/// Called once after the last batch of an asynchronous query, with false if the receiver stopped the query or it was
+/// cancelled.
+typedef void(^indexstoredb_async_query_completion_t)(bool finished);
+
 typedef void *indexstoredb_creation_options_t;
 
 INDEXSTOREDB_PUBLIC indexstoredb_creation_options_t _Nonnull
@@ -212,6 +260,63 @@ INDEXSTOREDB_PUBLIC void
 indexstoredb_creation_options_use_explicit_output_units(indexstoredb_creation_options_t _Nonnull options,
                                                             bool useExplicitOutputUnits);
 
+/// Records the number of occurrences of each symbol when importing records, which is needed for the occurrence count
+/// of \c indexstoredb_index_symbol_occurrence_count_by_usr.
+INDEXSTOREDB_PUBLIC void
+indexstoredb_creation_options_record_occurrence_counts(indexstoredb_creation_options_t _Nonnull options,
+                                                       bool recordOccurrenceCounts);
+
+/// Limits the memory used by the caches of the index to \p bytes; they are trimmed to fit when the pending units are
+/// imported. 0, the default, means no limit.
+INDEXSTOREDB_PUBLIC void
+indexstoredb_creation_options_memory_budget(indexstoredb_creation_options_t _Nonnull options,
+                                            size_t bytes);
+
+/// Creates the database from the snapshot at \p snapshotPath, written by \c indexstoredb_index_export_snapshot, if
+/// there is no database yet. The units of the store that are out of date with the snapshot are imported as usual.
+INDEXSTOREDB_PUBLIC void
+indexstoredb_creation_options_snapshot(indexstoredb_creation_options_t _Nonnull options,
+                                       const char * _Nonnull snapshotPath);
+
+/// Adds a remapping from \c path_prefix, as written in the snapshot, to \c remapped_path_prefix.
+INDEXSTOREDB_PUBLIC void
+indexstoredb_creation_options_add_snapshot_prefix_mapping(indexstoredb_creation_options_t _Nonnull options,
+                                                          const char * _Nonnull pathPrefix,
+                                                          const char * _Nonnull remappedPathPrefix);
+
+/// Opens the database in place, for all the processes that use \p databasePath with this option at the same time.
+/// One of them imports the units and the others see its imports as they are committed; one of the others takes
+/// over when it exits.
+INDEXSTOREDB_PUBLIC void
+indexstoredb_creation_options_share_database(indexstoredb_creation_options_t _Nonnull options,
+                                             bool shareDatabase);
+
+/// Collects the delegate events for \p milliseconds and delivers them together; the out-of-date units as one
+/// \c INDEXSTOREDB_EVENT_UNITS_OUT_OF_DATE event if \c indexstoredb_creation_options_batch_out_of_date_units is set,
+/// and the completed units as one \c INDEXSTOREDB_EVENT_PROCESSING_COMPLETED event. 0 delivers them as soon as
+/// possible.
+INDEXSTOREDB_PUBLIC void
+indexstoredb_creation_options_delegate_batch_interval(indexstoredb_creation_options_t _Nonnull options,
+                                                      uint64_t milliseconds);
+
+/// Delivers the units that were found out-of-date together as one \c INDEXSTOREDB_EVENT_UNITS_OUT_OF_DATE event.
+/// Otherwise, by default, each of them gets an \c INDEXSTOREDB_EVENT_UNIT_OUT_OF_DATE event. Applies to the delegate
+/// passed to \c indexstoredb_index_create, the ones added later get the events of each unit.
+INDEXSTOREDB_PUBLIC void
+indexstoredb_creation_options_batch_out_of_date_units(indexstoredb_creation_options_t _Nonnull options,
+                                                      bool batchOutOfDateUnits);
+
+/// Sets the share of the unit processing time that the index gets while other indexes of the process have units to
+/// process as well. The default is 1.
+INDEXSTOREDB_PUBLIC void
+indexstoredb_creation_options_unit_processing_weight(indexstoredb_creation_options_t _Nonnull options,
+                                                     unsigned weight);
+
+/// Sets how many indexes of the process may process units at the same time, 1 by default. Each index processes its
+/// units in order, and the indexes with units to process take turns by their weight.
+INDEXSTOREDB_PUBLIC void
+indexstoredb_set_unit_processing_concurrency(unsigned concurrency);
+
 /// Creates an index for the given raw index data in \p storePath.
 ///
 /// The resulting index must be released using \c indexstoredb_release.
@@ -237,6 +342,66 @@ indexstoredb_indexstore_library_t
 indexstoredb_load_indexstore_library(const char * _Nonnull dylibPath,
                              indexstoredb_error_t _Nullable * _Nullable);
 
+/// Creates a token that can be used to stop the \c _cancellable query functions from another thread.
+///
+/// \param timeoutNanoseconds if non-zero, the token is also considered cancelled once this much time has passed
+/// since its creation.
+///
+/// The resulting object must be released using \c indexstoredb_release.
+INDEXSTOREDB_PUBLIC _Nonnull
+indexstoredb_cancellation_token_t
+indexstoredb_cancellation_token_create(uint64_t timeoutNanoseconds);
+
+/// Cancels all queries using \p token. They return false after a bounded amount of additional work.
+INDEXSTOREDB_PUBLIC void
+indexstoredb_cancellation_token_cancel(_Nonnull indexstoredb_cancellation_token_t token);
+
+/// Returns true if \p token was cancelled or its timeout has passed.
+INDEXSTOREDB_PUBLIC bool
+indexstoredb_cancellation_token_is_cancelled(_Nonnull indexstoredb_cancellation_token_t token);
+
+/// Creates an empty query profile.
+///
+/// The resulting object must be released using \c indexstoredb_release.
+INDEXSTOREDB_PUBLIC _Nonnull
+indexstoredb_query_profile_t
+indexstoredb_query_profile_create(void);
+
+/// Calls \p body and adds the work of all the queries it executes on the current thread to \p profile.
+INDEXSTOREDB_PUBLIC void
+indexstoredb_query_profile_collect(_Nonnull indexstoredb_query_profile_t profile,
+                                   void(^_Nonnull body)(void));
+
+/// Returns the value of \p counter in \p profile.
+INDEXSTOREDB_PUBLIC uint64_t
+indexstoredb_query_profile_get_count(_Nonnull indexstoredb_query_profile_t profile,
+                                     indexstoredb_query_profile_counter_t counter);
+
+/// Returns the wall time spent in \p phase, excluding time spent in phases nested in it, in nanoseconds.
+INDEXSTOREDB_PUBLIC uint64_t
+indexstoredb_query_profile_get_phase_nanoseconds(_Nonnull indexstoredb_query_profile_t profile,
+                                                 indexstoredb_query_profile_phase_t phase);
+
+/// Returns the wall time of all \c indexstoredb_query_profile_collect calls with \p profile, in nanoseconds.
+INDEXSTOREDB_PUBLIC uint64_t
+indexstoredb_query_profile_get_total_nanoseconds(_Nonnull indexstoredb_query_profile_t profile);
+
+/// Enables or disables the collection of the process-wide index metrics. Collection is disabled by default.
+INDEXSTOREDB_PUBLIC void
+indexstoredb_metrics_set_enabled(bool enabled);
+
+/// Zeroes the process-wide counters and latency histograms.
+INDEXSTOREDB_PUBLIC void
+indexstoredb_metrics_reset(void);
+
+/// Passes the process-wide metrics, the storage statistics of the database of \p index and the statistics of its unit
+/// processing queue, as a JSON object, to \p receiver.
+///
+/// The string is only valid for the duration of the call.
+INDEXSTOREDB_PUBLIC void
+indexstoredb_index_metrics_json(_Nonnull indexstoredb_index_t index,
+                                void(^_Nonnull receiver)(const char *_Nonnull json));
+
 /// Retrieve the format version of the indexstore.
 INDEXSTOREDB_PUBLIC unsigned
 indexstoredb_format_version(_Nonnull indexstoredb_indexstore_library_t lib);
@@ -266,13 +431,58 @@ indexstoredb_index_remove_unit_out_file_paths(_Nonnull indexstoredb_index_t inde
                                               size_t count,
                                               bool waitForProcessing);
 
+/// Replace the set of output filepaths of the unit files that index data should be loaded from. Only the units of
+/// the filepaths that were added or removed since the previous set get loaded or removed.
+/// Only has an effect if `useExplicitOutputUnits` was set to true for `indexstoredb_index_create`.
+INDEXSTOREDB_PUBLIC void
+indexstoredb_index_set_unit_out_file_paths(_Nonnull indexstoredb_index_t index,
+                                           const char *_Nonnull const *_Nonnull paths,
+                                           size_t count,
+                                           bool waitForProcessing);
+
+/// Import the pending units of the given files, main source files or unit output files, ahead of the other pending
+/// units.
+INDEXSTOREDB_PUBLIC void
+indexstoredb_index_prioritize_files(_Nonnull indexstoredb_index_t index,
+                                    const char *_Nonnull const *_Nonnull paths,
+                                    size_t count);
+
+/// Releases memory held by the caches of the index, for instance when the system reports memory pressure.
+INDEXSTOREDB_PUBLIC void
+indexstoredb_index_trim_memory(_Nonnull indexstoredb_index_t index,
+                               indexstoredb_memory_trim_level_t level);
+
+/// Writes a compacted copy of the database into the new directory \p snapshotPath, replacing the path prefixes
+/// \p pathPrefixes with the corresponding \p remappedPathPrefixes, to seed the database of another machine.
+///
+/// \returns false and sets \p error on failure.
+INDEXSTOREDB_PUBLIC bool
+indexstoredb_index_export_snapshot(_Nonnull indexstoredb_index_t index,
+                                   const char * _Nonnull snapshotPath,
+                                   const char *_Nonnull const *_Nullable pathPrefixes,
+                                   const char *_Nonnull const *_Nullable remappedPathPrefixes,
+                                   size_t count,
+                                   indexstoredb_error_t _Nullable * _Nullable error);
+
+/// Calls \p receiver with the name and the approximate number of bytes of each of the caches of the index.
+INDEXSTOREDB_PUBLIC bool
+indexstoredb_index_memory_usage(_Nonnull indexstoredb_index_t index,
+                                _Nonnull indexstoredb_memory_usage_receiver receiver);
+
 INDEXSTOREDB_PUBLIC
 indexstoredb_delegate_event_kind_t
 indexstoredb_delegate_event_get_kind(_Nonnull indexstoredb_delegate_event_t);
 
+/// The number of units for \c INDEXSTOREDB_EVENT_UNITS_OUT_OF_DATE.
 INDEXSTOREDB_PUBLIC
 uint64_t indexstoredb_delegate_event_get_count(_Nonnull indexstoredb_delegate_event_t);
 
+/// Valid only if the event kind is \p INDEXSTOREDB_EVENT_UNITS_OUT_OF_DATE and \p index is less than its count,
+/// otherwise returns null. Returns the \c INDEXSTOREDB_EVENT_UNIT_OUT_OF_DATE event of the unit at \p index, which
+/// has the same lifetime as the given event.
+INDEXSTOREDB_PUBLIC _Nullable indexstoredb_delegate_event_t
+indexstoredb_delegate_event_get_outofdate_event(_Nonnull indexstoredb_delegate_event_t, size_t index);
+
 /// Valid only if the event kind is \p INDEXSTOREDB_EVENT_UNIT_OUT_OF_DATE, otherwise returns null.
 /// The indexstoredb_unit_info_t pointer has the same lifetime as the \c indexstoredb_delegate_event_t
 INDEXSTOREDB_PUBLIC _Nullable indexstoredb_unit_info_t
@@ -283,7 +493,8 @@ indexstoredb_delegate_event_get_outofdate_unit_info(_Nonnull indexstoredb_delega
 INDEXSTOREDB_PUBLIC uint64_t
 indexstoredb_delegate_event_get_outofdate_modtime(_Nonnull indexstoredb_delegate_event_t);
 
-/// Valid only if the event kind is \p INDEXSTOREDB_EVENT_UNIT_OUT_OF_DATE, otherwise returns false.
+/// Valid only if the event kind is \p INDEXSTOREDB_EVENT_UNIT_OUT_OF_DATE or
+/// \p INDEXSTOREDB_EVENT_UNITS_OUT_OF_DATE, otherwise returns false.
 INDEXSTOREDB_PUBLIC bool
 indexstoredb_delegate_event_get_outofdate_is_synchronous(_Nonnull indexstoredb_delegate_event_t);
 
@@ -308,6 +519,15 @@ indexstoredb_index_symbol_occurrences_by_usr(
     uint64_t roles,
     _Nonnull indexstoredb_symbol_occurrence_receiver_t);
 
+/// Same as \c indexstoredb_index_symbol_occurrences_by_usr but stops and returns false once \p token is cancelled.
+INDEXSTOREDB_PUBLIC bool
+indexstoredb_index_symbol_occurrences_by_usr_cancellable(
+    _Nonnull indexstoredb_index_t index,
+    const char *_Nonnull usr,
+    uint64_t roles,
+    _Nullable indexstoredb_cancellation_token_t token,
+    _Nonnull indexstoredb_symbol_occurrence_receiver_t);
+
 /// Iterates over each symbol occurrence related to the \p usr with \p roles.
 ///
 /// The occurrence passed to the receiver is only valid for the duration of the
@@ -319,6 +539,48 @@ indexstoredb_index_related_symbol_occurrences_by_usr(
     uint64_t roles,
     _Nonnull indexstoredb_symbol_occurrence_receiver_t);
 
+/// Same as \c indexstoredb_index_related_symbol_occurrences_by_usr but stops and returns false once \p token is
+/// cancelled.
+INDEXSTOREDB_PUBLIC bool
+indexstoredb_index_related_symbol_occurrences_by_usr_cancellable(
+    _Nonnull indexstoredb_index_t index,
+    const char *_Nonnull usr,
+    uint64_t roles,
+    _Nullable indexstoredb_cancellation_token_t token,
+    _Nonnull indexstoredb_symbol_occurrence_receiver_t);
+
+/// Counts what \c indexstoredb_index_symbol_occurrences_by_usr would pass to its receiver, without reading any
+/// record data.
+///
+/// \param providerCount if non-null, set to the number of records containing the symbol with any of \p roles.
+/// \param fileCount if non-null, set to the number of distinct source files of those records.
+/// \param occurrenceCount if non-null, set to the number of occurrences, or 0 if it is not available.
+/// \param isExact if non-null, set to false if \p occurrenceCount is only an upper bound.
+/// \returns true if the occurrence count is available, which requires occurrence counts to have been recorded.
+INDEXSTOREDB_PUBLIC bool
+indexstoredb_index_symbol_occurrence_count_by_usr(
+    _Nonnull indexstoredb_index_t index,
+    const char *_Nonnull usr,
+    uint64_t roles,
+    uint64_t *_Nullable providerCount,
+    uint64_t *_Nullable fileCount,
+    uint64_t *_Nullable occurrenceCount,
+    bool *_Nullable isExact);
+
+/// Counts what \c indexstoredb_index_related_symbol_occurrences_by_usr would pass to its receiver, without reading
+/// any record data.
+///
+/// The parameters are the same as for \c indexstoredb_index_symbol_occurrence_count_by_usr.
+INDEXSTOREDB_PUBLIC bool
+indexstoredb_index_related_symbol_occurrence_count_by_usr(
+    _Nonnull indexstoredb_index_t index,
+    const char *_Nonnull usr,
+    uint64_t roles,
+    uint64_t *_Nullable providerCount,
+    uint64_t *_Nullable fileCount,
+    uint64_t *_Nullable occurrenceCount,
+    bool *_Nullable isExact);
+
 /// Iterates over all the symbols contained in \p path
 ///
 /// The symbol passed to the receiver is only valid for the duration of the
@@ -436,6 +698,12 @@ indexstoredb_error_dispose(_Nullable indexstoredb_error_t);
 INDEXSTOREDB_PUBLIC bool
 indexstoredb_index_symbol_names(_Nonnull indexstoredb_index_t index, _Nonnull indexstoredb_symbol_name_receiver);
 
+/// Same as \c indexstoredb_index_symbol_names but stops and returns false once \p token is cancelled.
+INDEXSTOREDB_PUBLIC bool
+indexstoredb_index_symbol_names_cancellable(_Nonnull indexstoredb_index_t index,
+                                            _Nullable indexstoredb_cancellation_token_t token,
+                                            _Nonnull indexstoredb_symbol_name_receiver);
+
 /// Iterates over every canonical symbol that matches the string.
 ///
 /// \param index An IndexStoreDB object which contains the symbols.
@@ -450,6 +718,16 @@ indexstoredb_index_canonical_symbol_occurences_by_name(
     indexstoredb_symbol_occurrence_receiver_t _Nonnull receiver
 );
 
+/// Same as \c indexstoredb_index_canonical_symbol_occurences_by_name but stops and returns false once \p token is
+/// cancelled.
+INDEXSTOREDB_PUBLIC bool
+indexstoredb_index_canonical_symbol_occurences_by_name_cancellable(
+    indexstoredb_index_t _Nonnull index,
+    const char *_Nonnull symbolName,
+    indexstoredb_cancellation_token_t _Nullable token,
+    indexstoredb_symbol_occurrence_receiver_t _Nonnull receiver
+);
+
 /// Iterates over every canonical symbol that matches the pattern.
 ///
 /// \param index An IndexStoreDB object which contains the symbols.
@@ -469,6 +747,94 @@ indexstoredb_index_canonical_symbol_occurences_containing_pattern(
     bool ignoreCase,
     _Nonnull indexstoredb_symbol_occurrence_receiver_t receiver);
 
+/// Same as \c indexstoredb_index_canonical_symbol_occurences_containing_pattern but stops and returns false once
+/// \p token is cancelled.
+INDEXSTOREDB_PUBLIC bool
+indexstoredb_index_canonical_symbol_occurences_containing_pattern_cancellable(
+    _Nonnull indexstoredb_index_t index,
+    const char *_Nonnull pattern,
+    bool anchorStart,
+    bool anchorEnd,
+    bool subsequence,
+    bool ignoreCase,
+    _Nullable indexstoredb_cancellation_token_t token,
+    _Nonnull indexstoredb_symbol_occurrence_receiver_t receiver);
+
+/// Sets how many asynchronous queries of the process may run at the same time, the number of cores by default.
+INDEXSTOREDB_PUBLIC void
+indexstoredb_set_async_query_concurrency(unsigned concurrency);
+
+/// Same as \c indexstoredb_index_symbol_occurrences_by_usr_cancellable but runs on the query executor at \p priority
+/// and passes the occurrences to \p receiver in batches of \p batchSize, on a thread of the executor. \p completion is
+/// called after the last batch. The query keeps \p index alive until it completes.
+///
+/// The resulting object must be released using \c indexstoredb_release; releasing it doesn't cancel the query.
+INDEXSTOREDB_PUBLIC _Nonnull indexstoredb_async_query_t
+indexstoredb_index_symbol_occurrences_by_usr_async(
+    _Nonnull indexstoredb_index_t index,
+    const char *_Nonnull usr,
+    uint64_t roles,
+    indexstoredb_query_priority_t priority,
+    size_t batchSize,
+    _Nullable indexstoredb_cancellation_token_t token,
+    _Nonnull indexstoredb_symbol_occurrence_batch_receiver_t receiver,
+    _Nullable indexstoredb_async_query_completion_t completion);
+
+/// Asynchronous variant of \c indexstoredb_index_related_symbol_occurrences_by_usr_cancellable, see
+/// \c indexstoredb_index_symbol_occurrences_by_usr_async.
+INDEXSTOREDB_PUBLIC _Nonnull indexstoredb_async_query_t
+indexstoredb_index_related_symbol_occurrences_by_usr_async(
+    _Nonnull indexstoredb_index_t index,
+    const char *_Nonnull usr,
+    uint64_t roles,
+    indexstoredb_query_priority_t priority,
+    size_t batchSize,
+    _Nullable indexstoredb_cancellation_token_t token,
+    _Nonnull indexstoredb_symbol_occurrence_batch_receiver_t receiver,
+    _Nullable indexstoredb_async_query_completion_t completion);
+
+/// Asynchronous variant of \c indexstoredb_index_canonical_symbol_occurences_by_name_cancellable, see
+/// \c indexstoredb_index_symbol_occurrences_by_usr_async.
+INDEXSTOREDB_PUBLIC _Nonnull indexstoredb_async_query_t
+indexstoredb_index_canonical_symbol_occurences_by_name_async(
+    _Nonnull indexstoredb_index_t index,
+    const char *_Nonnull symbolName,
+    indexstoredb_query_priority_t priority,
+    size_t batchSize,
+    _Nullable indexstoredb_cancellation_token_t token,
+    _Nonnull indexstoredb_symbol_occurrence_batch_receiver_t receiver,
+    _Nullable indexstoredb_async_query_completion_t completion);
+
+/// Asynchronous variant of \c indexstoredb_index_canonical_symbol_occurences_containing_pattern_cancellable, see
+/// \c indexstoredb_index_symbol_occurrences_by_usr_async.
+INDEXSTOREDB_PUBLIC _Nonnull indexstoredb_async_query_t
+indexstoredb_index_canonical_symbol_occurences_containing_pattern_async(
+    _Nonnull indexstoredb_index_t index,
+    const char *_Nonnull pattern,
+    bool anchorStart,
+    bool anchorEnd,
+    bool subsequence,
+    bool ignoreCase,
+    indexstoredb_query_priority_t priority,
+    size_t batchSize,
+    _Nullable indexstoredb_cancellation_token_t token,
+    _Nonnull indexstoredb_symbol_occurrence_batch_receiver_t receiver,
+    _Nullable indexstoredb_async_query_completion_t completion);
+
+/// Stops \p query within a bounded amount of work. A query that didn't start yet doesn't run; its completion is
+/// called either way.
+INDEXSTOREDB_PUBLIC void
+indexstoredb_async_query_cancel(_Nonnull indexstoredb_async_query_t query);
+
+/// Returns true once the completion of \p query has returned.
+INDEXSTOREDB_PUBLIC bool
+indexstoredb_async_query_is_finished(_Nonnull indexstoredb_async_query_t query);
+
+/// Blocks until the completion of \p query has returned. Must not be called from the receiver or the completion of a
+/// query.
+INDEXSTOREDB_PUBLIC void
+indexstoredb_async_query_wait(_Nonnull indexstoredb_async_query_t query);
+
 /// Returns the set of roles of the given symbol relation.
 INDEXSTOREDB_PUBLIC uint64_t
 indexstoredb_symbol_relation_get_roles(_Nonnull  indexstoredb_symbol_relation_t);
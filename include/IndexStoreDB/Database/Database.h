@@ -15,24 +15,79 @@
 
 #include "IndexStoreDB/Database/IDCode.h"
 #include "IndexStoreDB/Support/LLVM.h"
+#include "IndexStoreDB/Support/Path.h"
 #include "IndexStoreDB/Support/Visibility.h"
+#include "llvm/ADT/StringRef.h"
+#include <cstdint>
+#include <functional>
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace IndexStoreDB {
 namespace db {
   class Database;
   typedef std::shared_ptr<Database> DatabaseRef;
 
+/// Storage statistics of the database and its tables.
+struct DatabaseStats {
+  struct Table {
+    StringRef Name;
+    unsigned Depth;
+    uint64_t BranchPages;
+    uint64_t LeafPages;
+    uint64_t OverflowPages;
+    uint64_t Entries;
+  };
+
+  uint64_t MapSize = 0;
+  unsigned PageSize = 0;
+  std::vector<Table> Tables;
+};
+
 class INDEXSTOREDB_EXPORT Database {
 public:
   static DatabaseRef create(StringRef dbPath, bool readonly, Optional<size_t> initialDBSize, std::string &error);
+
+  /// Opens the database of \p dbPath in place, for several processes to use
+  /// at the same time. One of them is the writer, the one that holds a lock
+  /// file; the others read the commits of the writer as they happen and one
+  /// of them takes over when the writer exits.
+  ///
+  /// All the processes that use \p dbPath at the same time need to share it.
+  static DatabaseRef createShared(StringRef dbPath, bool readonly, Optional<size_t> initialDBSize, std::string &error);
   ~Database();
 
+  /// \returns false if another process writes the shared database.
+  bool isWriter();
+  /// Runs \p work when this process takes over as the writer of the shared
+  /// database.
+  /// \returns false, without keeping \p work, if it is the writer already.
+  bool deferUntilWriter(std::function<void()> work);
+
   void increaseMapSize();
 
+  DatabaseStats getStats();
   void printStats(raw_ostream &OS);
 
+  /// Writes a compacted copy of the database into a new directory, with the
+  /// path prefixes of \p prefixMap replaced, for instance by placeholders of
+  /// the roots of the build machine. The state of the polled units is specific
+  /// to the machine and left out.
+  ///
+  /// \returns true if an error occurred.
+  bool exportSnapshot(StringRef destPath, const PathPrefixMap &prefixMap, std::string &error);
+
+  /// If there is no database at \p dbPath yet, creates it from the snapshot at
+  /// \p snapshotPath, replacing the path prefixes of \p prefixMap.
+  ///
+  /// Since the paths are identified by hashes, the tables that refer to paths
+  /// get new codes and are sorted again, the others are copied as they are.
+  ///
+  /// \returns true if an error occurred.
+  static bool seedFromSnapshot(StringRef dbPath, StringRef snapshotPath,
+                               const PathPrefixMap &prefixMap, std::string &error);
+
   class Implementation;
 private:
   std::shared_ptr<Implementation> Impl;
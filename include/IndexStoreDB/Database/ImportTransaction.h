@@ -24,9 +24,40 @@ namespace db {
   class Database;
   typedef std::shared_ptr<Database> DatabaseRef;
 
+/// Imports units into an empty database faster than one write transaction
+/// per unit: the import transactions that are part of the bulk load stage
+/// their entries, and a flush sorts them and appends them to the tables.
+///
+/// The entries of the bulk load are not visible until it is flushed. A write
+/// transaction that is not part of the bulk load flushes it before it begins.
+class INDEXSTOREDB_EXPORT BulkLoad {
+public:
+  /// \returns null if the database already has units or a bulk load.
+  static std::shared_ptr<BulkLoad> create(DatabaseRef dbase);
+  ~BulkLoad();
+
+  /// \returns true if the unit was imported as part of this bulk load, flushed
+  /// or not.
+  bool containsUnit(IDCode unitCode) const;
+  /// Approximate number of bytes of the entries that were not flushed.
+  size_t getStagedBytes() const;
+
+  /// Writes the staged entries in one write transaction. If it throws a
+  /// \c MapFullError the entries stay staged for another try.
+  void flush();
+
+  class Implementation;
+  Implementation *_impl() const { return Impl.get(); }
+private:
+  explicit BulkLoad(std::unique_ptr<Implementation> impl);
+  std::unique_ptr<Implementation> Impl;
+};
+
 class INDEXSTOREDB_EXPORT ImportTransaction {
 public:
-  explicit ImportTransaction(DatabaseRef dbase);
+  /// \param bulk if set, the transaction is part of the bulk load and can only
+  /// import units that are missing from the database and from the bulk load.
+  explicit ImportTransaction(DatabaseRef dbase, BulkLoad *bulk = nullptr);
   ~ImportTransaction();
 
   IDCode getUnitCode(StringRef unitName);
@@ -35,15 +66,29 @@ public:
   void setProviderContainsTestSymbols(IDCode provider);
   bool providerContainsTestSymbols(IDCode provider);
   /// \returns a IDCode of the USR.
+  ///
+  /// \param occurrenceCount number of occurrences of the USR in the provider,
+  /// if it was computed.
+  /// \param relatedOccurrenceCount number of occurrences in the provider that
+  /// have a relation to the USR, if it was computed.
   IDCode addSymbolInfo(IDCode provider,
                        StringRef USR, StringRef symbolName, SymbolInfo symInfo,
-                       SymbolRoleSet roles, SymbolRoleSet relatedRoles);
+                       SymbolRoleSet roles, SymbolRoleSet relatedRoles,
+                       Optional<unsigned> occurrenceCount = None,
+                       Optional<unsigned> relatedOccurrenceCount = None);
   IDCode addFilePath(CanonicalFilePathRef filePath);
   IDCode addUnitFileIdentifier(StringRef unitFile);
 
   void removeUnitData(IDCode unitCode);
   void removeUnitData(StringRef unitName);
 
+  /// Records the modification time of a unit found by a poll of the store.
+  void setPolledUnit(StringRef unitName, llvm::sys::TimePoint<> modTime);
+  void removePolledUnit(StringRef unitName);
+  /// Records the generation of the units directory of the polled store; pass
+  /// \c None if it is unknown.
+  void setPolledUnitsGeneration(Optional<llvm::sys::TimePoint<>> generation);
+
   void commit();
 
   class Implementation;
@@ -78,6 +123,10 @@ class INDEXSTOREDB_EXPORT UnitDataImport {
   std::vector<IDCode> FileDepends;
   std::vector<IDCode> UnitDepends;
   std::vector<UnitInfo::Provider> ProviderDepends;
+  // The system dependencies, stored after the user ones.
+  std::vector<IDCode> SystemFileDepends;
+  std::vector<IDCode> SystemUnitDepends;
+  std::vector<UnitInfo::Provider> SystemProviderDepends;
 
 public:
   UnitDataImport(ImportTransaction &import, StringRef unitName, llvm::sys::TimePoint<> modTime);
@@ -107,8 +156,8 @@ public:
   void setSymbolProviderKind(SymbolProviderKind K);
   void setTarget(StringRef target);
 
-  IDCode addFileDependency(CanonicalFilePathRef filePathDep);
-  IDCode addUnitDependency(StringRef unitNameDep);
+  IDCode addFileDependency(CanonicalFilePathRef filePathDep, bool isSystem);
+  IDCode addUnitDependency(StringRef unitNameDep, bool isSystem);
   /// \returns the provider code.
   IDCode addProviderDependency(StringRef providerName, CanonicalFilePathRef filePathDep, StringRef moduleName, bool isSystem, bool *isNewProvider = nullptr);
 
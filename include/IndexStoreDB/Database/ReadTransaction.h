@@ -15,6 +15,7 @@
 
 #include "IndexStoreDB/Core/Symbol.h"
 #include "IndexStoreDB/Database/UnitInfo.h"
+#include "IndexStoreDB/Support/Cancellation.h"
 #include "llvm/ADT/STLExtras.h"
 #include <memory>
 
@@ -28,9 +29,14 @@ namespace db {
 
 class INDEXSTOREDB_EXPORT ReadTransaction {
 public:
-  explicit ReadTransaction(DatabaseRef dbase);
+  /// If \c cancelToken is given, scans stop early once it is cancelled and
+  /// return false, as if their receiver returned false.
+  explicit ReadTransaction(DatabaseRef dbase, CancellationTokenRef cancelToken = nullptr);
   ~ReadTransaction();
 
+  /// \returns true if the cancellation token was cancelled.
+  bool isCancelled() const;
+
   /// Returns providers containing the USR with any of the roles.
   /// If both \c roles and \c relatedRoles are given then both any roles and any related roles should be satisfied.
   /// If both \c roles and \c relatedRoles are empty then all providers are returned.
@@ -38,6 +44,11 @@ public:
                              llvm::function_ref<bool(IDCode provider, SymbolRoleSet roles, SymbolRoleSet relatedRoles)> receiver);
   bool lookupProvidersForUSR(IDCode usrCode, SymbolRoleSet roles, SymbolRoleSet relatedRoles,
                              llvm::function_ref<bool(IDCode provider, SymbolRoleSet roles, SymbolRoleSet relatedRoles)> receiver);
+  /// Same as \c lookupProvidersForUSR but also passes the occurrence counts that were recorded for the USR in each
+  /// provider. A count is \c None if it was not recorded when the provider was imported.
+  bool lookupProviderOccurrenceCountsForUSR(IDCode usrCode, SymbolRoleSet roles, SymbolRoleSet relatedRoles,
+    function_ref<bool(IDCode provider, SymbolRoleSet roles, SymbolRoleSet relatedRoles,
+                      Optional<unsigned> occurrenceCount, Optional<unsigned> relatedOccurrenceCount)> receiver);
 
   StringRef getProviderName(IDCode provider);
   StringRef getTargetName(IDCode target);
@@ -57,6 +68,9 @@ public:
 
   /// Returns USR codes in batches.
   bool foreachUSROfGlobalSymbolKind(SymbolKind symKind, llvm::function_ref<bool(ArrayRef<IDCode> usrCodes)> receiver);
+  /// Returns the number of USRs that \c foreachUSROfGlobalSymbolKind would pass, without iterating them.
+  /// This includes USRs whose providers are no longer visible.
+  size_t countUSRsOfGlobalSymbolKind(SymbolKind symKind);
 
   /// Returns USR codes in batches.
   bool foreachUSROfGlobalUnitTestSymbol(llvm::function_ref<bool(ArrayRef<IDCode> usrCodes)> receiver);
@@ -98,6 +112,15 @@ public:
   UnitInfo getUnitInfo(IDCode unitCode);
   /// UnitInfo.UnitName will be empty if \c unit was not found. UnitInfo.UnitCode is always filled out.
   UnitInfo getUnitInfo(StringRef unitName);
+  /// Visits all the units of the database, in unit code order.
+  bool foreachUnitInfo(function_ref<bool(const UnitInfo &unitInfo)> receiver);
+
+  /// Visits the units that were found by the last poll of the store, with the
+  /// modification time they had then.
+  bool foreachPolledUnit(function_ref<bool(StringRef unitName, llvm::sys::TimePoint<> modTime)> receiver);
+  /// \returns the generation of the units directory when the store was last
+  /// polled, or \c None if it was not recorded.
+  Optional<llvm::sys::TimePoint<>> getPolledUnitsGeneration();
 
   bool foreachUnitContainingFile(IDCode filePathCode,
                                  llvm::function_ref<bool(ArrayRef<IDCode> unitCodes)> receiver);
@@ -51,6 +51,15 @@ struct UnitInfo {
   ArrayRef<IDCode> FileDepends;
   ArrayRef<IDCode> UnitDepends;
   ArrayRef<Provider> ProviderDepends;
+  /// Number of the dependencies that are not system ones. They come first in
+  /// each of the dependency arrays.
+  unsigned UserFileDependSize;
+  unsigned UserUnitDependSize;
+  unsigned UserProviderDependSize;
+
+  ArrayRef<IDCode> getUserFileDepends() const { return FileDepends.take_front(UserFileDependSize); }
+  ArrayRef<IDCode> getUserUnitDepends() const { return UnitDepends.take_front(UserUnitDependSize); }
+  ArrayRef<Provider> getUserProviderDepends() const { return ProviderDepends.take_front(UserProviderDependSize); }
 
   bool isInvalid() const { return UnitName.empty(); }
   bool isValid() const { return !isInvalid(); }
@@ -0,0 +1,101 @@
+//===--- AsyncQuery.h -------------------------------------------*- C++ -*-===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2018 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://swift.org/LICENSE.txt for license information
+// See https://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef INDEXSTOREDB_INDEX_ASYNCQUERY_H
+#define INDEXSTOREDB_INDEX_ASYNCQUERY_H
+
+#include "IndexStoreDB/Support/Cancellation.h"
+#include "IndexStoreDB/Support/Concurrency.h"
+#include "IndexStoreDB/Support/LLVM.h"
+#include "IndexStoreDB/Support/Visibility.h"
+#include "llvm/ADT/ArrayRef.h"
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+namespace IndexStoreDB {
+  class SymbolOccurrence;
+  typedef std::shared_ptr<SymbolOccurrence> SymbolOccurrenceRef;
+
+namespace index {
+
+struct AsyncQueryOptions {
+  /// The priority that the query runs at. While the query executor is busy,
+  /// the pending queries of higher priority start first.
+  WorkQueue::Priority Priority = WorkQueue::Priority::Default;
+  /// Number of results that are delivered together; the last batch may be
+  /// smaller.
+  size_t BatchSize = 128;
+  /// Cancels the query in addition to \c AsyncQuery::cancel, for instance
+  /// with a deadline.
+  CancellationTokenRef CancelToken;
+};
+
+/// Receives a batch of results of an asynchronous query, on a thread of the
+/// query executor. Returns false to stop the query.
+typedef std::function<bool(ArrayRef<SymbolOccurrenceRef> occurs)> SymbolOccurrenceBatchReceiver;
+
+/// Called once after the last batch of an asynchronous query, with false if
+/// the receiver stopped the query or it was cancelled.
+typedef std::function<void(bool finished)> AsyncQueryCompletion;
+
+/// Handle of a query that runs on the query executor, see
+/// \c IndexSystem::foreachSymbolOccurrenceByUSRAsync.
+///
+/// The query keeps its index alive until it completes.
+class INDEXSTOREDB_EXPORT AsyncQuery {
+public:
+  explicit AsyncQuery(CancellationTokenRef token)
+    : Token(token ? std::move(token) : CancellationToken::create()) {}
+
+  /// Stops the query within a bounded amount of work. A query that didn't
+  /// start yet doesn't run; its completion is called either way.
+  void cancel() { Token->cancel(); }
+  bool isCancelled() const { return Token->isCancelled(); }
+
+  /// \returns true once the completion of the query has returned.
+  bool isFinished() const {
+    std::lock_guard<std::mutex> L(FinishedMtx);
+    return Finished;
+  }
+
+  /// Blocks until the completion of the query has returned. Don't call it
+  /// from the receiver or the completion of a query.
+  void wait() {
+    std::unique_lock<std::mutex> L(FinishedMtx);
+    FinishedCV.wait(L, [&] { return Finished; });
+  }
+
+  const CancellationTokenRef &getCancellationToken() const { return Token; }
+
+private:
+  friend class QueryExecutor;
+
+  void setFinished() {
+    std::lock_guard<std::mutex> L(FinishedMtx);
+    Finished = true;
+    FinishedCV.notify_all();
+  }
+
+  const CancellationTokenRef Token;
+  mutable std::mutex FinishedMtx;
+  std::condition_variable FinishedCV;
+  bool Finished = false;
+};
+
+typedef std::shared_ptr<AsyncQuery> AsyncQueryRef;
+
+} // namespace index
+} // namespace IndexStoreDB
+
+#endif
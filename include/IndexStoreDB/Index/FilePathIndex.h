@@ -13,6 +13,7 @@
 #ifndef INDEXSTOREDB_INDEX_FILEPATHINDEX_H
 #define INDEXSTOREDB_INDEX_FILEPATHINDEX_H
 
+#include "IndexStoreDB/Support/Cancellation.h"
 #include "IndexStoreDB/Support/LLVM.h"
 #include "llvm/ADT/StringRef.h"
 #include <memory>
@@ -51,20 +52,23 @@ public:
   //===--------------------------------------------------------------------===//
 
   bool foreachMainUnitContainingFile(CanonicalFilePathRef filePath,
-                                 function_ref<bool(const StoreUnitInfo &unitInfo)> Receiver);
+                                 function_ref<bool(const StoreUnitInfo &unitInfo)> Receiver,
+                                 CancellationTokenRef CancelToken = nullptr);
 
   bool isKnownFile(CanonicalFilePathRef filePath);
 
   bool foreachFileOfUnit(StringRef unitName,
                          bool followDependencies,
-                         function_ref<bool(CanonicalFilePathRef filePath)> receiver);
+                         function_ref<bool(CanonicalFilePathRef filePath)> receiver,
+                         CancellationTokenRef cancelToken = nullptr);
 
   bool foreachFilenameContainingPattern(StringRef Pattern,
                                         bool AnchorStart,
                                         bool AnchorEnd,
                                         bool Subsequence,
                                         bool IgnoreCase,
-                               function_ref<bool(CanonicalFilePathRef FilePath)> Receiver);
+                               function_ref<bool(CanonicalFilePathRef FilePath)> Receiver,
+                               CancellationTokenRef CancelToken = nullptr);
 
   bool foreachFileIncludingFile(CanonicalFilePathRef targetPath,
                             function_ref<bool(CanonicalFilePathRef SourcePath, unsigned Line)> Receiver);
@@ -13,7 +13,12 @@
 #ifndef INDEXSTOREDB_INDEX_INDEXSYSTEM_H
 #define INDEXSTOREDB_INDEX_INDEXSYSTEM_H
 
+#include "IndexStoreDB/Index/AsyncQuery.h"
+#include "IndexStoreDB/Support/Cancellation.h"
 #include "IndexStoreDB/Support/LLVM.h"
+#include "IndexStoreDB/Support/MemoryGovernor.h"
+#include "IndexStoreDB/Support/Path.h"
+#include "IndexStoreDB/Support/QueryProfile.h"
 #include "IndexStoreDB/Support/Visibility.h"
 #include "indexstore/IndexStoreCXX.h"
 #include "llvm/ADT/OptionSet.h"
@@ -42,6 +47,8 @@ namespace index {
   class IndexSystemDelegate;
   typedef std::shared_ptr<SymbolDataProvider> SymbolDataProviderRef;
   struct StoreUnitInfo;
+  class SymbolOccurrenceView;
+  struct SymbolOccurrenceCount;
   class IndexStoreLibraryProvider;
 
 struct CreationOptions {
@@ -51,9 +58,37 @@ struct CreationOptions {
   bool readonly = false;
   bool enableOutOfDateFileWatching = false;
   bool listenToUnitEvents = true;
+  /// Record the number of occurrences of each symbol when importing records, so that
+  /// \c countSymbolOccurrencesByUSR can report occurrence counts.
+  bool recordOccurrenceCounts = false;
+  /// Number of bytes that the long-lived caches may use, see
+  /// \c IndexSystem::getMemoryUsage. They are trimmed to fit when the pending
+  /// units are imported. 0 means no budget.
+  size_t memoryBudget = 0;
+  /// Snapshot written by \c IndexSystem::exportSnapshot, to create the
+  /// database from if there is none yet. The initial scan then imports only
+  /// the units that are out of date with the snapshot.
+  std::string snapshotPath;
+  /// Replaces the path prefixes of the snapshot with local paths.
+  PathPrefixMap snapshotPrefixMap;
+  /// Opens the database in place so that other processes can use it at the
+  /// same time; see \c db::Database::createShared. Only the process that
+  /// writes the database imports units, the others see its imports as they
+  /// are committed and take over when it exits. All the processes that use
+  /// the database path need to set this.
+  bool shareDatabase = false;
+  /// Time during which the delegate events are collected and then delivered
+  /// together, through \c IndexSystemDelegate::processedStoreUnits and
+  /// \c IndexSystemDelegate::unitsAreOutOfDate, with the completed actions
+  /// added up. 0 delivers them as soon as the delegate queue gets to them.
+  std::chrono::milliseconds delegateBatchInterval{0};
+  /// Share of the unit processing time that the index gets while other
+  /// indexes of the process have units to process as well; see
+  /// \c IndexSystem::setUnitProcessingConcurrency.
+  unsigned unitProcessingWeight = 1;
 };
 
-class INDEXSTOREDB_EXPORT IndexSystem {
+class INDEXSTOREDB_EXPORT IndexSystem : public std::enable_shared_from_this<IndexSystem> {
 public:
   ~IndexSystem();
 
@@ -65,6 +100,16 @@ public:
                                              Optional<size_t> initialDBSize,
                                              std::string &Error);
 
+  /// Sets how many indexes of the process may process units at the same
+  /// time, 1 by default. Each index processes its units in order, and the
+  /// indexes with units to process take turns by their
+  /// \c CreationOptions::unitProcessingWeight.
+  static void setUnitProcessingConcurrency(unsigned concurrency);
+
+  /// Sets how many asynchronous queries of the process may run at the same
+  /// time, the number of cores by default.
+  static void setAsyncQueryConcurrency(unsigned concurrency);
+
   bool isUnitOutOfDate(StringRef unitOutputPath, ArrayRef<StringRef> dirtyFiles);
   bool isUnitOutOfDate(StringRef unitOutputPath, llvm::sys::TimePoint<> outOfDateModTime);
 
@@ -83,15 +128,50 @@ public:
   /// Only has an effect if `useExplicitOutputUnits` was set to true at initialization.
   void removeUnitOutFilePaths(ArrayRef<StringRef> filePaths, bool waitForProcessing = false);
 
+  /// Replace the set of output filepaths of the unit files that index data should be loaded from.
+  /// Only the units of the filepaths that were added or removed since the previous set get loaded or removed.
+  /// Only has an effect if `useExplicitOutputUnits` was set to true at initialization.
+  void setUnitOutFilePaths(ArrayRef<StringRef> filePaths, bool waitForProcessing = false);
+
+  /// Import the pending units of the given files, main source files or unit
+  /// output files, ahead of the other pending units.
+  ///
+  /// The units of registered main files and of explicit output files already
+  /// get priority, as do the units of files that are queried.
+  void prioritizeFiles(ArrayRef<StringRef> filePaths);
+
   // FIXME: Accept a list of active main files so that it can remove stale unit
   // files.
   void purgeStaleData();
 
+  /// \returns the approximate number of bytes used by each of the long-lived
+  /// caches of the index.
+  std::vector<MemoryUsage> getMemoryUsage();
+
+  /// Releases memory held by caches, for instance when the system reports
+  /// memory pressure. The index keeps working and fills the caches again as
+  /// needed.
+  void trimMemory(MemoryTrimLevel level);
+
   /// *For Testing* Poll for any changes to units and wait until they have been registered.
   void pollForUnitChangesAndWait(bool isInitialScan);
 
   void printStats(raw_ostream &OS);
 
+  /// Writes a compacted copy of the database into the directory \p destPath,
+  /// to seed the database of another machine through
+  /// \c CreationOptions::snapshotPath. \p prefixMap replaces the path prefixes
+  /// that are specific to this machine, for instance the root of the sources
+  /// with a placeholder.
+  ///
+  /// \returns true if an error occurred.
+  bool exportSnapshot(StringRef destPath, const PathPrefixMap &prefixMap, std::string &error);
+
+  /// Writes the process-wide metrics, see \c metrics::Registry, the storage
+  /// statistics of the database and the statistics of the unit processing
+  /// queue of the index as a JSON object.
+  void writeMetricsJSON(raw_ostream &OS);
+
   void dumpProviderFileAssociations(raw_ostream &OS);
   void dumpProviderFileAssociations();
 
@@ -107,23 +187,48 @@ public:
   bool foreachSymbolOccurrenceInFilePath(StringRef FilePath,
                                          function_ref<bool(SymbolOccurrenceRef Occur)> Receiver);
 
+  // Queries that accept a \c CancellationToken stop within a bounded amount of
+  // work after it is cancelled, or its deadline passes, and return false.
+  //
+  // Queries execute on the calling thread; to find out where their time goes,
+  // run them inside a \c QueryProfile::Scope.
+
   bool foreachSymbolOccurrenceByUSR(StringRef USR, SymbolRoleSet RoleSet,
-                        function_ref<bool(SymbolOccurrenceRef Occur)> Receiver);
+                        function_ref<bool(SymbolOccurrenceRef Occur)> Receiver,
+                        CancellationTokenRef CancelToken = nullptr);
 
   bool foreachRelatedSymbolOccurrenceByUSR(StringRef USR, SymbolRoleSet RoleSet,
-                        function_ref<bool(SymbolOccurrenceRef Occur)> Receiver);
+                        function_ref<bool(SymbolOccurrenceRef Occur)> Receiver,
+                        CancellationTokenRef CancelToken = nullptr);
+
+  /// Same as \c foreachSymbolOccurrenceByUSR but reports the occurrences as
+  /// views that point into the record data and are valid only for the
+  /// duration of the receiver call, so that reporting them doesn't allocate.
+  /// Use \c SymbolOccurrenceView::copy to retain an occurrence.
+  bool foreachSymbolOccurrenceViewByUSR(StringRef USR, SymbolRoleSet RoleSet,
+                        function_ref<bool(const SymbolOccurrenceView &Occur)> Receiver,
+                        CancellationTokenRef CancelToken = nullptr);
+
+  /// Same as \c foreachRelatedSymbolOccurrenceByUSR but reports the
+  /// occurrences as views, see \c foreachSymbolOccurrenceViewByUSR.
+  bool foreachRelatedSymbolOccurrenceViewByUSR(StringRef USR, SymbolRoleSet RoleSet,
+                        function_ref<bool(const SymbolOccurrenceView &Occur)> Receiver,
+                        CancellationTokenRef CancelToken = nullptr);
 
   bool foreachCanonicalSymbolOccurrenceContainingPattern(StringRef Pattern,
                                                 bool AnchorStart,
                                                 bool AnchorEnd,
                                                 bool Subsequence,
                                                 bool IgnoreCase,
-                        function_ref<bool(SymbolOccurrenceRef Occur)> Receiver);
+                        function_ref<bool(SymbolOccurrenceRef Occur)> Receiver,
+                        CancellationTokenRef CancelToken = nullptr);
 
   bool foreachCanonicalSymbolOccurrenceByName(StringRef name,
-                        function_ref<bool(SymbolOccurrenceRef Occur)> receiver);
+                        function_ref<bool(SymbolOccurrenceRef Occur)> receiver,
+                        CancellationTokenRef cancelToken = nullptr);
 
-  bool foreachSymbolName(function_ref<bool(StringRef name)> receiver);
+  bool foreachSymbolName(function_ref<bool(StringRef name)> receiver,
+                         CancellationTokenRef cancelToken = nullptr);
 
   bool foreachCanonicalSymbolOccurrenceByUSR(StringRef USR,
                         function_ref<bool(SymbolOccurrenceRef occur)> receiver);
@@ -131,25 +236,70 @@ public:
   bool foreachSymbolCallOccurrence(SymbolOccurrenceRef Callee,
                         function_ref<bool(SymbolOccurrenceRef Occur)> Receiver);
 
+  /// Counts what \c foreachSymbolOccurrenceByUSR would report, without reading any record data.
+  SymbolOccurrenceCount countSymbolOccurrencesByUSR(StringRef USR, SymbolRoleSet RoleSet);
+  /// Counts what \c foreachRelatedSymbolOccurrenceByUSR would report, without reading any record data.
+  SymbolOccurrenceCount countRelatedSymbolOccurrencesByUSR(StringRef USR, SymbolRoleSet RoleSet);
+
   size_t countOfCanonicalSymbolsWithKind(SymbolKind symKind, bool workspaceOnly);
+  /// Returns an estimate for \c countOfCanonicalSymbolsWithKind in constant time.
+  size_t estimateCountOfSymbolsWithKind(SymbolKind symKind);
   bool foreachCanonicalSymbolOccurrenceByKind(SymbolKind symKind, bool workspaceOnly,
-                        function_ref<bool(SymbolOccurrenceRef Occur)> Receiver);
+                        function_ref<bool(SymbolOccurrenceRef Occur)> Receiver,
+                        CancellationTokenRef CancelToken = nullptr);
+
+  // Asynchronous variants of the queries above. They run on the query
+  // executor, see \c setAsyncQueryConcurrency, deliver the occurrences to
+  // \p receiver in batches of \c AsyncQueryOptions::BatchSize and then call
+  // \p completion with what the query returned.
+
+  AsyncQueryRef foreachSymbolOccurrenceByUSRAsync(StringRef USR, SymbolRoleSet RoleSet,
+                                                  const AsyncQueryOptions &Options,
+                                                  SymbolOccurrenceBatchReceiver Receiver,
+                                                  AsyncQueryCompletion Completion);
+
+  AsyncQueryRef foreachRelatedSymbolOccurrenceByUSRAsync(StringRef USR, SymbolRoleSet RoleSet,
+                                                         const AsyncQueryOptions &Options,
+                                                         SymbolOccurrenceBatchReceiver Receiver,
+                                                         AsyncQueryCompletion Completion);
+
+  AsyncQueryRef foreachCanonicalSymbolOccurrenceContainingPatternAsync(StringRef Pattern,
+                                                             bool AnchorStart,
+                                                             bool AnchorEnd,
+                                                             bool Subsequence,
+                                                             bool IgnoreCase,
+                                                             const AsyncQueryOptions &Options,
+                                                             SymbolOccurrenceBatchReceiver Receiver,
+                                                             AsyncQueryCompletion Completion);
+
+  AsyncQueryRef foreachCanonicalSymbolOccurrenceByNameAsync(StringRef name,
+                                                            const AsyncQueryOptions &options,
+                                                            SymbolOccurrenceBatchReceiver receiver,
+                                                            AsyncQueryCompletion completion);
+
+  AsyncQueryRef foreachCanonicalSymbolOccurrenceByKindAsync(SymbolKind symKind, bool workspaceOnly,
+                                                            const AsyncQueryOptions &Options,
+                                                            SymbolOccurrenceBatchReceiver Receiver,
+                                                            AsyncQueryCompletion Completion);
 
   bool isKnownFile(StringRef filePath);
 
   bool foreachMainUnitContainingFile(StringRef filePath,
-                             function_ref<bool(const StoreUnitInfo &unitInfo)> receiver);
+                             function_ref<bool(const StoreUnitInfo &unitInfo)> receiver,
+                             CancellationTokenRef cancelToken = nullptr);
 
   bool foreachFileOfUnit(StringRef unitName,
                          bool followDependencies,
-                         function_ref<bool(CanonicalFilePathRef filePath)> receiver);
+                         function_ref<bool(CanonicalFilePathRef filePath)> receiver,
+                         CancellationTokenRef cancelToken = nullptr);
 
   bool foreachFilenameContainingPattern(StringRef Pattern,
                                         bool AnchorStart,
                                         bool AnchorEnd,
                                         bool Subsequence,
                                         bool IgnoreCase,
-                               function_ref<bool(CanonicalFilePathRef FilePath)> Receiver);
+                               function_ref<bool(CanonicalFilePathRef FilePath)> Receiver,
+                               CancellationTokenRef CancelToken = nullptr);
 
   bool foreachFileIncludingFile(StringRef TargetPath,
                                              function_ref<bool(CanonicalFilePathRef SourcePath, unsigned Line)> Receiver);
@@ -163,7 +313,8 @@ public:
   /// Returns unit test class/method occurrences that are referenced from units associated with the provided output file paths.
   /// \returns `false` if the receiver returned `false` to stop receiving symbols, `true` otherwise.
   bool foreachUnitTestSymbolReferencedByOutputPaths(ArrayRef<CanonicalFilePathRef> FilePaths,
-      function_ref<bool(SymbolOccurrenceRef Occur)> Receiver);
+      function_ref<bool(SymbolOccurrenceRef Occur)> Receiver,
+      CancellationTokenRef CancelToken = nullptr);
 
 
   /// Calls `receiver` for every unit test symbol in unit files that reference
@@ -172,13 +323,15 @@ public:
   ///  \returns `false` if the receiver returned `false` to stop receiving symbols, `true` otherwise.
   bool foreachUnitTestSymbolReferencedByMainFiles(
       ArrayRef<StringRef> mainFilePaths,
-      function_ref<bool(SymbolOccurrenceRef Occur)> receiver
+      function_ref<bool(SymbolOccurrenceRef Occur)> receiver,
+      CancellationTokenRef cancelToken = nullptr
   );
 
   /// Calls `receiver` for every unit test symbol in the index.
   ///
   ///  \returns `false` if the receiver returned `false` to stop receiving symbols, `true` otherwise.
-  bool foreachUnitTestSymbol(function_ref<bool(SymbolOccurrenceRef Occur)> receiver);
+  bool foreachUnitTestSymbol(function_ref<bool(SymbolOccurrenceRef Occur)> receiver,
+                             CancellationTokenRef cancelToken = nullptr);
 
   /// Returns the latest modification date of a unit that contains the given source file.
   ///
@@ -14,6 +14,8 @@
 #define INDEXSTOREDB_INDEX_INDEXSYSTEMDELEGATE_H
 
 #include "IndexStoreDB/Index/StoreUnitInfo.h"
+#include "IndexStoreDB/Support/LLVM.h"
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/Support/Chrono.h"
 #include <memory>
 #include <string>
@@ -52,6 +54,12 @@ public:
   std::string description() { return FilePath; }
 };
 
+/// A unit that became out-of-date, and the file that triggered it.
+struct OutOfDateUnit {
+  StoreUnitInfo UnitInfo;
+  OutOfDateFileTriggerRef Trigger;
+};
+
 class INDEXSTOREDB_EXPORT IndexSystemDelegate {
 public:
   virtual ~IndexSystemDelegate() {}
@@ -68,6 +76,23 @@ public:
                                OutOfDateFileTriggerRef trigger,
                                bool synchronous = false) {}
 
+  /// Called with the units processed together, or during the batching
+  /// interval of the index; see \c CreationOptions::delegateBatchInterval.
+  /// Calls \c processedStoreUnit for each of them by default.
+  virtual void processedStoreUnits(ArrayRef<StoreUnitInfo> unitInfos) {
+    for (const StoreUnitInfo &unitInfo : unitInfos)
+      processedStoreUnit(unitInfo);
+  }
+
+  /// Called with the units found out-of-date together, or during the
+  /// batching interval of the index. Calls \c unitIsOutOfDate for each of
+  /// them by default.
+  virtual void unitsAreOutOfDate(ArrayRef<OutOfDateUnit> units,
+                                 bool synchronous = false) {
+    for (const OutOfDateUnit &unit : units)
+      unitIsOutOfDate(unit.UnitInfo, unit.Trigger, synchronous);
+  }
+
 private:
   virtual void anchor();
 };
@@ -33,6 +33,7 @@ namespace db {
 }
 
 namespace index {
+  class SymbolOccurrenceView;
 
 class SymbolDataProvider {
 public:
@@ -48,6 +49,12 @@ public:
                                                        SymbolRoleSet Roles,
                                                        SymbolRoleSet RelatedRoles)> Receiver) = 0;
 
+  /// Passes, for each USR in the provider, the number of occurrences of the
+  /// symbol and the number of occurrences that have a relation to it.
+  virtual bool foreachSymbolOccurrenceCount(function_ref<bool(StringRef USR,
+                                                              unsigned NumOccurrences,
+                                                              unsigned NumRelatedOccurrences)> Receiver) = 0;
+
   virtual bool foreachSymbolOccurrence(function_ref<bool(SymbolOccurrenceRef Occur)> Receiver) = 0;
 
   virtual bool foreachSymbolOccurrenceByUSR(ArrayRef<db::IDCode> USRs,
@@ -58,6 +65,16 @@ public:
                                             SymbolRoleSet RoleSet,
                         function_ref<bool(SymbolOccurrenceRef Occur)> Receiver) = 0;
 
+  /// Same as \c foreachSymbolOccurrenceByUSR but reports the occurrences as
+  /// views that are valid only for the duration of the receiver call.
+  virtual bool foreachSymbolOccurrenceViewByUSR(ArrayRef<db::IDCode> USRs,
+                                                SymbolRoleSet RoleSet,
+                        function_ref<bool(const SymbolOccurrenceView &Occur)> Receiver) = 0;
+
+  virtual bool foreachRelatedSymbolOccurrenceViewByUSR(ArrayRef<db::IDCode> USRs,
+                                                       SymbolRoleSet RoleSet,
+                        function_ref<bool(const SymbolOccurrenceView &Occur)> Receiver) = 0;
+
   virtual bool foreachUnitTestSymbolOccurrence(
                         function_ref<bool(SymbolOccurrenceRef Occur)> Receiver) = 0;
 
@@ -13,6 +13,7 @@
 #ifndef INDEXSTOREDB_INDEX_SYMBOLINDEX_H
 #define INDEXSTOREDB_INDEX_SYMBOLINDEX_H
 
+#include "IndexStoreDB/Support/Cancellation.h"
 #include "IndexStoreDB/Support/LLVM.h"
 #include "llvm/ADT/OptionSet.h"
 #include "llvm/Support/Chrono.h"
@@ -39,12 +40,15 @@ namespace db {
 namespace index {
   class FileVisibilityChecker;
   class SymbolDataProvider;
+  class SymbolOccurrenceView;
+  struct SymbolOccurrenceCount;
   typedef std::shared_ptr<SymbolDataProvider> SymbolDataProviderRef;
 
 class SymbolIndex {
 public:
   SymbolIndex(db::DatabaseRef dbase, indexstore::IndexStoreRef indexStore,
-              std::shared_ptr<FileVisibilityChecker> visibilityChecker);
+              std::shared_ptr<FileVisibilityChecker> visibilityChecker,
+              bool recordOccurrenceCounts = false);
   ~SymbolIndex();
 
   db::DatabaseRef getDBase() const;
@@ -59,11 +63,24 @@ public:
   // Queries
   //===--------------------------------------------------------------------===//
 
+  // Queries that accept a \c CancellationToken return false when they stop
+  // early because it was cancelled.
+
   bool foreachSymbolOccurrenceByUSR(StringRef USR, SymbolRoleSet RoleSet,
-                        function_ref<bool(SymbolOccurrenceRef Occur)> Receiver);
+                        function_ref<bool(SymbolOccurrenceRef Occur)> Receiver,
+                        CancellationTokenRef CancelToken = nullptr);
 
   bool foreachRelatedSymbolOccurrenceByUSR(StringRef USR, SymbolRoleSet RoleSet,
-                        function_ref<bool(SymbolOccurrenceRef Occur)> Receiver);
+                        function_ref<bool(SymbolOccurrenceRef Occur)> Receiver,
+                        CancellationTokenRef CancelToken = nullptr);
+
+  bool foreachSymbolOccurrenceViewByUSR(StringRef USR, SymbolRoleSet RoleSet,
+                        function_ref<bool(const SymbolOccurrenceView &Occur)> Receiver,
+                        CancellationTokenRef CancelToken = nullptr);
+
+  bool foreachRelatedSymbolOccurrenceViewByUSR(StringRef USR, SymbolRoleSet RoleSet,
+                        function_ref<bool(const SymbolOccurrenceView &Occur)> Receiver,
+                        CancellationTokenRef CancelToken = nullptr);
 
   bool foreachSymbolInFilePath(CanonicalFilePathRef filePath,
                                function_ref<bool(SymbolRef Occur)> Receiver);
@@ -76,22 +93,35 @@ public:
                                                 bool AnchorEnd,
                                                 bool Subsequence,
                                                 bool IgnoreCase,
-                              function_ref<bool(SymbolOccurrenceRef)> Receiver);
+                              function_ref<bool(SymbolOccurrenceRef)> Receiver,
+                              CancellationTokenRef CancelToken = nullptr);
 
   bool foreachCanonicalSymbolOccurrenceByName(StringRef name,
-                        function_ref<bool(SymbolOccurrenceRef Occur)> receiver);
+                        function_ref<bool(SymbolOccurrenceRef Occur)> receiver,
+                        CancellationTokenRef cancelToken = nullptr);
 
-  bool foreachSymbolName(function_ref<bool(StringRef name)> receiver);
+  bool foreachSymbolName(function_ref<bool(StringRef name)> receiver,
+                         CancellationTokenRef cancelToken = nullptr);
 
   bool foreachCanonicalSymbolOccurrenceByUSR(StringRef USR,
                         function_ref<bool(SymbolOccurrenceRef occur)> receiver);
 
+  /// Counts what \c foreachSymbolOccurrenceByUSR would report, without reading any record data.
+  SymbolOccurrenceCount countSymbolOccurrencesByUSR(StringRef USR, SymbolRoleSet RoleSet);
+  /// Counts what \c foreachRelatedSymbolOccurrenceByUSR would report, without reading any record data.
+  SymbolOccurrenceCount countRelatedSymbolOccurrencesByUSR(StringRef USR, SymbolRoleSet RoleSet);
+
   size_t countOfCanonicalSymbolsWithKind(SymbolKind symKind, bool workspaceOnly);
+  /// Returns an estimate for \c countOfCanonicalSymbolsWithKind in constant time.
+  /// Each symbol is counted once, including system symbols and symbols whose records are no longer visible.
+  size_t estimateCountOfSymbolsWithKind(SymbolKind symKind);
   bool foreachCanonicalSymbolOccurrenceByKind(SymbolKind symKind, bool workspaceOnly,
-                                              function_ref<bool(SymbolOccurrenceRef Occur)> Receiver);
+                                              function_ref<bool(SymbolOccurrenceRef Occur)> Receiver,
+                                              CancellationTokenRef CancelToken = nullptr);
 
   bool foreachUnitTestSymbolReferencedByOutputPaths(ArrayRef<CanonicalFilePathRef> FilePaths,
-      function_ref<bool(SymbolOccurrenceRef Occur)> Receiver);
+      function_ref<bool(SymbolOccurrenceRef Occur)> Receiver,
+      CancellationTokenRef CancelToken = nullptr);
 
   /// Calls `receiver` for every unit test symbol in unit files that reference
   /// one of the main files in `mainFilePaths`.
@@ -99,12 +129,14 @@ public:
   ///  \returns `false` if the receiver returned `false` to stop receiving symbols, `true` otherwise.
   bool foreachUnitTestSymbolReferencedByMainFiles(
       ArrayRef<CanonicalFilePath> mainFilePaths,
-      function_ref<bool(SymbolOccurrenceRef Occur)> receiver
+      function_ref<bool(SymbolOccurrenceRef Occur)> receiver,
+      CancellationTokenRef cancelToken = nullptr
   );
   /// Calls `receiver` for every unit test symbol in the index.
   ///
   ///  \returns `false` if the receiver returned `false` to stop receiving symbols, `true` otherwise.
-  bool foreachUnitTestSymbol(function_ref<bool(SymbolOccurrenceRef Occur)> receiver);
+  bool foreachUnitTestSymbol(function_ref<bool(SymbolOccurrenceRef Occur)> receiver,
+                             CancellationTokenRef cancelToken = nullptr);
 
   /// Returns the latest modification date of a unit that contains the given source file.
   ///
@@ -0,0 +1,51 @@
+//===--- SymbolOccurrenceCount.h --------------------------------*- C++ -*-===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2018 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://swift.org/LICENSE.txt for license information
+// See https://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef INDEXSTOREDB_INDEX_SYMBOLOCCURRENCECOUNT_H
+#define INDEXSTOREDB_INDEX_SYMBOLOCCURRENCECOUNT_H
+
+#include "IndexStoreDB/Support/LLVM.h"
+#include "llvm/ADT/Optional.h"
+#include <cstddef>
+
+namespace IndexStoreDB {
+namespace index {
+
+/// Counts for a symbol occurrence query, computed from the database without
+/// reading any record data.
+struct SymbolOccurrenceCount {
+  /// Number of visible records that contain the symbol with any of the
+  /// requested roles.
+  size_t ProviderCount = 0;
+  /// Number of distinct visible source files of those records.
+  size_t FileCount = 0;
+  /// Number of occurrences that the equivalent \c foreach query would report.
+  /// \c None if occurrence counts were not recorded for one of the records,
+  /// see \c CreationOptions::recordOccurrenceCounts.
+  Optional<size_t> OccurrenceCount;
+  /// If false, \c OccurrenceCount is an upper bound because some records also
+  /// contain occurrences of the symbol without any of the requested roles.
+  bool IsExact = true;
+
+  SymbolOccurrenceCount() = default;
+  SymbolOccurrenceCount(size_t providerCount, size_t fileCount,
+                        Optional<size_t> occurrenceCount, bool isExact)
+      : ProviderCount(providerCount),
+        FileCount(fileCount),
+        OccurrenceCount(occurrenceCount),
+        IsExact(isExact) {}
+};
+
+} // namespace index
+} // namespace IndexStoreDB
+
+#endif
@@ -0,0 +1,105 @@
+//===--- SymbolOccurrenceView.h ---------------------------------*- C++ -*-===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2018 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://swift.org/LICENSE.txt for license information
+// See https://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef INDEXSTOREDB_INDEX_SYMBOLOCCURRENCEVIEW_H
+#define INDEXSTOREDB_INDEX_SYMBOLOCCURRENCEVIEW_H
+
+#include "IndexStoreDB/Core/Symbol.h"
+#include "IndexStoreDB/Support/Visibility.h"
+#include "indexstore/IndexStoreCXX.h"
+
+namespace IndexStoreDB {
+namespace index {
+
+/// A symbol of a \c SymbolOccurrenceView. Its name and USR point into the
+/// record that it was read from.
+class SymbolView {
+  SymbolInfo SymInfo;
+  StringRef Name;
+  StringRef USR;
+
+public:
+  SymbolView(SymbolInfo Info, StringRef Name, StringRef USR)
+    : SymInfo(Info), Name(Name), USR(USR) {}
+
+  const SymbolInfo &getSymbolInfo() const { return SymInfo; }
+  SymbolKind getSymbolKind() const { return SymInfo.Kind; }
+  SymbolSubKind getSymbolSubKind() const { return SymInfo.SubKind; }
+  SymbolPropertySet getSymbolProperties() const { return SymInfo.Properties; }
+  SymbolLanguage getLanguage() const { return SymInfo.Lang; }
+  StringRef getName() const { return Name; }
+  StringRef getUSR() const { return USR; }
+
+  /// Copies the symbol for use after the receiver returns.
+  SymbolRef copy() const {
+    return std::make_shared<Symbol>(SymInfo, Name, USR);
+  }
+};
+
+/// A symbol occurrence that is only valid for the duration of the receiver
+/// call, see \c IndexSystem::foreachSymbolOccurrenceViewByUSR.
+///
+/// Unlike \c SymbolOccurrence, reporting it doesn't allocate: its strings
+/// point into the record reader and into the file references of the record,
+/// which all the occurrences of the record share, and its relations are only
+/// decoded when they are iterated.
+class INDEXSTOREDB_EXPORT SymbolOccurrenceView {
+  mutable indexstore::IndexRecordOccurrence RecOccur;
+  SymbolView Sym;
+  SymbolRoleSet Roles;
+  const TimestampedPath &Path;
+  StringRef Target;
+  unsigned Line;
+  unsigned Column;
+  SymbolProviderKind ProviderKind;
+
+public:
+  SymbolOccurrenceView(indexstore::IndexRecordOccurrence RecOccur,
+                       SymbolView Sym,
+                       SymbolRoleSet Roles,
+                       const TimestampedPath &Path,
+                       StringRef Target,
+                       unsigned Line,
+                       unsigned Column,
+                       SymbolProviderKind ProviderKind)
+    : RecOccur(std::move(RecOccur)), Sym(Sym), Roles(Roles), Path(Path),
+      Target(Target), Line(Line), Column(Column), ProviderKind(ProviderKind) {}
+
+  SymbolOccurrenceView(const SymbolOccurrenceView &) = delete;
+  SymbolOccurrenceView &operator=(const SymbolOccurrenceView &) = delete;
+
+  const SymbolView &getSymbol() const { return Sym; }
+  SymbolRoleSet getRoles() const { return Roles; }
+  const TimestampedPath &getPath() const { return Path; }
+  unsigned getLine() const { return Line; }
+  unsigned getColumn() const { return Column; }
+  StringRef getTarget() const { return Target; }
+  SymbolProviderKind getSymbolProviderKind() const { return ProviderKind; }
+
+  bool isCanonical() const {
+    return Roles.contains(SymbolRole::Canonical);
+  }
+
+  /// Decodes the relations of the occurrence from the record.
+  ///
+  /// \returns false if the receiver returned false to stop.
+  bool foreachRelation(function_ref<bool(SymbolRoleSet Roles, const SymbolView &Sym)> Receiver) const;
+
+  /// Copies the occurrence, with its relations, for use after the receiver
+  /// returns.
+  SymbolOccurrenceRef copy() const;
+};
+
+} // namespace index
+} // namespace IndexStoreDB
+
+#endif
@@ -0,0 +1,81 @@
+//===--- Cancellation.h -----------------------------------------*- C++ -*-===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2018 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://swift.org/LICENSE.txt for license information
+// See https://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef INDEXSTOREDB_SUPPORT_CANCELLATION_H
+#define INDEXSTOREDB_SUPPORT_CANCELLATION_H
+
+#include "IndexStoreDB/Support/Visibility.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+namespace IndexStoreDB {
+
+/// Allows stopping a query from another thread, or after a deadline.
+///
+/// Queries check the token periodically and return as if the receiver had
+/// returned false once it is cancelled.
+class INDEXSTOREDB_EXPORT CancellationToken {
+public:
+  typedef std::chrono::steady_clock::time_point Deadline;
+
+  CancellationToken() = default;
+  explicit CancellationToken(Deadline deadline) : TheDeadline(deadline) {}
+
+  static std::shared_ptr<CancellationToken> create() {
+    return std::make_shared<CancellationToken>();
+  }
+  static std::shared_ptr<CancellationToken> createWithTimeout(std::chrono::nanoseconds timeout);
+
+  void cancel() { Cancelled.store(true, std::memory_order_relaxed); }
+
+  /// \returns true if \c cancel was called or the deadline has passed.
+  bool isCancelled() const;
+
+private:
+  std::atomic<bool> Cancelled{false};
+  Deadline TheDeadline = Deadline::max();
+};
+
+typedef std::shared_ptr<CancellationToken> CancellationTokenRef;
+
+/// Checks a, possibly null, token for use inside tight loops.
+///
+/// The token is consulted on the first call and then every \c CheckInterval
+/// calls so that checking the deadline doesn't dominate cheap iterations. Once
+/// cancellation was observed it keeps reporting it.
+class CancellationCheck {
+  const CancellationToken *Token;
+  unsigned Count = CheckInterval - 1;
+  bool Cancelled = false;
+
+public:
+  static const unsigned CheckInterval = 64;
+
+  explicit CancellationCheck(const CancellationToken *token) : Token(token) {}
+
+  bool isCancelled() {
+    if (Cancelled)
+      return true;
+    if (!Token)
+      return false;
+    if (++Count < CheckInterval)
+      return false;
+    Count = 0;
+    Cancelled = Token->isCancelled();
+    return Cancelled;
+  }
+};
+
+} // namespace IndexStoreDB
+
+#endif
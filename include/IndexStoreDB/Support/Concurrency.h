@@ -13,8 +13,10 @@
 #ifndef LLVM_INDEXSTOREDB_SUPPORT_CONCURRENCY_H
 #define LLVM_INDEXSTOREDB_SUPPORT_CONCURRENCY_H
 
+#include "IndexStoreDB/Support/LLVM.h"
 #include "IndexStoreDB/Support/Visibility.h"
 #include "llvm/ADT/StringRef.h"
+#include <chrono>
 
 namespace IndexStoreDB {
 
@@ -65,6 +67,12 @@ public:
                                              isStackDeep));
   }
 
+  /// Dispatches \p Fn to run after \p Delay has elapsed.
+  template <typename Callable>
+  void dispatchAfter(std::chrono::nanoseconds Delay, Callable &&Fn) {
+    Impl::dispatchAfter(ImplObj, Delay, DispatchData(std::forward<Callable>(Fn)));
+  }
+
   void dispatchBarrier(void *Context, DispatchFn Fn, bool isStackDeep = false) {
     Impl::dispatchBarrier(ImplObj, DispatchData(Context, Fn, isStackDeep));
   }
@@ -106,6 +114,31 @@ public:
                                                 isStackDeep));
   }
 
+  /// Calls \p Fn with each index in [0, \p Iterations) concurrently and
+  /// returns when all the calls have returned. The calling thread takes part.
+  static void concurrentPerform(size_t Iterations,
+                                llvm::function_ref<void(size_t)> Fn,
+                                Priority Prio = Priority::Default);
+
+  /// Tells the executor that the calling thread waits for other work of the
+  /// work queues while the scope is alive. The native thread pool starts a
+  /// worker in place of a worker that waits, so that the work it waits for
+  /// can run. \c dispatchSync and \c concurrentPerform do this already.
+  class BlockingScope {
+  public:
+    BlockingScope() { Impl::beginBlocking(); }
+    ~BlockingScope() { Impl::endBlocking(); }
+
+    BlockingScope(const BlockingScope &) = delete;
+    BlockingScope &operator=(const BlockingScope &) = delete;
+  };
+
+  /// \returns the name of the executor that runs the work queues, either
+  /// "libdispatch" or "native".
+  static llvm::StringRef getExecutorName() {
+    return Impl::getExecutorName();
+  }
+
   void suspend() {
     Impl::suspend(ImplObj);
   }
@@ -170,16 +203,22 @@ private:
     bool IsStackDeep;
   };
 
-  // Platform-specific implementation.
+  // Executor-specific implementation, over libdispatch or over the native
+  // thread pool when built with INDEXSTOREDB_NATIVE_WORK_QUEUE.
   struct Impl {
     typedef void *Ty;
     static Ty create(Dequeuing DeqKind, Priority Prio, llvm::StringRef Label);
     static void dispatch(Ty Obj, const DispatchData &Fn);
     static void dispatchSync(Ty Obj, const DispatchData &Fn);
+    static void dispatchAfter(Ty Obj, std::chrono::nanoseconds Delay,
+                              const DispatchData &Fn);
     static void dispatchBarrier(Ty Obj, const DispatchData &Fn);
     static void dispatchBarrierSync(Ty Obj, const DispatchData &Fn);
     static void dispatchOnMain(const DispatchData &Fn);
     static void dispatchConcurrent(Priority Prio, const DispatchData &Fn);
+    static void beginBlocking();
+    static void endBlocking();
+    static llvm::StringRef getExecutorName();
     static void suspend(Ty Obj);
     static void resume(Ty Obj);
     static void setPriority(Ty Obj, Priority Prio);
@@ -0,0 +1,40 @@
+//===--- DirectoryScan.h ----------------------------------------*- C++ -*-===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2018 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://swift.org/LICENSE.txt for license information
+// See https://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef INDEXSTOREDB_SUPPORT_DIRECTORYSCAN_H
+#define INDEXSTOREDB_SUPPORT_DIRECTORYSCAN_H
+
+#include "IndexStoreDB/Support/LLVM.h"
+#include "IndexStoreDB/Support/Visibility.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Chrono.h"
+#include <string>
+
+namespace IndexStoreDB {
+
+/// Calls \p receiver with the name and modification time of each regular file
+/// of the directory at \p dirPath, in no particular order.
+///
+/// The entries are read in batches by the directory stream and each file is
+/// stat'ed relative to the open directory, so that its path does not need to
+/// be built and resolved again.
+///
+/// \returns true if an error occurred, in which case \p error is set.
+INDEXSTOREDB_EXPORT
+bool scanDirectoryModificationTimes(StringRef dirPath,
+                                    function_ref<void(StringRef name, llvm::sys::TimePoint<> modTime)> receiver,
+                                    std::string &error);
+
+} // namespace IndexStoreDB
+
+#endif
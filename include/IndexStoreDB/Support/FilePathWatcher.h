@@ -18,6 +18,8 @@
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/StringRef.h"
 #include <functional>
+#include <string>
+#include <vector>
 
 namespace IndexStoreDB {
 
@@ -29,6 +31,16 @@ public:
   explicit FilePathWatcher(FileEventsReceiverTy pathsReceiver);
   ~FilePathWatcher();
 
+  /// \returns true if the watcher of this platform only reports the
+  /// directories added with \c addDirectories. Otherwise it watches the whole
+  /// file system and ignores them.
+  static bool watchesIndividualDirectories();
+
+  /// Starts watching the files directly in \p directories. Each directory
+  /// should be added once, until it's removed.
+  void addDirectories(ArrayRef<std::string> directories);
+  void removeDirectories(ArrayRef<std::string> directories);
+
 private:
   Implementation &Impl;
 };
@@ -0,0 +1,84 @@
+//===--- MemoryGovernor.h ---------------------------------------*- C++ -*-===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2018 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://swift.org/LICENSE.txt for license information
+// See https://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef INDEXSTOREDB_SUPPORT_MEMORYGOVERNOR_H
+#define INDEXSTOREDB_SUPPORT_MEMORYGOVERNOR_H
+
+#include "IndexStoreDB/Support/LLVM.h"
+#include "IndexStoreDB/Support/Visibility.h"
+#include "llvm/ADT/StringRef.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace IndexStoreDB {
+
+enum class MemoryTrimLevel : uint8_t {
+  /// Drop the caches of lookups, which fill up again as they are used.
+  Moderate,
+  /// Also drop the data that can be reloaded from the database, and release
+  /// the unused capacity of the structures that can't be dropped.
+  Critical,
+};
+
+/// Approximate number of bytes held by one of the long-lived structures.
+struct MemoryUsage {
+  std::string Name;
+  size_t Bytes;
+};
+
+/// \returns an estimate of the bytes allocated by an \c std::unordered_map or
+/// \c std::unordered_set, not counting what its elements point to.
+template <typename HashContainer>
+size_t getHashContainerMemoryUsage(const HashContainer &container) {
+  // Each node holds the element, its hash and the next pointer.
+  return container.size() * (sizeof(typename HashContainer::value_type) + 2 * sizeof(void *)) +
+         container.bucket_count() * sizeof(void *);
+}
+
+/// Accounts for the memory of the long-lived caches of an index and trims
+/// them when asked to, or when they go over a budget.
+class INDEXSTOREDB_EXPORT MemoryGovernor {
+public:
+  typedef std::function<size_t()> UsageFn;
+  typedef std::function<void(MemoryTrimLevel)> TrimFn;
+
+  /// \param budget number of bytes that the consumers may use together, or 0
+  /// for no limit.
+  explicit MemoryGovernor(size_t budget = 0);
+  ~MemoryGovernor();
+
+  size_t getBudget() const;
+
+  /// Adds a named structure. \p trim is called with the governor unlocked and
+  /// may be called concurrently with \p usage.
+  void addConsumer(StringRef name, UsageFn usage, TrimFn trim);
+
+  std::vector<MemoryUsage> getMemoryUsage() const;
+
+  void trimMemory(MemoryTrimLevel level);
+
+  /// Trims the consumers if they use more than the budget, moderately first
+  /// and critically if that was not enough.
+  ///
+  /// \returns true if the consumers fit the budget afterwards.
+  bool enforceBudget();
+
+private:
+  void *Impl;
+};
+
+} // namespace IndexStoreDB
+
+#endif
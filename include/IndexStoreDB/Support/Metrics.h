@@ -0,0 +1,198 @@
+//===--- Metrics.h ----------------------------------------------*- C++ -*-===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2018 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://swift.org/LICENSE.txt for license information
+// See https://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef INDEXSTOREDB_SUPPORT_METRICS_H
+#define INDEXSTOREDB_SUPPORT_METRICS_H
+
+#include "IndexStoreDB/Support/LLVM.h"
+#include "IndexStoreDB/Support/Visibility.h"
+#include "llvm/ADT/StringRef.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+/// Set to 0 to compile out all the metric probes; the registry then only
+/// reports gauges.
+#ifndef INDEXSTOREDB_ENABLE_METRICS
+#define INDEXSTOREDB_ENABLE_METRICS 1
+#endif
+
+namespace llvm {
+namespace json {
+  class Value;
+}
+}
+
+namespace IndexStoreDB {
+namespace metrics {
+
+/// Base of the named metrics of the process. Metrics are meant to be defined
+/// as static objects in the translation unit that updates them; they register
+/// themselves with the \c Registry when constructed.
+class INDEXSTOREDB_EXPORT Metric {
+public:
+  enum class Kind {
+    Counter,
+    Gauge,
+    Histogram,
+  };
+
+  Kind getKind() const { return TheKind; }
+  StringRef getName() const { return Name; }
+  StringRef getDescription() const { return Description; }
+
+protected:
+  Metric(Kind kind, StringRef name, StringRef description);
+  ~Metric() = default;
+
+private:
+  Kind TheKind;
+  StringRef Name;
+  StringRef Description;
+};
+
+/// Process-wide collection of the metrics.
+///
+/// Collection is off by default. While it is off, updating a counter or a
+/// histogram costs a relaxed atomic load, and nothing if the probes are
+/// compiled out with \c INDEXSTOREDB_ENABLE_METRICS.
+class INDEXSTOREDB_EXPORT Registry {
+public:
+  static Registry &get();
+
+  static bool isEnabled() {
+#if INDEXSTOREDB_ENABLE_METRICS
+    return Enabled.load(std::memory_order_relaxed);
+#else
+    return false;
+#endif
+  }
+  static void setEnabled(bool enabled);
+
+  void registerMetric(Metric *metric);
+
+  /// Zeroes the counters and histograms; gauges keep their level.
+  void reset();
+
+  /// \returns an object with the \c counters, \c gauges and \c histograms
+  /// sections, each keyed by metric name.
+  llvm::json::Value toJSON() const;
+  void writeJSON(raw_ostream &OS) const;
+  void print(raw_ostream &OS) const;
+
+private:
+  Registry();
+
+  static std::atomic<bool> Enabled;
+  void *Impl;
+};
+
+/// A monotonically increasing count of events.
+class INDEXSTOREDB_EXPORT Counter : public Metric {
+  std::atomic<uint64_t> Value{0};
+
+public:
+  Counter(StringRef name, StringRef description)
+    : Metric(Kind::Counter, name, description) {}
+
+  void add(uint64_t amount = 1) {
+    if (Registry::isEnabled())
+      Value.fetch_add(amount, std::memory_order_relaxed);
+  }
+
+  uint64_t getValue() const { return Value.load(std::memory_order_relaxed); }
+  void reset() { Value.store(0, std::memory_order_relaxed); }
+
+  static bool classof(const Metric *M) { return M->getKind() == Kind::Counter; }
+};
+
+/// A level that goes up and down, like the length of a queue.
+///
+/// Unlike counters, gauges are maintained whether collection is enabled or
+/// not, so that their level is right when it gets enabled. Keep them out of
+/// hot paths.
+class INDEXSTOREDB_EXPORT Gauge : public Metric {
+  std::atomic<int64_t> Value{0};
+
+public:
+  Gauge(StringRef name, StringRef description)
+    : Metric(Kind::Gauge, name, description) {}
+
+  void add(int64_t amount) { Value.fetch_add(amount, std::memory_order_relaxed); }
+  void set(int64_t value) { Value.store(value, std::memory_order_relaxed); }
+
+  int64_t getValue() const { return Value.load(std::memory_order_relaxed); }
+
+  static bool classof(const Metric *M) { return M->getKind() == Kind::Gauge; }
+};
+
+/// Distribution of latencies, in power-of-two microsecond buckets.
+class INDEXSTOREDB_EXPORT Histogram : public Metric {
+public:
+  /// Bucket 0 holds latencies below 1us, bucket \c i latencies in
+  /// [2^(i-1), 2^i) microseconds; the last bucket also holds everything above.
+  static const unsigned NumBuckets = 32;
+
+  Histogram(StringRef name, StringRef description)
+    : Metric(Kind::Histogram, name, description) {}
+
+  void record(std::chrono::nanoseconds latency) {
+    if (Registry::isEnabled())
+      recordImpl(latency);
+  }
+
+  uint64_t getCount() const { return Count.load(std::memory_order_relaxed); }
+  uint64_t getBucketCount(unsigned bucket) const {
+    return Buckets[bucket].load(std::memory_order_relaxed);
+  }
+  /// \returns the upper bound, in microseconds, of the bucket that contains
+  /// the \p percentile (0-100) of the recorded latencies.
+  uint64_t getPercentileMicroseconds(double percentile) const;
+  uint64_t getTotalMicroseconds() const { return TotalMicroseconds.load(std::memory_order_relaxed); }
+  uint64_t getMaxMicroseconds() const { return MaxMicroseconds.load(std::memory_order_relaxed); }
+
+  void reset();
+
+  static bool classof(const Metric *M) { return M->getKind() == Kind::Histogram; }
+
+  /// Records the wall time of its lifetime. The clock is only read if
+  /// collection was enabled when the timer started.
+  class Timer {
+    Histogram &Hist;
+    std::chrono::steady_clock::time_point Start;
+    bool Active;
+  public:
+    explicit Timer(Histogram &hist) : Hist(hist), Active(Registry::isEnabled()) {
+      if (Active)
+        Start = std::chrono::steady_clock::now();
+    }
+    ~Timer() {
+      if (Active)
+        Hist.recordImpl(std::chrono::steady_clock::now() - Start);
+    }
+    Timer(const Timer &) = delete;
+    Timer &operator=(const Timer &) = delete;
+  };
+
+private:
+  void recordImpl(std::chrono::nanoseconds latency);
+
+  std::atomic<uint64_t> Buckets[NumBuckets] = {};
+  std::atomic<uint64_t> Count{0};
+  std::atomic<uint64_t> TotalMicroseconds{0};
+  std::atomic<uint64_t> MaxMicroseconds{0};
+};
+
+} // namespace metrics
+} // namespace IndexStoreDB
+
+#endif
@@ -17,6 +17,9 @@
 #include "IndexStoreDB/Support/Visibility.h"
 #include "llvm/ADT/SmallString.h"
 #include "llvm/Support/Path.h"
+#include <string>
+#include <utility>
+#include <vector>
 
 namespace IndexStoreDB {
   class CanonicalFilePathRef;
@@ -87,6 +90,29 @@ public:
 
   CanonicalFilePath getCanonicalPath(StringRef Path,
                                      StringRef WorkingDir = StringRef());
+
+  /// \returns the approximate number of bytes used by the cached paths.
+  size_t getMemoryUsage() const;
+  /// Drops all the cached paths.
+  void clear();
+};
+
+/// Replaces path prefixes, like the prefix mappings of
+/// \c indexstore::IndexStoreCreationOptions.
+class INDEXSTOREDB_EXPORT PathPrefixMap {
+  std::vector<std::pair<std::string, std::string>> prefixMap;
+
+public:
+  void addPrefixMapping(StringRef orig, StringRef remapped) {
+    prefixMap.emplace_back(std::string(orig), std::string(remapped));
+  }
+
+  bool hasPrefixMappings() const { return !prefixMap.empty(); }
+
+  /// Replaces the prefix of the first mapping that matches whole path
+  /// components of \p path.
+  /// \returns false if no mapping matched and \p path was left as is.
+  bool remap(StringRef path, SmallVectorImpl<char> &result) const;
 };
 
 } // namespace IndexStoreDB
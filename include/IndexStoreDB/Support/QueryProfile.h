@@ -0,0 +1,121 @@
+//===--- QueryProfile.h -----------------------------------------*- C++ -*-===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2018 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://swift.org/LICENSE.txt for license information
+// See https://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef INDEXSTOREDB_SUPPORT_QUERYPROFILE_H
+#define INDEXSTOREDB_SUPPORT_QUERYPROFILE_H
+
+#include "IndexStoreDB/Support/LLVM.h"
+#include "IndexStoreDB/Support/Visibility.h"
+#include "llvm/ADT/StringRef.h"
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+namespace IndexStoreDB {
+
+/// Collects where the work of the queries executed on a thread goes.
+///
+/// Profiling is opt-in: a \c QueryProfile::Scope activates a profile for the
+/// current thread and the probes in the database and index layers only record
+/// into it while it is active. Without an active profile a probe costs a
+/// thread-local load.
+class INDEXSTOREDB_EXPORT QueryProfile {
+public:
+  enum class Counter : unsigned {
+    /// Database read transactions that were opened.
+    ReadTransactions,
+    /// Keyed LMDB lookups, each of them descends the B-tree from its root.
+    DBLookups,
+    /// LMDB cursor steps, mostly reading from already touched pages.
+    DBCursorSteps,
+    /// Symbol providers, i.e. records, that were resolved from the database.
+    ProvidersResolved,
+    /// Record files that were opened and decoded.
+    RecordsOpened,
+    /// Symbol occurrences decoded from the opened records.
+    OccurrencesDecoded,
+    /// Unit visibility checks.
+    VisibilityChecks,
+    /// Unit visibility checks that were answered from the visibility cache.
+    VisibilityCacheHits,
+  };
+  static const unsigned NumCounters = unsigned(Counter::VisibilityCacheHits) + 1;
+
+  enum class Phase : unsigned {
+    /// Scanning the database for the USRs and providers that match the query.
+    LookupProviders,
+    /// Resolving provider codes to records, including visibility checks.
+    ResolveProviders,
+    /// Reading the records and passing their occurrences to the receiver.
+    ReadRecords,
+  };
+  static const unsigned NumPhases = unsigned(Phase::ReadRecords) + 1;
+
+  uint64_t getCount(Counter counter) const { return Counters[unsigned(counter)]; }
+  /// Wall time spent in \p phase, excluding time spent in nested phases.
+  std::chrono::nanoseconds getTime(Phase phase) const { return PhaseTimes[unsigned(phase)]; }
+  /// Wall time of all the scopes that activated this profile.
+  std::chrono::nanoseconds getTotalTime() const { return TotalTime; }
+
+  void reset();
+  void print(raw_ostream &OS) const;
+
+  static StringRef getCounterName(Counter counter);
+  static StringRef getPhaseName(Phase phase);
+
+  /// \returns the profile that is active on the current thread, if any.
+  static QueryProfile *getActive();
+
+  static void count(Counter counter, uint64_t amount = 1) {
+    if (QueryProfile *profile = getActive())
+      profile->Counters[unsigned(counter)] += amount;
+  }
+
+  /// Activates a profile for the current thread for the lifetime of the scope.
+  class INDEXSTOREDB_EXPORT Scope {
+    QueryProfile &Profile;
+    QueryProfile *Previous;
+    std::chrono::steady_clock::time_point Start;
+  public:
+    explicit Scope(QueryProfile &profile);
+    ~Scope();
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+  };
+
+  /// Attributes the wall time of its lifetime to a phase of the active
+  /// profile. When phases nest, the outer phase is paused.
+  class INDEXSTOREDB_EXPORT PhaseTimer {
+    QueryProfile *Profile;
+    unsigned OuterPhase;
+  public:
+    explicit PhaseTimer(Phase phase);
+    ~PhaseTimer();
+    PhaseTimer(const PhaseTimer &) = delete;
+    PhaseTimer &operator=(const PhaseTimer &) = delete;
+  };
+
+private:
+  static const unsigned NoPhase = ~0U;
+
+  uint64_t Counters[NumCounters] = {};
+  std::chrono::nanoseconds PhaseTimes[NumPhases] = {};
+  std::chrono::nanoseconds TotalTime{0};
+  unsigned ActivePhase = NoPhase;
+  std::chrono::steady_clock::time_point ActivePhaseStart;
+};
+
+typedef std::shared_ptr<QueryProfile> QueryProfileRef;
+
+} // namespace IndexStoreDB
+
+#endif
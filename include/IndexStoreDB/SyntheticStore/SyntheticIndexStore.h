@@ -0,0 +1,123 @@
+//===--- SyntheticIndexStore.h ----------------------------------*- C++ -*-===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2018 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://swift.org/LICENSE.txt for license information
+// See https://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef INDEXSTOREDB_SYNTHETICSTORE_SYNTHETICINDEXSTORE_H
+#define INDEXSTOREDB_SYNTHETICSTORE_SYNTHETICINDEXSTORE_H
+
+#include "IndexStoreDB/Index/IndexStoreLibraryProvider.h"
+#include "IndexStoreDB/Support/LLVM.h"
+#include "IndexStoreDB/Support/Visibility.h"
+#include "llvm/ADT/StringRef.h"
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace IndexStoreDB {
+namespace index {
+
+/// Describes the shape of the index data that a \c SyntheticIndexStore
+/// generates.
+struct SyntheticStoreOptions {
+  /// Number of units, each with its own main file.
+  unsigned numUnits = 1000;
+  /// Number of records each unit depends on: the record of its main file plus
+  /// records of headers from the shared header pool.
+  unsigned recordsPerUnit = 8;
+  /// Size of the shared header pool. Headers are picked with a Zipf
+  /// distribution, so a few headers are included by most of the units.
+  unsigned numHeaders = 200;
+  /// Number of distinct symbols that each record contains.
+  unsigned symbolsPerRecord = 40;
+  /// Number of occurrences of each symbol in a record.
+  unsigned occurrencesPerSymbol = 3;
+  /// Number of distinct USRs. The references of a record are picked with a
+  /// Zipf distribution, so a few USRs are referenced from most of the records.
+  unsigned numUSRs = 50000;
+  /// Exponent of the Zipf distributions; 0 makes them uniform.
+  double zipfExponent = 1.0;
+  /// Percentage of the symbols that are unit test methods.
+  unsigned unitTestSymbolPercent = 1;
+  /// Seed for all the random choices; the same options always produce the same
+  /// store.
+  uint64_t seed = 1;
+  /// Root of the (non-existent) source and build directories of the units.
+  std::string sourceRoot = "/synthetic";
+};
+
+/// Picks integers in [0, N) where the probability of \c k is proportional to
+/// 1 / (k+1)^s.
+class INDEXSTOREDB_EXPORT ZipfDistribution {
+  std::vector<double> CDF;
+
+public:
+  ZipfDistribution(unsigned N, double s);
+
+  unsigned operator()(std::mt19937_64 &rng) const;
+};
+
+/// In-memory index store that serves generated units and records through the
+/// \c indexstore_functions_t table, so that \c IndexSystem can be exercised at
+/// any scale without a compiler toolchain or \c libIndexStore.
+///
+/// A store is registered under its store path when created; opening an index
+/// store at that path with the library from \c getSyntheticIndexStoreLibrary
+/// reads from it.
+class INDEXSTOREDB_EXPORT SyntheticIndexStore {
+public:
+  ~SyntheticIndexStore();
+
+  static std::shared_ptr<SyntheticIndexStore> create(StringRef storePath,
+                                                     const SyntheticStoreOptions &options);
+
+  const SyntheticStoreOptions &getOptions() const;
+  StringRef getStorePath() const;
+
+  unsigned getNumRecords() const;
+  /// Total number of occurrences in the records that units currently depend on.
+  uint64_t getNumOccurrences() const;
+
+  StringRef getSymbolUSR(unsigned symbolIndex) const;
+  StringRef getSymbolName(unsigned symbolIndex) const;
+  std::string getMainFilePath(unsigned unitIndex) const;
+  std::string getOutputFilePath(unsigned unitIndex) const;
+  std::string getHeaderPath(unsigned headerIndex) const;
+
+  /// Regenerates the main file record of \p count units, picked with
+  /// \p rng, and bumps their modification time, as if they were recompiled.
+  /// Event listeners are notified of the modified units.
+  ///
+  /// \returns the indices of the modified units.
+  std::vector<unsigned> modifyUnits(unsigned count, std::mt19937_64 &rng);
+
+  class Implementation;
+private:
+  SyntheticIndexStore() = default;
+
+  std::shared_ptr<Implementation> Impl;
+};
+
+typedef std::shared_ptr<SyntheticIndexStore> SyntheticIndexStoreRef;
+
+/// \returns an indexstore library that can only open synthetic stores.
+INDEXSTOREDB_EXPORT IndexStoreLibraryRef getSyntheticIndexStoreLibrary();
+
+class INDEXSTOREDB_EXPORT SyntheticIndexStoreLibraryProvider: public IndexStoreLibraryProvider {
+public:
+  IndexStoreLibraryRef getLibraryForStorePath(StringRef storePath) override;
+};
+
+} // namespace index
+} // namespace IndexStoreDB
+
+#endif
@@ -12,13 +12,19 @@
 
 #include "CIndexStoreDB/CIndexStoreDB.h"
 #include "CIndexStoreDB/CIndexStoreDB_Internal.h"
+#include "IndexStoreDB/Index/AsyncQuery.h"
 #include "IndexStoreDB/Index/IndexStoreLibraryProvider.h"
 #include "IndexStoreDB/Index/IndexSystem.h"
 #include "IndexStoreDB/Index/IndexSystemDelegate.h"
+#include "IndexStoreDB/Index/SymbolOccurrenceCount.h"
+#include "IndexStoreDB/Support/Cancellation.h"
+#include "IndexStoreDB/Support/Metrics.h"
 #include "IndexStoreDB/Support/Path.h"
+#include "IndexStoreDB/Support/QueryProfile.h"
 #include "IndexStoreDB/Core/Symbol.h"
 #include "indexstore/IndexStoreCXX.h"
 #include "llvm/ADT/IntrusiveRefCntPtr.h"
+#include "llvm/Support/raw_ostream.h"
 #include <Block.h>
 
 using namespace IndexStoreDB;
@@ -63,12 +69,40 @@ struct DelegateEvent {
   std::string outOfDateTriggerFile;
   std::string outOfDateTriggerDescription;
   bool outOfDateIsSynchronous = false;
+  /// The events of the units of an INDEXSTOREDB_EVENT_UNITS_OUT_OF_DATE event.
+  const DelegateEvent *outOfDateEvents = nullptr;
+};
+
+static DelegateEvent makeOutOfDateEvent(StoreUnitInfo *unitInfo,
+                                        const OutOfDateFileTriggerRef &trigger,
+                                        bool synchronous) {
+  return DelegateEvent{
+      INDEXSTOREDB_EVENT_UNIT_OUT_OF_DATE,
+      0,
+      unitInfo,
+      (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+          trigger->getModTime().time_since_epoch())
+          .count(),
+      trigger->getPath(),
+      trigger->description(),
+      synchronous};
+}
+
+/// The options of the index, and the ones that only concern the delegate of
+/// the C API.
+struct CCreationOptions : CreationOptions {
+  /// Deliver the units found out-of-date together as one
+  /// \c INDEXSTOREDB_EVENT_UNITS_OUT_OF_DATE event, instead of one
+  /// \c INDEXSTOREDB_EVENT_UNIT_OUT_OF_DATE event each.
+  bool batchOutOfDateUnits = false;
 };
 
 class BlockIndexSystemDelegate: public IndexSystemDelegate {
   indexstoredb_delegate_event_receiver_t callback;
+  bool batchOutOfDateUnits;
 public:
-  BlockIndexSystemDelegate(indexstoredb_delegate_event_receiver_t callback) : callback(Block_copy(callback)) {}
+  BlockIndexSystemDelegate(indexstoredb_delegate_event_receiver_t callback, bool batchOutOfDateUnits = false)
+    : callback(Block_copy(callback)), batchOutOfDateUnits(batchOutOfDateUnits) {}
   ~BlockIndexSystemDelegate() { Block_release(callback); }
 
   void processingAddedPending(unsigned NumActions) override {
@@ -82,16 +116,27 @@ public:
 
   void unitIsOutOfDate(StoreUnitInfo unitInfo, OutOfDateFileTriggerRef trigger,
                        bool synchronous) override {
-    DelegateEvent event{
-        INDEXSTOREDB_EVENT_UNIT_OUT_OF_DATE,
-        0,
-        &unitInfo,
-        (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
-            trigger->getModTime().time_since_epoch())
-            .count(),
-        trigger->getPath(),
-        trigger->description(),
-        synchronous};
+    DelegateEvent event = makeOutOfDateEvent(&unitInfo, trigger, synchronous);
+    callback(&event);
+  }
+
+  void unitsAreOutOfDate(ArrayRef<OutOfDateUnit> units,
+                         bool synchronous) override {
+    // Clients that didn't ask for the batches only know the event of a unit.
+    if (!batchOutOfDateUnits)
+      return IndexSystemDelegate::unitsAreOutOfDate(units, synchronous);
+
+    std::vector<StoreUnitInfo> unitInfos;
+    unitInfos.reserve(units.size());
+    std::vector<DelegateEvent> events;
+    events.reserve(units.size());
+    for (const OutOfDateUnit &unit : units) {
+      unitInfos.push_back(unit.UnitInfo);
+      events.push_back(makeOutOfDateEvent(&unitInfos.back(), unit.Trigger, synchronous));
+    }
+    DelegateEvent event{INDEXSTOREDB_EVENT_UNITS_OUT_OF_DATE, units.size()};
+    event.outOfDateIsSynchronous = synchronous;
+    event.outOfDateEvents = events.data();
     callback(&event);
   }
 };
@@ -100,12 +145,12 @@ public:
 
 indexstoredb_creation_options_t
 indexstoredb_creation_options_create(void) {
-  return new CreationOptions();
+  return new CCreationOptions();
 }
 
 void
 indexstoredb_creation_options_dispose(indexstoredb_creation_options_t c_options) {
-  auto *options = static_cast<CreationOptions *>(c_options);
+  auto *options = static_cast<CCreationOptions *>(c_options);
   delete options;
 }
 
@@ -113,45 +158,107 @@ void
 indexstoredb_creation_options_add_prefix_mapping(indexstoredb_creation_options_t c_options,
                                                  const char *path_prefix,
                                                  const char *remapped_path_prefix) {
-  auto *options = static_cast<CreationOptions *>(c_options);
+  auto *options = static_cast<CCreationOptions *>(c_options);
   options->indexStoreOptions.addPrefixMapping(path_prefix, remapped_path_prefix);
 }
 
 void
 indexstoredb_creation_options_listen_to_unit_events(indexstoredb_creation_options_t c_options,
                                                         bool listenToUnitEvents) {
-  auto *options = static_cast<CreationOptions *>(c_options);
+  auto *options = static_cast<CCreationOptions *>(c_options);
   options->listenToUnitEvents = listenToUnitEvents;
 }
 
 void
 indexstoredb_creation_options_enable_out_of_date_file_watching(indexstoredb_creation_options_t c_options,
                                                                bool enableOutOfDateFileWatching) {
-  auto *options = static_cast<CreationOptions *>(c_options);
+  auto *options = static_cast<CCreationOptions *>(c_options);
   options->enableOutOfDateFileWatching = enableOutOfDateFileWatching;
 }
 
 void
 indexstoredb_creation_options_readonly(indexstoredb_creation_options_t c_options,
                                            bool readonly) {
-  auto *options = static_cast<CreationOptions *>(c_options);
+  auto *options = static_cast<CCreationOptions *>(c_options);
   options->readonly = readonly;
 }
 
 void
 indexstoredb_creation_options_wait(indexstoredb_creation_options_t c_options,
                                        bool wait) {
-  auto *options = static_cast<CreationOptions *>(c_options);
+  auto *options = static_cast<CCreationOptions *>(c_options);
   options->wait = wait;
 }
 
 void
 indexstoredb_creation_options_use_explicit_output_units(indexstoredb_creation_options_t c_options,
                                                             bool useExplicitOutputUnits) {
-  auto *options = static_cast<CreationOptions *>(c_options);
+  auto *options = static_cast<CCreationOptions *>(c_options);
   options->useExplicitOutputUnits = useExplicitOutputUnits;
 }
 
+void
+indexstoredb_creation_options_record_occurrence_counts(indexstoredb_creation_options_t c_options,
+                                                       bool recordOccurrenceCounts) {
+  auto *options = static_cast<CCreationOptions *>(c_options);
+  options->recordOccurrenceCounts = recordOccurrenceCounts;
+}
+
+void
+indexstoredb_creation_options_memory_budget(indexstoredb_creation_options_t c_options,
+                                            size_t bytes) {
+  auto *options = static_cast<CCreationOptions *>(c_options);
+  options->memoryBudget = bytes;
+}
+
+void
+indexstoredb_creation_options_snapshot(indexstoredb_creation_options_t c_options,
+                                       const char *snapshotPath) {
+  auto *options = static_cast<CCreationOptions *>(c_options);
+  options->snapshotPath = snapshotPath;
+}
+
+void
+indexstoredb_creation_options_add_snapshot_prefix_mapping(indexstoredb_creation_options_t c_options,
+                                                          const char *path_prefix,
+                                                          const char *remapped_path_prefix) {
+  auto *options = static_cast<CCreationOptions *>(c_options);
+  options->snapshotPrefixMap.addPrefixMapping(path_prefix, remapped_path_prefix);
+}
+
+void
+indexstoredb_creation_options_share_database(indexstoredb_creation_options_t c_options,
+                                             bool shareDatabase) {
+  auto *options = static_cast<CCreationOptions *>(c_options);
+  options->shareDatabase = shareDatabase;
+}
+
+void
+indexstoredb_creation_options_delegate_batch_interval(indexstoredb_creation_options_t c_options,
+                                                      uint64_t milliseconds) {
+  auto *options = static_cast<CCreationOptions *>(c_options);
+  options->delegateBatchInterval = std::chrono::milliseconds(milliseconds);
+}
+
+void
+indexstoredb_creation_options_batch_out_of_date_units(indexstoredb_creation_options_t c_options,
+                                                      bool batchOutOfDateUnits) {
+  auto *options = static_cast<CCreationOptions *>(c_options);
+  options->batchOutOfDateUnits = batchOutOfDateUnits;
+}
+
+void
+indexstoredb_creation_options_unit_processing_weight(indexstoredb_creation_options_t c_options,
+                                                     unsigned weight) {
+  auto *options = static_cast<CCreationOptions *>(c_options);
+  options->unitProcessingWeight = weight;
+}
+
+void
+indexstoredb_set_unit_processing_concurrency(unsigned concurrency) {
+  IndexSystem::setUnitProcessingConcurrency(concurrency);
+}
+
 indexstoredb_index_t
 indexstoredb_index_create(const char *storePath, const char *databasePath,
                           indexstore_library_provider_t libProvider,
@@ -159,9 +266,9 @@ indexstoredb_index_create(const char *storePath, const char *databasePath,
                           indexstoredb_creation_options_t cOptions,
                           indexstoredb_error_t *error) {
 
-  auto delegate = std::make_shared<BlockIndexSystemDelegate>(delegateCallback);
+  auto options = static_cast<CCreationOptions *>(cOptions);
+  auto delegate = std::make_shared<BlockIndexSystemDelegate>(delegateCallback, options->batchOutOfDateUnits);
   auto libProviderObj = std::make_shared<BlockIndexStoreLibraryProvider>(libProvider);
-  auto options = static_cast<CreationOptions *>(cOptions);
 
   std::string errMsg;
   if (auto index =
@@ -195,6 +302,109 @@ indexstoredb_load_indexstore_library(const char *dylibPath,
   return nullptr;
 }
 
+indexstoredb_cancellation_token_t
+indexstoredb_cancellation_token_create(uint64_t timeoutNanoseconds) {
+  if (timeoutNanoseconds == 0)
+    return make_object(CancellationToken::create());
+  return make_object(CancellationToken::createWithTimeout(std::chrono::nanoseconds(timeoutNanoseconds)));
+}
+
+void
+indexstoredb_cancellation_token_cancel(indexstoredb_cancellation_token_t token) {
+  auto obj = (Object<CancellationTokenRef> *)token;
+  obj->value->cancel();
+}
+
+bool
+indexstoredb_cancellation_token_is_cancelled(indexstoredb_cancellation_token_t token) {
+  auto obj = (Object<CancellationTokenRef> *)token;
+  return obj->value->isCancelled();
+}
+
+static CancellationTokenRef toCancellationToken(indexstoredb_cancellation_token_t token) {
+  if (!token)
+    return nullptr;
+  return ((Object<CancellationTokenRef> *)token)->value;
+}
+
+indexstoredb_query_profile_t
+indexstoredb_query_profile_create(void) {
+  return make_object(std::make_shared<QueryProfile>());
+}
+
+void
+indexstoredb_query_profile_collect(indexstoredb_query_profile_t profile, void(^body)(void)) {
+  auto obj = (Object<QueryProfileRef> *)profile;
+  QueryProfile::Scope scope(*obj->value);
+  body();
+}
+
+uint64_t
+indexstoredb_query_profile_get_count(indexstoredb_query_profile_t profile,
+                                     indexstoredb_query_profile_counter_t counter) {
+  auto obj = (Object<QueryProfileRef> *)profile;
+  switch (counter) {
+  case INDEXSTOREDB_QUERY_PROFILE_COUNTER_READ_TRANSACTIONS:
+    return obj->value->getCount(QueryProfile::Counter::ReadTransactions);
+  case INDEXSTOREDB_QUERY_PROFILE_COUNTER_DB_LOOKUPS:
+    return obj->value->getCount(QueryProfile::Counter::DBLookups);
+  case INDEXSTOREDB_QUERY_PROFILE_COUNTER_DB_CURSOR_STEPS:
+    return obj->value->getCount(QueryProfile::Counter::DBCursorSteps);
+  case INDEXSTOREDB_QUERY_PROFILE_COUNTER_PROVIDERS_RESOLVED:
+    return obj->value->getCount(QueryProfile::Counter::ProvidersResolved);
+  case INDEXSTOREDB_QUERY_PROFILE_COUNTER_RECORDS_OPENED:
+    return obj->value->getCount(QueryProfile::Counter::RecordsOpened);
+  case INDEXSTOREDB_QUERY_PROFILE_COUNTER_OCCURRENCES_DECODED:
+    return obj->value->getCount(QueryProfile::Counter::OccurrencesDecoded);
+  case INDEXSTOREDB_QUERY_PROFILE_COUNTER_VISIBILITY_CHECKS:
+    return obj->value->getCount(QueryProfile::Counter::VisibilityChecks);
+  case INDEXSTOREDB_QUERY_PROFILE_COUNTER_VISIBILITY_CACHE_HITS:
+    return obj->value->getCount(QueryProfile::Counter::VisibilityCacheHits);
+  }
+  return 0;
+}
+
+uint64_t
+indexstoredb_query_profile_get_phase_nanoseconds(indexstoredb_query_profile_t profile,
+                                                 indexstoredb_query_profile_phase_t phase) {
+  auto obj = (Object<QueryProfileRef> *)profile;
+  switch (phase) {
+  case INDEXSTOREDB_QUERY_PROFILE_PHASE_LOOKUP_PROVIDERS:
+    return obj->value->getTime(QueryProfile::Phase::LookupProviders).count();
+  case INDEXSTOREDB_QUERY_PROFILE_PHASE_RESOLVE_PROVIDERS:
+    return obj->value->getTime(QueryProfile::Phase::ResolveProviders).count();
+  case INDEXSTOREDB_QUERY_PROFILE_PHASE_READ_RECORDS:
+    return obj->value->getTime(QueryProfile::Phase::ReadRecords).count();
+  }
+  return 0;
+}
+
+uint64_t
+indexstoredb_query_profile_get_total_nanoseconds(indexstoredb_query_profile_t profile) {
+  auto obj = (Object<QueryProfileRef> *)profile;
+  return obj->value->getTotalTime().count();
+}
+
+void
+indexstoredb_metrics_set_enabled(bool enabled) {
+  metrics::Registry::setEnabled(enabled);
+}
+
+void
+indexstoredb_metrics_reset(void) {
+  metrics::Registry::get().reset();
+}
+
+void
+indexstoredb_index_metrics_json(indexstoredb_index_t index,
+                                void(^receiver)(const char *json)) {
+  auto obj = (Object<std::shared_ptr<IndexSystem>> *)index;
+  std::string json;
+  llvm::raw_string_ostream OS(json);
+  obj->value->writeMetricsJSON(OS);
+  receiver(OS.str().c_str());
+}
+
 unsigned indexstoredb_format_version(indexstoredb_indexstore_library_t lib) {
   auto obj = (Object<std::shared_ptr<indexstore::IndexStoreLibrary>> *)lib;
   return obj->value->api().format_version();
@@ -236,6 +446,67 @@ void indexstoredb_index_remove_unit_out_file_paths(indexstoredb_index_t index,
   return obj->value->removeUnitOutFilePaths(strVec, waitForProcessing);
 }
 
+void indexstoredb_index_set_unit_out_file_paths(indexstoredb_index_t index,
+                                                const char *const *paths, size_t count,
+                                                bool waitForProcessing) {
+  auto obj = (Object<std::shared_ptr<IndexSystem>> *)index;
+  SmallVector<StringRef, 32> strVec;
+  strVec.reserve(count);
+  for (unsigned i = 0; i != count; ++i)
+    strVec.push_back(paths[i]);
+  return obj->value->setUnitOutFilePaths(strVec, waitForProcessing);
+}
+
+void indexstoredb_index_prioritize_files(indexstoredb_index_t index,
+                                         const char *const *paths, size_t count) {
+  auto obj = (Object<std::shared_ptr<IndexSystem>> *)index;
+  SmallVector<StringRef, 32> strVec;
+  strVec.reserve(count);
+  for (unsigned i = 0; i != count; ++i)
+    strVec.push_back(paths[i]);
+  return obj->value->prioritizeFiles(strVec);
+}
+
+void indexstoredb_index_trim_memory(indexstoredb_index_t index,
+                                    indexstoredb_memory_trim_level_t level) {
+  auto obj = (Object<std::shared_ptr<IndexSystem>> *)index;
+  switch (level) {
+  case INDEXSTOREDB_MEMORY_TRIM_LEVEL_MODERATE:
+    return obj->value->trimMemory(MemoryTrimLevel::Moderate);
+  case INDEXSTOREDB_MEMORY_TRIM_LEVEL_CRITICAL:
+    return obj->value->trimMemory(MemoryTrimLevel::Critical);
+  }
+}
+
+bool indexstoredb_index_export_snapshot(indexstoredb_index_t index,
+                                        const char *snapshotPath,
+                                        const char *const *pathPrefixes,
+                                        const char *const *remappedPathPrefixes,
+                                        size_t count,
+                                        indexstoredb_error_t *error) {
+  auto obj = (Object<std::shared_ptr<IndexSystem>> *)index;
+  PathPrefixMap prefixMap;
+  for (size_t i = 0; i != count; ++i)
+    prefixMap.addPrefixMapping(pathPrefixes[i], remappedPathPrefixes[i]);
+  std::string errMsg;
+  if (obj->value->exportSnapshot(snapshotPath, prefixMap, errMsg)) {
+    if (error)
+      *error = (indexstoredb_error_t)new IndexStoreDBError(errMsg);
+    return false;
+  }
+  return true;
+}
+
+bool indexstoredb_index_memory_usage(indexstoredb_index_t index,
+                                     indexstoredb_memory_usage_receiver receiver) {
+  auto obj = (Object<std::shared_ptr<IndexSystem>> *)index;
+  for (const MemoryUsage &usage : obj->value->getMemoryUsage()) {
+    if (!receiver(usage.Name.c_str(), usage.Bytes))
+      return false;
+  }
+  return true;
+}
+
 indexstoredb_delegate_event_kind_t
 indexstoredb_delegate_event_get_kind(indexstoredb_delegate_event_t event) {
   return reinterpret_cast<DelegateEvent *>(event)->kind;
@@ -245,6 +516,14 @@ uint64_t indexstoredb_delegate_event_get_count(indexstoredb_delegate_event_t eve
   return reinterpret_cast<DelegateEvent *>(event)->count;
 }
 
+indexstoredb_delegate_event_t
+indexstoredb_delegate_event_get_outofdate_event(indexstoredb_delegate_event_t event, size_t index) {
+  DelegateEvent *evt = reinterpret_cast<DelegateEvent *>(event);
+  if (!evt->outOfDateEvents || index >= evt->count)
+    return nullptr;
+  return const_cast<DelegateEvent *>(&evt->outOfDateEvents[index]);
+}
+
 indexstoredb_unit_info_t
 indexstoredb_delegate_event_get_outofdate_unit_info(indexstoredb_delegate_event_t event) {
   return reinterpret_cast<DelegateEvent *>(event)->outOfDateUnitInfo;
@@ -282,12 +561,23 @@ indexstoredb_index_symbol_occurrences_by_usr(
     const char *usr,
     uint64_t roles,
     indexstoredb_symbol_occurrence_receiver_t receiver)
+{
+  return indexstoredb_index_symbol_occurrences_by_usr_cancellable(index, usr, roles, nullptr, receiver);
+}
+
+bool
+indexstoredb_index_symbol_occurrences_by_usr_cancellable(
+    indexstoredb_index_t index,
+    const char *usr,
+    uint64_t roles,
+    indexstoredb_cancellation_token_t token,
+    indexstoredb_symbol_occurrence_receiver_t receiver)
 {
   auto obj = (Object<std::shared_ptr<IndexSystem>> *)index;
   return obj->value->foreachSymbolOccurrenceByUSR(usr, (SymbolRoleSet)roles,
     [&](SymbolOccurrenceRef Occur) -> bool {
       return receiver((indexstoredb_symbol_occurrence_t)Occur.get());
-    });
+    }, toCancellationToken(token));
 }
 
 bool
@@ -296,12 +586,69 @@ indexstoredb_index_related_symbol_occurrences_by_usr(
     const char *usr,
     uint64_t roles,
     indexstoredb_symbol_occurrence_receiver_t receiver)
+{
+  return indexstoredb_index_related_symbol_occurrences_by_usr_cancellable(index, usr, roles, nullptr, receiver);
+}
+
+bool
+indexstoredb_index_related_symbol_occurrences_by_usr_cancellable(
+    indexstoredb_index_t index,
+    const char *usr,
+    uint64_t roles,
+    indexstoredb_cancellation_token_t token,
+    indexstoredb_symbol_occurrence_receiver_t receiver)
 {
   auto obj = (Object<std::shared_ptr<IndexSystem>> *)index;
   return obj->value->foreachRelatedSymbolOccurrenceByUSR(usr, (SymbolRoleSet)roles,
     [&](SymbolOccurrenceRef Occur) -> bool {
       return receiver((indexstoredb_symbol_occurrence_t)Occur.get());
-    });
+    }, toCancellationToken(token));
+}
+
+static bool passOccurrenceCount(const SymbolOccurrenceCount &count,
+                                uint64_t *providerCount,
+                                uint64_t *fileCount,
+                                uint64_t *occurrenceCount,
+                                bool *isExact) {
+  if (providerCount)
+    *providerCount = count.ProviderCount;
+  if (fileCount)
+    *fileCount = count.FileCount;
+  if (occurrenceCount)
+    *occurrenceCount = count.OccurrenceCount.getValueOr(0);
+  if (isExact)
+    *isExact = count.IsExact;
+  return count.OccurrenceCount.hasValue();
+}
+
+bool
+indexstoredb_index_symbol_occurrence_count_by_usr(
+    indexstoredb_index_t index,
+    const char *usr,
+    uint64_t roles,
+    uint64_t *providerCount,
+    uint64_t *fileCount,
+    uint64_t *occurrenceCount,
+    bool *isExact)
+{
+  auto obj = (Object<std::shared_ptr<IndexSystem>> *)index;
+  auto count = obj->value->countSymbolOccurrencesByUSR(usr, (SymbolRoleSet)roles);
+  return passOccurrenceCount(count, providerCount, fileCount, occurrenceCount, isExact);
+}
+
+bool
+indexstoredb_index_related_symbol_occurrence_count_by_usr(
+    indexstoredb_index_t index,
+    const char *usr,
+    uint64_t roles,
+    uint64_t *providerCount,
+    uint64_t *fileCount,
+    uint64_t *occurrenceCount,
+    bool *isExact)
+{
+  auto obj = (Object<std::shared_ptr<IndexSystem>> *)index;
+  auto count = obj->value->countRelatedSymbolOccurrencesByUSR(usr, (SymbolRoleSet)roles);
+  return passOccurrenceCount(count, providerCount, fileCount, occurrenceCount, isExact);
 }
 
 bool
@@ -365,10 +712,17 @@ indexstoredb_symbol_properties(indexstoredb_symbol_t symbol) {
 
 bool
 indexstoredb_index_symbol_names(indexstoredb_index_t index, indexstoredb_symbol_name_receiver receiver) {
+  return indexstoredb_index_symbol_names_cancellable(index, nullptr, receiver);
+}
+
+bool
+indexstoredb_index_symbol_names_cancellable(indexstoredb_index_t index,
+                                            indexstoredb_cancellation_token_t token,
+                                            indexstoredb_symbol_name_receiver receiver) {
   auto obj = (Object<std::shared_ptr<IndexSystem>> *)index;
   return obj->value->foreachSymbolName([&](StringRef ref) -> bool {
     return receiver(ref.str().c_str());
-  });
+  }, toCancellationToken(token));
 }
 
 bool
@@ -376,11 +730,21 @@ indexstoredb_index_canonical_symbol_occurences_by_name(
   indexstoredb_index_t index,
   const char *_Nonnull symbolName,
   indexstoredb_symbol_occurrence_receiver_t receiver)
+{
+  return indexstoredb_index_canonical_symbol_occurences_by_name_cancellable(index, symbolName, nullptr, receiver);
+}
+
+bool
+indexstoredb_index_canonical_symbol_occurences_by_name_cancellable(
+  indexstoredb_index_t index,
+  const char *_Nonnull symbolName,
+  indexstoredb_cancellation_token_t token,
+  indexstoredb_symbol_occurrence_receiver_t receiver)
 {
   auto obj = (Object<std::shared_ptr<IndexSystem>> *)index;
   return obj->value->foreachCanonicalSymbolOccurrenceByName(symbolName, [&](SymbolOccurrenceRef occur) -> bool {
     return receiver((indexstoredb_symbol_occurrence_t)occur.get());
-  });
+  }, toCancellationToken(token));
 }
 
 bool
@@ -392,6 +756,21 @@ indexstoredb_index_canonical_symbol_occurences_containing_pattern(
   bool subsequence,
   bool ignoreCase,
   indexstoredb_symbol_occurrence_receiver_t receiver)
+{
+  return indexstoredb_index_canonical_symbol_occurences_containing_pattern_cancellable(
+    index, pattern, anchorStart, anchorEnd, subsequence, ignoreCase, nullptr, receiver);
+}
+
+bool
+indexstoredb_index_canonical_symbol_occurences_containing_pattern_cancellable(
+  indexstoredb_index_t index,
+  const char *_Nonnull pattern,
+  bool anchorStart,
+  bool anchorEnd,
+  bool subsequence,
+  bool ignoreCase,
+  indexstoredb_cancellation_token_t token,
+  indexstoredb_symbol_occurrence_receiver_t receiver)
 {
   auto obj = (Object<std::shared_ptr<IndexSystem>> *)index;
   return obj->value->foreachCanonicalSymbolOccurrenceContainingPattern(
@@ -403,7 +782,162 @@ indexstoredb_index_canonical_symbol_occurences_containing_pattern(
     [&](SymbolOccurrenceRef occur
   ) -> bool {
       return receiver((indexstoredb_symbol_occurrence_t)occur.get());
-  });
+  }, toCancellationToken(token));
+}
+
+void
+indexstoredb_set_async_query_concurrency(unsigned concurrency) {
+  IndexSystem::setAsyncQueryConcurrency(concurrency);
+}
+
+namespace {
+
+/// Copies of the blocks of an asynchronous query, released once the query no
+/// longer refers to them.
+struct AsyncQueryBlocks {
+  indexstoredb_symbol_occurrence_batch_receiver_t receiver;
+  indexstoredb_async_query_completion_t completion;
+
+  AsyncQueryBlocks(indexstoredb_symbol_occurrence_batch_receiver_t receiver,
+                   indexstoredb_async_query_completion_t completion)
+    : receiver(Block_copy(receiver)),
+      completion(completion ? Block_copy(completion) : nullptr) {}
+  ~AsyncQueryBlocks() {
+    Block_release(receiver);
+    if (completion)
+      Block_release(completion);
+  }
+};
+
+} // anonymous namespace
+
+static AsyncQueryOptions toAsyncQueryOptions(indexstoredb_query_priority_t priority,
+                                             size_t batchSize,
+                                             indexstoredb_cancellation_token_t token) {
+  AsyncQueryOptions options;
+  switch (priority) {
+  case INDEXSTOREDB_QUERY_PRIORITY_HIGH:
+    options.Priority = WorkQueue::Priority::High;
+    break;
+  case INDEXSTOREDB_QUERY_PRIORITY_DEFAULT:
+    options.Priority = WorkQueue::Priority::Default;
+    break;
+  case INDEXSTOREDB_QUERY_PRIORITY_LOW:
+    options.Priority = WorkQueue::Priority::Low;
+    break;
+  case INDEXSTOREDB_QUERY_PRIORITY_BACKGROUND:
+    options.Priority = WorkQueue::Priority::Background;
+    break;
+  }
+  options.BatchSize = batchSize;
+  options.CancelToken = toCancellationToken(token);
+  return options;
+}
+
+static SymbolOccurrenceBatchReceiver toBatchReceiver(std::shared_ptr<AsyncQueryBlocks> blocks) {
+  return [blocks](ArrayRef<SymbolOccurrenceRef> occurs) -> bool {
+    SmallVector<indexstoredb_symbol_occurrence_t, 128> cOccurs;
+    cOccurs.reserve(occurs.size());
+    for (const SymbolOccurrenceRef &occur : occurs)
+      cOccurs.push_back((indexstoredb_symbol_occurrence_t)occur.get());
+    return blocks->receiver(cOccurs.data(), cOccurs.size());
+  };
+}
+
+static AsyncQueryCompletion toCompletion(std::shared_ptr<AsyncQueryBlocks> blocks) {
+  return [blocks](bool finished) {
+    if (blocks->completion)
+      blocks->completion(finished);
+  };
+}
+
+indexstoredb_async_query_t
+indexstoredb_index_symbol_occurrences_by_usr_async(
+    indexstoredb_index_t index,
+    const char *usr,
+    uint64_t roles,
+    indexstoredb_query_priority_t priority,
+    size_t batchSize,
+    indexstoredb_cancellation_token_t token,
+    indexstoredb_symbol_occurrence_batch_receiver_t receiver,
+    indexstoredb_async_query_completion_t completion)
+{
+  auto obj = (Object<std::shared_ptr<IndexSystem>> *)index;
+  auto blocks = std::make_shared<AsyncQueryBlocks>(receiver, completion);
+  return make_object(obj->value->foreachSymbolOccurrenceByUSRAsync(usr, (SymbolRoleSet)roles,
+    toAsyncQueryOptions(priority, batchSize, token), toBatchReceiver(blocks), toCompletion(blocks)));
+}
+
+indexstoredb_async_query_t
+indexstoredb_index_related_symbol_occurrences_by_usr_async(
+    indexstoredb_index_t index,
+    const char *usr,
+    uint64_t roles,
+    indexstoredb_query_priority_t priority,
+    size_t batchSize,
+    indexstoredb_cancellation_token_t token,
+    indexstoredb_symbol_occurrence_batch_receiver_t receiver,
+    indexstoredb_async_query_completion_t completion)
+{
+  auto obj = (Object<std::shared_ptr<IndexSystem>> *)index;
+  auto blocks = std::make_shared<AsyncQueryBlocks>(receiver, completion);
+  return make_object(obj->value->foreachRelatedSymbolOccurrenceByUSRAsync(usr, (SymbolRoleSet)roles,
+    toAsyncQueryOptions(priority, batchSize, token), toBatchReceiver(blocks), toCompletion(blocks)));
+}
+
+indexstoredb_async_query_t
+indexstoredb_index_canonical_symbol_occurences_by_name_async(
+    indexstoredb_index_t index,
+    const char *symbolName,
+    indexstoredb_query_priority_t priority,
+    size_t batchSize,
+    indexstoredb_cancellation_token_t token,
+    indexstoredb_symbol_occurrence_batch_receiver_t receiver,
+    indexstoredb_async_query_completion_t completion)
+{
+  auto obj = (Object<std::shared_ptr<IndexSystem>> *)index;
+  auto blocks = std::make_shared<AsyncQueryBlocks>(receiver, completion);
+  return make_object(obj->value->foreachCanonicalSymbolOccurrenceByNameAsync(symbolName,
+    toAsyncQueryOptions(priority, batchSize, token), toBatchReceiver(blocks), toCompletion(blocks)));
+}
+
+indexstoredb_async_query_t
+indexstoredb_index_canonical_symbol_occurences_containing_pattern_async(
+    indexstoredb_index_t index,
+    const char *pattern,
+    bool anchorStart,
+    bool anchorEnd,
+    bool subsequence,
+    bool ignoreCase,
+    indexstoredb_query_priority_t priority,
+    size_t batchSize,
+    indexstoredb_cancellation_token_t token,
+    indexstoredb_symbol_occurrence_batch_receiver_t receiver,
+    indexstoredb_async_query_completion_t completion)
+{
+  auto obj = (Object<std::shared_ptr<IndexSystem>> *)index;
+  auto blocks = std::make_shared<AsyncQueryBlocks>(receiver, completion);
+  return make_object(obj->value->foreachCanonicalSymbolOccurrenceContainingPatternAsync(pattern,
+    anchorStart, anchorEnd, subsequence, ignoreCase,
+    toAsyncQueryOptions(priority, batchSize, token), toBatchReceiver(blocks), toCompletion(blocks)));
+}
+
+void
+indexstoredb_async_query_cancel(indexstoredb_async_query_t query) {
+  auto obj = (Object<AsyncQueryRef> *)query;
+  obj->value->cancel();
+}
+
+bool
+indexstoredb_async_query_is_finished(indexstoredb_async_query_t query) {
+  auto obj = (Object<AsyncQueryRef> *)query;
+  return obj->value->isFinished();
+}
+
+void
+indexstoredb_async_query_wait(indexstoredb_async_query_t query) {
+  auto obj = (Object<AsyncQueryRef> *)query;
+  obj->value->wait();
 }
 
 indexstoredb_symbol_t
@@ -0,0 +1,204 @@
+//===--- BulkLoad.cpp -----------------------------------------------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2018 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://swift.org/LICENSE.txt for license information
+// See https://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#include "BulkLoadImpl.h"
+#include "DatabaseImpl.h"
+#include "ReadTransactionImpl.h"
+#include "IndexStoreDB/Support/Logging.h"
+#include "IndexStoreDB/Support/Metrics.h"
+#include "llvm/ADT/STLExtras.h"
+
+using namespace IndexStoreDB;
+using namespace IndexStoreDB::db;
+
+static metrics::Counter NumBulkLoads("database.bulk_loads",
+                                     "Bulk loads started for an empty database");
+static metrics::Counter NumBulkLoadEntries("database.bulk_load_entries",
+                                           "Entries written by the flushes of bulk loads");
+static metrics::Histogram BulkLoadFlushLatency("database.bulk_load_flush_latency",
+                                               "Time to sort and write the staged entries of a bulk load");
+
+StringRef BulkLoadBatch::copy(const void *data, size_t size) {
+  if (size == 0)
+    return StringRef();
+  char *buf = static_cast<char *>(Allocator->Allocate(size, alignof(uint64_t)));
+  memcpy(buf, data, size);
+  return StringRef(buf, size);
+}
+
+void BulkLoadBatch::put(lmdb::dbi &dbi, const lmdb::val &key, const lmdb::val &value, unsigned flags) {
+  BulkLoadTable &table = Tables[dbi.handle()];
+  table.DBI = &dbi;
+  table.Entries.push_back(BulkLoadEntry{copy(key.data(), key.size()), copy(value.data(), value.size()), flags});
+  Bytes += key.size() + value.size() + sizeof(BulkLoadEntry);
+}
+
+char *BulkLoadBatch::reserve(lmdb::dbi &dbi, const lmdb::val &key, size_t size, unsigned flags) {
+  char *buf = static_cast<char *>(Allocator->Allocate(size, alignof(uint64_t)));
+  BulkLoadTable &table = Tables[dbi.handle()];
+  table.DBI = &dbi;
+  table.Entries.push_back(BulkLoadEntry{copy(key.data(), key.size()), StringRef(buf, size), flags});
+  Bytes += key.size() + size + sizeof(BulkLoadEntry);
+  return buf;
+}
+
+BulkLoad::Implementation::~Implementation() {
+  DBase->impl().clearActiveBulkLoad(this);
+  if (!Tables.empty())
+    LOG_WARN_FUNC("discarding " << StagedBytes << " bytes of entries that were not flushed");
+}
+
+void BulkLoad::Implementation::addBatch(BulkLoadBatch batch) {
+  llvm::sys::ScopedLock L(StateMtx);
+  for (auto &pair : batch.Tables) {
+    BulkLoadTable &table = Tables[pair.first];
+    table.DBI = pair.second.DBI;
+    table.Entries.insert(table.Entries.end(), pair.second.Entries.begin(), pair.second.Entries.end());
+  }
+  // The allocator owns the staged bytes, the slabs don't move with it.
+  Allocators.push_back(std::move(batch.Allocator));
+  StagedProviders.insert(batch.Providers.begin(), batch.Providers.end());
+  StagedTestSymbolProviders.insert(batch.TestSymbolProviders.begin(), batch.TestSymbolProviders.end());
+  Units.insert(batch.Units.begin(), batch.Units.end());
+  StagedBytes += batch.Bytes;
+}
+
+bool BulkLoad::Implementation::isProviderStaged(IDCode provider) const {
+  llvm::sys::ScopedLock L(StateMtx);
+  return StagedProviders.count(provider);
+}
+
+bool BulkLoad::Implementation::isTestSymbolProviderStaged(IDCode provider) const {
+  llvm::sys::ScopedLock L(StateMtx);
+  return StagedTestSymbolProviders.count(provider);
+}
+
+bool BulkLoad::Implementation::containsUnit(IDCode unitCode) const {
+  llvm::sys::ScopedLock L(StateMtx);
+  return Units.count(unitCode);
+}
+
+size_t BulkLoad::Implementation::getStagedBytes() const {
+  llvm::sys::ScopedLock L(StateMtx);
+  return StagedBytes;
+}
+
+size_t db::writeBulkLoadTable(lmdb::txn &txn, BulkLoadTable &table) {
+  lmdb::dbi &dbi = *table.DBI;
+  bool isDupSort = dbi.flags(txn) & MDB_DUPSORT;
+  auto compare = [&](const BulkLoadEntry &lhs, const BulkLoadEntry &rhs) -> int {
+    MDB_val lhsKey{lhs.Key.size(), const_cast<char *>(lhs.Key.data())};
+    MDB_val rhsKey{rhs.Key.size(), const_cast<char *>(rhs.Key.data())};
+    int comp = mdb_cmp(txn, dbi.handle(), &lhsKey, &rhsKey);
+    if (comp != 0 || !isDupSort)
+      return comp;
+    MDB_val lhsValue{lhs.Value.size(), const_cast<char *>(lhs.Value.data())};
+    MDB_val rhsValue{rhs.Value.size(), const_cast<char *>(rhs.Value.data())};
+    return mdb_dcmp(txn, dbi.handle(), &lhsValue, &rhsValue);
+  };
+  // Stable, so that the entries that compare equal stay in the order they
+  // were staged; the sort is also idempotent if the flush gets retried.
+  auto &entries = table.Entries;
+  std::stable_sort(entries.begin(), entries.end(), [&](const BulkLoadEntry &lhs, const BulkLoadEntry &rhs) {
+    return compare(lhs, rhs) < 0;
+  });
+
+  bool isEmpty = dbi.stat(txn).ms_entries == 0;
+  auto cursor = lmdb::cursor::open(txn, dbi);
+  size_t numWritten = 0;
+  for (size_t i = 0, e = entries.size(); i != e; ++i) {
+    // Of the entries that compare equal, a no-overwrite put keeps the first
+    // one and the others are updates that keep the last one.
+    const BulkLoadEntry *entry = &entries[i];
+    while (i + 1 != e && compare(entries[i + 1], *entry) == 0) {
+      ++i;
+      if (!(entry->Flags & MDB_NOOVERWRITE))
+        entry = &entries[i];
+    }
+
+    lmdb::val key{entry->Key.data(), entry->Key.size()};
+    lmdb::val value{entry->Value.data(), entry->Value.size()};
+    ++numWritten;
+    if (isEmpty) {
+      cursor.put(key, value, isDupSort ? MDB_APPENDDUP : MDB_APPEND);
+      continue;
+    }
+    if (!isDupSort) {
+      cursor.put(key, value, entry->Flags);
+      continue;
+    }
+    if (cursor.put(key, value, MDB_NODUPDATA))
+      continue;
+    // The staged entry is more recent than the one in the table, but don't
+    // dirty the page if it's the same.
+    lmdb::val existingKey;
+    lmdb::val existingValue;
+    cursor.get(existingKey, existingValue, MDB_GET_CURRENT);
+    if (existingValue.size() != value.size() ||
+        memcmp(existingValue.data(), value.data(), value.size()) != 0)
+      cursor.put(key, value, MDB_CURRENT);
+  }
+  return numWritten;
+}
+
+void BulkLoad::Implementation::flush() {
+  llvm::sys::ScopedLock L(StateMtx);
+  if (Tables.empty())
+    return;
+
+  metrics::Histogram::Timer timer(BulkLoadFlushLatency);
+  auto txn = lmdb::txn::begin(DBase->impl().getDBEnv());
+  size_t numEntries = 0;
+  for (auto &pair : Tables)
+    numEntries += writeBulkLoadTable(txn, pair.second);
+  txn.commit();
+
+  LOG_INFO_FUNC(Low, "wrote " << numEntries << " entries of " << Units.size() << " units");
+  NumBulkLoadEntries.add(numEntries);
+  Tables.clear();
+  Allocators.clear();
+  StagedProviders.clear();
+  StagedTestSymbolProviders.clear();
+  StagedBytes = 0;
+}
+
+std::shared_ptr<BulkLoad> BulkLoad::create(DatabaseRef dbase) {
+  auto &db = dbase->impl();
+  {
+    ReadTransactionGuard guard(dbase);
+    auto txn = lmdb::txn::begin(db.getDBEnv(), /*parent=*/nullptr, MDB_RDONLY);
+    if (db.getDBIUnitInfoByCode().stat(txn).ms_entries != 0)
+      return nullptr;
+  }
+
+  std::unique_ptr<Implementation> impl(new Implementation(dbase));
+  if (!db.setActiveBulkLoad(impl.get()))
+    return nullptr;
+  NumBulkLoads.add();
+  return std::shared_ptr<BulkLoad>(new BulkLoad(std::move(impl)));
+}
+
+BulkLoad::BulkLoad(std::unique_ptr<Implementation> impl) : Impl(std::move(impl)) {}
+
+BulkLoad::~BulkLoad() {}
+
+bool BulkLoad::containsUnit(IDCode unitCode) const {
+  return Impl->containsUnit(unitCode);
+}
+
+size_t BulkLoad::getStagedBytes() const {
+  return Impl->getStagedBytes();
+}
+
+void BulkLoad::flush() {
+  return Impl->flush();
+}
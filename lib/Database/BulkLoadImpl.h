@@ -0,0 +1,100 @@
+//===--- BulkLoadImpl.h -----------------------------------------*- C++ -*-===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2018 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://swift.org/LICENSE.txt for license information
+// See https://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef INDEXSTOREDB_SKDATABASE_LIB_BULKLOADIMPL_H
+#define INDEXSTOREDB_SKDATABASE_LIB_BULKLOADIMPL_H
+
+#include "IndexStoreDB/Database/ImportTransaction.h"
+#include "lmdb/lmdb++.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/Mutex.h"
+#include <unordered_set>
+#include <vector>
+
+namespace IndexStoreDB {
+namespace db {
+
+struct BulkLoadEntry {
+  StringRef Key;
+  StringRef Value;
+  /// The flags of the put that staged the entry.
+  unsigned Flags;
+};
+
+struct BulkLoadTable {
+  lmdb::dbi *DBI = nullptr;
+  std::vector<BulkLoadEntry> Entries;
+};
+
+typedef llvm::SmallDenseMap<MDB_dbi, BulkLoadTable, 16> BulkLoadTables;
+
+/// Sorts the staged entries of a table in the order of the table and writes
+/// them. If the table is empty the entries are appended, which fills the pages
+/// in order instead of searching and splitting them for each entry.
+///
+/// \returns the number of entries written.
+size_t writeBulkLoadTable(lmdb::txn &txn, BulkLoadTable &table);
+
+/// The entries staged by one import transaction of a bulk load. They are added
+/// to the bulk load when the transaction commits.
+class BulkLoadBatch {
+public:
+  std::unique_ptr<llvm::BumpPtrAllocator> Allocator{new llvm::BumpPtrAllocator()};
+  BulkLoadTables Tables;
+  std::unordered_set<IDCode> Providers;
+  std::unordered_set<IDCode> TestSymbolProviders;
+  std::unordered_set<IDCode> Units;
+  size_t Bytes = 0;
+
+  void put(lmdb::dbi &dbi, const lmdb::val &key, const lmdb::val &value, unsigned flags);
+  /// \returns the buffer of \p size bytes for the value, to be filled by the
+  /// caller.
+  char *reserve(lmdb::dbi &dbi, const lmdb::val &key, size_t size, unsigned flags);
+
+private:
+  StringRef copy(const void *data, size_t size);
+};
+
+class BulkLoad::Implementation {
+  DatabaseRef DBase;
+
+  mutable llvm::sys::Mutex StateMtx;
+  std::vector<std::unique_ptr<llvm::BumpPtrAllocator>> Allocators;
+  BulkLoadTables Tables;
+  std::unordered_set<IDCode> StagedProviders;
+  std::unordered_set<IDCode> StagedTestSymbolProviders;
+  /// All the units imported as part of the bulk load, including the flushed
+  /// ones.
+  std::unordered_set<IDCode> Units;
+  size_t StagedBytes = 0;
+
+public:
+  explicit Implementation(DatabaseRef dbase) : DBase(std::move(dbase)) {}
+  ~Implementation();
+
+  DatabaseRef getDBase() const { return DBase; }
+
+  void addBatch(BulkLoadBatch batch);
+
+  bool isProviderStaged(IDCode provider) const;
+  bool isTestSymbolProviderStaged(IDCode provider) const;
+  bool containsUnit(IDCode unitCode) const;
+  size_t getStagedBytes() const;
+
+  void flush();
+};
+
+} // namespace db
+} // namespace IndexStoreDB
+
+#endif
@@ -11,9 +11,11 @@
 //===----------------------------------------------------------------------===//
 
 #include "DatabaseImpl.h"
+#include "BulkLoadImpl.h"
 #include "IndexStoreDB/Core/Symbol.h"
 #include "IndexStoreDB/Database/UnitInfo.h"
 #include "IndexStoreDB/Support/Logging.h"
+#include "IndexStoreDB/Support/Metrics.h"
 #include "IndexStoreDB/Support/Path.h"
 #include "llvm/ADT/Hashing.h"
 #include "llvm/ADT/StringRef.h"
@@ -22,10 +24,15 @@
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Mutex.h"
 #include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
 #include "llvm/Support/raw_ostream.h"
 #if defined(_WIN32)
 #define NOMINMAX
 #include "Windows.h"
+#include <io.h>
+#else
+#include <sys/file.h>
+#include <unistd.h>
 #endif
 
 #if defined(_WIN32)
@@ -34,18 +41,24 @@ typedef DWORD indexstorePid_t;
 typedef pid_t indexstorePid_t;
 #endif
 
-// Dispatch on Linux doesn't have QOS_* macros.
-#if !__has_include(<sys/qos.h>)
-#define QOS_CLASS_BACKGROUND DISPATCH_QUEUE_PRIORITY_BACKGROUND
-#endif
-
 using namespace IndexStoreDB;
 using namespace IndexStoreDB::db;
 
-const unsigned Database::DATABASE_FORMAT_VERSION = 13;
+const unsigned Database::DATABASE_FORMAT_VERSION = 16;
 
 static const char *DeadProcessDBSuffix = "-dead";
 
+/// File in the versioned directory that the writer of the shared database
+/// keeps locked.
+static const char *SharedWriterLockFilename = "shared-writer.lock";
+/// How often the readers of a shared database check if the writer exited.
+static const std::chrono::seconds WriterElectionInterval(1);
+
+static metrics::Counter NumWriterTakeovers("database.writer_takeovers",
+                                           "Times a reader of the shared database took over as the writer");
+static metrics::Counter NumStaleReadersCleared("database.stale_readers_cleared",
+                                               "Reader slots of exited processes cleared from the shared database");
+
 static int providersForUSR_compare(const MDB_val *a, const MDB_val *b) {
   assert(a->mv_size == sizeof(ProviderForUSRData));
   assert(b->mv_size == sizeof(ProviderForUSRData));
@@ -73,24 +86,32 @@ static int filesForProvider_compare(const MDB_val *a, const MDB_val *b) {
 }
 
 /// Returns a global serial queue for stale database removal.
-static dispatch_queue_t getDiscardedDBsCleanupQueue() {
-  static dispatch_queue_t queue;
-  static dispatch_once_t onceToken = 0;
-  dispatch_once(&onceToken, ^{
-    dispatch_queue_attr_t qosAttribute = dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_SERIAL, QOS_CLASS_BACKGROUND, 0);
-    queue = dispatch_queue_create("indexstoredb.db.discarded_dbs_cleanup", qosAttribute);
-  });
-  return queue;
+static WorkQueue &getDiscardedDBsCleanupQueue() {
+  static WorkQueue *queue = new WorkQueue(WorkQueue::Dequeuing::Serial,
+                                          "indexstoredb.db.discarded_dbs_cleanup",
+                                          WorkQueue::Priority::Background);
+  return *queue;
 }
 
-Database::Implementation::Implementation() {
-  ReadTxnGroup = dispatch_group_create();
-  TxnSyncQueue = dispatch_queue_create("indexstoredb.db.txn_sync", DISPATCH_QUEUE_CONCURRENT);
-}
+Database::Implementation::Implementation()
+  : TxnSyncQueue(WorkQueue::Dequeuing::Concurrent, "indexstoredb.db.txn_sync") {}
+
 Database::Implementation::~Implementation() {
-  if (!IsReadOnly) {
+  if (ElectionStopped) {
+    // Waits for an election that is in progress.
+    ElectionQueue.dispatchSync([this] { *ElectionStopped = true; });
+  }
+  if (WriterLockFD >= 0) {
+    // Let a reader take over after the last commit.
     DBEnv.close();
-    assert(!SavedPath.empty() && !UniquePath.empty());
+    llvm::sys::Process::SafelyCloseFileDescriptor(WriterLockFD);
+  }
+
+  // Snapshots and shared databases are opened without a directory of the
+  // process.
+  if (!IsReadOnly && !UniquePath.empty()) {
+    DBEnv.close();
+    assert(!SavedPath.empty());
     // In case some other process already created the 'saved' path, override it so
     // that the 'last one wins'.
     llvm::sys::fs::rename(SavedPath, llvm::Twine(UniquePath)+"-saved"+DeadProcessDBSuffix);
@@ -101,27 +122,34 @@ Database::Implementation::~Implementation() {
       LOG_INFO_FUNC(High, "failed moving " << llvm::sys::path::filename(UniquePath) << " directory to 'saved': " << ec.message());
     }
   }
-
-  dispatch_release(ReadTxnGroup);
-  dispatch_release(TxnSyncQueue);
 }
 
-std::shared_ptr<Database::Implementation>
-Database::Implementation::create(StringRef path, bool readonly, Optional<size_t> initialDBSize, std::string &error) {
+void Database::Implementation::getVersionedPath(StringRef dbPath, SmallVectorImpl<char> &result) {
   SmallString<10> versionStr;
   llvm::raw_svector_ostream(versionStr) << 'v' << Database::DATABASE_FORMAT_VERSION;
-  SmallString<128> versionPath = path;
-  llvm::sys::path::append(versionPath, versionStr);
+  result.assign(dbPath.begin(), dbPath.end());
+  llvm::sys::path::append(result, versionStr);
+}
 
-  SmallString<128> savedPathBuf = versionPath;
-  llvm::sys::path::append(savedPathBuf, "saved");
-  SmallString<128> prefixPathBuf = versionPath;
+void Database::Implementation::getProcessDirPrefix(StringRef versionPath, SmallVectorImpl<char> &result) {
+  result.assign(versionPath.begin(), versionPath.end());
 #if defined(WIN32)
-  llvm::raw_svector_ostream(prefixPathBuf) << "/p" << GetCurrentProcessId();
+  llvm::raw_svector_ostream(result) << "/p" << GetCurrentProcessId();
 #else
-  llvm::raw_svector_ostream(prefixPathBuf) << "/p" << getpid();
+  llvm::raw_svector_ostream(result) << "/p" << getpid();
 #endif
-  llvm::raw_svector_ostream(prefixPathBuf) << "-";
+  llvm::raw_svector_ostream(result) << "-";
+}
+
+std::shared_ptr<Database::Implementation>
+Database::Implementation::create(StringRef path, bool readonly, Optional<size_t> initialDBSize, std::string &error) {
+  SmallString<128> versionPath;
+  getVersionedPath(path, versionPath);
+
+  SmallString<128> savedPathBuf = versionPath;
+  llvm::sys::path::append(savedPathBuf, "saved");
+  SmallString<128> prefixPathBuf;
+  getProcessDirPrefix(versionPath, prefixPathBuf);
   SmallString<128> uniqueDirPath;
 
   bool existingDB = true;
@@ -167,12 +195,9 @@ Database::Implementation::create(StringRef path, bool readonly, Optional<size_t>
 retry:
   try {
     auto db = std::make_shared<Database::Implementation>();
-    db->IsReadOnly = readonly;
     db->VersionedPath = versionPath.str();
     db->SavedPath = savedPathBuf.str();
     db->UniquePath = uniqueDirPath.str();
-    db->DBEnv = lmdb::env::create();
-    db->DBEnv.set_max_dbs(14);
 
     uint64_t dbFileSize = 0;
     if (existingDB) {
@@ -183,37 +208,7 @@ retry:
     // Start with 64MB.
     uint64_t initialSize = initialDBSize.getValueOr(64ULL*1024ULL*1024ULL);
 
-    db->MapSize = std::max(dbFileSize, initialSize);
-    db->DBEnv.set_mapsize(db->MapSize);
-
-    unsigned openflags = MDB_NOMEMINIT|MDB_WRITEMAP|MDB_NOSYNC;
-    if (readonly)
-      openflags |= MDB_RDONLY;
-    db->DBEnv.open(dbPath, openflags);
-    db->MaxKeySize = lmdb::env_get_max_keysize(db->DBEnv);
-
-    unsigned txnflags = lmdb::txn::default_flags;
-    if (readonly)
-      txnflags |= MDB_RDONLY;
-    auto txn = lmdb::txn::begin(db->DBEnv, /*parent=*/nullptr, txnflags);
-    db->DBISymbolProvidersByUSR = lmdb::dbi::open(txn, "usrs", MDB_INTEGERKEY|MDB_DUPSORT|MDB_DUPFIXED|MDB_CREATE);
-    db->DBISymbolProvidersByUSR.set_dupsort(txn, providersForUSR_compare);
-    db->DBISymbolProviderNameByCode = lmdb::dbi::open(txn, "providers", MDB_INTEGERKEY|MDB_CREATE);
-    db->DBISymbolProvidersWithTestSymbols = lmdb::dbi::open(txn, "providers-with-test-symbols", MDB_INTEGERKEY|MDB_CREATE);
-    db->DBIUSRsBySymbolName = lmdb::dbi::open(txn, "symbol-names", MDB_DUPSORT|MDB_DUPFIXED|MDB_INTEGERDUP|MDB_CREATE);
-    db->DBIUSRsByGlobalSymbolKind = lmdb::dbi::open(txn, "symbol-kinds", MDB_INTEGERKEY|MDB_DUPSORT|MDB_DUPFIXED|MDB_INTEGERDUP|MDB_CREATE);
-    db->DBIDirNameByCode = lmdb::dbi::open(txn, "directories", MDB_INTEGERKEY|MDB_CREATE);
-    db->DBIFilenameByCode = lmdb::dbi::open(txn, "filenames", MDB_INTEGERKEY|MDB_CREATE);
-    db->DBIFilePathCodesByDir = lmdb::dbi::open(txn, "filepaths-by-directory", MDB_INTEGERKEY|MDB_DUPSORT|MDB_DUPFIXED|MDB_INTEGERDUP|MDB_CREATE);
-    db->DBITimestampedFilesByProvider = lmdb::dbi::open(txn, "provider-files", MDB_INTEGERKEY|MDB_DUPSORT|MDB_DUPFIXED|MDB_CREATE);
-    db->DBITimestampedFilesByProvider.set_dupsort(txn, filesForProvider_compare);
-    db->DBIUnitInfoByCode = lmdb::dbi::open(txn, "unit-info", MDB_INTEGERKEY|MDB_CREATE);
-    db->DBIUnitByFileDependency = lmdb::dbi::open(txn, "unit-by-file", MDB_INTEGERKEY|MDB_DUPSORT|MDB_DUPFIXED|MDB_INTEGERDUP|MDB_CREATE);
-    db->DBIUnitByUnitDependency = lmdb::dbi::open(txn, "unit-by-unit", MDB_INTEGERKEY|MDB_DUPSORT|MDB_DUPFIXED|MDB_INTEGERDUP|MDB_CREATE);
-    db->DBITargetNameByCode = lmdb::dbi::open(txn, "target-names", MDB_INTEGERKEY|MDB_CREATE);
-    db->DBIModuleNameByCode = lmdb::dbi::open(txn, "module-names", MDB_INTEGERKEY|MDB_CREATE);
-    txn.commit();
-
+    db->open(dbPath, readonly, std::max(dbFileSize, initialSize));
     db->cleanupDiscardedDBs();
 
     return db;
@@ -244,28 +239,214 @@ retry:
   }
 }
 
+void Database::Implementation::open(StringRef dbPath, bool readonly, uint64_t mapSize) {
+  IsReadOnly = readonly;
+  DBEnv = lmdb::env::create();
+  DBEnv.set_max_dbs(16);
+
+  MapSize = mapSize;
+  DBEnv.set_mapsize(MapSize);
+
+  unsigned openflags = MDB_NOMEMINIT|MDB_WRITEMAP|MDB_NOSYNC;
+  if (readonly)
+    openflags |= MDB_RDONLY;
+  DBEnv.open(dbPath, openflags);
+  MaxKeySize = lmdb::env_get_max_keysize(DBEnv);
+  // Another process may have grown the map of a shared environment already.
+  MDB_envinfo info;
+  mdb_env_info(DBEnv, &info);
+  MapSize = info.me_mapsize;
+
+  unsigned txnflags = lmdb::txn::default_flags;
+  if (readonly)
+    txnflags |= MDB_RDONLY;
+  auto txn = lmdb::txn::begin(DBEnv, /*parent=*/nullptr, txnflags);
+  DBISymbolProvidersByUSR = lmdb::dbi::open(txn, "usrs", MDB_INTEGERKEY|MDB_DUPSORT|MDB_DUPFIXED|MDB_CREATE);
+  DBISymbolProvidersByUSR.set_dupsort(txn, providersForUSR_compare);
+  DBISymbolProviderNameByCode = lmdb::dbi::open(txn, "providers", MDB_INTEGERKEY|MDB_CREATE);
+  DBISymbolProvidersWithTestSymbols = lmdb::dbi::open(txn, "providers-with-test-symbols", MDB_INTEGERKEY|MDB_CREATE);
+  DBIUSRsBySymbolName = lmdb::dbi::open(txn, "symbol-names", MDB_DUPSORT|MDB_DUPFIXED|MDB_INTEGERDUP|MDB_CREATE);
+  DBIUSRsByGlobalSymbolKind = lmdb::dbi::open(txn, "symbol-kinds", MDB_INTEGERKEY|MDB_DUPSORT|MDB_DUPFIXED|MDB_INTEGERDUP|MDB_CREATE);
+  DBIDirNameByCode = lmdb::dbi::open(txn, "directories", MDB_INTEGERKEY|MDB_CREATE);
+  DBIFilenameByCode = lmdb::dbi::open(txn, "filenames", MDB_INTEGERKEY|MDB_CREATE);
+  DBIFilePathCodesByDir = lmdb::dbi::open(txn, "filepaths-by-directory", MDB_INTEGERKEY|MDB_DUPSORT|MDB_DUPFIXED|MDB_INTEGERDUP|MDB_CREATE);
+  DBITimestampedFilesByProvider = lmdb::dbi::open(txn, "provider-files", MDB_INTEGERKEY|MDB_DUPSORT|MDB_DUPFIXED|MDB_CREATE);
+  DBITimestampedFilesByProvider.set_dupsort(txn, filesForProvider_compare);
+  DBIUnitInfoByCode = lmdb::dbi::open(txn, "unit-info", MDB_INTEGERKEY|MDB_CREATE);
+  DBIUnitByFileDependency = lmdb::dbi::open(txn, "unit-by-file", MDB_INTEGERKEY|MDB_DUPSORT|MDB_DUPFIXED|MDB_INTEGERDUP|MDB_CREATE);
+  DBIUnitByUnitDependency = lmdb::dbi::open(txn, "unit-by-unit", MDB_INTEGERKEY|MDB_DUPSORT|MDB_DUPFIXED|MDB_INTEGERDUP|MDB_CREATE);
+  DBITargetNameByCode = lmdb::dbi::open(txn, "target-names", MDB_INTEGERKEY|MDB_CREATE);
+  DBIModuleNameByCode = lmdb::dbi::open(txn, "module-names", MDB_INTEGERKEY|MDB_CREATE);
+  DBIPolledUnitsByCode = lmdb::dbi::open(txn, "polled-units", MDB_INTEGERKEY|MDB_CREATE);
+  DBIStoreState = lmdb::dbi::open(txn, "store-state", MDB_CREATE);
+  txn.commit();
+}
+
+std::shared_ptr<Database::Implementation>
+Database::Implementation::createShared(StringRef path, bool readonly, Optional<size_t> initialDBSize, std::string &error) {
+  SmallString<128> versionPath;
+  getVersionedPath(path, versionPath);
+  SmallString<128> sharedPath = versionPath;
+  llvm::sys::path::append(sharedPath, "shared");
+
+  try {
+    auto db = std::make_shared<Database::Implementation>();
+    db->VersionedPath = versionPath.str();
+    db->SharedPath = sharedPath.str();
+
+    if (readonly) {
+      db->IsWriter = false;
+    } else {
+      if (std::error_code ec = llvm::sys::fs::create_directories(versionPath)) {
+        llvm::raw_string_ostream(error) << "failed creating directory '" << versionPath << "': " << ec.message();
+        return nullptr;
+      }
+      db->IsWriter = db->tryLockWriter();
+      // The first writer starts from the database that was saved by a process
+      // that didn't share it; a reader may have created an empty one already,
+      // which the rename doesn't replace.
+      if (db->IsWriter && !llvm::sys::fs::exists(sharedPath)) {
+        SmallString<128> savedPath = versionPath;
+        llvm::sys::path::append(savedPath, "saved");
+        llvm::sys::fs::rename(savedPath, sharedPath);
+      }
+      if (std::error_code ec = llvm::sys::fs::create_directories(sharedPath)) {
+        llvm::raw_string_ostream(error) << "failed creating directory '" << sharedPath << "': " << ec.message();
+        return nullptr;
+      }
+    }
+
+    uint64_t dbFileSize = 0;
+    llvm::sys::fs::file_size(sharedPath + "/data.mdb", dbFileSize);
+    // Start with 64MB.
+    uint64_t initialSize = initialDBSize.getValueOr(64ULL*1024ULL*1024ULL);
+    db->open(sharedPath, readonly, std::max(dbFileSize, initialSize));
+    db->clearStaleReaders();
+
+    if (!readonly) {
+      if (!db->IsWriter)
+        db->startWriterElection();
+      db->cleanupDiscardedDBs();
+    }
+    LOG_INFO_FUNC(High, "opened shared database '" << sharedPath << "' as the " << (db->IsWriter ? "writer" : "reader"));
+    return db;
+
+  } catch (lmdb::error err) {
+    llvm::raw_string_ostream(error) << "failed opening shared database: " << err.description();
+    return nullptr;
+  }
+}
+
+bool Database::Implementation::tryLockWriter() {
+  SmallString<128> lockPath(VersionedPath);
+  llvm::sys::path::append(lockPath, SharedWriterLockFilename);
+  int fd;
+  if (std::error_code ec = llvm::sys::fs::openFileForReadWrite(lockPath, fd, llvm::sys::fs::CD_OpenAlways, llvm::sys::fs::OF_None)) {
+    LOG_WARN_FUNC("failed opening '" << lockPath << "': " << ec.message());
+    return false;
+  }
+  // The lock goes away with the process, however it exits.
+#if defined(_WIN32)
+  OVERLAPPED overlapped = {};
+  bool locked = LockFileEx((HANDLE)_get_osfhandle(fd), LOCKFILE_EXCLUSIVE_LOCK|LOCKFILE_FAIL_IMMEDIATELY,
+                           0, 1, 0, &overlapped);
+#else
+  bool locked = flock(fd, LOCK_EX|LOCK_NB) == 0;
+#endif
+  if (!locked) {
+    llvm::sys::Process::SafelyCloseFileDescriptor(fd);
+    return false;
+  }
+  WriterLockFD = fd;
+  return true;
+}
+
+void Database::Implementation::startWriterElection() {
+  ElectionQueue = WorkQueue(WorkQueue::Dequeuing::Serial, "indexstoredb.db.writer_election");
+  ElectionStopped = std::make_shared<bool>(false);
+  scheduleWriterElection();
+}
+
+void Database::Implementation::scheduleWriterElection() {
+  std::shared_ptr<bool> stopped = ElectionStopped;
+  ElectionQueue.dispatchAfter(WriterElectionInterval, [this, stopped] {
+    // The database may be gone once the election stopped.
+    if (*stopped)
+      return;
+    clearStaleReaders();
+    if (!tryLockWriter()) {
+      scheduleWriterElection();
+      return;
+    }
+    *stopped = true;
+    becomeWriter();
+  });
+}
+
+void Database::Implementation::becomeWriter() {
+  // The previous writer may have exited in the middle of a read transaction.
+  clearStaleReaders();
+  // The previous writer may have grown the map.
+  adoptMapSize();
+  std::vector<std::function<void()>> handlers;
+  {
+    llvm::sys::ScopedLock L(WriterMtx);
+    IsWriter = true;
+    handlers.swap(WriterHandlers);
+  }
+  NumWriterTakeovers.add();
+  LOG_INFO_FUNC(High, "took over as the writer of shared database '" << SharedPath << "'");
+  // The handlers may hold the last references of the database, don't run
+  // them on the queue that its destructor waits for.
+  for (auto &handler : handlers)
+    WorkQueue::dispatchConcurrent(std::move(handler));
+}
+
+void Database::Implementation::clearStaleReaders() {
+  int numCleared = 0;
+  if (int rc = mdb_reader_check(DBEnv, &numCleared)) {
+    LOG_WARN_FUNC("mdb_reader_check failed: " << mdb_strerror(rc));
+    return;
+  }
+  if (numCleared > 0) {
+    NumStaleReadersCleared.add(numCleared);
+    LOG_INFO_FUNC(High, "cleared " << numCleared << " stale readers of shared database '" << SharedPath << "'");
+  }
+}
+
+bool Database::Implementation::deferUntilWriter(std::function<void()> work) {
+  llvm::sys::ScopedLock L(WriterMtx);
+  if (IsWriter)
+    return false;
+  WriterHandlers.push_back(std::move(work));
+  return true;
+}
+
 UnitInfo Database::Implementation::getUnitInfo(IDCode unitCode, lmdb::txn &Txn) {
   lmdb::val key{&unitCode, sizeof(unitCode)};
   lmdb::val value{};
   bool found = getDBIUnitInfoByCode().get(Txn, key, value);
   if (!found)
     return UnitInfo{ StringRef(), unitCode };
+  return getUnitInfoFromData(unitCode, value);
+}
 
+UnitInfo Database::Implementation::getUnitInfoFromData(IDCode unitCode, const lmdb::val &value) {
   UnitInfoData infoData;
   ArrayRef<IDCode> fileDepends;
   ArrayRef<IDCode> unitDepends;
   ArrayRef<UnitInfo::Provider> providerDepends;
   StringRef unitName;
 
-  char *ptr = value.data();
+  const char *ptr = value.data();
   memcpy(&infoData, ptr, sizeof(infoData));
   ptr += sizeof(infoData);
   assert(llvm::alignmentAdjustment(ptr, alignof(IDCode)) == 0 && "misaligned IDCode");
-  fileDepends = llvm::makeArrayRef((IDCode*)ptr, infoData.FileDependSize);
+  fileDepends = llvm::makeArrayRef((const IDCode*)ptr, infoData.FileDependSize);
   ptr += sizeof(IDCode)*fileDepends.size();
-  unitDepends = llvm::makeArrayRef((IDCode*)ptr, infoData.UnitDependSize);
+  unitDepends = llvm::makeArrayRef((const IDCode*)ptr, infoData.UnitDependSize);
   ptr += sizeof(IDCode)*unitDepends.size();
-  providerDepends = llvm::makeArrayRef((UnitInfo::Provider*)ptr, infoData.ProviderDependSize);
+  providerDepends = llvm::makeArrayRef((const UnitInfo::Provider*)ptr, infoData.ProviderDependSize);
   ptr += sizeof(UnitInfo::Provider)*providerDepends.size();
   unitName = StringRef(ptr, infoData.NameLength);
 
@@ -274,25 +455,83 @@ UnitInfo Database::Implementation::getUnitInfo(IDCode unitCode, lmdb::txn &Txn)
     infoData.OutFileCode, infoData.MainFileCode, infoData.SysrootCode, infoData.TargetCode,
     infoData.HasMainFile, infoData.HasSysroot, infoData.IsSystem, infoData.HasTestSymbols,
     SymbolProviderKind(infoData.SymProviderKind),
-    fileDepends, unitDepends, providerDepends };
+    fileDepends, unitDepends, providerDepends,
+    infoData.UserFileDependSize, infoData.UserUnitDependSize, infoData.UserProviderDependSize };
+}
+
+void Database::Implementation::countReadTransaction(void *ctx) {
+  auto *db = static_cast<Database::Implementation *>(ctx);
+  std::lock_guard<std::mutex> L(db->ReadTxnMtx);
+  ++db->NumReadTxns;
 }
 
 void Database::Implementation::enterReadTransaction() {
   // Prevent the read transaction from starting if increaseMapSize() is running.
-  dispatch_sync(TxnSyncQueue, ^{
-    dispatch_group_enter(ReadTxnGroup);
-  });
+  TxnSyncQueue.dispatchSync(this, countReadTransaction);
 }
 
 void Database::Implementation::exitReadTransaction() {
-  dispatch_group_leave(ReadTxnGroup);
+  std::lock_guard<std::mutex> L(ReadTxnMtx);
+  if (--NumReadTxns == 0)
+    ReadTxnCV.notify_all();
 }
 
-void Database::Implementation::increaseMapSize() {
+void Database::Implementation::withReadTransactionsPaused(llvm::function_ref<void()> fn) {
   // Prevent new read transactions from starting.
-  dispatch_barrier_sync(TxnSyncQueue, ^{
+  TxnSyncQueue.dispatchBarrierSync([&] {
     // Wait until all pending read transactions are finished.
-    dispatch_group_wait(ReadTxnGroup, DISPATCH_TIME_FOREVER);
+    WorkQueue::BlockingScope blocking;
+    std::unique_lock<std::mutex> L(ReadTxnMtx);
+    ReadTxnCV.wait(L, [&] { return NumReadTxns == 0; });
+    fn();
+  });
+}
+
+lmdb::txn Database::Implementation::beginReadTransaction() {
+  while (true) {
+    try {
+      return lmdb::txn::begin(DBEnv, /*parent=*/nullptr, MDB_RDONLY);
+    } catch (lmdb::error err) {
+      if (err.code() != MDB_MAP_RESIZED)
+        throw;
+    }
+    // Adopting the size waits for the read transactions to finish, including
+    // the one of the caller.
+    exitReadTransaction();
+    adoptMapSize();
+    enterReadTransaction();
+  }
+}
+
+static metrics::Counter NumMapGrowths("database.map_growths",
+                                      "Times the database map size was doubled");
+static metrics::Histogram MapGrowthLatency("database.map_growth_latency",
+                                           "Time to double the map size, including waiting for read transactions");
+
+bool Database::Implementation::setActiveBulkLoad(BulkLoad::Implementation *bulk) {
+  llvm::sys::ScopedLock L(BulkLoadMtx);
+  if (ActiveBulkLoad)
+    return false;
+  ActiveBulkLoad = bulk;
+  return true;
+}
+
+void Database::Implementation::clearActiveBulkLoad(BulkLoad::Implementation *bulk) {
+  llvm::sys::ScopedLock L(BulkLoadMtx);
+  if (ActiveBulkLoad == bulk)
+    ActiveBulkLoad = nullptr;
+}
+
+void Database::Implementation::flushActiveBulkLoad() {
+  llvm::sys::ScopedLock L(BulkLoadMtx);
+  if (ActiveBulkLoad)
+    ActiveBulkLoad->flush();
+}
+
+void Database::Implementation::increaseMapSize() {
+  NumMapGrowths.add();
+  metrics::Histogram::Timer timer(MapGrowthLatency);
+  withReadTransactionsPaused([&] {
     // Double the map size;
     MapSize *= 2;
     DBEnv.set_mapsize(MapSize);
@@ -300,6 +539,17 @@ void Database::Implementation::increaseMapSize() {
   LOG_INFO_FUNC(High, "increased lmdb map size to: " << MapSize);
 }
 
+void Database::Implementation::adoptMapSize() {
+  withReadTransactionsPaused([&] {
+    // Zero maps the size recorded in the environment.
+    DBEnv.set_mapsize(0);
+    MDB_envinfo info;
+    mdb_env_info(DBEnv, &info);
+    MapSize = info.me_mapsize;
+  });
+  LOG_INFO_FUNC(High, "adopted lmdb map size: " << MapSize);
+}
+
 static bool isProcessStillExecuting(indexstorePid_t PID) {
 #if defined(_WIN32)
   HANDLE hProcess;
@@ -368,37 +618,39 @@ static void cleanupDiscardedDBsImpl(StringRef versionedPath) {
 
 void Database::Implementation::cleanupDiscardedDBs() {
   std::string localVersionedPath = VersionedPath;
-  dispatch_async(getDiscardedDBsCleanupQueue(), ^{
+  getDiscardedDBsCleanupQueue().dispatch([localVersionedPath] {
     cleanupDiscardedDBsImpl(localVersionedPath);
   });
 }
 
-void Database::Implementation::printStats(raw_ostream &OS) {
-  OS << "\n*** Database Statistics\n";
-  auto txn = lmdb::txn::begin(DBEnv, nullptr, MDB_RDONLY);
-  auto printDBStats = [&](lmdb::dbi &db, StringRef name) {
-    OS << "DB " << name << '\n';
+DatabaseStats Database::Implementation::getStats() {
+  DatabaseStats stats;
+  ReadTransactionScope scope(*this);
+  auto txn = beginReadTransaction();
+  auto addTableStats = [&](lmdb::dbi &db, StringRef name) {
     MDB_stat st = db.stat(txn);
-    OS << "depth: " << st.ms_depth << '\n';
-    OS << "branch pages: " << st.ms_branch_pages << '\n';
-    OS << "leaf pages: " << st.ms_leaf_pages << '\n';
-    OS << "overflow pages: " << st.ms_overflow_pages << '\n';
-    OS << "entries: " << st.ms_entries << '\n';
-    OS << "---\n";
+    stats.PageSize = st.ms_psize;
+    stats.Tables.push_back(DatabaseStats::Table{name, st.ms_depth,
+      st.ms_branch_pages, st.ms_leaf_pages, st.ms_overflow_pages, st.ms_entries});
   };
-  printDBStats(DBISymbolProvidersByUSR, "SymbolProvidersByUSR");
-  printDBStats(DBISymbolProviderNameByCode, "SymbolProviderNameByCode");
-  printDBStats(DBIUSRsBySymbolName, "USRsBySymbolName");
-  printDBStats(DBIUSRsByGlobalSymbolKind, "USRsBySymbolKind");
-  printDBStats(DBIDirNameByCode, "DirNameByCode");
-  printDBStats(DBIFilenameByCode, "FilenameByCode");
-  printDBStats(DBIFilePathCodesByDir, "FilePathCodesByDir");
-  printDBStats(DBITimestampedFilesByProvider, "TimestampedFilesByProvider");
-  printDBStats(DBIUnitInfoByCode, "UnitInfoByCode");
-  printDBStats(DBIUnitByFileDependency, "UnitByFileDependency");
-  printDBStats(DBIUnitByUnitDependency, "UnitByUnitDependency");
-  printDBStats(DBITargetNameByCode, "TargetNameByCode");
-  printDBStats(DBIModuleNameByCode, "ModuleNameByCode");
+  addTableStats(DBISymbolProvidersByUSR, "SymbolProvidersByUSR");
+  addTableStats(DBISymbolProviderNameByCode, "SymbolProviderNameByCode");
+  addTableStats(DBISymbolProvidersWithTestSymbols, "SymbolProvidersWithTestSymbols");
+  addTableStats(DBIUSRsBySymbolName, "USRsBySymbolName");
+  addTableStats(DBIUSRsByGlobalSymbolKind, "USRsBySymbolKind");
+  addTableStats(DBIDirNameByCode, "DirNameByCode");
+  addTableStats(DBIFilenameByCode, "FilenameByCode");
+  addTableStats(DBIFilePathCodesByDir, "FilePathCodesByDir");
+  addTableStats(DBITimestampedFilesByProvider, "TimestampedFilesByProvider");
+  addTableStats(DBIUnitInfoByCode, "UnitInfoByCode");
+  addTableStats(DBIUnitByFileDependency, "UnitByFileDependency");
+  addTableStats(DBIUnitByUnitDependency, "UnitByUnitDependency");
+  addTableStats(DBITargetNameByCode, "TargetNameByCode");
+  addTableStats(DBIModuleNameByCode, "ModuleNameByCode");
+  addTableStats(DBIPolledUnitsByCode, "PolledUnitsByCode");
+  addTableStats(DBIStoreState, "StoreState");
+  stats.MapSize = MapSize;
+  return stats;
 }
 
 // LMDB prohibits opening an LMDB database twice in the same process at the same time.
@@ -406,11 +658,11 @@ void Database::Implementation::printStats(raw_ostream &OS) {
 // This allows referring to the same database from multiple index clients and addresses
 // racing issues where a new index client opens the same database before another client
 // had the chance to close it.
-static std::shared_ptr<Database::Implementation>
-getLMDBDatabaseRefForPath(StringRef dbPath, bool readonly, Optional<size_t> initialDBSize, std::string &error) {
-  static llvm::sys::Mutex processDatabasesMtx;
-  static llvm::StringMap<std::weak_ptr<Database::Implementation>> databasesByPath;
+static llvm::sys::Mutex processDatabasesMtx;
+static llvm::StringMap<std::weak_ptr<Database::Implementation>> databasesByPath;
 
+static std::shared_ptr<Database::Implementation>
+getLMDBDatabaseRefForPath(StringRef dbPath, bool readonly, bool shared, Optional<size_t> initialDBSize, std::string &error) {
   // Note that canonicalization of the path may result in different paths, if the
   // path doesn't exist yet vs the path exists. Use the path as given by the client.
 
@@ -419,7 +671,8 @@ getLMDBDatabaseRefForPath(StringRef dbPath, bool readonly, Optional<size_t> init
   if (auto dbRef = dbWeakRef.lock()) {
     return dbRef;
   }
-  auto dbRef = Database::Implementation::create(dbPath, readonly, initialDBSize, error);
+  auto dbRef = shared ? Database::Implementation::createShared(dbPath, readonly, initialDBSize, error)
+                      : Database::Implementation::create(dbPath, readonly, initialDBSize, error);
   if (!dbRef)
     return nullptr;
   dbWeakRef = dbRef;
@@ -427,7 +680,7 @@ getLMDBDatabaseRefForPath(StringRef dbPath, bool readonly, Optional<size_t> init
 }
 
 DatabaseRef Database::create(StringRef dbPath, bool readonly, Optional<size_t> initialDBSize, std::string &error) {
-  auto impl = getLMDBDatabaseRefForPath(dbPath, readonly, initialDBSize, error);
+  auto impl = getLMDBDatabaseRefForPath(dbPath, readonly, /*shared=*/false, initialDBSize, error);
   if (!impl)
     return nullptr;
 
@@ -436,14 +689,62 @@ DatabaseRef Database::create(StringRef dbPath, bool readonly, Optional<size_t> i
   return db;
 }
 
+DatabaseRef Database::createShared(StringRef dbPath, bool readonly, Optional<size_t> initialDBSize, std::string &error) {
+  auto impl = getLMDBDatabaseRefForPath(dbPath, readonly, /*shared=*/true, initialDBSize, error);
+  if (!impl)
+    return nullptr;
+
+  auto db = std::make_shared<Database>();
+  db->Impl = std::move(impl);
+  return db;
+}
+
+bool Database::isWriter() {
+  return Impl->isWriter();
+}
+
+bool Database::deferUntilWriter(std::function<void()> work) {
+  return Impl->deferUntilWriter(std::move(work));
+}
+
 Database::~Database() {}
 
 void Database::increaseMapSize() {
   return Impl->increaseMapSize();
 }
 
+DatabaseStats Database::getStats() {
+  return Impl->getStats();
+}
+
+bool Database::exportSnapshot(StringRef destPath, const PathPrefixMap &prefixMap, std::string &error) {
+  return Impl->exportSnapshot(destPath, prefixMap, error);
+}
+
+bool Database::seedFromSnapshot(StringRef dbPath, StringRef snapshotPath,
+                                const PathPrefixMap &prefixMap, std::string &error) {
+  // The 'saved' directory of a database that is open in the process is moved
+  // away, don't seed another one that would replace it when it closes.
+  llvm::sys::ScopedLock L(processDatabasesMtx);
+  auto found = databasesByPath.find(dbPath);
+  if (found != databasesByPath.end() && !found->second.expired())
+    return false;
+  return Implementation::seedFromSnapshot(dbPath, snapshotPath, prefixMap, error);
+}
+
 void Database::printStats(raw_ostream &OS) {
-  return Impl->printStats(OS);
+  DatabaseStats stats = getStats();
+  OS << "\n*** Database Statistics\n";
+  OS << "map size: " << stats.MapSize << '\n';
+  for (const auto &table : stats.Tables) {
+    OS << "DB " << table.Name << '\n';
+    OS << "depth: " << table.Depth << '\n';
+    OS << "branch pages: " << table.BranchPages << '\n';
+    OS << "leaf pages: " << table.LeafPages << '\n';
+    OS << "overflow pages: " << table.OverflowPages << '\n';
+    OS << "entries: " << table.Entries << '\n';
+    OS << "---\n";
+  }
 }
 
 IDCode db::makeIDCodeFromString(StringRef name) {
@@ -14,8 +14,16 @@
 #define INDEXSTOREDB_SKDATABASE_LIB_DATABASEIMPL_H
 
 #include "IndexStoreDB/Database/Database.h"
+#include "IndexStoreDB/Database/ImportTransaction.h"
+#include "IndexStoreDB/Support/Concurrency.h"
+#include "IndexStoreDB/Support/Path.h"
 #include "lmdb/lmdb++.h"
-#include <dispatch/dispatch.h>
+#include "llvm/Support/Mutex.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <vector>
 
 namespace IndexStoreDB {
   enum class SymbolKind : uint8_t;
@@ -39,23 +47,73 @@ class Database::Implementation {
   lmdb::dbi DBIUnitByUnitDependency{0};
   lmdb::dbi DBITargetNameByCode{0};
   lmdb::dbi DBIModuleNameByCode{0};
+  lmdb::dbi DBIPolledUnitsByCode{0};
+  lmdb::dbi DBIStoreState{0};
   size_t MaxKeySize;
   mdb_size_t MapSize;
 
-  dispatch_group_t ReadTxnGroup;
-  dispatch_queue_t TxnSyncQueue;
+  /// The map size changes in barriers of the queue, new read transactions
+  /// start outside of them.
+  WorkQueue TxnSyncQueue;
+  /// Counts the read transactions in progress; a map size change waits for
+  /// them to finish.
+  std::mutex ReadTxnMtx;
+  std::condition_variable ReadTxnCV;
+  unsigned NumReadTxns = 0;
+  static void countReadTransaction(void *ctx);
+
+  llvm::sys::Mutex BulkLoadMtx;
+  BulkLoad::Implementation *ActiveBulkLoad = nullptr;
 
   bool IsReadOnly;
   std::string VersionedPath;
   std::string SavedPath;
   std::string UniquePath;
 
+  // Only used by a shared database.
+  std::string SharedPath;
+  std::atomic<bool> IsWriter{true};
+  /// Descriptor of the lock file that the writer holds, -1 for the readers.
+  int WriterLockFD = -1;
+  /// Runs the periodic attempts to take over as the writer.
+  WorkQueue ElectionQueue;
+  /// Set on \c ElectionQueue once the election is over, the attempts that
+  /// are still scheduled then do nothing.
+  std::shared_ptr<bool> ElectionStopped;
+  llvm::sys::Mutex WriterMtx;
+  std::vector<std::function<void()>> WriterHandlers;
+
+  /// Tries to take the lock file of the writer of the shared database.
+  bool tryLockWriter();
+  /// Periodically tries to take over as the writer, until it succeeds.
+  void startWriterElection();
+  void scheduleWriterElection();
+  /// Waits until no read transaction is in progress and none can start, and
+  /// calls \p fn.
+  void withReadTransactionsPaused(llvm::function_ref<void()> fn);
+  void becomeWriter();
+  /// Frees the reader slots that processes which exited in the middle of a
+  /// read transaction left behind in the shared environment; they would
+  /// otherwise keep the writer from reusing the pages they saw.
+  void clearStaleReaders();
+
 public:
   static std::shared_ptr<Implementation> create(StringRef dbPath, bool readonly, Optional<size_t> initialDBSize, std::string &error);
+  static std::shared_ptr<Implementation> createShared(StringRef dbPath, bool readonly, Optional<size_t> initialDBSize, std::string &error);
 
   Implementation();
   ~Implementation();
 
+  /// Sets \p result to the directory of the databases of the current format.
+  static void getVersionedPath(StringRef dbPath, SmallVectorImpl<char> &result);
+  /// Sets \p result to the prefix of the directories that are owned by this
+  /// process and get discarded if it dies.
+  static void getProcessDirPrefix(StringRef versionPath, SmallVectorImpl<char> &result);
+
+  /// Opens the environment at \p dbPath and its tables. Throws
+  /// \c lmdb::error on failure.
+  void open(StringRef dbPath, bool readonly, uint64_t mapSize);
+
   lmdb::env &getDBEnv() { return DBEnv; }
   lmdb::dbi &getDBISymbolProvidersByUSR() { return DBISymbolProvidersByUSR; }
   lmdb::dbi &getDBISymbolProviderNameByCode() { return DBISymbolProviderNameByCode; }
@@ -71,19 +129,61 @@ public:
   lmdb::dbi &getDBIUnitByUnitDependency() { return DBIUnitByUnitDependency; }
   lmdb::dbi &getDBITargetNameByCode() { return DBITargetNameByCode; }
   lmdb::dbi &getDBIModuleNameByCode() { return DBIModuleNameByCode; }
+  lmdb::dbi &getDBIPolledUnitsByCode() { return DBIPolledUnitsByCode; }
+  lmdb::dbi &getDBIStoreState() { return DBIStoreState; }
   size_t getMaxKeySize() const { return MaxKeySize; }
 
   /// UnitInfo.UnitName will be empty if \c unit was not found. UnitInfo.UnitCode is always filled out.
   UnitInfo getUnitInfo(IDCode unitCode, lmdb::txn &Txn);
+  /// Decodes a value of the unit-info table.
+  static UnitInfo getUnitInfoFromData(IDCode unitCode, const lmdb::val &value);
 
   void enterReadTransaction();
   void exitReadTransaction();
 
+  /// Begins a read-only transaction, after \c enterReadTransaction(). If
+  /// another process grew the map of a shared database, adopts its size first.
+  lmdb::txn beginReadTransaction();
+
+  /// Keeps increaseMapSize() from running during a read transaction that
+  /// doesn't go through \c ReadTransaction.
+  class ReadTransactionScope {
+    Implementation &DB;
+  public:
+    explicit ReadTransactionScope(Implementation &DB) : DB(DB) { DB.enterReadTransaction(); }
+    ~ReadTransactionScope() { DB.exitReadTransaction(); }
+  };
+
   void increaseMapSize();
+  /// Maps the size that another process set for the shared environment.
+  void adoptMapSize();
+
+  bool isWriter() const { return IsWriter; }
+  /// Runs \p work when this process takes over as the writer of the shared
+  /// database, on a background queue.
+  /// \returns false, without keeping \p work, if it is the writer already.
+  bool deferUntilWriter(std::function<void()> work);
+
+  /// Makes \p bulk the bulk load of the database.
+  /// \returns false if there is one already.
+  bool setActiveBulkLoad(BulkLoad::Implementation *bulk);
+  void clearActiveBulkLoad(BulkLoad::Implementation *bulk);
+  /// Writes the staged entries of the bulk load, if there is one. Write
+  /// transactions that are not part of the bulk load call this before they
+  /// begin, so that the staged entries don't overwrite their changes later.
+  void flushActiveBulkLoad();
 
   void cleanupDiscardedDBs();
 
-  void printStats(raw_ostream &OS);
+  DatabaseStats getStats();
+
+  /// Writes a copy of the database into the new environment at \p destPath.
+  /// \returns true if an error occurred.
+  bool exportSnapshot(StringRef destPath, const PathPrefixMap &prefixMap, std::string &error);
+  /// Creates the saved database of \p dbPath from a snapshot, unless there is
+  /// one already. \returns true if an error occurred.
+  static bool seedFromSnapshot(StringRef dbPath, StringRef snapshotPath,
+                               const PathPrefixMap &prefixMap, std::string &error);
 };
 
 enum class GlobalSymbolKind : unsigned {
@@ -104,9 +204,16 @@ enum class GlobalSymbolKind : unsigned {
 Optional<GlobalSymbolKind> getGlobalSymbolKind(SymbolKind K);
 
 struct ProviderForUSRData {
+  /// Marks an occurrence count that was not recorded at import time.
+  static const uint32_t UnknownCount = UINT32_MAX;
+
   IDCode ProviderCode;
   uint64_t Roles;
   uint64_t RelatedRoles;
+  /// Number of occurrences of the USR in the provider.
+  uint32_t OccurrenceCount;
+  /// Number of occurrences in the provider that have a relation to the USR.
+  uint32_t RelatedOccurrenceCount;
 };
 
 struct TimestampedFileForProviderData {
@@ -117,6 +224,15 @@ struct TimestampedFileForProviderData {
   bool IsSystem;
 };
 
+/// Value of the 'polled-units' table, followed by the unit name.
+struct PolledUnitData {
+  uint64_t NanoTime;
+};
+
+/// Key of the 'store-state' table for the generation of the units directory
+/// when the store was last polled.
+static const char PolledUnitsGenerationKey[] = "polled-units-generation";
+
 struct UnitInfoData {
   struct Provider {
     IDCode ProviderCode;
@@ -143,6 +259,11 @@ struct UnitInfoData {
   uint32_t FileDependSize;
   uint32_t UnitDependSize;
   uint32_t ProviderDependSize;
+  /// Number of the dependencies that are not system ones, which come first in
+  /// each of the arrays.
+  uint32_t UserFileDependSize;
+  uint32_t UserUnitDependSize;
+  uint32_t UserProviderDependSize;
 
   // Follows:
   //  - Array of IDCodes for file dependencies
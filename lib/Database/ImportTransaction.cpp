@@ -12,6 +12,7 @@
 
 #include "ImportTransactionImpl.h"
 #include "DatabaseImpl.h"
+#include "IndexStoreDB/Support/Metrics.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ADT/SmallString.h"
 #include "llvm/Support/Path.h"
@@ -19,9 +20,30 @@
 using namespace IndexStoreDB;
 using namespace IndexStoreDB::db;
 
-ImportTransaction::Implementation::Implementation(DatabaseRef dbase)
-  : DBase(std::move(dbase)) {
-  Txn = lmdb::txn::begin(DBase->impl().getDBEnv());
+static metrics::Counter NumImportTransactions("database.import_transactions",
+                                              "Write transactions that were opened");
+static metrics::Histogram ImportCommitLatency("database.import_commit_latency",
+                                              "Time to commit a write transaction");
+
+ImportTransaction::Implementation::Implementation(DatabaseRef dbase, BulkLoad *bulk)
+  : DBase(std::move(dbase)), Bulk(bulk ? bulk->_impl() : nullptr) {
+  if (Bulk) {
+    TxnGuard.reset(new ReadTransactionGuard(DBase));
+    Txn = lmdb::txn::begin(DBase->impl().getDBEnv(), /*parent=*/nullptr, MDB_RDONLY);
+  } else {
+    DBase->impl().flushActiveBulkLoad();
+    Txn = lmdb::txn::begin(DBase->impl().getDBEnv());
+  }
+  NumImportTransactions.add();
+}
+
+void ImportTransaction::Implementation::put(lmdb::dbi &dbi, const lmdb::val &key, const lmdb::val &value, unsigned flags) {
+  if (Bulk) {
+    Staged.put(dbi, key, value, flags);
+    return;
+  }
+  lmdb::val data{value.data(), value.size()};
+  dbi.put(Txn, key, data, flags);
 }
 
 IDCode ImportTransaction::Implementation::getUnitCode(StringRef unitName) {
@@ -32,7 +54,16 @@ IDCode ImportTransaction::Implementation::addProviderName(StringRef name, bool *
   IDCode code = makeIDCodeFromString(name);
   lmdb::val key{&code, sizeof(code)};
   lmdb::val val{name.data(), name.size()};
-  bool inserted = DBase->impl().getDBISymbolProviderNameByCode().put(Txn, key, val, MDB_NOOVERWRITE);
+  auto &dbiProviderNames = DBase->impl().getDBISymbolProviderNameByCode();
+  bool inserted;
+  if (Bulk) {
+    inserted = !dbiProviderNames.get(Txn, code) && !Bulk->isProviderStaged(code) &&
+               Staged.Providers.insert(code).second;
+    if (inserted)
+      Staged.put(dbiProviderNames, key, val, MDB_NOOVERWRITE);
+  } else {
+    inserted = dbiProviderNames.put(Txn, key, val, MDB_NOOVERWRITE);
+  }
   if (wasInserted)
     *wasInserted = inserted;
   return code;
@@ -41,47 +72,72 @@ IDCode ImportTransaction::Implementation::addProviderName(StringRef name, bool *
 void ImportTransaction::Implementation::setProviderContainsTestSymbols(IDCode provider) {
   lmdb::val key{&provider, sizeof(provider)};
   lmdb::val val{nullptr, 0};
-  DBase->impl().getDBISymbolProvidersWithTestSymbols().put(Txn, key, val, MDB_NOOVERWRITE);
+  if (Bulk)
+    Staged.TestSymbolProviders.insert(provider);
+  put(DBase->impl().getDBISymbolProvidersWithTestSymbols(), key, val, MDB_NOOVERWRITE);
 }
 
 bool ImportTransaction::Implementation::providerContainsTestSymbols(IDCode provider) {
-  return DBase->impl().getDBISymbolProvidersWithTestSymbols().get(Txn, provider);
+  if (DBase->impl().getDBISymbolProvidersWithTestSymbols().get(Txn, provider))
+    return true;
+  return Bulk && (Staged.TestSymbolProviders.count(provider) || Bulk->isTestSymbolProviderStaged(provider));
 }
 
 IDCode ImportTransaction::Implementation::addSymbolInfo(IDCode provider, StringRef USR, StringRef symbolName,
                                                         SymbolInfo symInfo,
-                                                        SymbolRoleSet roles, SymbolRoleSet relatedRoles) {
+                                                        SymbolRoleSet roles, SymbolRoleSet relatedRoles,
+                                                        Optional<unsigned> occurrenceCount,
+                                                        Optional<unsigned> relatedOccurrenceCount) {
   auto &db = DBase->impl();
   auto &dbiProvidersByUSR = db.getDBISymbolProvidersByUSR();
 
   IDCode usrCode = makeIDCodeFromString(USR);
-  auto cursor = lmdb::cursor::open(Txn, dbiProvidersByUSR);
 
-  ProviderForUSRData entry{provider, roles.toRaw(), relatedRoles.toRaw()};
+  auto toStoredCount = [](Optional<unsigned> count) -> uint32_t {
+    if (!count.hasValue())
+      return ProviderForUSRData::UnknownCount;
+    return std::min<uint32_t>(count.getValue(), ProviderForUSRData::UnknownCount-1);
+  };
+  ProviderForUSRData entry{provider, roles.toRaw(), relatedRoles.toRaw(),
+                           toStoredCount(occurrenceCount), toStoredCount(relatedOccurrenceCount)};
   lmdb::val key{&usrCode, sizeof(usrCode)};
   lmdb::val value{&entry, sizeof(entry)};
-  // Don't dirty the page if it's not updating.
-  bool added = cursor.put(key, value, MDB_NODUPDATA);
-  if (!added) {
-    // Update roles if necessary.
-    lmdb::val existingKey;
-    lmdb::val existingValue;
-    cursor.get(existingKey, existingValue, MDB_GET_CURRENT);
-    const auto &existingData = *(ProviderForUSRData*)existingValue.data();
-    if (existingData.Roles != entry.Roles || existingData.RelatedRoles != entry.RelatedRoles)
-      cursor.put(key, value, MDB_CURRENT);
+  if (Bulk) {
+    // A provider is only imported once in a bulk load, there is nothing to
+    // update.
+    Staged.put(dbiProvidersByUSR, key, value, MDB_NODUPDATA);
+  } else {
+    auto cursor = lmdb::cursor::open(Txn, dbiProvidersByUSR);
+    // Don't dirty the page if it's not updating.
+    bool added = cursor.put(key, value, MDB_NODUPDATA);
+    if (!added) {
+      // Update roles and counts if necessary.
+      lmdb::val existingKey;
+      lmdb::val existingValue;
+      cursor.get(existingKey, existingValue, MDB_GET_CURRENT);
+      const auto &existingData = *(ProviderForUSRData*)existingValue.data();
+      if (existingData.Roles != entry.Roles || existingData.RelatedRoles != entry.RelatedRoles ||
+          existingData.OccurrenceCount != entry.OccurrenceCount ||
+          existingData.RelatedOccurrenceCount != entry.RelatedOccurrenceCount)
+        cursor.put(key, value, MDB_CURRENT);
+    }
   }
 
+  lmdb::val usrValue{&usrCode, sizeof(usrCode)};
+  auto addGlobalSymbolKind = [&](GlobalSymbolKind kind) {
+    lmdb::val kindKey{&kind, sizeof(kind)};
+    put(db.getDBIUSRsByGlobalSymbolKind(), kindKey, usrValue, MDB_NODUPDATA);
+  };
   if (roles & (SymbolRoleSet(SymbolRole::Declaration)|SymbolRole::Definition)) {
     if (!symbolName.empty() && symInfo.includeInGlobalNameSearch()) {
       if (symbolName.size() > db.getMaxKeySize())
         symbolName = symbolName.substr(0, db.getMaxKeySize());
-      db.getDBIUSRsBySymbolName().put(Txn, symbolName, usrCode, MDB_NODUPDATA);
+      put(db.getDBIUSRsBySymbolName(), lmdb::val(symbolName), usrValue, MDB_NODUPDATA);
     }
 
     auto globalKind = getGlobalSymbolKind(symInfo.Kind);
     if (globalKind.hasValue()) {
-      db.getDBIUSRsByGlobalSymbolKind().put(Txn, globalKind.getValue(), usrCode, MDB_NODUPDATA);
+      addGlobalSymbolKind(globalKind.getValue());
     }
     if (symInfo.Properties.contains(SymbolProperty::UnitTest) &&
         roles.contains(SymbolRole::Definition)) {
@@ -92,7 +148,7 @@ IDCode ImportTransaction::Implementation::addSymbolInfo(IDCode provider, StringR
         unitTestGlobalKind = GlobalSymbolKind::TestMethod;
 
       if (unitTestGlobalKind.hasValue()) {
-        db.getDBIUSRsByGlobalSymbolKind().put(Txn, unitTestGlobalKind.getValue(), usrCode, MDB_NODUPDATA);
+        addGlobalSymbolKind(unitTestGlobalKind.getValue());
       }
     }
   }
@@ -116,7 +172,7 @@ IDCode ImportTransaction::Implementation::addFilePath(StringRef filePath) {
     dirCode = makeIDCodeFromString(dirName);
     lmdb::val key{&dirCode, sizeof(dirCode)};
     lmdb::val val{dirName.data(), dirName.size()};
-    dbiDirNames.put(Txn, key, val, MDB_NOOVERWRITE);
+    put(dbiDirNames, key, val, MDB_NOOVERWRITE);
   }
 
   llvm::SmallString<64> dirCodeAndFilename;
@@ -125,13 +181,13 @@ IDCode ImportTransaction::Implementation::addFilePath(StringRef filePath) {
   dirCodeAndFilename += llvm::sys::path::filename(filePath);
   lmdb::val key{&filePathCode, sizeof(filePathCode)};
   lmdb::val val{dirCodeAndFilename.data(), dirCodeAndFilename.size()};
-  dbiFilenames.put(Txn, key, val, MDB_NOOVERWRITE);
+  put(dbiFilenames, key, val, MDB_NOOVERWRITE);
 
   if (!dirName.empty()) {
     auto &dbiPathsByDir = db.getDBIFilePathCodesByDir();
     lmdb::val key{&dirCode, sizeof(dirCode)};
     lmdb::val value{&filePathCode, sizeof(filePathCode)};
-    dbiPathsByDir.put(Txn, key, value, MDB_NODUPDATA);
+    put(dbiPathsByDir, key, value, MDB_NODUPDATA);
   }
 
   return filePathCode;
@@ -147,7 +203,7 @@ IDCode ImportTransaction::Implementation::addDirectory(CanonicalFilePathRef dire
   IDCode dirCode = makeIDCodeFromString(dirName);
   lmdb::val key{&dirCode, sizeof(dirCode)};
   lmdb::val val{dirName.data(), dirName.size()};
-  DBase->impl().getDBIDirNameByCode().put(Txn, key, val, MDB_NOOVERWRITE);
+  put(DBase->impl().getDBIDirNameByCode(), key, val, MDB_NOOVERWRITE);
   return dirCode;
 }
 
@@ -157,7 +213,7 @@ IDCode ImportTransaction::Implementation::addTargetName(StringRef target) {
   IDCode targetCode = makeIDCodeFromString(target);
   lmdb::val key{&targetCode, sizeof(targetCode)};
   lmdb::val val{target.data(), target.size()};
-  targetNames.put(Txn, key, val, MDB_NOOVERWRITE);
+  put(targetNames, key, val, MDB_NOOVERWRITE);
   return targetCode;
 }
 
@@ -171,7 +227,7 @@ IDCode ImportTransaction::Implementation::addModuleName(StringRef moduleName) {
   IDCode moduleCode = makeIDCodeFromString(moduleName);
   lmdb::val key{&moduleCode, sizeof(moduleCode)};
   lmdb::val val{moduleName.data(), moduleName.size()};
-  moduleNames.put(Txn, key, val, MDB_NOOVERWRITE);
+  put(moduleNames, key, val, MDB_NOOVERWRITE);
   return moduleCode;
 }
 
@@ -180,12 +236,18 @@ void ImportTransaction::Implementation::addFileAssociationForProvider(IDCode pro
   auto &db = DBase->impl();
   auto &dbiFilesByProvider = db.getDBITimestampedFilesByProvider();
 
-  auto cursor = lmdb::cursor::open(Txn, dbiFilesByProvider);
-
   uint64_t nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(modTime.time_since_epoch()).count();
   TimestampedFileForProviderData entry{file, unit, module, nanos, isSystem};
   lmdb::val key{&provider, sizeof(provider)};
   lmdb::val value{&entry, sizeof(entry)};
+  if (Bulk) {
+    // The unit is only imported once in a bulk load, the flush keeps the most
+    // recent association if it's added more than once.
+    Staged.put(dbiFilesByProvider, key, value, MDB_NODUPDATA);
+    return;
+  }
+
+  auto cursor = lmdb::cursor::open(Txn, dbiFilesByProvider);
   bool added = cursor.put(key, value, MDB_NODUPDATA);
   if (!added) {
     // Update timestamp if more recent.
@@ -200,6 +262,7 @@ void ImportTransaction::Implementation::addFileAssociationForProvider(IDCode pro
 }
 
 bool ImportTransaction::Implementation::removeFileAssociationFromProvider(IDCode provider, IDCode file, IDCode unit) {
+  assert(!Bulk && "removing entries in a bulk load");
   auto &db = DBase->impl();
   auto &dbiFilesByProvider = db.getDBITimestampedFilesByProvider();
   auto cursor = lmdb::cursor::open(Txn, dbiFilesByProvider);
@@ -231,12 +294,14 @@ UnitInfo ImportTransaction::Implementation::getUnitInfo(IDCode unitCode) {
 void ImportTransaction::Implementation::addUnitInfo(const UnitInfo &info) {
   auto &db = DBase->impl();
   auto &dbiUnitInfoByCode = db.getDBIUnitInfoByCode();
-  auto cursor = lmdb::cursor::open(Txn, dbiUnitInfoByCode);
 
   assert(static_cast<uint16_t>(info.UnitName.size()) == info.UnitName.size());
   assert(static_cast<uint32_t>(info.FileDepends.size()) == info.FileDepends.size());
   assert(static_cast<uint32_t>(info.UnitDepends.size()) == info.UnitDepends.size());
   assert(static_cast<uint32_t>(info.ProviderDepends.size()) == info.ProviderDepends.size());
+  assert(info.UserFileDependSize <= info.FileDepends.size());
+  assert(info.UserUnitDependSize <= info.UnitDepends.size());
+  assert(info.UserProviderDependSize <= info.ProviderDepends.size());
   auto nanoTime = std::chrono::duration_cast<std::chrono::nanoseconds>(info.ModTime.time_since_epoch()).count();
   UnitInfoData infoData{ info.MainFileCode, info.OutFileCode, info.SysrootCode,
     info.TargetCode,
@@ -247,6 +312,9 @@ void ImportTransaction::Implementation::addUnitInfo(const UnitInfo &info) {
     static_cast<uint32_t>(info.FileDepends.size()),
     static_cast<uint32_t>(info.UnitDepends.size()),
     static_cast<uint32_t>(info.ProviderDepends.size()),
+    info.UserFileDependSize,
+    info.UserUnitDependSize,
+    info.UserProviderDependSize,
   };
 
   size_t bufSize =
@@ -267,10 +335,16 @@ void ImportTransaction::Implementation::addUnitInfo(const UnitInfo &info) {
   bufSize = llvm::alignTo(bufSize, alignof(UnitInfoData));
 
   lmdb::val key{&info.UnitCode, sizeof(info.UnitCode)};
-  lmdb::val val{nullptr, bufSize};
-  cursor.put(key, val, MDB_RESERVE);
-
-  char *ptr = val.data();
+  char *ptr;
+  if (Bulk) {
+    Staged.Units.insert(info.UnitCode);
+    ptr = Staged.reserve(dbiUnitInfoByCode, key, bufSize, 0);
+  } else {
+    auto cursor = lmdb::cursor::open(Txn, dbiUnitInfoByCode);
+    lmdb::val val{nullptr, bufSize};
+    cursor.put(key, val, MDB_RESERVE);
+    ptr = val.data();
+  }
   memcpy(ptr, &infoData, sizeof(infoData));
   ptr += sizeof(infoData);
   memcpy(ptr, info.FileDepends.data(), sizeof(IDCode)*info.FileDepends.size());
@@ -289,7 +363,7 @@ IDCode ImportTransaction::Implementation::addUnitFileDependency(IDCode unitCode,
   IDCode fileCode = addFilePath(filePathDep);
   lmdb::val key{&fileCode, sizeof(fileCode)};
   lmdb::val value{&unitCode, sizeof(unitCode)};
-  dbiUnitByFileDependency.put(Txn, key, value, MDB_NODUPDATA);
+  put(dbiUnitByFileDependency, key, value, MDB_NODUPDATA);
 
   return fileCode;
 }
@@ -301,12 +375,13 @@ IDCode ImportTransaction::Implementation::addUnitUnitDependency(IDCode unitCode,
   IDCode unitDepCode = makeIDCodeFromString(unitNameDep);
   lmdb::val key{&unitDepCode, sizeof(unitDepCode)};
   lmdb::val value{&unitCode, sizeof(unitCode)};
-  dbiUnitByUnitDependency.put(Txn, key, value, MDB_NODUPDATA);
+  put(dbiUnitByUnitDependency, key, value, MDB_NODUPDATA);
 
   return unitDepCode;
 }
 
 void ImportTransaction::Implementation::removeUnitFileDependency(IDCode unitCode, IDCode pathCode) {
+  assert(!Bulk && "removing entries in a bulk load");
   auto &db = DBase->impl();
   lmdb::val key{&pathCode, sizeof(pathCode)};
   lmdb::val value{&unitCode, sizeof(unitCode)};
@@ -314,6 +389,7 @@ void ImportTransaction::Implementation::removeUnitFileDependency(IDCode unitCode
 }
 
 void ImportTransaction::Implementation::removeUnitUnitDependency(IDCode unitCode, IDCode unitDepCode) {
+  assert(!Bulk && "removing entries in a bulk load");
   auto &db = DBase->impl();
   lmdb::val key{&unitDepCode, sizeof(unitDepCode)};
   lmdb::val value{&unitCode, sizeof(unitCode)};
@@ -321,6 +397,7 @@ void ImportTransaction::Implementation::removeUnitUnitDependency(IDCode unitCode
 }
 
 void ImportTransaction::Implementation::removeUnitData(IDCode unitCode) {
+  assert(!Bulk && "removing entries in a bulk load");
   std::vector<IDCode> FileDepends;
   std::vector<IDCode> UnitDepends;
   std::vector<UnitInfo::Provider> ProviderDepends;
@@ -350,13 +427,53 @@ void ImportTransaction::Implementation::removeUnitData(StringRef unitName) {
   return removeUnitData(makeIDCodeFromString(unitName));
 }
 
+void ImportTransaction::Implementation::setPolledUnit(StringRef unitName, llvm::sys::TimePoint<> modTime) {
+  assert(!Bulk && "recording the polled units in a bulk load");
+  auto &db = DBase->impl();
+  IDCode unitCode = makeIDCodeFromString(unitName);
+  PolledUnitData data{uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(modTime.time_since_epoch()).count())};
+
+  lmdb::val key{&unitCode, sizeof(unitCode)};
+  lmdb::val val{nullptr, sizeof(data) + unitName.size()};
+  db.getDBIPolledUnitsByCode().put(Txn, key, val, MDB_RESERVE);
+  memcpy(val.data(), &data, sizeof(data));
+  memcpy(val.data() + sizeof(data), unitName.data(), unitName.size());
+}
+
+void ImportTransaction::Implementation::removePolledUnit(StringRef unitName) {
+  assert(!Bulk && "removing entries in a bulk load");
+  auto &db = DBase->impl();
+  IDCode unitCode = makeIDCodeFromString(unitName);
+  lmdb::val key{&unitCode, sizeof(unitCode)};
+  db.getDBIPolledUnitsByCode().del(Txn, key);
+}
+
+void ImportTransaction::Implementation::setPolledUnitsGeneration(Optional<llvm::sys::TimePoint<>> generation) {
+  assert(!Bulk && "recording the polled units in a bulk load");
+  auto &db = DBase->impl();
+  lmdb::val key{PolledUnitsGenerationKey, strlen(PolledUnitsGenerationKey)};
+  if (!generation) {
+    db.getDBIStoreState().del(Txn, key);
+    return;
+  }
+  uint64_t nanoTime = std::chrono::duration_cast<std::chrono::nanoseconds>(generation->time_since_epoch()).count();
+  lmdb::val val{&nanoTime, sizeof(nanoTime)};
+  db.getDBIStoreState().put(Txn, key, val);
+}
+
 void ImportTransaction::Implementation::commit() {
+  metrics::Histogram::Timer timer(ImportCommitLatency);
+  if (Bulk) {
+    Bulk->addBatch(std::move(Staged));
+    Staged = BulkLoadBatch();
+    return;
+  }
   Txn.commit();
 }
 
 
-ImportTransaction::ImportTransaction(DatabaseRef dbase)
-  : Impl(new Implementation(std::move(dbase))) {}
+ImportTransaction::ImportTransaction(DatabaseRef dbase, BulkLoad *bulk)
+  : Impl(new Implementation(std::move(dbase), bulk)) {}
 
 ImportTransaction::~ImportTransaction() {}
 
@@ -378,8 +495,11 @@ bool ImportTransaction::providerContainsTestSymbols(IDCode provider) {
 
 IDCode ImportTransaction::addSymbolInfo(IDCode provider, StringRef USR, StringRef symbolName,
                                         SymbolInfo symInfo,
-                                        SymbolRoleSet roles, SymbolRoleSet relatedRoles) {
-  return Impl->addSymbolInfo(provider, USR, symbolName, symInfo, roles, relatedRoles);
+                                        SymbolRoleSet roles, SymbolRoleSet relatedRoles,
+                                        Optional<unsigned> occurrenceCount,
+                                        Optional<unsigned> relatedOccurrenceCount) {
+  return Impl->addSymbolInfo(provider, USR, symbolName, symInfo, roles, relatedRoles,
+                             occurrenceCount, relatedOccurrenceCount);
 }
 
 IDCode ImportTransaction::addFilePath(CanonicalFilePathRef filePath) {
@@ -398,6 +518,18 @@ void ImportTransaction::removeUnitData(StringRef unitName) {
   return Impl->removeUnitData(unitName);
 }
 
+void ImportTransaction::setPolledUnit(StringRef unitName, llvm::sys::TimePoint<> modTime) {
+  return Impl->setPolledUnit(unitName, modTime);
+}
+
+void ImportTransaction::removePolledUnit(StringRef unitName) {
+  return Impl->removePolledUnit(unitName);
+}
+
+void ImportTransaction::setPolledUnitsGeneration(Optional<llvm::sys::TimePoint<>> generation) {
+  return Impl->setPolledUnitsGeneration(generation);
+}
+
 void ImportTransaction::commit() {
   return Impl->commit();
 }
@@ -470,10 +602,10 @@ void UnitDataImport::setTarget(StringRef T) {
   Target = T;
 }
 
-IDCode UnitDataImport::addFileDependency(CanonicalFilePathRef filePathDep) {
+IDCode UnitDataImport::addFileDependency(CanonicalFilePathRef filePathDep, bool isSystem) {
   assert(!IsUpToDate);
   IDCode pathCode = makeIDCodeFromString(filePathDep.getPath());
-  FileDepends.push_back(pathCode);
+  (isSystem ? SystemFileDepends : FileDepends).push_back(pathCode);
   auto it = PrevCombinedFileDepends.find(pathCode);
   if (it == PrevCombinedFileDepends.end()) {
     Import._impl()->addUnitFileDependency(UnitCode, filePathDep);
@@ -483,10 +615,10 @@ IDCode UnitDataImport::addFileDependency(CanonicalFilePathRef filePathDep) {
   return pathCode;
 }
 
-IDCode UnitDataImport::addUnitDependency(StringRef unitNameDep) {
+IDCode UnitDataImport::addUnitDependency(StringRef unitNameDep, bool isSystem) {
   assert(!IsUpToDate);
   IDCode unitDepCode = Import.getUnitCode(unitNameDep);
-  UnitDepends.push_back(unitDepCode);
+  (isSystem ? SystemUnitDepends : UnitDepends).push_back(unitDepCode);
   auto it = PrevUnitDepends.find(unitDepCode);
   if (it == PrevUnitDepends.end()) {
     Import._impl()->addUnitUnitDependency(UnitCode, unitNameDep);
@@ -502,7 +634,7 @@ IDCode UnitDataImport::addProviderDependency(StringRef providerName, CanonicalFi
   IDCode pathCode = makeIDCodeFromString(filePathDep.getPath());
   IDCode moduleNameCode = Import._impl()->addModuleName(moduleName);
   UnitInfo::Provider prov{providerCode, pathCode};
-  ProviderDepends.push_back(prov);
+  (isSystem ? SystemProviderDepends : ProviderDepends).push_back(prov);
   {
     auto it = PrevProviderDepends.find(prov);
     if (it == PrevProviderDepends.end()) {
@@ -563,6 +695,15 @@ void UnitDataImport::commit() {
       import.addTargetName(Target);
   }
 
+  // The user dependencies come first, so they can be read without going
+  // through the system ones.
+  unsigned userFileDependSize = FileDepends.size();
+  unsigned userUnitDependSize = UnitDepends.size();
+  unsigned userProviderDependSize = ProviderDepends.size();
+  FileDepends.insert(FileDepends.end(), SystemFileDepends.begin(), SystemFileDepends.end());
+  UnitDepends.insert(UnitDepends.end(), SystemUnitDepends.begin(), SystemUnitDepends.end());
+  ProviderDepends.insert(ProviderDepends.end(), SystemProviderDepends.begin(), SystemProviderDepends.end());
+
   // Update the `HasTestSymbols` value.
   HasTestSymbols = false;
   for (const UnitInfo::Provider &prov : ProviderDepends) {
@@ -588,6 +729,9 @@ void UnitDataImport::commit() {
     FileDepends,
     UnitDepends,
     ProviderDepends,
+    userFileDependSize,
+    userUnitDependSize,
+    userProviderDependSize,
   };
   import.addUnitInfo(info);
 
@@ -13,6 +13,8 @@
 #ifndef INDEXSTOREDB_SKDATABASE_LIB_IMPORTTRANSACTIONIMPL_H
 #define INDEXSTOREDB_SKDATABASE_LIB_IMPORTTRANSACTIONIMPL_H
 
+#include "BulkLoadImpl.h"
+#include "ReadTransactionImpl.h"
 #include "IndexStoreDB/Database/ImportTransaction.h"
 #include "IndexStoreDB/Database/UnitInfo.h"
 #include "lmdb/lmdb++.h"
@@ -23,9 +25,15 @@ namespace db {
 class ImportTransaction::Implementation {
 public:
   DatabaseRef DBase;
+  /// Set if the transaction is part of a bulk load. \c Txn is then read-only
+  /// and the entries are staged in \c Staged.
+  BulkLoad::Implementation *Bulk;
+  BulkLoadBatch Staged;
+  // This needs to be before 'Txn' so that it gets destructed after it.
+  std::unique_ptr<ReadTransactionGuard> TxnGuard;
   lmdb::txn Txn{nullptr};
 
-  explicit Implementation(DatabaseRef dbase);
+  Implementation(DatabaseRef dbase, BulkLoad *bulk);
 
   IDCode getUnitCode(StringRef unitName);
   IDCode addProviderName(StringRef name, bool *wasInserted);
@@ -34,7 +42,9 @@ public:
   bool providerContainsTestSymbols(IDCode provider);
   /// \returns a IDCode of the USR.
   IDCode addSymbolInfo(IDCode provider, StringRef USR, StringRef symbolName, SymbolInfo symInfo,
-                       SymbolRoleSet roles, SymbolRoleSet relatedRoles);
+                       SymbolRoleSet roles, SymbolRoleSet relatedRoles,
+                       Optional<unsigned> occurrenceCount,
+                       Optional<unsigned> relatedOccurrenceCount);
   IDCode addFilePath(CanonicalFilePathRef canonFilePath);
   IDCode addDirectory(CanonicalFilePathRef directory);
   IDCode addUnitFileIdentifier(StringRef unitFile);
@@ -59,10 +69,17 @@ public:
   void removeUnitData(IDCode unitCode);
   void removeUnitData(StringRef unitName);
 
+  void setPolledUnit(StringRef unitName, llvm::sys::TimePoint<> modTime);
+  void removePolledUnit(StringRef unitName);
+  void setPolledUnitsGeneration(Optional<llvm::sys::TimePoint<>> generation);
+
   void commit();
 
 private:
   IDCode addFilePath(StringRef filePath);
+  /// Puts the entry in the transaction, or stages it if the transaction is
+  /// part of a bulk load.
+  void put(lmdb::dbi &dbi, const lmdb::val &key, const lmdb::val &value, unsigned flags);
 };
 
 } // namespace db
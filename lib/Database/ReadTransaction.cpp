@@ -14,6 +14,8 @@
 #include "IndexStoreDB/Support/Path.h"
 #include "IndexStoreDB/Support/PatternMatching.h"
 #include "IndexStoreDB/Support/Logging.h"
+#include "IndexStoreDB/Support/Metrics.h"
+#include "IndexStoreDB/Support/QueryProfile.h"
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Support/Path.h"
@@ -22,6 +24,9 @@
 using namespace IndexStoreDB;
 using namespace IndexStoreDB::db;
 
+static metrics::Counter NumReadTransactions("database.read_transactions",
+                                            "Read transactions that were opened");
+
 ReadTransactionGuard::ReadTransactionGuard(DatabaseRef dbase) : DBase(dbase) {
   DBase->impl().enterReadTransaction();
 }
@@ -29,9 +34,34 @@ ReadTransactionGuard::~ReadTransactionGuard() {
   DBase->impl().exitReadTransaction();
 }
 
-ReadTransaction::Implementation::Implementation(DatabaseRef dbase)
-  : DBase(dbase), TxnGuard(dbase) {
-  Txn = lmdb::txn::begin(DBase->impl().getDBEnv(), /*parent=*/nullptr, MDB_RDONLY);
+ReadTransaction::Implementation::Implementation(DatabaseRef dbase, CancellationTokenRef cancelToken)
+  : DBase(dbase), TxnGuard(dbase), CancelToken(std::move(cancelToken)), Cancel(CancelToken.get()) {
+  Txn = DBase->impl().beginReadTransaction();
+  QueryProfile::count(QueryProfile::Counter::ReadTransactions);
+  NumReadTransactions.add();
+}
+
+/// Wraps \c lmdb::cursor::get to record the access in the active \c QueryProfile.
+static bool cursorGet(lmdb::cursor &cursor, lmdb::val &key, lmdb::val &value, MDB_cursor_op op) {
+  switch (op) {
+  case MDB_SET:
+  case MDB_SET_KEY:
+  case MDB_SET_RANGE:
+  case MDB_GET_BOTH:
+  case MDB_GET_BOTH_RANGE:
+    QueryProfile::count(QueryProfile::Counter::DBLookups);
+    break;
+  default:
+    QueryProfile::count(QueryProfile::Counter::DBCursorSteps);
+    break;
+  }
+  return cursor.get(key, value, op);
+}
+
+/// Wraps \c lmdb::dbi::get to record the lookup in the active \c QueryProfile.
+static bool dbiGet(lmdb::dbi &dbi, lmdb::txn &txn, lmdb::val &key, lmdb::val &value) {
+  QueryProfile::count(QueryProfile::Counter::DBLookups);
+  return dbi.get(txn, key, value);
 }
 
 bool ReadTransaction::Implementation::lookupProvidersForUSR(StringRef USR, SymbolRoleSet rolesToLookup, SymbolRoleSet relatedRolesToLookup,
@@ -41,6 +71,27 @@ bool ReadTransaction::Implementation::lookupProvidersForUSR(StringRef USR, Symbo
 
 bool ReadTransaction::Implementation::lookupProvidersForUSR(IDCode usrCode, SymbolRoleSet rolesToLookup, SymbolRoleSet relatedRolesToLookup,
                                                             llvm::function_ref<bool(IDCode provider, SymbolRoleSet roles, SymbolRoleSet relatedRoles)> receiver) {
+  return foreachProviderEntryForUSR(usrCode, rolesToLookup, relatedRolesToLookup, [&](const ProviderForUSRData &entry) -> bool {
+    return receiver(entry.ProviderCode, SymbolRoleSet(entry.Roles), SymbolRoleSet(entry.RelatedRoles));
+  });
+}
+
+bool ReadTransaction::Implementation::lookupProviderOccurrenceCountsForUSR(IDCode usrCode, SymbolRoleSet rolesToLookup, SymbolRoleSet relatedRolesToLookup,
+    function_ref<bool(IDCode provider, SymbolRoleSet roles, SymbolRoleSet relatedRoles,
+                      Optional<unsigned> occurrenceCount, Optional<unsigned> relatedOccurrenceCount)> receiver) {
+  auto getCount = [](uint32_t storedCount) -> Optional<unsigned> {
+    if (storedCount == ProviderForUSRData::UnknownCount)
+      return None;
+    return storedCount;
+  };
+  return foreachProviderEntryForUSR(usrCode, rolesToLookup, relatedRolesToLookup, [&](const ProviderForUSRData &entry) -> bool {
+    return receiver(entry.ProviderCode, SymbolRoleSet(entry.Roles), SymbolRoleSet(entry.RelatedRoles),
+                    getCount(entry.OccurrenceCount), getCount(entry.RelatedOccurrenceCount));
+  });
+}
+
+bool ReadTransaction::Implementation::foreachProviderEntryForUSR(IDCode usrCode, SymbolRoleSet rolesToLookup, SymbolRoleSet relatedRolesToLookup,
+                                                                 function_ref<bool(const ProviderForUSRData &entry)> receiver) {
   auto &db = DBase->impl();
   auto &dbiProvidersByUSR = db.getDBISymbolProvidersByUSR();
   auto cursorUSR = lmdb::cursor::open(Txn, dbiProvidersByUSR);
@@ -48,14 +99,14 @@ bool ReadTransaction::Implementation::lookupProvidersForUSR(IDCode usrCode, Symb
   auto handleEntry = [&](const ProviderForUSRData &entry) -> bool {
     if ((!rolesToLookup || (entry.Roles & rolesToLookup.toRaw())) &&
         (!relatedRolesToLookup || (entry.RelatedRoles & relatedRolesToLookup.toRaw()))) {
-      return receiver(entry.ProviderCode, SymbolRoleSet(entry.Roles), SymbolRoleSet(entry.RelatedRoles));
+      return receiver(entry);
     }
     return true;
   };
 
   lmdb::val key{&usrCode, sizeof(usrCode)};
   lmdb::val value{};
-  bool found = cursorUSR.get(key, value, MDB_SET_KEY);
+  bool found = cursorGet(cursorUSR, key, value, MDB_SET_KEY);
   if (!found)
     return true;
 
@@ -65,7 +116,9 @@ bool ReadTransaction::Implementation::lookupProvidersForUSR(IDCode usrCode, Symb
     return handleEntry(entry);
   } else {
     // The first one is returned again with MDB_NEXT_MULTIPLE.
-    while (cursorUSR.get(key, value, MDB_NEXT_MULTIPLE)) {
+    while (cursorGet(cursorUSR, key, value, MDB_NEXT_MULTIPLE)) {
+      if (Cancel.isCancelled())
+        return false;
       assert(value.size() % sizeof(ProviderForUSRData) == 0);
       ProviderForUSRData *entryPtr = (ProviderForUSRData*)value.data();
       size_t entryCount = value.size() / sizeof(ProviderForUSRData);
@@ -84,7 +137,7 @@ bool ReadTransaction::Implementation::lookupProvidersForUSR(IDCode usrCode, Symb
 StringRef ReadTransaction::Implementation::getProviderName(IDCode providerCode) {
   lmdb::val key{&providerCode, sizeof(providerCode)};
   lmdb::val data{};
-  if (!DBase->impl().getDBISymbolProviderNameByCode().get(Txn, key, data)) {
+  if (!dbiGet(DBase->impl().getDBISymbolProviderNameByCode(), Txn, key, data)) {
     LOG_WARN_FUNC("provider code not found");
     return StringRef();
   }
@@ -98,7 +151,7 @@ StringRef ReadTransaction::Implementation::getTargetName(IDCode targetCode) {
 
   lmdb::val key{&targetCode, sizeof(targetCode)};
   lmdb::val data{};
-  if (!DBase->impl().getDBITargetNameByCode().get(Txn, key, data)) {
+  if (!dbiGet(DBase->impl().getDBITargetNameByCode(), Txn, key, data)) {
     LOG_WARN_FUNC("target code not found");
     return StringRef();
   }
@@ -112,7 +165,7 @@ StringRef ReadTransaction::Implementation::getModuleName(IDCode moduleNameCode)
 
   lmdb::val key{&moduleNameCode, sizeof(moduleNameCode)};
   lmdb::val data{};
-  if (!DBase->impl().getDBIModuleNameByCode().get(Txn, key, data)) {
+  if (!dbiGet(DBase->impl().getDBIModuleNameByCode(), Txn, key, data)) {
     LOG_WARN_FUNC("module name code not found");
     return StringRef();
   }
@@ -190,7 +243,7 @@ static bool passFileReferencesForProviderCursor(lmdb::val &key,
         currUnitCode.reset();
       }
     }
-  } while (cursor.get(key, value, MDB_NEXT_DUP));
+  } while (cursorGet(cursor, key, value, MDB_NEXT_DUP));
 
   if (currFileCode) {
     return passCurrFile();
@@ -208,7 +261,7 @@ bool ReadTransaction::Implementation::getProviderFileCodeReferences(IDCode provi
 
   lmdb::val key{&provider, sizeof(provider)};
   lmdb::val value{};
-  bool found = cursor.get(key, value, MDB_SET_KEY);
+  bool found = cursorGet(cursor, key, value, MDB_SET_KEY);
   if (!found)
     return true;
 
@@ -224,7 +277,9 @@ bool ReadTransaction::Implementation::foreachProviderAndFileCodeReference(
 
   lmdb::val key{};
   lmdb::val value{};
-  while (cursor.get(key, value, MDB_NEXT_NODUP)) {
+  while (cursorGet(cursor, key, value, MDB_NEXT_NODUP)) {
+    if (Cancel.isCancelled())
+      return false;
     IDCode providerCode = *(IDCode*)key.data();
     bool cont = passFileReferencesForProviderCursor(key, value, cursor, unitFilter, [&](IDCode pathCode, IDCode unitCode, llvm::sys::TimePoint<> modTime, IDCode moduleNameCode, bool isSystem) -> bool {
       return receiver(providerCode, pathCode, unitCode, modTime, moduleNameCode, isSystem);
@@ -236,6 +291,7 @@ bool ReadTransaction::Implementation::foreachProviderAndFileCodeReference(
 }
 
 static bool passMultipleIDCodes(lmdb::cursor &cursor, lmdb::val &key, lmdb::val &value,
+                                CancellationCheck &cancel,
                                 llvm::function_ref<bool(ArrayRef<IDCode> codes)> receiver) {
   size_t numItems = cursor.count();
   if (numItems == 1) {
@@ -245,7 +301,9 @@ static bool passMultipleIDCodes(lmdb::cursor &cursor, lmdb::val &key, lmdb::val
       return false;
   } else {
     // The first one is returned again with MDB_NEXT_MULTIPLE.
-    while (cursor.get(key, value, MDB_NEXT_MULTIPLE)) {
+    while (cursorGet(cursor, key, value, MDB_NEXT_MULTIPLE)) {
+      if (cancel.isCancelled())
+        return false;
       assert(value.size() % sizeof(IDCode) == 0);
       size_t entryCount = value.size() / sizeof(IDCode);
       SmallVector<IDCode, 16> entries(entryCount);
@@ -265,7 +323,9 @@ bool ReadTransaction::Implementation::foreachProviderContainingTestSymbols(funct
 
   lmdb::val key{};
   lmdb::val value{};
-  while (cursor.get(key, value, MDB_NEXT)) {
+  while (cursorGet(cursor, key, value, MDB_NEXT)) {
+    if (Cancel.isCancelled())
+      return false;
     IDCode providerCode = *(IDCode*)key.data();
     if (!receiver(providerCode))
       return false;
@@ -281,6 +341,22 @@ bool ReadTransaction::Implementation::foreachUSROfGlobalSymbolKind(SymbolKind sy
   return foreachUSROfGlobalSymbolKind(globalKindOpt.getValue(), receiver);
 }
 
+size_t ReadTransaction::Implementation::countUSRsOfGlobalSymbolKind(SymbolKind symKind) {
+  auto globalKindOpt = getGlobalSymbolKind(symKind);
+  if (!globalKindOpt.hasValue())
+    return 0;
+  GlobalSymbolKind globalKind = globalKindOpt.getValue();
+
+  auto &db = DBase->impl();
+  auto cursor = lmdb::cursor::open(Txn, db.getDBIUSRsByGlobalSymbolKind());
+  lmdb::val key{&globalKind, sizeof(globalKind)};
+  lmdb::val value{};
+  bool found = cursorGet(cursor, key, value, MDB_SET_KEY);
+  if (!found)
+    return 0;
+  return cursor.count();
+}
+
 bool ReadTransaction::Implementation::foreachUSROfGlobalUnitTestSymbol(function_ref<bool(ArrayRef<IDCode> usrCodes)> receiver) {
   bool cont = foreachUSROfGlobalSymbolKind(GlobalSymbolKind::TestClassOrExtension, receiver);
   if (cont) {
@@ -295,11 +371,11 @@ bool ReadTransaction::Implementation::foreachUSROfGlobalSymbolKind(GlobalSymbolK
   auto cursor = lmdb::cursor::open(Txn, db.getDBIUSRsByGlobalSymbolKind());
   lmdb::val key{&globalKind, sizeof(globalKind)};
   lmdb::val value{};
-  bool found = cursor.get(key, value, MDB_SET_KEY);
+  bool found = cursorGet(cursor, key, value, MDB_SET_KEY);
   if (!found)
     return true;
 
-  return passMultipleIDCodes(cursor, key, value, receiver);
+  return passMultipleIDCodes(cursor, key, value, Cancel, receiver);
 }
 
 bool ReadTransaction::Implementation::findUSRsWithNameContaining(StringRef pattern,
@@ -312,12 +388,14 @@ bool ReadTransaction::Implementation::findUSRsWithNameContaining(StringRef patte
 
   lmdb::val key{};
   lmdb::val value{};
-  while (cursor.get(key, value, MDB_NEXT_NODUP)) {
+  while (cursorGet(cursor, key, value, MDB_NEXT_NODUP)) {
+    if (Cancel.isCancelled())
+      return false;
     StringRef name{key.data(), key.size()};
     if (!matchesPattern(name, pattern, anchorStart, anchorEnd, subsequence, ignoreCase))
       continue;
 
-    if (!passMultipleIDCodes(cursor, key, value, receiver))
+    if (!passMultipleIDCodes(cursor, key, value, Cancel, receiver))
       return false;
   }
   return true;
@@ -331,11 +409,11 @@ bool ReadTransaction::Implementation::foreachUSRBySymbolName(StringRef name,
 
   lmdb::val key{name};
   lmdb::val value{};
-  bool found = cursor.get(key, value, MDB_SET_KEY);
+  bool found = cursorGet(cursor, key, value, MDB_SET_KEY);
   if (!found)
     return true;
 
-  return passMultipleIDCodes(cursor, key, value, receiver);
+  return passMultipleIDCodes(cursor, key, value, Cancel, receiver);
 }
 
 bool ReadTransaction::Implementation::foreachSymbolName(function_ref<bool(StringRef name)> receiver) {
@@ -345,7 +423,9 @@ bool ReadTransaction::Implementation::foreachSymbolName(function_ref<bool(String
 
   lmdb::val key{};
   lmdb::val value{};
-  while (cursor.get(key, value, MDB_NEXT_NODUP)) {
+  while (cursorGet(cursor, key, value, MDB_NEXT_NODUP)) {
+    if (Cancel.isCancelled())
+      return false;
     StringRef name{key.data(), key.size()};
     if (!receiver(name))
       return false;
@@ -363,7 +443,9 @@ bool ReadTransaction::Implementation::findFilenamesContaining(StringRef pattern,
 
   lmdb::val key{};
   lmdb::val value{};
-  while (cursor.get(key, value, MDB_NEXT)) {
+  while (cursorGet(cursor, key, value, MDB_NEXT)) {
+    if (Cancel.isCancelled())
+      return false;
     IDCode dirCode;
     StringRef fileName;
     std::tie(dirCode, fileName) = decomposeFilePathValue(value);
@@ -393,7 +475,7 @@ bool ReadTransaction::Implementation::getFullFilePathFromCode(IDCode filePathCod
 
   lmdb::val key{&filePathCode, sizeof(filePathCode)};
   lmdb::val value{};
-  bool found = dbiFilenames.get(Txn, key, value);
+  bool found = dbiGet(dbiFilenames, Txn, key, value);
   if (!found)
     return false;
 
@@ -421,7 +503,7 @@ std::string ReadTransaction::Implementation::getUnitFileIdentifierFromCode(IDCod
 CanonicalFilePathRef ReadTransaction::Implementation::getDirectoryFromCode(IDCode dirCode) {
   lmdb::val key{&dirCode, sizeof(dirCode)};
   lmdb::val value{};
-  if (!DBase->impl().getDBIDirNameByCode().get(Txn, key, value)) {
+  if (!dbiGet(DBase->impl().getDBIDirNameByCode(), Txn, key, value)) {
     LOG_WARN_FUNC("directory code not found");
     return CanonicalFilePathRef();
   }
@@ -434,7 +516,9 @@ bool ReadTransaction::Implementation::foreachDirPath(llvm::function_ref<bool(Can
 
   lmdb::val key{};
   lmdb::val value{};
-  while (cursor.get(key, value, MDB_NEXT)) {
+  while (cursorGet(cursor, key, value, MDB_NEXT)) {
+    if (Cancel.isCancelled())
+      return false;
     StringRef dirPath(value.data(), value.size());
     if (!receiver(CanonicalFilePathRef::getAsCanonicalPath(dirPath)))
       return false;
@@ -463,6 +547,8 @@ bool ReadTransaction::Implementation::findFilePathsWithParentPaths(ArrayRef<Cano
   auto filePathCodesReceiver = [&](ArrayRef<IDCode> codes) -> bool {
     SmallString<256> pathBuf;
     for (IDCode pathCode : codes) {
+      if (Cancel.isCancelled())
+        return false;
       pathBuf.clear();
       {
         llvm::raw_svector_ostream OS(pathBuf);
@@ -480,10 +566,10 @@ bool ReadTransaction::Implementation::findFilePathsWithParentPaths(ArrayRef<Cano
     IDCode dirCode = getFilePathCode(CanonicalFilePathRef::getAsCanonicalPath(parentPath));
     lmdb::val key{&dirCode, sizeof(dirCode)};
     lmdb::val value{};
-    bool found = cursor.get(key, value, MDB_SET_KEY);
+    bool found = cursorGet(cursor, key, value, MDB_SET_KEY);
     if (!found)
       continue;
-    bool cont = passMultipleIDCodes(cursor, key, value, filePathCodesReceiver);
+    bool cont = passMultipleIDCodes(cursor, key, value, Cancel, filePathCodesReceiver);
     if (!cont)
       return false;
   }
@@ -509,7 +595,7 @@ bool ReadTransaction::Implementation::getFilePathFromValue(lmdb::val &filePathVa
 
   lmdb::val key{&dirCode, sizeof(dirCode)};
   lmdb::val value{};
-  bool found = dbiDirNames.get(Txn, key, value);
+  bool found = dbiGet(dbiDirNames, Txn, key, value);
   if (found)
     OS << StringRef(value.data(), value.size());
   OS << llvm::sys::path::get_separator();
@@ -542,17 +628,60 @@ UnitInfo ReadTransaction::Implementation::getUnitInfo(StringRef unitName) {
   return getUnitInfo(makeIDCodeFromString(unitName));
 }
 
+bool ReadTransaction::Implementation::foreachUnitInfo(function_ref<bool(const UnitInfo &unitInfo)> receiver) {
+  auto &db = DBase->impl();
+  auto cursor = lmdb::cursor::open(Txn, db.getDBIUnitInfoByCode());
+
+  lmdb::val key{};
+  lmdb::val value{};
+  while (cursorGet(cursor, key, value, MDB_NEXT)) {
+    if (Cancel.isCancelled())
+      return false;
+    IDCode unitCode = *(IDCode*)key.data();
+    if (!receiver(Database::Implementation::getUnitInfoFromData(unitCode, value)))
+      return false;
+  }
+  return true;
+}
+
+bool ReadTransaction::Implementation::foreachPolledUnit(function_ref<bool(StringRef unitName, llvm::sys::TimePoint<> modTime)> receiver) {
+  auto &db = DBase->impl();
+  auto cursor = lmdb::cursor::open(Txn, db.getDBIPolledUnitsByCode());
+
+  lmdb::val key{};
+  lmdb::val value{};
+  while (cursorGet(cursor, key, value, MDB_NEXT)) {
+    PolledUnitData data;
+    memcpy(&data, value.data(), sizeof(data));
+    StringRef unitName(value.data() + sizeof(data), value.size() - sizeof(data));
+    llvm::sys::TimePoint<> modTime{std::chrono::nanoseconds(data.NanoTime)};
+    if (!receiver(unitName, modTime))
+      return false;
+  }
+  return true;
+}
+
+Optional<llvm::sys::TimePoint<>> ReadTransaction::Implementation::getPolledUnitsGeneration() {
+  lmdb::val key{PolledUnitsGenerationKey, strlen(PolledUnitsGenerationKey)};
+  lmdb::val value{};
+  if (!dbiGet(DBase->impl().getDBIStoreState(), Txn, key, value))
+    return None;
+  uint64_t nanoTime;
+  memcpy(&nanoTime, value.data(), sizeof(nanoTime));
+  return llvm::sys::TimePoint<>(std::chrono::nanoseconds(nanoTime));
+}
+
 bool ReadTransaction::Implementation::foreachUnitContainingFile(IDCode filePathCode,
                                                                 llvm::function_ref<bool(ArrayRef<IDCode> unitCodes)> receiver) {
   auto &db = DBase->impl();
   auto cursor = lmdb::cursor::open(Txn, db.getDBIUnitByFileDependency());
   lmdb::val key{&filePathCode, sizeof(filePathCode)};
   lmdb::val value{};
-  bool found = cursor.get(key, value, MDB_SET_KEY);
+  bool found = cursorGet(cursor, key, value, MDB_SET_KEY);
   if (!found)
     return true;
 
-  return passMultipleIDCodes(cursor, key, value, receiver);
+  return passMultipleIDCodes(cursor, key, value, Cancel, receiver);
 }
 
 LLVM_DUMP_METHOD void ReadTransaction::Implementation::dumpUnitByFilePair() {
@@ -562,7 +691,7 @@ LLVM_DUMP_METHOD void ReadTransaction::Implementation::dumpUnitByFilePair() {
 
   lmdb::val key{};
   lmdb::val value{};
-  while (cursor.get(key, value, MDB_NEXT)) {
+  while (cursorGet(cursor, key, value, MDB_NEXT)) {
     IDCode filePathCode = *(IDCode*)key.data();
     IDCode unitCode = *(IDCode*)value.data();
 
@@ -578,18 +707,18 @@ bool ReadTransaction::Implementation::foreachUnitContainingUnit(IDCode unitCode,
   auto cursor = lmdb::cursor::open(Txn, db.getDBIUnitByUnitDependency());
   lmdb::val key{&unitCode, sizeof(unitCode)};
   lmdb::val value{};
-  bool found = cursor.get(key, value, MDB_SET_KEY);
+  bool found = cursorGet(cursor, key, value, MDB_SET_KEY);
   if (!found)
     return true;
 
-  return passMultipleIDCodes(cursor, key, value, receiver);
+  return passMultipleIDCodes(cursor, key, value, Cancel, receiver);
 }
 
 void ReadTransaction::Implementation::collectRootUnits(
                              IDCode unitCode,
                              SmallVectorImpl<UnitInfo> &rootUnits,
                              std::unordered_set<IDCode> &visited) {
-  if (visited.count(unitCode))
+  if (visited.count(unitCode) || Cancel.isCancelled())
     return;
   visited.insert(unitCode);
 
@@ -620,6 +749,8 @@ bool ReadTransaction::Implementation::foreachRootUnitOfFile(IDCode pathCode,
     }
     return true;
   });
+  if (Cancel.isCancelled())
+    return false;
 
   for (auto &root : rootUnits) {
     if (!receiver(root))
@@ -633,6 +764,8 @@ bool ReadTransaction::Implementation::foreachRootUnitOfUnit(IDCode unitCode,
   SmallVector<UnitInfo, 32> rootUnits;
   std::unordered_set<IDCode> visited;
   collectRootUnits(unitCode, rootUnits, visited);
+  if (Cancel.isCancelled())
+    return false;
 
   for (auto &root : rootUnits) {
     if (!receiver(root))
@@ -648,11 +781,15 @@ void ReadTransaction::Implementation::getDirectDependentUnits(IDCode unitCode, S
   });
 }
 
-ReadTransaction::ReadTransaction(DatabaseRef dbase)
-  : Impl(new Implementation(std::move(dbase))) {}
+ReadTransaction::ReadTransaction(DatabaseRef dbase, CancellationTokenRef cancelToken)
+  : Impl(new Implementation(std::move(dbase), std::move(cancelToken))) {}
 
 ReadTransaction::~ReadTransaction() {}
 
+bool ReadTransaction::isCancelled() const {
+  return Impl->isCancelled();
+}
+
 bool ReadTransaction::lookupProvidersForUSR(StringRef USR, SymbolRoleSet roles, SymbolRoleSet relatedRoles,
                                             llvm::function_ref<bool(IDCode provider, SymbolRoleSet roles, SymbolRoleSet relatedRoles)> receiver) {
   return Impl->lookupProvidersForUSR(USR, roles, relatedRoles, std::move(receiver));
@@ -663,6 +800,12 @@ bool ReadTransaction::lookupProvidersForUSR(IDCode usrCode, SymbolRoleSet roles,
   return Impl->lookupProvidersForUSR(usrCode, roles, relatedRoles, std::move(receiver));
 }
 
+bool ReadTransaction::lookupProviderOccurrenceCountsForUSR(IDCode usrCode, SymbolRoleSet roles, SymbolRoleSet relatedRoles,
+    function_ref<bool(IDCode provider, SymbolRoleSet roles, SymbolRoleSet relatedRoles,
+                      Optional<unsigned> occurrenceCount, Optional<unsigned> relatedOccurrenceCount)> receiver) {
+  return Impl->lookupProviderOccurrenceCountsForUSR(usrCode, roles, relatedRoles, std::move(receiver));
+}
+
 StringRef ReadTransaction::getProviderName(IDCode provider) {
   return Impl->getProviderName(provider);
 }
@@ -700,6 +843,10 @@ bool ReadTransaction::foreachUSROfGlobalSymbolKind(SymbolKind symKind, llvm::fun
   return Impl->foreachUSROfGlobalSymbolKind(symKind, std::move(receiver));
 }
 
+size_t ReadTransaction::countUSRsOfGlobalSymbolKind(SymbolKind symKind) {
+  return Impl->countUSRsOfGlobalSymbolKind(symKind);
+}
+
 bool ReadTransaction::foreachUSROfGlobalUnitTestSymbol(llvm::function_ref<bool(ArrayRef<IDCode> usrCodes)> receiver) {
   return Impl->foreachUSROfGlobalUnitTestSymbol(std::move(receiver));
 }
@@ -767,6 +914,18 @@ UnitInfo ReadTransaction::getUnitInfo(StringRef unitName) {
   return Impl->getUnitInfo(unitName);
 }
 
+bool ReadTransaction::foreachUnitInfo(function_ref<bool(const UnitInfo &unitInfo)> receiver) {
+  return Impl->foreachUnitInfo(std::move(receiver));
+}
+
+bool ReadTransaction::foreachPolledUnit(function_ref<bool(StringRef unitName, llvm::sys::TimePoint<> modTime)> receiver) {
+  return Impl->foreachPolledUnit(std::move(receiver));
+}
+
+Optional<llvm::sys::TimePoint<>> ReadTransaction::getPolledUnitsGeneration() {
+  return Impl->getPolledUnitsGeneration();
+}
+
 bool ReadTransaction::foreachUnitContainingFile(IDCode filePathCode,
                                                 llvm::function_ref<bool(ArrayRef<IDCode> unitCodes)> receiver) {
   return Impl->foreachUnitContainingFile(filePathCode, std::move(receiver));
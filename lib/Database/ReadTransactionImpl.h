@@ -33,14 +33,21 @@ class ReadTransaction::Implementation {
   // This needs to be before 'Txn' so that it gets destructed after it.
   ReadTransactionGuard TxnGuard;
   lmdb::txn Txn{nullptr};
+  CancellationTokenRef CancelToken;
+  CancellationCheck Cancel;
 
 public:
-  explicit Implementation(DatabaseRef dbase);
+  Implementation(DatabaseRef dbase, CancellationTokenRef cancelToken);
+
+  bool isCancelled() const { return CancelToken && CancelToken->isCancelled(); }
 
   bool lookupProvidersForUSR(StringRef USR, SymbolRoleSet roles, SymbolRoleSet relatedRoles,
                              llvm::function_ref<bool(IDCode provider, SymbolRoleSet roles, SymbolRoleSet relatedRoles)> receiver);
   bool lookupProvidersForUSR(IDCode usrCode, SymbolRoleSet roles, SymbolRoleSet relatedRoles,
                              llvm::function_ref<bool(IDCode provider, SymbolRoleSet roles, SymbolRoleSet relatedRoles)> receiver);
+  bool lookupProviderOccurrenceCountsForUSR(IDCode usrCode, SymbolRoleSet roles, SymbolRoleSet relatedRoles,
+    function_ref<bool(IDCode provider, SymbolRoleSet roles, SymbolRoleSet relatedRoles,
+                      Optional<unsigned> occurrenceCount, Optional<unsigned> relatedOccurrenceCount)> receiver);
 
   IDCode getUSRCode(StringRef USR);
   IDCode getProviderCode(StringRef providerName);
@@ -62,6 +69,7 @@ public:
   bool foreachUSROfGlobalSymbolKind(SymbolKind symKind, llvm::function_ref<bool(ArrayRef<IDCode> usrCodes)> receiver);
   bool foreachUSROfGlobalUnitTestSymbol(llvm::function_ref<bool(ArrayRef<IDCode> usrCodes)> receiver);
   bool foreachUSROfGlobalSymbolKind(GlobalSymbolKind globalSymKind, function_ref<bool(ArrayRef<IDCode> usrCodes)> receiver);
+  size_t countUSRsOfGlobalSymbolKind(SymbolKind symKind);
 
   bool findUSRsWithNameContaining(StringRef pattern,
                                   bool anchorStart, bool anchorEnd,
@@ -96,6 +104,9 @@ public:
   UnitInfo getUnitInfo(IDCode unitCode);
   /// UnitInfo.UnitName will be empty if \c unit was not found. UnitInfo.UnitCode is always filled out.
   UnitInfo getUnitInfo(StringRef unitName);
+  bool foreachUnitInfo(function_ref<bool(const UnitInfo &unitInfo)> receiver);
+  bool foreachPolledUnit(function_ref<bool(StringRef unitName, llvm::sys::TimePoint<> modTime)> receiver);
+  Optional<llvm::sys::TimePoint<>> getPolledUnitsGeneration();
   bool foreachUnitContainingFile(IDCode filePathCode,
                                  llvm::function_ref<bool(ArrayRef<IDCode> unitCodes)> receiver);
   bool foreachUnitContainingUnit(IDCode unitCode,
@@ -110,6 +121,8 @@ public:
   void dumpUnitByFilePair();
 
 private:
+  bool foreachProviderEntryForUSR(IDCode usrCode, SymbolRoleSet roles, SymbolRoleSet relatedRoles,
+                                  function_ref<bool(const ProviderForUSRData &entry)> receiver);
   std::pair<IDCode, StringRef> decomposeFilePathValue(lmdb::val &filePathValue);
   bool getFilePathFromValue(lmdb::val &filePathValue, raw_ostream &OS);
   CanonicalFilePath getFilePathFromValue(lmdb::val &filePathValue);
@@ -0,0 +1,383 @@
+//===--- Snapshot.cpp -----------------------------------------------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2018 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://swift.org/LICENSE.txt for license information
+// See https://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#include "BulkLoadImpl.h"
+#include "DatabaseImpl.h"
+#include "IndexStoreDB/Database/DatabaseError.h"
+#include "IndexStoreDB/Support/Logging.h"
+#include "IndexStoreDB/Support/Metrics.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include <unordered_map>
+
+using namespace IndexStoreDB;
+using namespace IndexStoreDB::db;
+
+static metrics::Counter NumSnapshotExports("database.snapshot_exports",
+                                           "Snapshots written from a database");
+static metrics::Counter NumSnapshotSeeds("database.snapshot_seeds",
+                                         "Databases created from a snapshot");
+static metrics::Histogram SnapshotCopyLatency("database.snapshot_copy_latency",
+                                              "Time to copy a database to or from a snapshot");
+
+/// Key of the 'store-state' table of a snapshot for the format version of the
+/// database that it was written from.
+static const char SnapshotFormatVersionKey[] = "snapshot-format-version";
+
+namespace {
+
+/// Copies the tables of a database into an empty one, replacing the path
+/// prefixes.
+///
+/// Since the codes of the paths are hashes of the paths, the remapped paths get
+/// new codes, which are replaced in all the tables that refer to them. The
+/// remapped tables are sorted again and written in order, the others are copied
+/// in the order they are in already. Either way the pages of the new database
+/// are filled in order, so it's also compacted.
+class SnapshotCopier {
+  struct RemappedDir {
+    IDCode Code;
+    std::string Path;
+  };
+
+  Database::Implementation &Source;
+  lmdb::txn &SourceTxn;
+  Database::Implementation &Dest;
+  const PathPrefixMap &PrefixMap;
+
+  /// The directories and files whose path changed, by their previous code.
+  std::unordered_map<IDCode, RemappedDir> Dirs;
+  std::unordered_map<IDCode, IDCode> Files;
+  size_t NumEntries = 0;
+
+public:
+  SnapshotCopier(Database::Implementation &source, lmdb::txn &sourceTxn,
+                 Database::Implementation &dest, const PathPrefixMap &prefixMap)
+    : Source(source), SourceTxn(sourceTxn), Dest(dest), PrefixMap(prefixMap) {}
+
+  /// \returns the number of entries written.
+  size_t copy();
+
+private:
+  IDCode mapDir(IDCode dirCode) const {
+    auto found = Dirs.find(dirCode);
+    return found == Dirs.end() ? dirCode : found->second.Code;
+  }
+  IDCode mapFile(IDCode fileCode) const {
+    auto found = Files.find(fileCode);
+    return found == Files.end() ? fileCode : found->second;
+  }
+
+  /// Runs a write transaction of the new database, growing its map if it's
+  /// full.
+  void write(llvm::function_ref<size_t(lmdb::txn &txn)> block);
+
+  void copyTable(lmdb::dbi &sourceDBI, lmdb::dbi &destDBI);
+
+  typedef llvm::function_ref<void(const lmdb::val &key, const lmdb::val &value, BulkLoadBatch &batch)> RemapEntryFn;
+  void remapTable(lmdb::dbi &sourceDBI, RemapEntryFn remapEntry);
+
+  void remapDirectories();
+  void remapFilenames();
+  void remapUnitInfo();
+};
+
+} // anonymous namespace
+
+void SnapshotCopier::write(llvm::function_ref<size_t(lmdb::txn &txn)> block) {
+  unsigned tries = 0;
+  while (true) {
+    try {
+      ++tries;
+      auto txn = lmdb::txn::begin(Dest.getDBEnv());
+      size_t numWritten = block(txn);
+      txn.commit();
+      NumEntries += numWritten;
+      return;
+    } catch (MapFullError err) {
+      // The size of the copy is about the used size of the source, a few
+      // doublings are only needed if a lot of paths got longer.
+      if (tries > 6)
+        throw;
+      Dest.increaseMapSize();
+    }
+  }
+}
+
+void SnapshotCopier::copyTable(lmdb::dbi &sourceDBI, lmdb::dbi &destDBI) {
+  write([&](lmdb::txn &txn) -> size_t {
+    bool isDupSort = destDBI.flags(txn) & MDB_DUPSORT;
+    auto sourceCursor = lmdb::cursor::open(SourceTxn, sourceDBI);
+    auto destCursor = lmdb::cursor::open(txn, destDBI);
+    lmdb::val key;
+    lmdb::val value;
+    size_t numWritten = 0;
+    while (sourceCursor.get(key, value, MDB_NEXT)) {
+      destCursor.put(key, value, isDupSort ? MDB_APPENDDUP : MDB_APPEND);
+      ++numWritten;
+    }
+    return numWritten;
+  });
+}
+
+void SnapshotCopier::remapTable(lmdb::dbi &sourceDBI, RemapEntryFn remapEntry) {
+  BulkLoadBatch batch;
+  {
+    auto cursor = lmdb::cursor::open(SourceTxn, sourceDBI);
+    lmdb::val key;
+    lmdb::val value;
+    while (cursor.get(key, value, MDB_NEXT))
+      remapEntry(key, value, batch);
+  }
+  for (auto &pair : batch.Tables) {
+    write([&](lmdb::txn &txn) -> size_t {
+      return writeBulkLoadTable(txn, pair.second);
+    });
+  }
+}
+
+void SnapshotCopier::remapDirectories() {
+  remapTable(Source.getDBIDirNameByCode(), [&](const lmdb::val &key, const lmdb::val &value, BulkLoadBatch &batch) {
+    IDCode dirCode;
+    memcpy(&dirCode, key.data(), sizeof(dirCode));
+    SmallString<256> newPath;
+    if (!PrefixMap.remap(StringRef(value.data(), value.size()), newPath)) {
+      batch.put(Dest.getDBIDirNameByCode(), key, value, MDB_NOOVERWRITE);
+      return;
+    }
+    IDCode newCode = makeIDCodeFromString(newPath);
+    Dirs[dirCode] = RemappedDir{newCode, newPath.str().str()};
+    batch.put(Dest.getDBIDirNameByCode(), lmdb::val(&newCode, sizeof(newCode)),
+              lmdb::val(newPath.data(), newPath.size()), MDB_NOOVERWRITE);
+  });
+}
+
+void SnapshotCopier::remapFilenames() {
+  // Only the files of the remapped directories get a new path; the file path
+  // is the directory joined with the filename, as it was added.
+  remapTable(Source.getDBIFilenameByCode(), [&](const lmdb::val &key, const lmdb::val &value, BulkLoadBatch &batch) {
+    IDCode dirCode;
+    memcpy(&dirCode, value.data(), sizeof(dirCode));
+    auto found = Dirs.find(dirCode);
+    if (found == Dirs.end()) {
+      batch.put(Dest.getDBIFilenameByCode(), key, value, MDB_NOOVERWRITE);
+      return;
+    }
+
+    IDCode fileCode;
+    memcpy(&fileCode, key.data(), sizeof(fileCode));
+    StringRef filename(value.data() + sizeof(IDCode), value.size() - sizeof(IDCode));
+    SmallString<256> newPath(found->second.Path);
+    llvm::sys::path::append(newPath, filename);
+    IDCode newCode = makeIDCodeFromString(newPath);
+    Files[fileCode] = newCode;
+
+    lmdb::val newKey{&newCode, sizeof(newCode)};
+    char *buf = batch.reserve(Dest.getDBIFilenameByCode(), newKey, value.size(), MDB_NOOVERWRITE);
+    memcpy(buf, &found->second.Code, sizeof(IDCode));
+    memcpy(buf + sizeof(IDCode), filename.data(), filename.size());
+  });
+}
+
+void SnapshotCopier::remapUnitInfo() {
+  remapTable(Source.getDBIUnitInfoByCode(), [&](const lmdb::val &key, const lmdb::val &value, BulkLoadBatch &batch) {
+    char *buf = batch.reserve(Dest.getDBIUnitInfoByCode(), key, value.size(), /*flags=*/0);
+    memcpy(buf, value.data(), value.size());
+
+    UnitInfoData infoData;
+    memcpy(&infoData, buf, sizeof(infoData));
+    infoData.MainFileCode = mapFile(infoData.MainFileCode);
+    infoData.OutFileCode = mapFile(infoData.OutFileCode);
+    infoData.SysrootCode = mapDir(infoData.SysrootCode);
+    memcpy(buf, &infoData, sizeof(infoData));
+
+    char *ptr = buf + sizeof(infoData);
+    IDCode *fileDepends = reinterpret_cast<IDCode *>(ptr);
+    for (uint32_t i = 0; i != infoData.FileDependSize; ++i)
+      fileDepends[i] = mapFile(fileDepends[i]);
+    ptr += sizeof(IDCode) * (infoData.FileDependSize + infoData.UnitDependSize);
+    auto *providers = reinterpret_cast<UnitInfoData::Provider *>(ptr);
+    for (uint32_t i = 0; i != infoData.ProviderDependSize; ++i)
+      providers[i].FileCode = mapFile(providers[i].FileCode);
+  });
+}
+
+size_t SnapshotCopier::copy() {
+  remapDirectories();
+  remapFilenames();
+
+  if (Files.empty() && Dirs.empty()) {
+    copyTable(Source.getDBIFilePathCodesByDir(), Dest.getDBIFilePathCodesByDir());
+    copyTable(Source.getDBIUnitByFileDependency(), Dest.getDBIUnitByFileDependency());
+    copyTable(Source.getDBITimestampedFilesByProvider(), Dest.getDBITimestampedFilesByProvider());
+    copyTable(Source.getDBIUnitInfoByCode(), Dest.getDBIUnitInfoByCode());
+  } else {
+    remapTable(Source.getDBIFilePathCodesByDir(), [&](const lmdb::val &key, const lmdb::val &value, BulkLoadBatch &batch) {
+      IDCode dirCode = mapDir(*key.data<IDCode>());
+      IDCode fileCode = mapFile(*value.data<IDCode>());
+      batch.put(Dest.getDBIFilePathCodesByDir(), lmdb::val(&dirCode, sizeof(dirCode)),
+                lmdb::val(&fileCode, sizeof(fileCode)), MDB_NODUPDATA);
+    });
+    remapTable(Source.getDBIUnitByFileDependency(), [&](const lmdb::val &key, const lmdb::val &value, BulkLoadBatch &batch) {
+      IDCode fileCode = mapFile(*key.data<IDCode>());
+      batch.put(Dest.getDBIUnitByFileDependency(), lmdb::val(&fileCode, sizeof(fileCode)), value, MDB_NODUPDATA);
+    });
+    remapTable(Source.getDBITimestampedFilesByProvider(), [&](const lmdb::val &key, const lmdb::val &value, BulkLoadBatch &batch) {
+      TimestampedFileForProviderData entry;
+      memcpy(&entry, value.data(), sizeof(entry));
+      entry.FileCode = mapFile(entry.FileCode);
+      batch.put(Dest.getDBITimestampedFilesByProvider(), key, lmdb::val(&entry, sizeof(entry)), MDB_NODUPDATA);
+    });
+    remapUnitInfo();
+  }
+
+  copyTable(Source.getDBISymbolProvidersByUSR(), Dest.getDBISymbolProvidersByUSR());
+  copyTable(Source.getDBISymbolProviderNameByCode(), Dest.getDBISymbolProviderNameByCode());
+  copyTable(Source.getDBISymbolProvidersWithTestSymbols(), Dest.getDBISymbolProvidersWithTestSymbols());
+  copyTable(Source.getDBIUSRsBySymbolName(), Dest.getDBIUSRsBySymbolName());
+  copyTable(Source.getDBIUSRsByGlobalSymbolKind(), Dest.getDBIUSRsByGlobalSymbolKind());
+  copyTable(Source.getDBIUnitByUnitDependency(), Dest.getDBIUnitByUnitDependency());
+  copyTable(Source.getDBITargetNameByCode(), Dest.getDBITargetNameByCode());
+  copyTable(Source.getDBIModuleNameByCode(), Dest.getDBIModuleNameByCode());
+  // The polled units and the store state describe the unit files on the
+  // machine of the source, the initial scan finds out about them again.
+
+  LOG_INFO_FUNC(Low, "copied " << NumEntries << " entries, remapped " << Dirs.size()
+                << " directories and " << Files.size() << " files");
+  return NumEntries;
+}
+
+/// Copies the database of \p source into a new one at \p destPath and closes
+/// it. Throws \c lmdb::error on failure.
+static void copyDatabase(Database::Implementation &source, StringRef destPath, uint64_t mapSize,
+                         const PathPrefixMap &prefixMap, bool isSnapshot) {
+  metrics::Histogram::Timer timer(SnapshotCopyLatency);
+  auto dest = std::make_shared<Database::Implementation>();
+  dest->open(destPath, /*readonly=*/false, mapSize);
+  {
+    auto sourceTxn = source.beginReadTransaction();
+    SnapshotCopier(source, sourceTxn, *dest, prefixMap).copy();
+  }
+  if (isSnapshot) {
+    auto txn = lmdb::txn::begin(dest->getDBEnv());
+    uint32_t version = Database::DATABASE_FORMAT_VERSION;
+    lmdb::val key{SnapshotFormatVersionKey, strlen(SnapshotFormatVersionKey)};
+    lmdb::val val{&version, sizeof(version)};
+    dest->getDBIStoreState().put(txn, key, val);
+    txn.commit();
+  }
+  // The environment is opened without syncing the commits.
+  dest->getDBEnv().sync(/*force=*/true);
+}
+
+bool Database::Implementation::exportSnapshot(StringRef destPath, const PathPrefixMap &prefixMap, std::string &error) {
+  SmallString<128> dataPath = destPath;
+  llvm::sys::path::append(dataPath, "data.mdb");
+  if (llvm::sys::fs::exists(dataPath)) {
+    llvm::raw_string_ostream(error) << "a database already exists at '" << destPath << "'";
+    return true;
+  }
+  if (std::error_code ec = llvm::sys::fs::create_directories(destPath)) {
+    llvm::raw_string_ostream(error) << "failed creating directory '" << destPath << "': " << ec.message();
+    return true;
+  }
+
+  try {
+    ReadTransactionScope scope(*this);
+    copyDatabase(*this, destPath, MapSize, prefixMap, /*isSnapshot=*/true);
+  } catch (lmdb::error err) {
+    llvm::sys::fs::remove(dataPath);
+    llvm::raw_string_ostream(error) << "failed exporting snapshot: " << err.description();
+    return true;
+  }
+  // The snapshot is only ever opened by a copy, leave just the data.
+  SmallString<128> lockPath = destPath;
+  llvm::sys::path::append(lockPath, "lock.mdb");
+  llvm::sys::fs::remove(lockPath);
+
+  NumSnapshotExports.add();
+  LOG_INFO_FUNC(High, "exported snapshot to '" << destPath << "'");
+  return false;
+}
+
+bool Database::Implementation::seedFromSnapshot(StringRef dbPath, StringRef snapshotPath,
+                                                const PathPrefixMap &prefixMap, std::string &error) {
+  SmallString<128> versionPath;
+  getVersionedPath(dbPath, versionPath);
+  SmallString<128> savedPath = versionPath;
+  llvm::sys::path::append(savedPath, "saved");
+  if (llvm::sys::fs::exists(savedPath))
+    return false;
+
+  uint64_t snapshotSize = 0;
+  if (std::error_code ec = llvm::sys::fs::file_size(snapshotPath + "/data.mdb", snapshotSize)) {
+    llvm::raw_string_ostream(error) << "failed reading snapshot '" << snapshotPath << "': " << ec.message();
+    return true;
+  }
+
+  // Write the database in a directory of the process, so that it gets
+  // discarded if the process dies before it's complete.
+  SmallString<128> prefixPath;
+  getProcessDirPrefix(versionPath, prefixPath);
+  SmallString<128> uniqueDirPath;
+  if (std::error_code ec = llvm::sys::fs::create_directories(versionPath)) {
+    llvm::raw_string_ostream(error) << "failed creating directory '" << versionPath << "': " << ec.message();
+    return true;
+  }
+  if (std::error_code ec = llvm::sys::fs::createUniqueDirectory(prefixPath, uniqueDirPath)) {
+    llvm::raw_string_ostream(error) << "failed creating directory '" << uniqueDirPath << "': " << ec.message();
+    return true;
+  }
+
+  try {
+    auto snapshot = std::make_shared<Database::Implementation>();
+    snapshot->open(snapshotPath, /*readonly=*/true, snapshotSize);
+
+    uint32_t version = 0;
+    {
+      ReadTransactionScope scope(*snapshot);
+      auto txn = lmdb::txn::begin(snapshot->getDBEnv(), /*parent=*/nullptr, MDB_RDONLY);
+      lmdb::val key{SnapshotFormatVersionKey, strlen(SnapshotFormatVersionKey)};
+      lmdb::val value{};
+      if (snapshot->getDBIStoreState().get(txn, key, value) && value.size() == sizeof(version))
+        memcpy(&version, value.data(), sizeof(version));
+    }
+    if (version != Database::DATABASE_FORMAT_VERSION) {
+      llvm::raw_string_ostream(error) << "snapshot '" << snapshotPath << "' has format version " << version
+                                      << ", expected " << Database::DATABASE_FORMAT_VERSION;
+      llvm::sys::fs::remove_directories(uniqueDirPath);
+      return true;
+    }
+
+    // Start with 64MB, like a new database.
+    uint64_t mapSize = std::max(snapshotSize, uint64_t(64*1024*1024));
+    ReadTransactionScope scope(*snapshot);
+    copyDatabase(*snapshot, uniqueDirPath, mapSize, prefixMap, /*isSnapshot=*/false);
+  } catch (lmdb::error err) {
+    llvm::sys::fs::remove_directories(uniqueDirPath);
+    llvm::raw_string_ostream(error) << "failed reading snapshot '" << snapshotPath << "': " << err.description();
+    return true;
+  }
+
+  if (std::error_code ec = llvm::sys::fs::rename(uniqueDirPath, savedPath)) {
+    // Another process saved its database meanwhile, which is more recent.
+    LOG_INFO_FUNC(High, "failed moving seeded database to 'saved': " << ec.message());
+    llvm::sys::fs::remove_directories(uniqueDirPath);
+    return false;
+  }
+  NumSnapshotSeeds.add();
+  LOG_INFO_FUNC(High, "seeded database from snapshot '" << snapshotPath << "'");
+  return false;
+}
@@ -57,18 +57,21 @@ public:
   bool isKnownFile(CanonicalFilePathRef filePath);
 
   bool foreachMainUnitContainingFile(CanonicalFilePathRef filePath,
-                                 function_ref<bool(const StoreUnitInfo &unitInfo)> receiver);
+                                 function_ref<bool(const StoreUnitInfo &unitInfo)> receiver,
+                                 CancellationTokenRef cancelToken);
 
   bool foreachFileOfUnit(StringRef unitName,
                          bool followDependencies,
-                         function_ref<bool(CanonicalFilePathRef filePath)> receiver);
+                         function_ref<bool(CanonicalFilePathRef filePath)> receiver,
+                         CancellationTokenRef cancelToken);
 
   bool foreachFilenameContainingPattern(StringRef Pattern,
                                         bool AnchorStart,
                                         bool AnchorEnd,
                                         bool Subsequence,
                                         bool IgnoreCase,
-                               function_ref<bool(CanonicalFilePathRef FilePath)> Receiver);
+                               function_ref<bool(CanonicalFilePathRef FilePath)> Receiver,
+                               CancellationTokenRef CancelToken);
 
   bool foreachFileIncludingFile(CanonicalFilePathRef targetPath,
                                 function_ref<bool(CanonicalFilePathRef sourcePath, unsigned line)> Receiver);
@@ -89,21 +92,25 @@ public:
 // FileIndexImpl
 //===----------------------------------------------------------------------===//
 
-static void collectFileDependencies(DatabaseRef dbase,
+/// \returns false if collection stopped because \p cancelToken was cancelled.
+static bool collectFileDependencies(DatabaseRef dbase,
                                     IDCode unitCode,
                                     bool followDependencies,
                                     std::set<std::string> &pathsSet,
-                                    std::unordered_set<IDCode> &visitedUnits) {
+                                    std::unordered_set<IDCode> &visitedUnits,
+                                    const CancellationTokenRef &cancelToken) {
   if (visitedUnits.count(unitCode))
-    return;
+    return true;
   visitedUnits.insert(unitCode);
+  if (cancelToken && cancelToken->isCancelled())
+    return false;
 
   std::vector<IDCode> UnitDepends;
   {
     ReadTransaction reader(dbase);
     auto dbUnit = reader.getUnitInfo(unitCode);
     if (dbUnit.isInvalid())
-      return; // Does not exist.
+      return true; // Does not exist.
 
     auto addPath = [&](IDCode pathCode) {
       std::string pathStr;
@@ -125,8 +132,10 @@ static void collectFileDependencies(DatabaseRef dbase,
   }
 
   for (auto unitDepCode : UnitDepends) {
-    collectFileDependencies(dbase, unitDepCode, followDependencies, pathsSet, visitedUnits);
+    if (!collectFileDependencies(dbase, unitDepCode, followDependencies, pathsSet, visitedUnits, cancelToken))
+      return false;
   }
+  return true;
 }
 
 CanonicalFilePath FileIndexImpl::getCanonicalPath(StringRef Path, StringRef WorkingDir) {
@@ -154,12 +163,13 @@ bool FileIndexImpl::isKnownFile(CanonicalFilePathRef filePath) {
 }
 
 bool FileIndexImpl::foreachMainUnitContainingFile(CanonicalFilePathRef filePath,
-                                              function_ref<bool(const StoreUnitInfo &unitInfo)> receiver) {
+                                              function_ref<bool(const StoreUnitInfo &unitInfo)> receiver,
+                                              CancellationTokenRef cancelToken) {
   std::vector<StoreUnitInfo> unitInfos;
   {
-    ReadTransaction reader(DBase);
+    ReadTransaction reader(DBase, cancelToken);
     IDCode pathCode = reader.getFilePathCode(filePath);
-    reader.foreachRootUnitOfFile(pathCode, [&](const UnitInfo &unitInfo) -> bool {
+    bool cont = reader.foreachRootUnitOfFile(pathCode, [&](const UnitInfo &unitInfo) -> bool {
       unitInfos.resize(unitInfos.size()+1);
       StoreUnitInfo &currUnit = unitInfos.back();
       currUnit.UnitName = unitInfo.UnitName;
@@ -168,6 +178,8 @@ bool FileIndexImpl::foreachMainUnitContainingFile(CanonicalFilePathRef filePath,
       currUnit.OutFileIdentifier = reader.getUnitFileIdentifierFromCode(unitInfo.OutFileCode);
       return true;
     });
+    if (!cont)
+      return false;
   }
 
   for (auto &unit : unitInfos) {
@@ -179,13 +191,15 @@ bool FileIndexImpl::foreachMainUnitContainingFile(CanonicalFilePathRef filePath,
 
 bool FileIndexImpl::foreachFileOfUnit(StringRef unitName,
                                       bool followDependencies,
-                                      function_ref<bool(CanonicalFilePathRef filePath)> receiver) {
+                                      function_ref<bool(CanonicalFilePathRef filePath)> receiver,
+                                      CancellationTokenRef cancelToken) {
   if (unitName.empty())
     return true;
 
   std::set<std::string> pathsSet;
   std::unordered_set<IDCode> visitedUnits;
-  collectFileDependencies(DBase, makeIDCodeFromString(unitName), followDependencies, pathsSet, visitedUnits);
+  if (!collectFileDependencies(DBase, makeIDCodeFromString(unitName), followDependencies, pathsSet, visitedUnits, cancelToken))
+    return false;
 
   for (auto &path : pathsSet) {
     if (!receiver(CanonicalFilePathRef::getAsCanonicalPath(path)))
@@ -199,8 +213,9 @@ bool FileIndexImpl::foreachFilenameContainingPattern(StringRef Pattern,
                                                      bool AnchorEnd,
                                                      bool Subsequence,
                                                      bool IgnoreCase,
-                              function_ref<bool(CanonicalFilePathRef FilePath)> Receiver) {
-  ReadTransaction reader(DBase);
+                              function_ref<bool(CanonicalFilePathRef FilePath)> Receiver,
+                              CancellationTokenRef CancelToken) {
+  ReadTransaction reader(DBase, std::move(CancelToken));
   return reader.findFilenamesContaining(Pattern, AnchorStart, AnchorEnd, Subsequence, IgnoreCase, [&](CanonicalFilePathRef filePath) -> bool {
     return Receiver(filePath);
   });
@@ -295,14 +310,16 @@ bool FilePathIndex::isKnownFile(CanonicalFilePathRef filePath) {
 }
 
 bool FilePathIndex::foreachMainUnitContainingFile(CanonicalFilePathRef filePath,
-                                              function_ref<bool(const StoreUnitInfo &unitInfo)> receiver) {
-  return IMPL->foreachMainUnitContainingFile(filePath, std::move(receiver));
+                                              function_ref<bool(const StoreUnitInfo &unitInfo)> receiver,
+                                              CancellationTokenRef cancelToken) {
+  return IMPL->foreachMainUnitContainingFile(filePath, std::move(receiver), std::move(cancelToken));
 }
 
 bool FilePathIndex::foreachFileOfUnit(StringRef unitName,
                                       bool followDependencies,
-                                      function_ref<bool(CanonicalFilePathRef filePath)> receiver) {
-  return IMPL->foreachFileOfUnit(unitName, followDependencies, std::move(receiver));
+                                      function_ref<bool(CanonicalFilePathRef filePath)> receiver,
+                                      CancellationTokenRef cancelToken) {
+  return IMPL->foreachFileOfUnit(unitName, followDependencies, std::move(receiver), std::move(cancelToken));
 }
 
 bool FilePathIndex::foreachFilenameContainingPattern(StringRef Pattern,
@@ -310,9 +327,11 @@ bool FilePathIndex::foreachFilenameContainingPattern(StringRef Pattern,
                                                 bool AnchorEnd,
                                                 bool Subsequence,
                                                 bool IgnoreCase,
-                              function_ref<bool(CanonicalFilePathRef FilePath)> Receiver) {
+                              function_ref<bool(CanonicalFilePathRef FilePath)> Receiver,
+                              CancellationTokenRef CancelToken) {
   return IMPL->foreachFilenameContainingPattern(Pattern, AnchorStart, AnchorEnd,
-                                  Subsequence, IgnoreCase, std::move(Receiver));
+                                  Subsequence, IgnoreCase, std::move(Receiver),
+                                  std::move(CancelToken));
 }
 
 bool FilePathIndex::foreachFileIncludingFile(CanonicalFilePathRef TargetPath, function_ref<bool (CanonicalFilePathRef, unsigned int)> Receiver) {
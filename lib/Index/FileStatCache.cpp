@@ -0,0 +1,113 @@
+//===--- FileStatCache.cpp ------------------------------------------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2018 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://swift.org/LICENSE.txt for license information
+// See https://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#include "FileStatCache.h"
+#include "IndexStoreDB/Database/Database.h"
+#include "IndexStoreDB/Support/Concurrency.h"
+#include "IndexStoreDB/Support/Metrics.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/FileSystem.h"
+#include <unordered_set>
+
+using namespace IndexStoreDB;
+using namespace IndexStoreDB::db;
+using namespace IndexStoreDB::index;
+using namespace llvm;
+
+static metrics::Counter NumFileStats("stat.files",
+                                     "Files stat'd for the out-of-date checks of units");
+static metrics::Counter NumFileStatCacheHits("stat.cache_hits",
+                                             "Modification times of files answered from the cache of a scan");
+
+/// Batches with fewer files to stat are stat'd serially.
+static const size_t FilesPerChunk = 16;
+
+sys::TimePoint<> FileStatCache::statModTime(StringRef filePath) {
+  sys::fs::file_status fileStat;
+  std::error_code EC = sys::fs::status(filePath, fileStat);
+  sys::TimePoint<> modTime = sys::TimePoint<>::min();
+  if (sys::fs::status_known(fileStat) && fileStat.type() == sys::fs::file_type::file_not_found) {
+    // Make a recent time value so that we consider this out-of-date.
+    modTime = std::chrono::system_clock::now();
+  } else if (!EC) {
+    modTime = fileStat.getLastModificationTime();
+  }
+  return modTime;
+}
+
+void FileStatCache::getModTimes(ArrayRef<StringRef> filePaths, MutableArrayRef<sys::TimePoint<>> modTimes) {
+  assert(filePaths.size() == modTimes.size());
+  std::vector<IDCode> codes(filePaths.size());
+  std::vector<bool> cached(filePaths.size());
+  // The first index of each file that needs to be stat'd.
+  std::vector<size_t> missing;
+  size_t numCached = 0;
+  {
+    sys::ScopedLock L(StateMtx);
+    std::unordered_set<IDCode> missingCodes;
+    for (size_t i = 0, e = filePaths.size(); i != e; ++i) {
+      codes[i] = makeIDCodeFromString(filePaths[i]);
+      auto found = ModTimes.find(codes[i]);
+      if (found != ModTimes.end()) {
+        modTimes[i] = found->second;
+        cached[i] = true;
+        ++numCached;
+      } else if (missingCodes.insert(codes[i]).second) {
+        missing.push_back(i);
+      }
+    }
+  }
+  NumFileStats.add(missing.size());
+  NumFileStatCacheHits.add(numCached);
+  if (missing.empty())
+    return;
+
+  std::vector<sys::TimePoint<>> missingTimes(missing.size());
+  if (missing.size() < FilesPerChunk) {
+    for (size_t i = 0, e = missing.size(); i != e; ++i)
+      missingTimes[i] = statModTime(filePaths[missing[i]]);
+  } else {
+    // This is mostly I/O, stat the chunks in parallel.
+    const StringRef *pathsPtr = filePaths.data();
+    const size_t *missingPtr = missing.data();
+    sys::TimePoint<> *timesPtr = missingTimes.data();
+    size_t numMissing = missing.size();
+    size_t numChunks = (numMissing + FilesPerChunk - 1) / FilesPerChunk;
+    WorkQueue::concurrentPerform(numChunks, [&](size_t chunk) {
+      for (size_t i = chunk * FilesPerChunk, e = std::min(i + FilesPerChunk, numMissing); i != e; ++i)
+        timesPtr[i] = statModTime(pathsPtr[missingPtr[i]]);
+    }, WorkQueue::Priority::Low);
+  }
+
+  sys::ScopedLock L(StateMtx);
+  for (size_t i = 0, e = missing.size(); i != e; ++i)
+    ModTimes[codes[missing[i]]] = missingTimes[i];
+  for (size_t i = 0, e = filePaths.size(); i != e; ++i) {
+    if (!cached[i])
+      modTimes[i] = ModTimes[codes[i]];
+  }
+}
+
+std::pair<StringRef, sys::TimePoint<>> FileStatCache::getMostRecentModTime(ArrayRef<StringRef> filePaths) {
+  std::vector<sys::TimePoint<>> modTimes(filePaths.size());
+  getModTimes(filePaths, modTimes);
+
+  sys::TimePoint<> mostRecentTime = sys::TimePoint<>::min();
+  StringRef mostRecentFile;
+  for (size_t i = 0, e = filePaths.size(); i != e; ++i) {
+    if (modTimes[i] > mostRecentTime) {
+      mostRecentTime = modTimes[i];
+      mostRecentFile = filePaths[i];
+    }
+  }
+  return std::make_pair(mostRecentFile, mostRecentTime);
+}
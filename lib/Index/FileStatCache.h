@@ -0,0 +1,55 @@
+//===--- FileStatCache.h ----------------------------------------*- C++ -*-===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2018 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://swift.org/LICENSE.txt for license information
+// See https://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef INDEXSTOREDB_LIB_INDEX_FILESTATCACHE_H
+#define INDEXSTOREDB_LIB_INDEX_FILESTATCACHE_H
+
+#include "IndexStoreDB/Database/IDCode.h"
+#include "IndexStoreDB/Support/LLVM.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Chrono.h"
+#include "llvm/Support/Mutex.h"
+#include <unordered_map>
+
+namespace IndexStoreDB {
+namespace index {
+
+/// Gets the modification times of files for the out-of-date checks of units,
+/// stat'ing the files of a batch in parallel.
+///
+/// The times are cached by the code of the path for the lifetime of the
+/// object, since the units of a scan share most of their files. It should not
+/// outlive the scan, the later changes are reported by the file watcher.
+class FileStatCache {
+  mutable llvm::sys::Mutex StateMtx;
+  std::unordered_map<db::IDCode, llvm::sys::TimePoint<>> ModTimes;
+
+public:
+  /// \returns the modification time of \p filePath, without caching it. A
+  /// file that doesn't exist gets the current time, so that the units that
+  /// depend on it are out of date, and a file that can't be stat'd gets the
+  /// minimum time.
+  static llvm::sys::TimePoint<> statModTime(StringRef filePath);
+
+  /// Sets \p modTimes to the modification times of \p filePaths, in the same
+  /// order.
+  void getModTimes(ArrayRef<StringRef> filePaths, llvm::MutableArrayRef<llvm::sys::TimePoint<>> modTimes);
+
+  /// \returns the most recently modified of \p filePaths and its time.
+  std::pair<StringRef, llvm::sys::TimePoint<>> getMostRecentModTime(ArrayRef<StringRef> filePaths);
+};
+
+} // namespace index
+} // namespace IndexStoreDB
+
+#endif
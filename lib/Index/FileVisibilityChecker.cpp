@@ -12,13 +12,21 @@
 
 #include "FileVisibilityChecker.h"
 #include "IndexStoreDB/Database/ReadTransaction.h"
+#include "IndexStoreDB/Support/MemoryGovernor.h"
+#include "IndexStoreDB/Support/Metrics.h"
 #include "IndexStoreDB/Support/Path.h"
+#include "IndexStoreDB/Support/QueryProfile.h"
 
 using namespace IndexStoreDB;
 using namespace IndexStoreDB::db;
 using namespace IndexStoreDB::index;
 using namespace llvm;
 
+static metrics::Counter NumVisibilityChecks("visibility.checks",
+                                            "Unit visibility checks");
+static metrics::Counter NumVisibilityCacheHits("visibility.cache_hits",
+                                               "Unit visibility checks answered from the visibility cache");
+
 FileVisibilityChecker::FileVisibilityChecker(DatabaseRef dbase,
                                              std::shared_ptr<CanonicalPathCache> canonPathCache,
                                              bool useExplicitOutputUnits)
@@ -65,28 +73,70 @@ void FileVisibilityChecker::addUnitOutFilePaths(ArrayRef<StringRef> filePaths) {
   sys::ScopedLock L(VisibleCacheMtx);
 
   ReadTransaction reader(DBase);
+  bool added = false;
   for (StringRef filePath : filePaths) {
     IDCode pathCode = reader.getUnitFileIdentifierCode(filePath);
-    OutUnitFiles.insert(pathCode);
+    added |= OutUnitFiles.insert(pathCode).second;
   }
-  UnitVisibilityCache.clear();
+  invalidateUnitVisibility(added, /*removedOutFiles=*/false);
 }
 
 void FileVisibilityChecker::removeUnitOutFilePaths(ArrayRef<StringRef> filePaths) {
   sys::ScopedLock L(VisibleCacheMtx);
 
   ReadTransaction reader(DBase);
+  bool removed = false;
   for (StringRef filePath : filePaths) {
     IDCode pathCode = reader.getUnitFileIdentifierCode(filePath);
-    OutUnitFiles.erase(pathCode);
+    removed |= OutUnitFiles.erase(pathCode) != 0;
+  }
+  invalidateUnitVisibility(/*addedOutFiles=*/false, removed);
+}
+
+void FileVisibilityChecker::setUnitOutFilePaths(ArrayRef<StringRef> filePaths) {
+  sys::ScopedLock L(VisibleCacheMtx);
+
+  std::unordered_set<IDCode> outUnitFiles;
+  outUnitFiles.reserve(filePaths.size());
+  ReadTransaction reader(DBase);
+  size_t numKept = 0;
+  for (StringRef filePath : filePaths) {
+    IDCode pathCode = reader.getUnitFileIdentifierCode(filePath);
+    if (outUnitFiles.insert(pathCode).second && OutUnitFiles.count(pathCode))
+      ++numKept;
+  }
+  bool added = numKept != outUnitFiles.size();
+  bool removed = numKept != OutUnitFiles.size();
+  OutUnitFiles = std::move(outUnitFiles);
+  invalidateUnitVisibility(added, removed);
+}
+
+void FileVisibilityChecker::invalidateUnitVisibility(bool addedOutFiles, bool removedOutFiles) {
+  if (!UseExplicitOutputUnits)
+    return;
+  if (addedOutFiles && removedOutFiles) {
+    UnitVisibilityCache.clear();
+    return;
+  }
+  if (!addedOutFiles && !removedOutFiles)
+    return;
+  // A unit without a main file is visible if one of its root units is, so
+  // added output files can only make the invisible ones visible, and removed
+  // ones the visible ones invisible.
+  for (auto it = UnitVisibilityCache.begin(); it != UnitVisibilityCache.end();) {
+    if (it->second == removedOutFiles)
+      it = UnitVisibilityCache.erase(it);
+    else
+      ++it;
   }
-  UnitVisibilityCache.clear();
 }
 
 bool FileVisibilityChecker::isUnitVisible(const db::UnitInfo &unitInfo, db::ReadTransaction &reader) {
   if (unitInfo.isInvalid())
     return false;
 
+  QueryProfile::count(QueryProfile::Counter::VisibilityChecks);
+  NumVisibilityChecks.add();
   sys::ScopedLock L(VisibleCacheMtx);
 
   auto visibleCheck = [&](const db::UnitInfo &unitInfo) -> bool {
@@ -108,6 +158,8 @@ bool FileVisibilityChecker::isUnitVisible(const db::UnitInfo &unitInfo, db::Read
   bool &isVisible = pair.first->second;
   bool isNew = pair.second;
   if (!isNew) {
+    QueryProfile::count(QueryProfile::Counter::VisibilityCacheHits);
+    NumVisibilityCacheHits.add();
     return isVisible;
   }
 
@@ -120,3 +172,13 @@ bool FileVisibilityChecker::isUnitVisible(const db::UnitInfo &unitInfo, db::Read
   });
   return isVisible;
 }
+
+size_t FileVisibilityChecker::getMemoryUsage() const {
+  sys::ScopedLock L(VisibleCacheMtx);
+  return getHashContainerMemoryUsage(UnitVisibilityCache);
+}
+
+void FileVisibilityChecker::clearUnitVisibilityCache() {
+  sys::ScopedLock L(VisibleCacheMtx);
+  std::unordered_map<db::IDCode, bool>().swap(UnitVisibilityCache);
+}
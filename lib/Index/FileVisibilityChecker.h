@@ -54,8 +54,21 @@ public:
 
   void addUnitOutFilePaths(ArrayRef<StringRef> filePaths);
   void removeUnitOutFilePaths(ArrayRef<StringRef> filePaths);
+  /// Replaces the unit output files with \p filePaths.
+  void setUnitOutFilePaths(ArrayRef<StringRef> filePaths);
 
   bool isUnitVisible(const db::UnitInfo &unitInfo, db::ReadTransaction &reader);
+
+  /// \returns the approximate number of bytes used by the visibility cache of
+  /// the units without a main file.
+  size_t getMemoryUsage() const;
+  void clearUnitVisibilityCache();
+
+private:
+  /// Drops the cached visibility of the units without a main file that a
+  /// change of the output files may affect. Must be called with the mutex
+  /// held.
+  void invalidateUnitVisibility(bool addedOutFiles, bool removedOutFiles);
 };
 
 } // namespace index
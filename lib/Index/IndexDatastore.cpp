@@ -11,7 +11,11 @@
 //===----------------------------------------------------------------------===//
 
 #include "IndexDatastore.h"
+#include "FileStatCache.h"
 #include "StoreSymbolRecord.h"
+#include "UnitMonitorTable.h"
+#include "UnitEventQueue.h"
+#include "UnitProcessingScheduler.h"
 #include "IndexStoreDB/Core/Symbol.h"
 #include "IndexStoreDB/Index/FilePathIndex.h"
 #include "IndexStoreDB/Index/SymbolIndex.h"
@@ -24,13 +28,17 @@
 #include "IndexStoreDB/Support/FilePathWatcher.h"
 #include "IndexStoreDB/Support/Path.h"
 #include "IndexStoreDB/Support/Concurrency.h"
+#include "IndexStoreDB/Support/DirectoryScan.h"
 #include "IndexStoreDB/Support/Logging.h"
+#include "IndexStoreDB/Support/MemoryGovernor.h"
+#include "IndexStoreDB/Support/Metrics.h"
 #include "indexstore/IndexStoreCXX.h"
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/StringSet.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/Errc.h"
 #include "llvm/Support/FileSystem.h"
@@ -38,8 +46,7 @@
 #include "llvm/Support/Path.h"
 #include "llvm/Support/raw_ostream.h"
 
-#include <dispatch/dispatch.h>
-#include <Block.h>
+#include <atomic>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -61,72 +68,97 @@ static sys::TimePoint<> toTimePoint(timespec ts) {
   return time;
 }
 
-const static dispatch_qos_class_t unitChangesQOS = QOS_CLASS_UTILITY;
+static metrics::Counter NumUnitsImported("import.units_imported",
+                                         "Units whose data was imported into the database");
+static metrics::Counter NumUnitsUpToDate("import.units_up_to_date",
+                                         "Unit events for units that were already up-to-date in the database");
+static metrics::Counter NumRecordsImported("import.records_imported",
+                                           "Records whose symbols were imported into the database");
+static metrics::Histogram UnitImportLatency("import.unit_latency",
+                                            "Time to process the event of a unit");
+static metrics::Histogram InitialScanFilterLatency("import.initial_scan_filter_latency",
+                                                   "Time to filter out the up-to-date units of an initial scan");
 
-/// Returns a global serial queue for unit processing.
-/// This is useful to avoid doing a lot of parallel CPU and I/O work when opening multiple workspaces.
-static dispatch_queue_t getGlobalQueueForUnitChanges() {
-  static dispatch_queue_t queueForUnitChanges;
-  static dispatch_once_t onceToken = 0;
-  dispatch_once(&onceToken, ^{
-    dispatch_queue_attr_t qosAttribute = dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_SERIAL, unitChangesQOS, 0);
-    queueForUnitChanges = dispatch_queue_create("IndexStoreDB.store.unit.processing", qosAttribute);
-  });
-  return queueForUnitChanges;
-}
+/// Bulk loads are flushed when their staged entries use more memory than this.
+static const size_t MaxBulkLoadStagedBytes = 64 * 1024 * 1024;
 
 namespace {
 
-  class UnitMonitor;
   class UnitProcessingSession;
 
-struct UnitEventInfo {
-  IndexStore::UnitEvent::Kind kind;
-  std::string name;
-  /// Whether this is from the initial unit scan.
-  bool isInitialScan;
-  /// Whether this is an explicit enqueue of a dependency unit for processing, while `UseExplicitOutputUnits` is enabled.
-  bool isDependency;
-
-  UnitEventInfo(IndexStore::UnitEvent::Kind kind, std::string name, bool isInitialScan, bool isDependency = false)
-  : kind(kind), name(std::move(name)), isInitialScan(isInitialScan), isDependency(isDependency) {}
-};
-
 struct PollUnitsState {
   llvm::sys::Mutex pollMtx;
+  /// Whether \c knownUnits and \c generation were loaded from the database.
+  bool restored = false;
   llvm::StringMap<sys::TimePoint<>> knownUnits;
+  /// Modification time of the units directory when \c knownUnits was
+  /// gathered, if it can be trusted to detect changes to the directory.
+  Optional<sys::TimePoint<>> generation;
+  /// Approximate number of bytes used by \c knownUnits, updated by the polls
+  /// so that it can be read while a poll holds \c pollMtx.
+  std::atomic<size_t> memoryUsage{0};
 };
 
 class StoreUnitRepo : public std::enable_shared_from_this<StoreUnitRepo> {
   IndexStoreRef IdxStore;
+  std::string StorePath;
   SymbolIndexRef SymIndex;
   const bool UseExplicitOutputUnits;
   const bool EnableOutOfDateFileWatching;
   std::shared_ptr<IndexSystemDelegate> Delegate;
   std::shared_ptr<CanonicalPathCache> CanonPathCache;
-
+  /// The units are processed in order on this queue, which takes turns with
+  /// the queues of the other indexes of the process.
+  std::shared_ptr<UnitProcessingScheduler::Queue> ProcessingQueue;
+
+  /// Guards \c UnitMonitors and \c PathWatcher, so that the watcher gets the
+  /// directories of the monitors in order.
+  mutable llvm::sys::Mutex MonitorsMtx;
+  UnitMonitorTable UnitMonitors;
   std::shared_ptr<FilePathWatcher> PathWatcher;
 
   PollUnitsState pollUnitsState;
+  /// False while another process writes the shared database; the units are
+  /// imported by that process then.
+  std::atomic<bool> ImportsUnits{true};
 
   mutable llvm::sys::Mutex StateMtx;
-  std::unordered_map<IDCode, std::shared_ptr<UnitMonitor>> UnitMonitorsByCode;
 
-  std::unordered_set<db::IDCode> ExplicitOutputUnitsSet;
+  /// The names of the units of the explicit output files, by unit code.
+  std::unordered_map<db::IDCode, std::string> ExplicitOutputUnits;
+  /// Units that are imported with high priority whenever they change.
+  std::unordered_set<db::IDCode> PrioritizedUnitsSet;
+  /// The queues of the processing sessions, to apply boosts to their pending
+  /// events.
+  std::vector<std::weak_ptr<UnitEventQueue>> EventQueues;
+
+  // These are only accessed from the work of the unit processing queue.
+  /// Imports the units of the initial scan of an empty database.
+  std::shared_ptr<BulkLoad> ActiveBulkLoad;
+  bool CanStartBulkLoad = true;
+  /// Units of the bulk load that were not reported to the delegate yet, their
+  /// data is not visible until the bulk load is flushed.
+  std::vector<StoreUnitInfo> BulkLoadedUnits;
 
 public:
-  StoreUnitRepo(IndexStoreRef IdxStore, SymbolIndexRef SymIndex,
+  StoreUnitRepo(IndexStoreRef IdxStore, StringRef storePath, SymbolIndexRef SymIndex,
                 bool useExplicitOutputUnits, bool enableOutOfDateFileWatching,
                 std::shared_ptr<IndexSystemDelegate> Delegate,
-                std::shared_ptr<CanonicalPathCache> canonPathCache)
+                std::shared_ptr<CanonicalPathCache> canonPathCache,
+                unsigned processingWeight)
   : IdxStore(IdxStore),
+    StorePath(storePath),
     SymIndex(std::move(SymIndex)),
     UseExplicitOutputUnits(useExplicitOutputUnits),
     EnableOutOfDateFileWatching(enableOutOfDateFileWatching),
     Delegate(std::move(Delegate)),
-    CanonPathCache(std::move(canonPathCache)) {
+    CanonPathCache(std::move(canonPathCache)),
+    ProcessingQueue(UnitProcessingScheduler::getShared().createQueue(storePath, processingWeight)) {
   }
 
+  std::shared_ptr<UnitProcessingScheduler::Queue> getProcessingQueue() const { return ProcessingQueue; }
+  UnitProcessingStats getProcessingStats() const { return ProcessingQueue->getStats(); }
+
   void onFilesChange(std::vector<UnitEventInfo> evts,
                      std::shared_ptr<UnitProcessingSession> processSession,
                      function_ref<void(unsigned)> ReportCompleted,
@@ -135,27 +167,118 @@ public:
   /// *For Testing* Poll for any changes to units and wait until they have been registered.
   void pollForUnitChangesAndWait(bool isInitialScan);
 
+  bool importsUnits() const { return ImportsUnits; }
+  void setImportsUnits(bool importsUnits) { ImportsUnits = importsUnits; }
+
+  /// Takes the events of an initial scan of the whole store and returns the
+  /// ones that need to go through the write path: units that are new or whose
+  /// modification time changed, plus removal events for the units of the
+  /// database that are no longer in the store.
+  ///
+  /// Units that are already up-to-date are handled here without a write
+  /// transaction, by reporting them to the delegate and monitoring their files
+  /// on the unit processing queue.
+  ///
+  /// \param evts must list all the units of the store.
+  /// \param statCache the modification times of the files of the scan.
+  std::vector<UnitEventInfo> filterInitialScanEvents(std::vector<UnitEventInfo> evts, bool waitForProcessing,
+                                                     std::shared_ptr<FileStatCache> statCache);
+
   std::shared_ptr<UnitProcessingSession> makeUnitProcessingSession();
 
   void addUnitOutFilePaths(ArrayRef<StringRef> filePaths, bool waitForProcessing);
   void removeUnitOutFilePaths(ArrayRef<StringRef> filePaths, bool waitForProcessing);
+  void setUnitOutFilePaths(ArrayRef<StringRef> filePaths, bool waitForProcessing);
   bool isUnitNameInKnownOutFilePaths(StringRef unitName) const;
 
+  void addEventQueue(std::shared_ptr<UnitEventQueue> queue);
+  /// Raises the priority of the events of prioritized units and of explicit
+  /// output units.
+  void assignEventPriorities(MutableArrayRef<UnitEventInfo> evts) const;
+  /// Moves the pending events of the units of \p filePaths ahead of the other
+  /// pending events. If \p remember is true, the units also get high priority
+  /// when they change later.
+  void prioritizeFiles(ArrayRef<StringRef> filePaths, bool remember);
+  void unprioritizeFiles(ArrayRef<StringRef> filePaths);
+
   void purgeStaleData();
 
-  std::shared_ptr<UnitMonitor> getUnitMonitor(IDCode unitCode) const;
-  void addUnitMonitor(IDCode unitCode, std::shared_ptr<UnitMonitor> monitor);
+  size_t getUnitMonitorsMemoryUsage() const;
+  /// Compacts the monitor table. The monitors themselves hold the out-of-date
+  /// state of the units and are kept.
+  void trimUnitMonitors(MemoryTrimLevel level);
+  size_t getPolledUnitsMemoryUsage() const;
+  /// Drops the snapshot of the polled units, which the next poll reloads from
+  /// the database.
+  void trimPolledUnits(MemoryTrimLevel level);
+
+  /// Starts monitoring the user files of a unit for out-of-date checks,
+  /// replacing its previous monitor. The unit is out of date with the changes
+  /// that its user unit dependencies are out of date with.
+  ///
+  /// \param outOfDateStats if set, the unit is also checked for being out of
+  /// date with the times of its files in the cache.
+  void monitorUnit(IDCode unitCode, StringRef unitName, sys::TimePoint<> modTime,
+                   ArrayRef<CanonicalFilePath> userFileDepends,
+                   ArrayRef<IDCode> userUnitDepends,
+                   FileStatCache *outOfDateStats);
   void removeUnitMonitor(IDCode unitCode);
 
-  void onUnitOutOfDate(IDCode unitCode, StringRef unitName,
-                       OutOfDateFileTriggerRef trigger,
-                       bool synchronous = false);
   void onFSEvent(std::vector<std::string> parentPaths);
   void checkUnitContainingFileIsOutOfDate(StringRef file);
 
 private:
+  struct OutOfDateMark {
+    IDCode UnitCode;
+    OutOfDateFileTriggerRef Trigger;
+  };
+  /// Records the triggers of \p marks for the monitored units that they make
+  /// out of date, reports the units to the delegate and goes on with their
+  /// dependent units, a batch for each level of dependents.
+  void markUnitsOutOfDate(std::vector<OutOfDateMark> marks, bool synchronous);
+  /// Adds the marks for the monitored units of \p unitCodes that a change of
+  /// \p filePath at \p modTime makes out of date. The trigger is only created
+  /// if there are any.
+  void collectOutOfDateMarks(ArrayRef<IDCode> unitCodes, StringRef filePath, sys::TimePoint<> modTime,
+                             std::vector<OutOfDateMark> &marks) const;
+
   void registerUnit(StringRef UnitName, bool isInitialScan, std::shared_ptr<UnitProcessingSession> processSession);
   void removeUnit(StringRef UnitName);
+  void startPathWatcherIfNeeded();
+  /// Runs \p block, growing the database and running it again if the database
+  /// is full.
+  void guardForMapFullError(function_ref<void()> block);
+  /// Writes the entries of the bulk load and reports its units.
+  void flushBulkLoad();
+  /// Flushes the bulk load and goes back to importing one unit per write
+  /// transaction.
+  void finishBulkLoad();
+
+  /// Gets the modification times of \p unitNames in parallel, this is mostly
+  /// I/O. The time of a unit is left unset if it could not be read.
+  void getUnitModificationTimes(ArrayRef<StringRef> unitNames,
+                                MutableArrayRef<Optional<sys::TimePoint<>>> modTimes);
+
+  /// Enqueues the unit dependencies of an imported unit that are not
+  /// registered or are out of date, in explicit output units mode. The
+  /// dependencies that the session already checked are skipped.
+  void enqueueUnitDependenciesNeedingUpdate(ArrayRef<std::string> unitDependencies, bool isInitialScan,
+                                            UnitProcessingSession &processSession);
+
+  /// Reads the names and modification times of all the units of the store.
+  /// \p generation is set if the store layout provides one.
+  void scanUnitModificationTimes(llvm::StringMap<sys::TimePoint<>> &units,
+                                 Optional<sys::TimePoint<>> &generation);
+
+  /// Adds the units whose main file or output file is one of \p filePaths.
+  void collectUnitsOfFiles(ArrayRef<StringRef> filePaths, std::unordered_set<IDCode> &unitCodes);
+
+  /// Starts monitoring the user dependencies of a unit whose data is already
+  /// in the database for out-of-date checks. The dependencies are read from
+  /// the database, without loading the unit file.
+  /// \param outOfDateStats if set, the unit is also checked for being out of
+  /// date with the times of its files in the cache.
+  void monitorImportedUnit(IDCode unitCode, StringRef unitName, sys::TimePoint<> modTime, FileStatCache *outOfDateStats);
 };
 
 class IndexDatastoreImpl {
@@ -164,6 +287,7 @@ class IndexDatastoreImpl {
 
 public:
   bool init(IndexStoreRef idxStore,
+            StringRef storePath,
             SymbolIndexRef SymIndex,
             std::shared_ptr<IndexSystemDelegate> Delegate,
             std::shared_ptr<CanonicalPathCache> CanonPathCache,
@@ -176,49 +300,19 @@ public:
 
   void addUnitOutFilePaths(ArrayRef<StringRef> filePaths, bool waitForProcessing);
   void removeUnitOutFilePaths(ArrayRef<StringRef> filePaths, bool waitForProcessing);
+  void setUnitOutFilePaths(ArrayRef<StringRef> filePaths, bool waitForProcessing);
 
-  void purgeStaleData();
-
-  /// *For Testing* Poll for any changes to units and wait until they have been registered.
-  void pollForUnitChangesAndWait(bool isInitialScan);
-};
-
-class UnitMonitor {
-  std::weak_ptr<StoreUnitRepo> UnitRepo;
-  IDCode UnitCode;
-  std::string UnitName;
-  sys::TimePoint<> ModTime;
-
-  mutable llvm::sys::Mutex StateMtx;
-
-  /// Map of out-of-date file paths to their associated info. Note that the
-  /// StringRef key references the string in the trigger, so must not outlive
-  /// it. Access to this map should be guarded by \c StateMtx.
-  llvm::DenseMap<StringRef, OutOfDateFileTriggerRef> OutOfDateTriggers;
-
-  /// Retrieves an unordered list of out-of-date trigger files.
-  std::vector<OutOfDateFileTriggerRef> getUnorderedOutOfDateTriggers() const;
-
-public:
-  UnitMonitor(std::shared_ptr<StoreUnitRepo> unitRepo);
-
-  void initialize(IDCode unitCode,
-                  StringRef UnitName,
-                  sys::TimePoint<> modTime,
-                  ArrayRef<CanonicalFilePath> userFileDepends,
-                  ArrayRef<IDCode> userUnitDepends,
-                  bool checkForOutOfDate);
+  void prioritizeFiles(ArrayRef<StringRef> filePaths, bool remember);
+  void unprioritizeFiles(ArrayRef<StringRef> filePaths);
 
-  ~UnitMonitor();
+  void purgeStaleData();
 
-  StringRef getUnitName() const { return UnitName; }
-  sys::TimePoint<> getModTime() const { return ModTime; }
+  void addMemoryConsumers(MemoryGovernor &governor);
 
-  void checkForOutOfDate(sys::TimePoint<> outOfDateModTime, StringRef filePath, bool synchronous=false);
-  void markOutOfDate(OutOfDateFileTriggerRef trigger, bool synchronous = false);
+  Optional<UnitProcessingStats> getUnitProcessingStats() const;
 
-  static std::pair<StringRef, sys::TimePoint<>> getMostRecentModTime(ArrayRef<StringRef> filePaths);
-  static sys::TimePoint<> getModTimeForOutOfDateCheck(StringRef filePath);
+  /// *For Testing* Poll for any changes to units and wait until they have been registered.
+  void pollForUnitChangesAndWait(bool isInitialScan);
 };
 
 } // anonymous namespace
@@ -229,54 +323,30 @@ public:
 
 namespace {
 
-/// A thread-safe deque object for UnitEventInfo objects.
-class UnitEventInfoDeque {
-  std::deque<UnitEventInfo> EventsDequeue;
-  mutable llvm::sys::Mutex StateMtx;
-
-public:
-  void addEvents(ArrayRef<UnitEventInfo> evts) {
-    sys::ScopedLock L(StateMtx);
-    EventsDequeue.insert(EventsDequeue.end(), evts.begin(), evts.end());
-  }
-
-  std::vector<UnitEventInfo> popFront(unsigned N) {
-    sys::ScopedLock L(StateMtx);
-    std::vector<UnitEventInfo> evts;
-    for (unsigned i = 0; i < N; ++i) {
-      if (EventsDequeue.empty())
-        break;
-      UnitEventInfo evt = EventsDequeue.front();
-      EventsDequeue.pop_front();
-      evts.push_back(std::move(evt));
-    }
-    return evts;
-  }
-
-  bool hasEnqueuedUnitDependency(StringRef unitName) const {
-    sys::ScopedLock L(StateMtx);
-    for (const auto &evt : EventsDequeue) {
-      if (evt.isDependency && evt.name == unitName)
-        return true;
-    }
-    return false;
-  }
-};
-
 /// Encapsulates state for processing a number of units and handles asynchronous (or synchronous for testing) scheduling.
 class UnitProcessingSession : public std::enable_shared_from_this<UnitProcessingSession> {
-  std::shared_ptr<UnitEventInfoDeque> Deque;
+  std::shared_ptr<UnitEventQueue> Deque;
   std::weak_ptr<StoreUnitRepo> WeakUnitRepo;
   std::shared_ptr<IndexSystemDelegate> Delegate;
+  std::shared_ptr<UnitProcessingScheduler::Queue> ProcessingQueue;
+  /// The modification times of the files checked by the initial scan of the
+  /// session, the units of a scan share most of their files.
+  std::shared_ptr<FileStatCache> StatCache = std::make_shared<FileStatCache>();
+  /// The unit dependencies that the session checked for being up-to-date in
+  /// explicit output units mode, the units share most of their module and PCH
+  /// dependencies.
+  mutable llvm::sys::Mutex CheckedDepsMtx;
+  std::unordered_set<IDCode> CheckedUnitDependencies;
 
   static const unsigned MAX_STORE_EVENTS_TO_PROCESS_PER_WORK_UNIT = 10;
 
 public:
-  UnitProcessingSession(std::shared_ptr<UnitEventInfoDeque> eventsDeque,
+  UnitProcessingSession(std::shared_ptr<UnitEventQueue> eventsDeque,
                         std::weak_ptr<StoreUnitRepo> unitRepo,
-                        std::shared_ptr<IndexSystemDelegate> delegate)
+                        std::shared_ptr<IndexSystemDelegate> delegate,
+                        std::shared_ptr<UnitProcessingScheduler::Queue> processingQueue)
   : Deque(std::move(eventsDeque)), WeakUnitRepo(std::move(unitRepo)),
-    Delegate(std::move(delegate)) {
+    Delegate(std::move(delegate)), ProcessingQueue(std::move(processingQueue)) {
   }
 
   void process(std::vector<UnitEventInfo> evts, bool waitForProcessing) {
@@ -298,32 +368,41 @@ public:
   void enqueue(std::vector<UnitEventInfo> evts) {
     if (evts.empty())
       return;
+    if (auto unitRepo = WeakUnitRepo.lock())
+      unitRepo->assignEventPriorities(evts);
     Delegate->processingAddedPending(evts.size());
-    Deque->addEvents(std::move(evts));
+    // Coalesced events are done as far as the delegate is concerned, the
+    // pending event of their unit is completed separately.
+    if (unsigned numCoalesced = Deque->addEvents(evts))
+      Delegate->processingCompleted(numCoalesced);
   }
 
   bool hasEnqueuedUnitDependency(StringRef unitName) const {
     return Deque->hasEnqueuedUnitDependency(unitName);
   }
 
+  /// Marks the unit dependency as checked by the session.
+  /// \returns false if it was already checked.
+  bool markUnitDependencyChecked(StringRef unitName) {
+    sys::ScopedLock L(CheckedDepsMtx);
+    return CheckedUnitDependencies.insert(makeIDCodeFromString(unitName)).second;
+  }
+
+  bool isIdle() const {
+    return Deque->empty();
+  }
+
+  FileStatCache &getStatCache() const { return *StatCache; }
+  std::shared_ptr<FileStatCache> getStatCachePtr() const { return StatCache; }
+
 private:
   void processUnitsAsync() {
+    // Process the registration events incrementally on the processing queue
+    // of the index, which takes turns with the other indexes of the process.
     auto session = shared_from_this();
-    auto onUnitChangeBlockImpl = ^{
-      // Pass registration events to be processed incrementally by the global serial queue.
-      // This allows intermixing processing of registration events from multiple workspaces.
-      session->processUnitEventsIncrementally(getGlobalQueueForUnitChanges());
-    };
-
-#if defined(__APPLE__)
-    // Create the block with QoS explicitly to ensure that the QoS from the indexstore callback can't affect the onFilesChange priority. This call may do a lot of I/O and we don't want to wedge the system by running at elevated priority.
-    dispatch_block_t onUnitChangeBlock = dispatch_block_create_with_qos_class(DISPATCH_BLOCK_INHERIT_QOS_CLASS, unitChangesQOS, 0, onUnitChangeBlockImpl);
-#else
-    // FIXME: https://bugs.swift.org/browse/SR-10319
-    auto onUnitChangeBlock = Block_copy(onUnitChangeBlockImpl);
-#endif
-    dispatch_async(getGlobalQueueForUnitChanges(), onUnitChangeBlock);
-    Block_release(onUnitChangeBlock);
+    ProcessingQueue->dispatch([session] {
+      session->processUnitEventsIncrementally();
+    });
   }
 
   /// Primarily used for testing.
@@ -338,7 +417,7 @@ private:
         break;
       }
 
-      dispatch_sync(getGlobalQueueForUnitChanges(), ^{
+      ProcessingQueue->dispatchSync([&] {
         unitRepo->onFilesChange(std::move(evts), shared_from_this(), [&](unsigned numCompleted){
           Delegate->processingCompleted(numCompleted);
         }, []{
@@ -351,7 +430,7 @@ private:
   /// Enqueues asynchronous processing of the unit events in an incremental fashion.
   /// Events are queued-up individually and the next event is enqueued only after
   /// the current one has been processed.
-  void processUnitEventsIncrementally(dispatch_queue_t queue) {
+  void processUnitEventsIncrementally() {
     std::vector<UnitEventInfo> poppedEvts = Deque->popFront(MAX_STORE_EVENTS_TO_PROCESS_PER_WORK_UNIT);
     if (poppedEvts.empty())
       return;
@@ -367,9 +446,10 @@ private:
       // FIXME: the database should recover.
     });
 
-    // Enqueue processing the rest of the events.
-    dispatch_async(queue, ^{
-      session->processUnitEventsIncrementally(queue);
+    // Enqueue processing the rest of the events, after the turns of the
+    // other indexes that are waiting.
+    ProcessingQueue->dispatch([session] {
+      session->processUnitEventsIncrementally();
     });
   }
 };
@@ -381,28 +461,6 @@ void StoreUnitRepo::onFilesChange(std::vector<UnitEventInfo> evts,
                                   function_ref<void(unsigned)> ReportCompleted,
                                   function_ref<void()> DirectoryDeleted) {
 
-  auto guardForMapFullError = [&](function_ref<void()> block) {
-    unsigned tries = 0;
-    while (true) {
-      try {
-        ++tries;
-        block();
-        break;
-      } catch (db::MapFullError err) {
-        // If we hit the map size limit try again but only for a limited number of times.
-        if (tries > 6) {
-          // If it still fails after doubling the map size 6 times then something is going
-          // wrong so give up. The value 6 was obtained by taking the largest known single
-          // unit, which required 5 doublings, and adding 1 for margin of error.
-          LOG_WARN("guardForMapFullError", "Still MDB_MAP_FULL error after increasing map size, tries: " << tries);
-          throw;
-        }
-        SymIndex->getDBase()->increaseMapSize();
-        // Try again.
-      }
-    }
-  };
-
   auto shouldIgnore = [&](const UnitEventInfo &evt) -> bool {
     if (!UseExplicitOutputUnits)
       return false;
@@ -411,7 +469,13 @@ void StoreUnitRepo::onFilesChange(std::vector<UnitEventInfo> evts,
     return !isUnitNameInKnownOutFilePaths(evt.name);
   };
 
-  for (const auto &evt : evts) {
+  for (size_t i = 0, e = evts.size(); i != e; ++i) {
+    const auto &evt = evts[i];
+    bool isInitialImport = evt.isInitialScan &&
+      (evt.kind == IndexStore::UnitEvent::Kind::Added || evt.kind == IndexStore::UnitEvent::Kind::Modified);
+    if (ActiveBulkLoad && !isInitialImport)
+      finishBulkLoad();
+
     guardForMapFullError([&]{
       switch (evt.kind) {
       case IndexStore::UnitEvent::Kind::Added:
@@ -429,12 +493,61 @@ void StoreUnitRepo::onFilesChange(std::vector<UnitEventInfo> evts,
       }
     });
 
-    ReportCompleted(1);
+    // Make the data visible before the session reports that it's done.
+    if (ActiveBulkLoad && i + 1 == e && processSession->isIdle())
+      finishBulkLoad();
+  }
+
+  // Reported together rather than for each event, the delegate only tracks
+  // the progress.
+  ReportCompleted(evts.size());
+  startPathWatcherIfNeeded();
+}
+
+void StoreUnitRepo::guardForMapFullError(function_ref<void()> block) {
+  unsigned tries = 0;
+  while (true) {
+    try {
+      ++tries;
+      block();
+      break;
+    } catch (db::MapFullError err) {
+      // If we hit the map size limit try again but only for a limited number of times.
+      if (tries > 6) {
+        // If it still fails after doubling the map size 6 times then something is going
+        // wrong so give up. The value 6 was obtained by taking the largest known single
+        // unit, which required 5 doublings, and adding 1 for margin of error.
+        LOG_WARN("guardForMapFullError", "Still MDB_MAP_FULL error after increasing map size, tries: " << tries);
+        throw;
+      }
+      SymIndex->getDBase()->increaseMapSize();
+      // Try again.
+    }
   }
+}
+
+void StoreUnitRepo::flushBulkLoad() {
+  guardForMapFullError([&]{
+    ActiveBulkLoad->flush();
+  });
+  std::vector<StoreUnitInfo> units = std::move(BulkLoadedUnits);
+  BulkLoadedUnits.clear();
+  if (Delegate && !units.empty())
+    Delegate->processedStoreUnits(units);
+}
+
+void StoreUnitRepo::finishBulkLoad() {
+  flushBulkLoad();
+  ActiveBulkLoad.reset();
+}
 
+void StoreUnitRepo::startPathWatcherIfNeeded() {
   // Can't just initialize this in the constructor because 'shared_from_this()'
   // cannot be called from a constructor.
-  if (EnableOutOfDateFileWatching && !PathWatcher) {
+  if (!EnableOutOfDateFileWatching)
+    return;
+  sys::ScopedLock L(MonitorsMtx);
+  if (!PathWatcher) {
     std::weak_ptr<StoreUnitRepo> weakUnitRepo = shared_from_this();
     auto pathEventsReceiver = [weakUnitRepo](std::vector<std::string> paths) {
       if (auto unitRepo = weakUnitRepo.lock()) {
@@ -442,6 +555,8 @@ void StoreUnitRepo::onFilesChange(std::vector<UnitEventInfo> evts,
       }
     };
     PathWatcher = std::make_shared<FilePathWatcher>(std::move(pathEventsReceiver));
+    // The units that were monitored so far.
+    PathWatcher->addDirectories(UnitMonitors.getDirectories());
   }
 }
 
@@ -482,10 +597,22 @@ void StoreUnitRepo::registerUnit(StringRef unitName, bool isInitialScan, std::sh
 
   SmallVector<std::string, 16> unitDependencies;
 
+  // The units of the initial scan of an empty database are bulk loaded. A unit
+  // that was already part of the bulk load gets updated the regular way.
+  if (ActiveBulkLoad && ActiveBulkLoad->containsUnit(makeIDCodeFromString(unitName)))
+    finishBulkLoad();
+  if (CanStartBulkLoad && isInitialScan && !UseExplicitOutputUnits) {
+    CanStartBulkLoad = false;
+    ActiveBulkLoad = BulkLoad::create(SymIndex->getDBase());
+  }
+  BulkLoad *bulk = isInitialScan ? ActiveBulkLoad.get() : nullptr;
+
   // Returns true if an error occurred.
   auto importUnit = [&]() -> bool {
-    ImportTransaction import(SymIndex->getDBase());
+    metrics::Histogram::Timer timer(UnitImportLatency);
+    ImportTransaction import(SymIndex->getDBase(), bulk);
     UnitDataImport unitImport(import, unitName, unitModTime);
+    assert((!bulk || unitImport.isMissing()) && "bulk loading a unit of the database");
     unitCode = unitImport.getUnitCode();
     needDatabaseUpdate = !unitImport.isUpToDate();
     optIsSystem = unitImport.getIsSystem();
@@ -493,6 +620,7 @@ void StoreUnitRepo::registerUnit(StringRef unitName, bool isInitialScan, std::sh
       PrevMainFileCode = unitImport.getPrevMainFileCode();
       PrevOutFileCode = unitImport.getPrevOutFileCode();
       PrevHasTestSymbols = unitImport.getHasTestSymbols();
+      NumUnitsUpToDate.add();
       return false;
     }
 
@@ -566,12 +694,13 @@ void StoreUnitRepo::registerUnit(StringRef unitName, bool isInitialScan, std::sh
           }
 
           SymIndex->importSymbols(import, Rec);
+          NumRecordsImported.add();
           break;
         }
 
         case IndexUnitDependency::DependencyKind::Unit: {
           unitDependencies.push_back(dep.Name);
-          IDCode unitDepCode = unitImport.addUnitDependency(dep.Name);
+          IDCode unitDepCode = unitImport.addUnitDependency(dep.Name, dep.IsSystem);
           if (!dep.IsSystem)
             UserUnitDepends.push_back(unitDepCode);
           break;
@@ -584,7 +713,7 @@ void StoreUnitRepo::registerUnit(StringRef unitName, bool isInitialScan, std::sh
 
           if (!dep.IsSystem)
             UserFileDepends.push_back(CanonPath);
-          unitImport.addFileDependency(CanonPath);
+          unitImport.addFileDependency(CanonPath, dep.IsSystem);
         }
       }
     }
@@ -592,6 +721,7 @@ void StoreUnitRepo::registerUnit(StringRef unitName, bool isInitialScan, std::sh
     unitImport.commit();
     StoreUnitInfoOpt = StoreUnitInfo{unitName, CanonMainFile, OutFileIdentifier, unitImport.getHasTestSymbols().getValue(), unitModTime};
     import.commit();
+    NumUnitsImported.add();
     return false;
   };
 
@@ -605,43 +735,19 @@ void StoreUnitRepo::registerUnit(StringRef unitName, bool isInitialScan, std::sh
       std::string outFileIdentifier = reader.getUnitFileIdentifierFromCode(PrevOutFileCode);
       StoreUnitInfoOpt = StoreUnitInfo{unitName, mainFile, outFileIdentifier, PrevHasTestSymbols.getValue(), unitModTime};
     }
-    Delegate->processedStoreUnit(StoreUnitInfoOpt.getValue());
+    if (bulk)
+      BulkLoadedUnits.push_back(StoreUnitInfoOpt.getValue());
+    else
+      Delegate->processedStoreUnit(StoreUnitInfoOpt.getValue());
   }
+  if (bulk && bulk->getStagedBytes() > MaxBulkLoadStagedBytes)
+    flushBulkLoad();
 
   if (UseExplicitOutputUnits) {
     // Unit dependencies, like PCH/modules, are not included in the explicit list,
     // make sure to process them as we find them.
     // We do this after finishing processing the dependent unit to avoid nested write transactions.
-    std::vector<UnitEventInfo> unitsNeedingUpdate;
-    {
-      ReadTransaction reader(SymIndex->getDBase());
-
-      auto needsUpdate = [&](StringRef unitName) -> bool {
-        if (processSession->hasEnqueuedUnitDependency(unitName)) {
-          // Avoid enqueuing the same dependency from multiple dependents.
-          return false;
-        }
-        UnitInfo info = reader.getUnitInfo(unitName);
-        if (info.isInvalid()) {
-          return true; // not registered yet.
-        }
-        std::string error;
-        auto optModTime = IdxStore->getUnitModificationTime(unitName, error);
-        if (!optModTime) {
-          LOG_WARN_FUNC("error getting mod time for unit '" << unitName << "':" << error);
-          return false;
-        }
-        auto unitModTime = toTimePoint(optModTime.getValue());
-        return info.ModTime != unitModTime;
-      };
-
-      for (const auto &unitName : unitDependencies) {
-        if (needsUpdate(unitName)) {
-          unitsNeedingUpdate.push_back(UnitEventInfo(IndexStore::UnitEvent::Kind::Added, unitName, isInitialScan, /*isDependency=*/true));
-        }
-      }
-    }
-    processSession->enqueue(std::move(unitsNeedingUpdate));
+    enqueueUnitDependenciesNeedingUpdate(unitDependencies, isInitialScan, *processSession);
   }
 
 
@@ -650,37 +756,85 @@ void StoreUnitRepo::registerUnit(StringRef unitName, bool isInitialScan, std::sh
 
   // Monitor user files of the unit.
 
-  // Get the user files if we didn't already go through them earlier.
+  // Get the user files from the database if we didn't already go through them
+  // earlier.
+  FileStatCache *outOfDateStats = isInitialScan ? &processSession->getStatCache() : nullptr;
   if (!needDatabaseUpdate) {
-    auto &Reader = getUnitReader();
-    if (Reader.isInvalid())
-      return;
+    monitorImportedUnit(unitCode, unitName, unitModTime, outOfDateStats);
+    return;
+  }
 
-    StringRef WorkDir = Reader.getWorkingDirectory();
-    Reader.foreachDependency([&](IndexUnitDependency Dep)->bool {
-      switch (Dep.getKind()) {
-        case IndexUnitDependency::DependencyKind::Unit:
-          if (!Dep.isSystem())
-            UserUnitDepends.push_back(makeIDCodeFromString(Dep.getName()));
-          break;
-        case IndexUnitDependency::DependencyKind::Record:
-        case IndexUnitDependency::DependencyKind::File: {
-          CanonicalFilePath CanonPath = CanonPathCache->getCanonicalPath(Dep.getFilePath(), WorkDir);
-          if (CanonPath.empty())
-            break;
+  monitorUnit(unitCode, unitName, unitModTime, UserFileDepends, UserUnitDepends, outOfDateStats);
+}
 
-          if (!Dep.isSystem())
-            UserFileDepends.push_back(CanonPath);
-        }
+void StoreUnitRepo::enqueueUnitDependenciesNeedingUpdate(ArrayRef<std::string> unitDependencies, bool isInitialScan,
+                                                         UnitProcessingSession &processSession) {
+  std::vector<StringRef> unitsToCheck;
+  for (const std::string &unitName : unitDependencies) {
+    // Avoid enqueuing the same dependency from multiple dependents.
+    if (processSession.hasEnqueuedUnitDependency(unitName))
+      continue;
+    if (processSession.markUnitDependencyChecked(unitName))
+      unitsToCheck.push_back(unitName);
+  }
+  if (unitsToCheck.empty())
+    return;
+
+  std::vector<UnitEventInfo> unitsNeedingUpdate;
+  std::vector<StringRef> registeredUnits;
+  std::vector<sys::TimePoint<>> registeredModTimes;
+  {
+    ReadTransaction reader(SymIndex->getDBase());
+    for (StringRef unitName : unitsToCheck) {
+      UnitInfo info = reader.getUnitInfo(unitName);
+      if (info.isInvalid()) {
+        // Not registered yet.
+        unitsNeedingUpdate.push_back(UnitEventInfo(IndexStore::UnitEvent::Kind::Added, unitName, isInitialScan, /*isDependency=*/true));
+        continue;
       }
-      return true;
-    });
+      registeredUnits.push_back(unitName);
+      registeredModTimes.push_back(info.ModTime);
+    }
   }
 
-  auto localThis = shared_from_this();
-  auto unitMonitor = std::make_shared<UnitMonitor>(localThis);
-  unitMonitor->initialize(unitCode, unitName, unitModTime, UserFileDepends, UserUnitDepends, /*checkForOutOfDate=*/isInitialScan);
-  addUnitMonitor(unitCode, unitMonitor);
+  std::vector<Optional<sys::TimePoint<>>> modTimes(registeredUnits.size());
+  getUnitModificationTimes(registeredUnits, modTimes);
+  for (size_t i = 0, e = registeredUnits.size(); i != e; ++i) {
+    if (!modTimes[i]) {
+      LOG_WARN_FUNC("error getting mod time for unit '" << registeredUnits[i] << "'");
+      continue;
+    }
+    if (modTimes[i].getValue() != registeredModTimes[i])
+      unitsNeedingUpdate.push_back(UnitEventInfo(IndexStore::UnitEvent::Kind::Added, registeredUnits[i], isInitialScan, /*isDependency=*/true));
+  }
+  processSession.enqueue(std::move(unitsNeedingUpdate));
+}
+
+void StoreUnitRepo::monitorImportedUnit(IDCode unitCode, StringRef unitName, sys::TimePoint<> modTime, FileStatCache *outOfDateStats) {
+  std::vector<CanonicalFilePath> UserFileDepends;
+  std::vector<IDCode> UserUnitDepends;
+  {
+    ReadTransaction reader(SymIndex->getDBase());
+    UnitInfo unitInfo = reader.getUnitInfo(unitCode);
+    if (unitInfo.isInvalid()) {
+      LOG_WARN_FUNC("unit '" << unitName << "' is missing from the database");
+      return;
+    }
+
+    auto userFileDepends = unitInfo.getUserFileDepends();
+    auto userProviderDepends = unitInfo.getUserProviderDepends();
+    UserFileDepends.reserve(userFileDepends.size() + userProviderDepends.size());
+    for (IDCode pathCode : userFileDepends) {
+      UserFileDepends.push_back(reader.getFullFilePathFromCode(pathCode));
+    }
+    for (const UnitInfo::Provider &prov : userProviderDepends) {
+      UserFileDepends.push_back(reader.getFullFilePathFromCode(prov.FileCode));
+    }
+    auto userUnitDepends = unitInfo.getUserUnitDepends();
+    UserUnitDepends.assign(userUnitDepends.begin(), userUnitDepends.end());
+  }
+
+  monitorUnit(unitCode, unitName, modTime, UserFileDepends, UserUnitDepends, outOfDateStats);
 }
 
 void StoreUnitRepo::removeUnit(StringRef unitName) {
@@ -700,11 +854,15 @@ void StoreUnitRepo::addUnitOutFilePaths(ArrayRef<StringRef> filePaths, bool wait
       nameBuf.clear();
       IdxStore->getUnitNameFromOutputPath(filePath, nameBuf);
       StringRef unitName = nameBuf.str();
-      ExplicitOutputUnitsSet.insert(makeIDCodeFromString(unitName));
+      ExplicitOutputUnits.emplace(makeIDCodeFromString(unitName), unitName.str());
       // It makes no difference for unit registration whether the kind is `Added` or `Modified`.
       unitEvts.push_back(UnitEventInfo(IndexStore::UnitEvent::Kind::Added, unitName, /*isInitialScan=*/true));
     }
   }
+  // The set is kept for when this process takes over the shared database, its
+  // initial scan registers the units then.
+  if (!ImportsUnits)
+    return;
   auto session = makeUnitProcessingSession();
   session->process(std::move(unitEvts), waitForProcessing);
 }
@@ -719,17 +877,51 @@ void StoreUnitRepo::removeUnitOutFilePaths(ArrayRef<StringRef> filePaths, bool w
       nameBuf.clear();
       IdxStore->getUnitNameFromOutputPath(filePath, nameBuf);
       StringRef unitName = nameBuf.str();
-      ExplicitOutputUnitsSet.erase(makeIDCodeFromString(unitName));
+      ExplicitOutputUnits.erase(makeIDCodeFromString(unitName));
       unitEvts.push_back(UnitEventInfo(IndexStore::UnitEvent::Kind::Removed, unitName, /*isInitialScan=*/false));
     }
   }
+  if (!ImportsUnits)
+    return;
+  auto session = makeUnitProcessingSession();
+  session->process(std::move(unitEvts), waitForProcessing);
+}
+
+void StoreUnitRepo::setUnitOutFilePaths(ArrayRef<StringRef> filePaths, bool waitForProcessing) {
+  std::unordered_map<IDCode, std::string> units;
+  units.reserve(filePaths.size());
+  SmallString<128> nameBuf;
+  for (StringRef filePath : filePaths) {
+    nameBuf.clear();
+    IdxStore->getUnitNameFromOutputPath(filePath, nameBuf);
+    StringRef unitName = nameBuf.str();
+    units.emplace(makeIDCodeFromString(unitName), unitName.str());
+  }
+
+  // Only the units that were added or removed get registered or removed.
+  // FIXME: Like removeUnitOutFilePaths, this doesn't remove unit dependencies.
+  std::vector<UnitEventInfo> unitEvts;
+  {
+    sys::ScopedLock L(StateMtx);
+    for (const auto &entry : units) {
+      if (!ExplicitOutputUnits.count(entry.first))
+        unitEvts.push_back(UnitEventInfo(IndexStore::UnitEvent::Kind::Added, entry.second, /*isInitialScan=*/true));
+    }
+    for (const auto &entry : ExplicitOutputUnits) {
+      if (!units.count(entry.first))
+        unitEvts.push_back(UnitEventInfo(IndexStore::UnitEvent::Kind::Removed, entry.second, /*isInitialScan=*/false));
+    }
+    ExplicitOutputUnits = std::move(units);
+  }
+  if (!ImportsUnits)
+    return;
   auto session = makeUnitProcessingSession();
   session->process(std::move(unitEvts), waitForProcessing);
 }
 
 bool StoreUnitRepo::isUnitNameInKnownOutFilePaths(StringRef unitName) const {
   sys::ScopedLock L(StateMtx);
-  return ExplicitOutputUnitsSet.count(makeIDCodeFromString(unitName));
+  return ExplicitOutputUnits.count(makeIDCodeFromString(unitName));
 }
 
 void StoreUnitRepo::purgeStaleData() {
@@ -737,111 +929,515 @@ void StoreUnitRepo::purgeStaleData() {
   // IdxStore->purgeStaleRecords(ActiveRecNames);
 }
 
+void StoreUnitRepo::scanUnitModificationTimes(llvm::StringMap<sys::TimePoint<>> &units,
+                                              Optional<sys::TimePoint<>> &generation) {
+  // The units of a libIndexStore store are the files of its 'v5/units'
+  // directory. When it exists, list it directly, which gets all the
+  // modification times in one batched pass instead of a query per unit, and
+  // provides the directory modification time as the generation of the units:
+  // units are written by renaming them into place, so any change to the set of
+  // units or to a unit updates it.
+  if (!StorePath.empty()) {
+    SmallString<128> unitsDir = StringRef(StorePath);
+    sys::path::append(unitsDir, "v5", "units");
+    sys::fs::file_status dirStatus;
+    if (!sys::fs::status(unitsDir, dirStatus) && sys::fs::is_directory(dirStatus)) {
+      std::string error;
+      bool err = scanDirectoryModificationTimes(unitsDir, [&](StringRef unitName, sys::TimePoint<> modTime) {
+        units[unitName] = modTime;
+      }, error);
+      if (!err) {
+        generation = dirStatus.getLastModificationTime();
+        return;
+      }
+      LOG_WARN_FUNC(error);
+      units.clear();
+    }
+  }
+
+  generation = None;
+  IdxStore->foreachUnit(/*sort=*/false, [&](StringRef unitName) {
+    std::string error;
+    auto optModTime = IdxStore->getUnitModificationTime(unitName, error);
+    if (!optModTime) {
+      LOG_WARN_FUNC("error getting mod time for unit '" << unitName << "':" << error);
+      return true;
+    }
+    units[unitName] = toTimePoint(optModTime.getValue());
+    return true;
+  });
+}
+
 void StoreUnitRepo::pollForUnitChangesAndWait(bool isInitialScan) {
+  if (!ImportsUnits)
+    return;
   sys::ScopedLock L(pollUnitsState.pollMtx);
+
+  // Start from the units that the last poll found, even if it was done by
+  // another process, so that a restart only reports what actually changed.
+  if (!pollUnitsState.restored) {
+    ReadTransaction reader(SymIndex->getDBase());
+    reader.foreachPolledUnit([&](StringRef unitName, sys::TimePoint<> modTime) -> bool {
+      pollUnitsState.knownUnits[unitName] = modTime;
+      return true;
+    });
+    pollUnitsState.generation = reader.getPolledUnitsGeneration();
+    pollUnitsState.restored = true;
+  }
+
   std::vector<UnitEventInfo> events;
-  {
-    llvm::StringMap<sys::TimePoint<>> knownUnits;
-    llvm::StringMap<sys::TimePoint<>> foundUnits;
+  llvm::StringMap<sys::TimePoint<>> &knownUnits = pollUnitsState.knownUnits;
+  llvm::StringMap<sys::TimePoint<>> foundUnits;
+  Optional<sys::TimePoint<>> generation;
+  auto scanStartTime = std::chrono::system_clock::now();
+  bool unchanged = false;
+  if (pollUnitsState.generation.hasValue() && !StorePath.empty()) {
+    // If the units directory did not change there is no need to list it.
+    SmallString<128> unitsDir = StringRef(StorePath);
+    sys::path::append(unitsDir, "v5", "units");
+    sys::fs::file_status dirStatus;
+    if (!sys::fs::status(unitsDir, dirStatus) &&
+        dirStatus.getLastModificationTime() == pollUnitsState.generation.getValue()) {
+      unchanged = true;
+      generation = pollUnitsState.generation;
+    }
+  }
+  if (unchanged) {
+    foundUnits = knownUnits;
+  } else {
+    scanUnitModificationTimes(foundUnits, generation);
+  }
+
+  std::vector<std::pair<std::string, sys::TimePoint<>>> changedUnits;
+  std::vector<std::string> removedUnits;
+  for (const auto &found : foundUnits) {
+    StringRef unitName = found.getKey();
+    auto modTime = found.getValue();
+    auto I = knownUnits.find(unitName);
+    Optional<UnitEventInfo> evt;
+    if (I == knownUnits.end()) {
+      evt = UnitEventInfo(IndexStore::UnitEvent::Kind::Added, unitName.str(), isInitialScan);
+      changedUnits.emplace_back(unitName.str(), modTime);
+    } else if (I->getValue() != modTime) {
+      evt = UnitEventInfo(IndexStore::UnitEvent::Kind::Modified, unitName.str(), /*isInitialScan=*/false);
+      changedUnits.emplace_back(unitName.str(), modTime);
+    } else if (isInitialScan) {
+      // The initial scan reports all the units, so their files get monitored.
+      evt = UnitEventInfo(IndexStore::UnitEvent::Kind::Added, unitName.str(), isInitialScan);
+    }
+    if (evt) {
+      evt->modTime = modTime;
+      events.push_back(std::move(evt.getValue()));
+    }
+  }
+  for (const auto &known : knownUnits) {
+    if (foundUnits.count(known.getKey()) == 0) {
+      removedUnits.push_back(known.getKey().str());
+      events.push_back({IndexStore::UnitEvent::Kind::Removed, known.getKey().str(), /*isInitialScan=*/false});
+    }
+  }
 
-    std::swap(knownUnits, pollUnitsState.knownUnits);
+  // A directory modified within the timestamp granularity of the file system
+  // may be modified again without its modification time changing, only trust
+  // generations that are old enough.
+  if (generation.hasValue() && generation.getValue() > scanStartTime - std::chrono::seconds(2))
+    generation = None;
+
+  bool snapshotChanged = !changedUnits.empty() || !removedUnits.empty() ||
+    generation != pollUnitsState.generation;
+  pollUnitsState.knownUnits = std::move(foundUnits);
+  pollUnitsState.generation = generation;
+  size_t knownUnitsBytes = pollUnitsState.knownUnits.getNumBuckets() * (sizeof(void *) + sizeof(unsigned));
+  for (const auto &known : pollUnitsState.knownUnits)
+    knownUnitsBytes += sizeof(known) + known.getKeyLength() + 1;
+  pollUnitsState.memoryUsage = knownUnitsBytes;
 
-    IdxStore->foreachUnit(/*sort=*/false, [&](StringRef unitName) {
+  auto session = makeUnitProcessingSession();
+  if (isInitialScan)
+    events = filterInitialScanEvents(std::move(events), /*waitForProcessing=*/true, session->getStatCachePtr());
+  session->process(std::move(events), /*waitForProcessing=*/true);
+
+  // Record what this poll found only after processing it, so that the changes
+  // are reported again if the process exits before they are imported.
+  if (!snapshotChanged)
+    return;
+  guardForMapFullError([&]{
+    ImportTransaction import(SymIndex->getDBase());
+    for (const auto &unit : changedUnits)
+      import.setPolledUnit(unit.first, unit.second);
+    for (const auto &unitName : removedUnits)
+      import.removePolledUnit(unitName);
+    import.setPolledUnitsGeneration(generation);
+    import.commit();
+  });
+}
+
+void StoreUnitRepo::getUnitModificationTimes(ArrayRef<StringRef> unitNames,
+                                             MutableArrayRef<Optional<sys::TimePoint<>>> modTimes) {
+  assert(unitNames.size() == modTimes.size());
+  static const size_t UnitsPerChunk = 128;
+  const StringRef *namesPtr = unitNames.data();
+  Optional<sys::TimePoint<>> *modTimesPtr = modTimes.data();
+  size_t numUnits = unitNames.size();
+  size_t numChunks = (numUnits + UnitsPerChunk - 1) / UnitsPerChunk;
+  IndexStore *idxStore = IdxStore.get();
+  WorkQueue::concurrentPerform(numChunks, [&](size_t chunk) {
+    for (size_t i = chunk * UnitsPerChunk, e = std::min(i + UnitsPerChunk, numUnits); i != e; ++i) {
       std::string error;
-      auto optModTime = IdxStore->getUnitModificationTime(unitName, error);
-      if (!optModTime) {
-        LOG_WARN_FUNC("error getting mod time for unit '" << unitName << "':" << error);
-        return true;
-      }
+      if (auto optModTime = idxStore->getUnitModificationTime(namesPtr[i], error))
+        modTimesPtr[i] = toTimePoint(optModTime.getValue());
+    }
+  }, WorkQueue::Priority::Low);
+}
 
-      auto modTime = toTimePoint(optModTime.getValue());
-      foundUnits[unitName] = modTime;
+std::vector<UnitEventInfo> StoreUnitRepo::filterInitialScanEvents(std::vector<UnitEventInfo> evts, bool waitForProcessing,
+                                                                  std::shared_ptr<FileStatCache> statCache) {
+  metrics::Histogram::Timer timer(InitialScanFilterLatency);
 
-      auto I = knownUnits.find(unitName);
-      if (I != knownUnits.end() && I->getValue() != modTime) {
-        events.push_back({IndexStore::UnitEvent::Kind::Modified, unitName.str(), /*isInitialScan=*/false});
-      } else {
-        events.push_back({IndexStore::UnitEvent::Kind::Added, unitName.str(), isInitialScan});
+  std::vector<Optional<sys::TimePoint<>>> modTimes(evts.size());
+  {
+    std::vector<StringRef> unitsToStat;
+    std::vector<size_t> evtIndices;
+    for (size_t i = 0, e = evts.size(); i != e; ++i) {
+      const UnitEventInfo &evt = evts[i];
+      if (evt.kind != IndexStore::UnitEvent::Kind::Added &&
+          evt.kind != IndexStore::UnitEvent::Kind::Modified)
+        continue;
+      if (evt.modTime.hasValue()) {
+        modTimes[i] = evt.modTime;
+        continue;
       }
+      unitsToStat.push_back(evt.name);
+      evtIndices.push_back(i);
+    }
+    std::vector<Optional<sys::TimePoint<>>> statModTimes(unitsToStat.size());
+    getUnitModificationTimes(unitsToStat, statModTimes);
+    for (size_t i = 0, e = evtIndices.size(); i != e; ++i)
+      modTimes[evtIndices[i]] = statModTimes[i];
+  }
 
+  struct UpToDateUnit {
+    IDCode UnitCode;
+    bool IsSystem;
+    StoreUnitInfo Info;
+  };
+  auto upToDateUnits = std::make_shared<std::vector<UpToDateUnit>>();
+  std::vector<UnitEventInfo> remainingEvts;
+  {
+    ReadTransaction reader(SymIndex->getDBase());
+    std::unordered_map<IDCode, UnitInfo> unitInfos;
+    reader.foreachUnitInfo([&](const UnitInfo &unitInfo) -> bool {
+      unitInfos.insert(std::make_pair(unitInfo.UnitCode, unitInfo));
       return true;
     });
 
-    for (const auto &known : knownUnits) {
-      if (foundUnits.count(known.getKey()) == 0) {
-        events.push_back({IndexStore::UnitEvent::Kind::Removed, known.getKey().str(), /*isInitialScan=*/false});
+    for (size_t i = 0, e = evts.size(); i != e; ++i) {
+      UnitEventInfo &evt = evts[i];
+      auto found = unitInfos.find(makeIDCodeFromString(evt.name));
+      if (found == unitInfos.end() ||
+          (evt.kind != IndexStore::UnitEvent::Kind::Added &&
+           evt.kind != IndexStore::UnitEvent::Kind::Modified)) {
+        if (found != unitInfos.end())
+          unitInfos.erase(found);
+        remainingEvts.push_back(std::move(evt));
+        continue;
+      }
+      UnitInfo unitInfo = found->second;
+      unitInfos.erase(found);
+
+      // Let the write path report the units we failed to get the time of.
+      if (!modTimes[i].hasValue() || unitInfo.ModTime != modTimes[i].getValue()) {
+        remainingEvts.push_back(std::move(evt));
+        continue;
       }
+
+      NumUnitsUpToDate.add();
+      if (UseExplicitOutputUnits && !evt.isDependency && !isUnitNameInKnownOutFilePaths(evt.name))
+        continue;
+      CanonicalFilePath mainFile = reader.getFullFilePathFromCode(unitInfo.MainFileCode);
+      std::string outFileIdentifier = reader.getUnitFileIdentifierFromCode(unitInfo.OutFileCode);
+      upToDateUnits->push_back(UpToDateUnit{unitInfo.UnitCode, unitInfo.IsSystem,
+        StoreUnitInfo{evt.name, mainFile, outFileIdentifier, unitInfo.HasTestSymbols, unitInfo.ModTime}});
+    }
+
+    // The scan lists all the units of the store, so the units of the database
+    // that it didn't find were removed while we were not running.
+    for (const auto &entry : unitInfos) {
+      remainingEvts.push_back(UnitEventInfo(IndexStore::UnitEvent::Kind::Removed, entry.second.UnitName.str(), /*isInitialScan=*/true));
     }
+  }
+
+  if (upToDateUnits->empty())
+    return remainingEvts;
 
-    pollUnitsState.knownUnits = std::move(foundUnits);
+  // Report the up-to-date units and monitor their files on the unit processing
+  // queue, like the units that go through the write path.
+  std::weak_ptr<StoreUnitRepo> weakUnitRepo = shared_from_this();
+  auto processUpToDateUnits = [weakUnitRepo, upToDateUnits, statCache] {
+    auto unitRepo = weakUnitRepo.lock();
+    if (!unitRepo)
+      return;
+    if (unitRepo->Delegate) {
+      std::vector<StoreUnitInfo> unitInfos;
+      unitInfos.reserve(upToDateUnits->size());
+      for (const UpToDateUnit &unit : *upToDateUnits)
+        unitInfos.push_back(unit.Info);
+      unitRepo->Delegate->processedStoreUnits(unitInfos);
+    }
+    for (const UpToDateUnit &unit : *upToDateUnits) {
+      if (!unit.IsSystem && unitRepo->EnableOutOfDateFileWatching)
+        unitRepo->monitorImportedUnit(unit.UnitCode, unit.Info.UnitName, unit.Info.ModTime, statCache.get());
+    }
+    unitRepo->startPathWatcherIfNeeded();
+  };
+  if (waitForProcessing) {
+    ProcessingQueue->dispatchSync(processUpToDateUnits);
+  } else {
+    ProcessingQueue->dispatch(processUpToDateUnits);
   }
 
-  auto session = makeUnitProcessingSession();
-  session->process(std::move(events), /*waitForProcessing=*/true);
+  return remainingEvts;
 }
 
 std::shared_ptr<UnitProcessingSession> StoreUnitRepo::makeUnitProcessingSession() {
-  return std::make_shared<UnitProcessingSession>(std::make_shared<UnitEventInfoDeque>(),
+  auto queue = std::make_shared<UnitEventQueue>();
+  addEventQueue(queue);
+  return std::make_shared<UnitProcessingSession>(std::move(queue),
                                                  shared_from_this(),
-                                                 Delegate);
+                                                 Delegate,
+                                                 ProcessingQueue);
 }
 
-std::shared_ptr<UnitMonitor> StoreUnitRepo::getUnitMonitor(IDCode unitCode) const {
+void StoreUnitRepo::addEventQueue(std::shared_ptr<UnitEventQueue> queue) {
   sys::ScopedLock L(StateMtx);
-  auto It = UnitMonitorsByCode.find(unitCode);
-  if (It != UnitMonitorsByCode.end())
-    return It->second;
-  return nullptr;
+  EventQueues.erase(std::remove_if(EventQueues.begin(), EventQueues.end(),
+                                   [](const std::weak_ptr<UnitEventQueue> &queue) { return queue.expired(); }),
+                    EventQueues.end());
+  EventQueues.push_back(std::move(queue));
 }
 
-void StoreUnitRepo::addUnitMonitor(IDCode unitCode, std::shared_ptr<UnitMonitor> monitor) {
+void StoreUnitRepo::assignEventPriorities(MutableArrayRef<UnitEventInfo> evts) const {
   sys::ScopedLock L(StateMtx);
-  UnitMonitorsByCode[unitCode] = monitor;
+  if (PrioritizedUnitsSet.empty() && ExplicitOutputUnits.empty())
+    return;
+  for (UnitEventInfo &evt : evts) {
+    IDCode unitCode = makeIDCodeFromString(evt.name);
+    if (PrioritizedUnitsSet.count(unitCode) || ExplicitOutputUnits.count(unitCode))
+      evt.priority = UnitEventPriority::High;
+  }
 }
 
-void StoreUnitRepo::removeUnitMonitor(IDCode unitCode) {
+void StoreUnitRepo::collectUnitsOfFiles(ArrayRef<StringRef> filePaths, std::unordered_set<IDCode> &unitCodes) {
+  ReadTransaction reader(SymIndex->getDBase());
+  SmallString<128> nameBuf;
+  for (StringRef filePath : filePaths) {
+    // The path may be the output file of a unit that is not imported yet.
+    nameBuf.clear();
+    IdxStore->getUnitNameFromOutputPath(filePath, nameBuf);
+    unitCodes.insert(makeIDCodeFromString(nameBuf.str()));
+
+    // Or the main file of imported units.
+    CanonicalFilePath canonPath = CanonPathCache->getCanonicalPath(filePath);
+    if (canonPath.empty())
+      continue;
+    IDCode fileCode = reader.getFilePathCode(canonPath);
+    reader.foreachUnitContainingFile(fileCode, [&](ArrayRef<IDCode> unitCodesContainingFile) -> bool {
+      for (IDCode unitCode : unitCodesContainingFile) {
+        UnitInfo unitInfo = reader.getUnitInfo(unitCode);
+        if (unitInfo.isValid() && unitInfo.HasMainFile && unitInfo.MainFileCode == fileCode)
+          unitCodes.insert(unitCode);
+      }
+      return true;
+    });
+  }
+}
+
+void StoreUnitRepo::prioritizeFiles(ArrayRef<StringRef> filePaths, bool remember) {
+  std::vector<std::shared_ptr<UnitEventQueue>> queues;
+  {
+    sys::ScopedLock L(StateMtx);
+    for (const auto &weakQueue : EventQueues) {
+      if (auto queue = weakQueue.lock()) {
+        if (!queue->empty())
+          queues.push_back(std::move(queue));
+      }
+    }
+  }
+  // Avoid reading the database for the queries done while nothing is pending.
+  if (queues.empty() && !remember)
+    return;
+
+  std::unordered_set<IDCode> unitCodes;
+  collectUnitsOfFiles(filePaths, unitCodes);
+  if (remember) {
+    sys::ScopedLock L(StateMtx);
+    PrioritizedUnitsSet.insert(unitCodes.begin(), unitCodes.end());
+  }
+  for (const auto &queue : queues)
+    queue->prioritize(unitCodes);
+}
+
+void StoreUnitRepo::unprioritizeFiles(ArrayRef<StringRef> filePaths) {
+  std::unordered_set<IDCode> unitCodes;
+  collectUnitsOfFiles(filePaths, unitCodes);
   sys::ScopedLock L(StateMtx);
-  UnitMonitorsByCode.erase(unitCode);
+  for (IDCode unitCode : unitCodes)
+    PrioritizedUnitsSet.erase(unitCode);
 }
 
-void StoreUnitRepo::onUnitOutOfDate(IDCode unitCode, StringRef unitName,
-                                    OutOfDateFileTriggerRef trigger,
-                                    bool synchronous) {
-  CanonicalFilePath MainFilePath;
-  std::string OutFileIdentifier;
-  bool hasTestSymbols = false;
-  llvm::sys::TimePoint<> CurrModTime;
-  SmallVector<IDCode, 8> dependentUnits;
+void StoreUnitRepo::monitorUnit(IDCode unitCode, StringRef unitName, sys::TimePoint<> modTime,
+                                ArrayRef<CanonicalFilePath> userFileDepends,
+                                ArrayRef<IDCode> userUnitDepends,
+                                FileStatCache *outOfDateStats) {
+  // The directories are the ones the files are listed by in the database.
+  SmallVector<StringRef, 8> directories;
+  if (FilePathWatcher::watchesIndividualDirectories()) {
+    llvm::StringSet<> uniqueDirectories;
+    for (const auto &canonPath : userFileDepends) {
+      StringRef directory = sys::path::parent_path(canonPath.getPath());
+      if (!directory.empty() && uniqueDirectories.insert(directory).second)
+        directories.push_back(directory);
+    }
+  }
+
+  std::vector<OutOfDateMark> marks;
   {
-    ReadTransaction reader(SymIndex->getDBase());
-    auto unitInfo = reader.getUnitInfo(unitCode);
-    if (!unitInfo.isInvalid()) {
-      if (unitInfo.HasMainFile) {
-        MainFilePath = reader.getFullFilePathFromCode(unitInfo.MainFileCode);
+    sys::ScopedLock L(MonitorsMtx);
+    std::vector<std::string> addedDirectories;
+    std::vector<std::string> removedDirectories;
+    UnitMonitors.add(unitCode, unitName, modTime, directories, addedDirectories, removedDirectories);
+    if (PathWatcher) {
+      if (!addedDirectories.empty())
+        PathWatcher->addDirectories(addedDirectories);
+      if (!removedDirectories.empty())
+        PathWatcher->removeDirectories(removedDirectories);
+    }
+
+    for (IDCode unitDepCode : userUnitDepends) {
+      if (auto depSlot = UnitMonitors.find(unitDepCode)) {
+        for (const auto &trigger : UnitMonitors.getTriggers(*depSlot)) {
+          if (trigger->getModTime() > modTime)
+            marks.push_back(OutOfDateMark{unitCode, trigger});
+        }
       }
-      OutFileIdentifier = reader.getUnitFileIdentifierFromCode(unitInfo.OutFileCode);
-      hasTestSymbols = unitInfo.HasTestSymbols;
-      CurrModTime = unitInfo.ModTime;
     }
-    reader.getDirectDependentUnits(unitCode, dependentUnits);
   }
 
-  if (!MainFilePath.empty() && Delegate) {
-    StoreUnitInfo unitInfo{
-      unitName,
-      MainFilePath,
-      OutFileIdentifier,
-      hasTestSymbols,
-      CurrModTime
-    };
-    Delegate->unitIsOutOfDate(unitInfo, trigger, synchronous);
+  if (outOfDateStats) {
+    SmallVector<StringRef, 32> filePaths;
+    filePaths.reserve(userFileDepends.size());
+    for (const auto &canonPath : userFileDepends) {
+      filePaths.push_back(canonPath.getPath());
+    }
+    auto mostRecentFileAndTime = outOfDateStats->getMostRecentModTime(filePaths);
+    if (mostRecentFileAndTime.second > modTime) {
+      auto trigger = OutOfDateFileTrigger::create(mostRecentFileAndTime.first,
+                                                  mostRecentFileAndTime.second);
+      marks.push_back(OutOfDateMark{unitCode, std::move(trigger)});
+    }
+  }
+
+  if (!marks.empty())
+    markUnitsOutOfDate(std::move(marks), /*synchronous=*/false);
+}
+
+void StoreUnitRepo::removeUnitMonitor(IDCode unitCode) {
+  sys::ScopedLock L(MonitorsMtx);
+  std::vector<std::string> removedDirectories;
+  UnitMonitors.remove(unitCode, removedDirectories);
+  if (PathWatcher && !removedDirectories.empty())
+    PathWatcher->removeDirectories(removedDirectories);
+}
+
+size_t StoreUnitRepo::getUnitMonitorsMemoryUsage() const {
+  sys::ScopedLock L(MonitorsMtx);
+  return UnitMonitors.getMemoryUsage();
+}
+
+void StoreUnitRepo::trimUnitMonitors(MemoryTrimLevel level) {
+  if (level != MemoryTrimLevel::Critical)
+    return;
+  sys::ScopedLock L(MonitorsMtx);
+  UnitMonitors.compact();
+}
+
+size_t StoreUnitRepo::getPolledUnitsMemoryUsage() const {
+  return pollUnitsState.memoryUsage;
+}
+
+void StoreUnitRepo::trimPolledUnits(MemoryTrimLevel level) {
+  if (level != MemoryTrimLevel::Critical)
+    return;
+  // Don't wait for a poll, it is using the snapshot anyway.
+  if (!pollUnitsState.pollMtx.try_lock())
+    return;
+  pollUnitsState.knownUnits = llvm::StringMap<sys::TimePoint<>>();
+  pollUnitsState.generation = None;
+  pollUnitsState.restored = false;
+  pollUnitsState.memoryUsage = 0;
+  pollUnitsState.pollMtx.unlock();
+}
+
+void StoreUnitRepo::collectOutOfDateMarks(ArrayRef<IDCode> unitCodes, StringRef filePath, sys::TimePoint<> modTime,
+                                          std::vector<OutOfDateMark> &marks) const {
+  OutOfDateFileTriggerRef trigger;
+  sys::ScopedLock L(MonitorsMtx);
+  for (IDCode unitCode : unitCodes) {
+    auto slot = UnitMonitors.find(unitCode);
+    if (!slot || !UnitMonitors.isOutOfDateWith(*slot, filePath, modTime))
+      continue;
+    if (!trigger)
+      trigger = OutOfDateFileTrigger::create(filePath, modTime);
+    marks.push_back(OutOfDateMark{unitCode, trigger});
   }
+}
 
-  for (IDCode depUnit : dependentUnits) {
-    if (auto monitor = getUnitMonitor(depUnit)) {
-      if (monitor->getModTime() < trigger->getModTime())
-        monitor->markOutOfDate(trigger, synchronous);
+void StoreUnitRepo::markUnitsOutOfDate(std::vector<OutOfDateMark> marks, bool synchronous) {
+  struct MarkedUnit {
+    IDCode UnitCode;
+    std::string UnitName;
+    OutOfDateFileTriggerRef Trigger;
+  };
+
+  while (!marks.empty()) {
+    std::vector<MarkedUnit> outOfDateUnits;
+    {
+      sys::ScopedLock L(MonitorsMtx);
+      for (auto &mark : marks) {
+        auto slot = UnitMonitors.find(mark.UnitCode);
+        if (slot && UnitMonitors.addTrigger(*slot, mark.Trigger))
+          outOfDateUnits.push_back(MarkedUnit{mark.UnitCode, UnitMonitors.getUnitName(*slot).str(), std::move(mark.Trigger)});
+      }
     }
+    marks.clear();
+
+    std::vector<OutOfDateUnit> reports;
+    {
+      ReadTransaction reader(SymIndex->getDBase());
+      SmallVector<IDCode, 8> dependentUnits;
+      for (auto &unit : outOfDateUnits) {
+        auto unitInfo = reader.getUnitInfo(unit.UnitCode);
+        if (!unitInfo.isInvalid() && unitInfo.HasMainFile) {
+          StoreUnitInfo storeUnitInfo{
+            unit.UnitName,
+            reader.getFullFilePathFromCode(unitInfo.MainFileCode),
+            reader.getUnitFileIdentifierFromCode(unitInfo.OutFileCode),
+            unitInfo.HasTestSymbols,
+            unitInfo.ModTime
+          };
+          reports.push_back(OutOfDateUnit{std::move(storeUnitInfo), unit.Trigger});
+        }
+        dependentUnits.clear();
+        reader.getDirectDependentUnits(unit.UnitCode, dependentUnits);
+        for (IDCode depUnit : dependentUnits)
+          marks.push_back(OutOfDateMark{depUnit, unit.Trigger});
+      }
+    }
+
+    // We collect and call later to avoid calling the delegate in a read
+    // transaction.
+    if (Delegate && !reports.empty())
+      Delegate->unitsAreOutOfDate(reports, synchronous);
   }
 }
 
@@ -861,8 +1457,7 @@ void StoreUnitRepo::onFSEvent(std::vector<std::string> changedParentPaths) {
   {
     ReadTransaction reader(SymIndex->getDBase());
     reader.findFilePathsWithParentPaths(parentPathStrRefs, [&](IDCode pathCode, CanonicalFilePathRef filePath) -> bool {
-      auto modTime = UnitMonitor::getModTimeForOutOfDateCheck(filePath.getPath());
-      outOfDateChecks.push_back(OutOfDateCheck{filePath.getPath().str(), modTime, {}});
+      outOfDateChecks.push_back(OutOfDateCheck{filePath.getPath().str(), sys::TimePoint<>(), {}});
       reader.foreachUnitContainingFile(pathCode, [&](ArrayRef<IDCode> unitCodes) -> bool {
         outOfDateChecks.back().UnitCodes.append(unitCodes.begin(), unitCodes.end());
         return true;
@@ -870,14 +1465,24 @@ void StoreUnitRepo::onFSEvent(std::vector<std::string> changedParentPaths) {
       return true;
     });
   }
-  // We collect and call later to avoid nested read transactions.
-  for (auto &check : outOfDateChecks) {
-    for (IDCode unitCode : check.UnitCodes) {
-      if (auto monitor = getUnitMonitor(unitCode)) {
-        monitor->checkForOutOfDate(check.ModTime, check.FilePath);
-      }
-    }
+  // Stat the files of the changed directories as one batch, after the read
+  // transaction. The times are not kept, the next change needs new ones.
+  {
+    std::vector<StringRef> filePaths;
+    filePaths.reserve(outOfDateChecks.size());
+    for (const auto &check : outOfDateChecks)
+      filePaths.push_back(check.FilePath);
+    std::vector<sys::TimePoint<>> modTimes(filePaths.size());
+    FileStatCache().getModTimes(filePaths, modTimes);
+    for (size_t i = 0, e = outOfDateChecks.size(); i != e; ++i)
+      outOfDateChecks[i].ModTime = modTimes[i];
   }
+
+  // We collect and call later to avoid nested read transactions.
+  std::vector<OutOfDateMark> marks;
+  for (auto &check : outOfDateChecks)
+    collectOutOfDateMarks(check.UnitCodes, check.FilePath, check.ModTime, marks);
+  markUnitsOutOfDate(std::move(marks), /*synchronous=*/false);
 }
 
 void StoreUnitRepo::checkUnitContainingFileIsOutOfDate(StringRef filePath) {
@@ -887,159 +1492,21 @@ void StoreUnitRepo::checkUnitContainingFileIsOutOfDate(StringRef filePath) {
   // The timestamp that the file system returns has second precision, so if the file
   // was touched in less than a second after it got indexed, it will look like it is not actually dirty.
   // FIXME: Use modification-time + file-size to check for updated files.
-  auto modTime = UnitMonitor::getModTimeForOutOfDateCheck(filePath);
+  auto modTime = FileStatCache::statModTime(filePath);
 
-  std::vector<std::shared_ptr<UnitMonitor>> unitMonitors;
+  std::vector<IDCode> unitCodes;
   {
     ReadTransaction reader(SymIndex->getDBase());
     IDCode pathCode = reader.getFilePathCode(realPath);
-    reader.foreachUnitContainingFile(pathCode, [&](ArrayRef<IDCode> unitCodes) -> bool {
-      for (IDCode unitCode : unitCodes) {
-        if (auto monitor = getUnitMonitor(unitCode)) {
-          unitMonitors.push_back(std::move(monitor));
-        }
-      }
+    reader.foreachUnitContainingFile(pathCode, [&](ArrayRef<IDCode> codes) -> bool {
+      unitCodes.insert(unitCodes.end(), codes.begin(), codes.end());
       return true;
     });
   }
   // We collect and call later to avoid nested read transactions.
-  for (auto &unitMonitor : unitMonitors) {
-    unitMonitor->checkForOutOfDate(modTime, filePath, /*synchronous=*/true);
-  }
-}
-
-//===----------------------------------------------------------------------===//
-// UnitMonitor
-//===----------------------------------------------------------------------===//
-
-UnitMonitor::UnitMonitor(std::shared_ptr<StoreUnitRepo> unitRepo) {
-  this->UnitRepo = unitRepo;
-}
-
-void UnitMonitor::initialize(IDCode unitCode,
-                             StringRef unitName,
-                             sys::TimePoint<> modTime,
-                             ArrayRef<CanonicalFilePath> userFileDepends,
-                             ArrayRef<IDCode> userUnitDepends,
-                             bool checkForOutOfDate) {
-  auto unitRepo = this->UnitRepo.lock();
-  if (!unitRepo)
-    return;
-  this->UnitCode = unitCode;
-  this->UnitName = unitName;
-  this->ModTime = modTime;
-  for (IDCode unitDepCode : userUnitDepends) {
-    if (auto depMonitor = unitRepo->getUnitMonitor(unitDepCode)) {
-      for (const auto &trigger : depMonitor->getUnorderedOutOfDateTriggers()) {
-        if (trigger->getModTime() > modTime)
-          markOutOfDate(trigger);
-      }
-    }
-  }
-
-  if (checkForOutOfDate) {
-    SmallVector<StringRef, 32> filePaths;
-    filePaths.reserve(userFileDepends.size());
-    for (const auto &canonPath : userFileDepends) {
-      filePaths.push_back(canonPath.getPath());
-    }
-    auto mostRecentFileAndTime = getMostRecentModTime(filePaths);
-    if (mostRecentFileAndTime.second > modTime) {
-      auto trigger = OutOfDateFileTrigger::create(mostRecentFileAndTime.first,
-                                                  mostRecentFileAndTime.second);
-      markOutOfDate(trigger);
-    }
-  }
-}
-
-UnitMonitor::~UnitMonitor() {}
-
-std::vector<OutOfDateFileTriggerRef>
-UnitMonitor::getUnorderedOutOfDateTriggers() const {
-  sys::ScopedLock L(StateMtx);
-  std::vector<OutOfDateFileTriggerRef> triggers;
-  for (const auto &entry : OutOfDateTriggers) {
-    triggers.push_back(entry.second);
-  }
-  return triggers;
-}
-
-void UnitMonitor::checkForOutOfDate(sys::TimePoint<> outOfDateModTime,
-                                    StringRef filePath, bool synchronous) {
-  sys::ScopedLock L(StateMtx);
-  auto findIt = OutOfDateTriggers.find(filePath);
-  if (findIt != OutOfDateTriggers.end() &&
-      findIt->second->getModTime() >= outOfDateModTime) {
-    return; // already marked as out-of-date related to this trigger file.
-  }
-  if (ModTime < outOfDateModTime) {
-    markOutOfDate(OutOfDateFileTrigger::create(filePath, outOfDateModTime),
-                  synchronous);
-  }
-}
-
-void UnitMonitor::markOutOfDate(OutOfDateFileTriggerRef trigger,
-                                bool synchronous) {
-  {
-    // Note we have to be careful with the memory management here since the
-    // key for OutOfDateTriggers is a reference into the stored trigger value.
-    sys::ScopedLock L(StateMtx);
-    auto [iter, inserted] =
-        OutOfDateTriggers.try_emplace(trigger->getPathRef(), trigger);
-    if (!inserted) {
-      // If we have the same or newer mod time for this trigger already stored,
-      // we've seen it before, and have already informed the delegate that the
-      // unit is out of date.
-      if (iter->second->getModTime() >= trigger->getModTime())
-        return;
-
-      // We have a newer mod time for the file, update our trigger, and inform
-      // the delegate that the unit is out of date. Note we need to overwrite
-      // the key as well since it references the path stored in the trigger.
-      *iter = {trigger->getPathRef(), trigger};
-    }
-  }
-  if (auto localUnitRepo = UnitRepo.lock())
-    localUnitRepo->onUnitOutOfDate(UnitCode, UnitName, trigger, synchronous);
-}
-
-std::pair<StringRef, sys::TimePoint<>> UnitMonitor::getMostRecentModTime(ArrayRef<StringRef> filePaths) {
-  sys::TimePoint<> mostRecentTime = sys::TimePoint<>::min();
-  StringRef mostRecentFile;
-  auto checkModTime = [&](sys::TimePoint<> mod, StringRef filePath) {
-    if (mod > mostRecentTime) {
-      mostRecentTime = mod;
-      mostRecentFile = filePath;
-    }
-  };
-
-  for (StringRef filePath : filePaths) {
-    sys::fs::file_status fileStat;
-    std::error_code EC = sys::fs::status(filePath, fileStat);
-    sys::TimePoint<> currModTime = sys::TimePoint<>::min();
-    if (sys::fs::status_known(fileStat) && fileStat.type() == sys::fs::file_type::file_not_found) {
-      // Make a recent time value so that we consider this out-of-date.
-      currModTime = std::chrono::system_clock::now();
-    } else if (!EC) {
-      currModTime = fileStat.getLastModificationTime();
-    }
-    checkModTime(currModTime, filePath);
-  }
-
-  return std::make_pair(mostRecentFile, mostRecentTime);
-}
-
-sys::TimePoint<> UnitMonitor::getModTimeForOutOfDateCheck(StringRef filePath) {
-  sys::fs::file_status fileStat;
-  std::error_code EC = sys::fs::status(filePath, fileStat);
-  sys::TimePoint<> modTime = sys::TimePoint<>::min();
-  if (sys::fs::status_known(fileStat) && fileStat.type() == sys::fs::file_type::file_not_found) {
-    // Make a recent time value so that we consider this out-of-date.
-    modTime = std::chrono::system_clock::now();
-  } else if (!EC) {
-    modTime = fileStat.getLastModificationTime();
-  }
-  return modTime;
+  std::vector<OutOfDateMark> marks;
+  collectOutOfDateMarks(unitCodes, filePath, modTime, marks);
+  markUnitsOutOfDate(std::move(marks), /*synchronous=*/true);
 }
 
 //===----------------------------------------------------------------------===//
@@ -1047,6 +1514,7 @@ sys::TimePoint<> UnitMonitor::getModTimeForOutOfDateCheck(StringRef filePath) {
 //===----------------------------------------------------------------------===//
 
 bool IndexDatastoreImpl::init(IndexStoreRef idxStore,
+                              StringRef storePath,
                               SymbolIndexRef SymIndex,
                               std::shared_ptr<IndexSystemDelegate> Delegate,
                               std::shared_ptr<CanonicalPathCache> CanonPathCache,
@@ -1059,11 +1527,13 @@ bool IndexDatastoreImpl::init(IndexStoreRef idxStore,
   if (Options.readonly)
     return false;
 
-  auto UnitRepo = std::make_shared<StoreUnitRepo>(this->IdxStore, SymIndex, Options.useExplicitOutputUnits, Options.enableOutOfDateFileWatching, Delegate, CanonPathCache);
+  auto UnitRepo = std::make_shared<StoreUnitRepo>(this->IdxStore, storePath, SymIndex, Options.useExplicitOutputUnits, Options.enableOutOfDateFileWatching, Delegate, CanonPathCache, Options.unitProcessingWeight);
   std::weak_ptr<StoreUnitRepo> WeakUnitRepo = UnitRepo;
+  auto processingQueue = UnitRepo->getProcessingQueue();
   bool waitUntilDoneInitializing = Options.wait;
-  auto eventsDeque = std::make_shared<UnitEventInfoDeque>();
-  auto OnUnitsChange = [WeakUnitRepo, Delegate, eventsDeque, waitUntilDoneInitializing](IndexStore::UnitEventNotification EventNote) {
+  auto eventsDeque = std::make_shared<UnitEventQueue>();
+  UnitRepo->addEventQueue(eventsDeque);
+  auto OnUnitsChange = [WeakUnitRepo, Delegate, eventsDeque, processingQueue, waitUntilDoneInitializing](IndexStore::UnitEventNotification EventNote) {
     bool isInitialScan = EventNote.isInitial();
     bool shouldWait = waitUntilDoneInitializing && isInitialScan;
 
@@ -1073,16 +1543,46 @@ bool IndexDatastoreImpl::init(IndexStoreRef idxStore,
       evts.push_back(UnitEventInfo{evt.getKind(), evt.getUnitName(), isInitialScan});
     }
 
+    auto session = std::make_shared<UnitProcessingSession>(eventsDeque, WeakUnitRepo, Delegate, processingQueue);
     if (isInitialScan) {
+      if (auto unitRepo = WeakUnitRepo.lock())
+        evts = unitRepo->filterInitialScanEvents(std::move(evts), shouldWait, session->getStatCachePtr());
       Delegate->initialPendingUnits(evts.size());
     }
-
-    auto session = std::make_shared<UnitProcessingSession>(eventsDeque, WeakUnitRepo, Delegate);
     session->process(std::move(evts), shouldWait);
   };
 
   this->UnitRepo = std::move(UnitRepo);
 
+  // A reader of a shared database leaves the imports to the writer process,
+  // until it takes over from it.
+  auto dbase = SymIndex->getDBase();
+  if (!dbase->isWriter()) {
+    this->UnitRepo->setImportsUnits(false);
+    IndexStoreRef idxStore = this->IdxStore;
+    bool listenToUnitEvents = Options.listenToUnitEvents;
+    auto takeOver = [WeakUnitRepo, idxStore, OnUnitsChange, listenToUnitEvents]() {
+      auto unitRepo = WeakUnitRepo.lock();
+      if (!unitRepo)
+        return;
+      unitRepo->setImportsUnits(true);
+      // The initial scan catches up with the units that changed since the
+      // previous writer exited.
+      if (listenToUnitEvents) {
+        idxStore->setUnitEventHandler(OnUnitsChange);
+        std::string error;
+        if (idxStore->startEventListening(/*waitForProcessing=*/false, error))
+          LOG_WARN_FUNC("failed listening to unit events: " << error);
+      } else {
+        unitRepo->pollForUnitChangesAndWait(/*isInitialScan=*/true);
+      }
+    };
+    if (dbase->deferUntilWriter(std::move(takeOver)))
+      return false;
+    // Took over meanwhile.
+    this->UnitRepo->setImportsUnits(true);
+  }
+
   if (Options.listenToUnitEvents) {
     this->IdxStore->setUnitEventHandler(OnUnitsChange);
     bool err = this->IdxStore->startEventListening(waitUntilDoneInitializing, Error);
@@ -1096,7 +1596,7 @@ bool IndexDatastoreImpl::init(IndexStoreRef idxStore,
 }
 
 bool IndexDatastoreImpl::isUnitOutOfDate(StringRef unitOutputPath, ArrayRef<StringRef> dirtyFiles) {
-  auto mostRecentFileAndTime = UnitMonitor::getMostRecentModTime(dirtyFiles);
+  auto mostRecentFileAndTime = FileStatCache().getMostRecentModTime(dirtyFiles);
   return isUnitOutOfDate(unitOutputPath, mostRecentFileAndTime.second);
 }
 
@@ -1125,10 +1625,52 @@ void IndexDatastoreImpl::removeUnitOutFilePaths(ArrayRef<StringRef> filePaths, b
   return UnitRepo->removeUnitOutFilePaths(filePaths, waitForProcessing);
 }
 
+void IndexDatastoreImpl::setUnitOutFilePaths(ArrayRef<StringRef> filePaths, bool waitForProcessing) {
+  return UnitRepo->setUnitOutFilePaths(filePaths, waitForProcessing);
+}
+
+void IndexDatastoreImpl::prioritizeFiles(ArrayRef<StringRef> filePaths, bool remember) {
+  if (UnitRepo)
+    UnitRepo->prioritizeFiles(filePaths, remember);
+}
+
+void IndexDatastoreImpl::unprioritizeFiles(ArrayRef<StringRef> filePaths) {
+  if (UnitRepo)
+    UnitRepo->unprioritizeFiles(filePaths);
+}
+
 void IndexDatastoreImpl::purgeStaleData() {
   UnitRepo->purgeStaleData();
 }
 
+void IndexDatastoreImpl::addMemoryConsumers(MemoryGovernor &governor) {
+  if (!UnitRepo)
+    return;
+  std::weak_ptr<StoreUnitRepo> weakUnitRepo = UnitRepo;
+  governor.addConsumer("unit_monitors", [weakUnitRepo]() -> size_t {
+    if (auto unitRepo = weakUnitRepo.lock())
+      return unitRepo->getUnitMonitorsMemoryUsage();
+    return 0;
+  }, [weakUnitRepo](MemoryTrimLevel level) {
+    if (auto unitRepo = weakUnitRepo.lock())
+      unitRepo->trimUnitMonitors(level);
+  });
+  governor.addConsumer("polled_units", [weakUnitRepo]() -> size_t {
+    if (auto unitRepo = weakUnitRepo.lock())
+      return unitRepo->getPolledUnitsMemoryUsage();
+    return 0;
+  }, [weakUnitRepo](MemoryTrimLevel level) {
+    if (auto unitRepo = weakUnitRepo.lock())
+      unitRepo->trimPolledUnits(level);
+  });
+}
+
+Optional<UnitProcessingStats> IndexDatastoreImpl::getUnitProcessingStats() const {
+  if (!UnitRepo)
+    return None;
+  return UnitRepo->getProcessingStats();
+}
+
 void IndexDatastoreImpl::pollForUnitChangesAndWait(bool isInitialScan) {
   UnitRepo->pollForUnitChangesAndWait(isInitialScan);
 }
@@ -1139,13 +1681,14 @@ void IndexDatastoreImpl::pollForUnitChangesAndWait(bool isInitialScan) {
 
 std::unique_ptr<IndexDatastore>
 IndexDatastore::create(IndexStoreRef idxStore,
+                       StringRef storePath,
                        SymbolIndexRef SymIndex,
                        std::shared_ptr<IndexSystemDelegate> Delegate,
                        std::shared_ptr<CanonicalPathCache> CanonPathCache,
                        const CreationOptions &Options,
                        std::string &Error) {
   std::unique_ptr<IndexDatastoreImpl> Impl(new IndexDatastoreImpl());
-  bool Err = Impl->init(std::move(idxStore), std::move(SymIndex), std::move(Delegate), std::move(CanonPathCache),
+  bool Err = Impl->init(std::move(idxStore), storePath, std::move(SymIndex), std::move(Delegate), std::move(CanonPathCache),
                         Options, Error);
   if (Err)
     return nullptr;
@@ -1177,10 +1720,30 @@ void IndexDatastore::addUnitOutFilePaths(ArrayRef<StringRef> filePaths, bool wai
   return IMPL->addUnitOutFilePaths(filePaths, waitForProcessing);
 }
 
+void IndexDatastore::prioritizeFiles(ArrayRef<StringRef> filePaths, bool remember) {
+  return IMPL->prioritizeFiles(filePaths, remember);
+}
+
+void IndexDatastore::unprioritizeFiles(ArrayRef<StringRef> filePaths) {
+  return IMPL->unprioritizeFiles(filePaths);
+}
+
 void IndexDatastore::removeUnitOutFilePaths(ArrayRef<StringRef> filePaths, bool waitForProcessing) {
   return IMPL->removeUnitOutFilePaths(filePaths, waitForProcessing);
 }
 
+void IndexDatastore::setUnitOutFilePaths(ArrayRef<StringRef> filePaths, bool waitForProcessing) {
+  return IMPL->setUnitOutFilePaths(filePaths, waitForProcessing);
+}
+
+void IndexDatastore::addMemoryConsumers(MemoryGovernor &governor) {
+  return IMPL->addMemoryConsumers(governor);
+}
+
+Optional<UnitProcessingStats> IndexDatastore::getUnitProcessingStats() const {
+  return IMPL->getUnitProcessingStats();
+}
+
 void IndexDatastore::purgeStaleData() {
   return IMPL->purgeStaleData();
 }
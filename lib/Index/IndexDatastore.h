@@ -13,6 +13,7 @@
 #ifndef INDEXSTOREDB_LIB_INDEX_INDEXDATASTORE_H
 #define INDEXSTOREDB_LIB_INDEX_INDEXDATASTORE_H
 
+#include "UnitProcessingScheduler.h"
 #include "IndexStoreDB/Core/Symbol.h"
 #include "llvm/ADT/OptionSet.h"
 #include <memory>
@@ -26,6 +27,7 @@ namespace indexstore {
 
 namespace IndexStoreDB {
   class CanonicalPathCache;
+  class MemoryGovernor;
 
 namespace index {
   class IndexSystemDelegate;
@@ -38,6 +40,7 @@ public:
   ~IndexDatastore();
 
   static std::unique_ptr<IndexDatastore> create(indexstore::IndexStoreRef idxStore,
+                                                StringRef storePath,
                                                 SymbolIndexRef SymIndex,
                                                 std::shared_ptr<IndexSystemDelegate> Delegate,
                                                 std::shared_ptr<CanonicalPathCache> CanonPathCache,
@@ -53,9 +56,25 @@ public:
 
   void addUnitOutFilePaths(ArrayRef<StringRef> filePaths, bool waitForProcessing);
   void removeUnitOutFilePaths(ArrayRef<StringRef> filePaths, bool waitForProcessing);
+  void setUnitOutFilePaths(ArrayRef<StringRef> filePaths, bool waitForProcessing);
+
+  /// Moves the pending imports of the units of \p filePaths, either main files
+  /// or unit output files, ahead of the other pending units. If \p remember is
+  /// true, the units are also imported first when they change later.
+  void prioritizeFiles(ArrayRef<StringRef> filePaths, bool remember);
+  /// Stops giving priority to the units of \p filePaths when they change.
+  void unprioritizeFiles(ArrayRef<StringRef> filePaths);
 
   void purgeStaleData();
 
+  /// Adds the unit monitors and the snapshot of the polled units to the
+  /// structures accounted by \p governor.
+  void addMemoryConsumers(MemoryGovernor &governor);
+
+  /// \returns the statistics of the unit processing queue of the index, if it
+  /// processes units.
+  Optional<UnitProcessingStats> getUnitProcessingStats() const;
+
   /// *For Testing* Poll for any changes to units and wait until they have been registered.
   void pollForUnitChangesAndWait(bool isInitialScan);
 
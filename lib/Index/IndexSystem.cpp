@@ -16,17 +16,25 @@
 #include "IndexStoreDB/Index/IndexSystemDelegate.h"
 #include "IndexStoreDB/Index/FilePathIndex.h"
 #include "IndexStoreDB/Index/SymbolIndex.h"
+#include "IndexStoreDB/Index/SymbolOccurrenceCount.h"
 #include "IndexStoreDB/Database/Database.h"
 #include "FileVisibilityChecker.h"
 #include "IndexDatastore.h"
+#include "QueryExecutor.h"
 
 #include "IndexStoreDB/Support/Path.h"
 #include "IndexStoreDB/Support/Concurrency.h"
+#include "IndexStoreDB/Support/Logging.h"
+#include "IndexStoreDB/Support/MemoryGovernor.h"
+#include "IndexStoreDB/Support/Metrics.h"
 #include "indexstore/IndexStoreCXX.h"
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/Mutex.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include <unordered_map>
@@ -41,14 +49,44 @@ namespace {
 ///
 /// This allows the index system to invoke \c IndexSystemDelegate methods
 /// without blocking on their implementations.
+///
+/// The processed and out-of-date units and the completed actions are collected
+/// for the batching interval and delivered together, so that a change that
+/// affects many units doesn't turn into as many blocks and delegate calls.
 class AsyncIndexDelegate : public IndexSystemDelegate {
-  std::vector<std::shared_ptr<IndexSystemDelegate>> Others;
-  unsigned PendingActions = 0;
+  struct UnitEvent {
+    StoreUnitInfo UnitInfo;
+    /// Null for a processed unit.
+    OutOfDateFileTriggerRef Trigger;
+  };
+
+  /// The state used by the blocks on the queue. The flush of a batch can
+  /// outlive the delegate while it waits for the batching interval.
+  struct State {
+    std::vector<std::shared_ptr<IndexSystemDelegate>> Others;
+    unsigned PendingActions = 0;
+
+    /// Guards the batch, which is filled by the callers and delivered on the
+    /// queue.
+    llvm::sys::Mutex BatchMtx;
+    std::vector<UnitEvent> BatchedUnits;
+    unsigned BatchedCompleted = 0;
+    bool FlushScheduled = false;
+
+    /// Delivers the batch. Must be called on the queue.
+    void flush();
+  };
+
+  std::shared_ptr<State> S = std::make_shared<State>();
+  std::chrono::milliseconds BatchInterval;
   WorkQueue Queue{WorkQueue::Dequeuing::Serial, "indexstoredb.AsyncIndexDelegate"};
 
 public:
-  AsyncIndexDelegate(std::shared_ptr<IndexSystemDelegate> Other)
-    : Others(1, std::move(Other)) {}
+  AsyncIndexDelegate(std::shared_ptr<IndexSystemDelegate> Other,
+                     std::chrono::milliseconds batchInterval)
+    : BatchInterval(batchInterval) {
+    S->Others.push_back(std::move(Other));
+  }
 
   ~AsyncIndexDelegate() {
     _wait(); // Ensure the queue is drained, since we capture `this`.
@@ -56,67 +94,167 @@ public:
 
   void addDelegate(std::shared_ptr<IndexSystemDelegate> Other) {
     Queue.dispatchSync([&] {
-      if (PendingActions)
-        Other->processingAddedPending(PendingActions);
-      Others.push_back(std::move(Other));
+      if (S->PendingActions)
+        Other->processingAddedPending(S->PendingActions);
+      S->Others.push_back(std::move(Other));
     });
   }
 
 private:
+  /// Adds to the batch with \p add and schedules its delivery if it was
+  /// empty.
+  template <typename Fn>
+  void addToBatch(Fn add) {
+    {
+      llvm::sys::ScopedLock L(S->BatchMtx);
+      add(*S);
+      if (S->FlushScheduled)
+        return;
+      S->FlushScheduled = true;
+    }
+    auto state = S;
+    auto flush = [state]{ state->flush(); };
+    if (BatchInterval.count() == 0)
+      Queue.dispatch(std::move(flush));
+    else
+      Queue.dispatchAfter(BatchInterval, std::move(flush));
+  }
+
   virtual void initialPendingUnits(unsigned numUnits) override {
     Queue.dispatch([this, numUnits]{
-      for (auto &other : Others)
+      for (auto &other : S->Others)
         other->initialPendingUnits(numUnits);
     });
   }
 
   virtual void processingAddedPending(unsigned NumActions) override {
+    // Delivered right away, ahead of the completion of these actions which
+    // may be batched.
     Queue.dispatch([this, NumActions]{
-      PendingActions += NumActions;
-      for (auto &other : Others)
+      S->PendingActions += NumActions;
+      for (auto &other : S->Others)
         other->processingAddedPending(NumActions);
     });
   }
 
   virtual void processingCompleted(unsigned NumActions) override {
-    Queue.dispatch([this, NumActions]{
-      assert(NumActions <= PendingActions);
-      PendingActions -= NumActions;
-      for (auto &other : Others)
-        other->processingCompleted(NumActions);
+    addToBatch([&](State &state) {
+      state.BatchedCompleted += NumActions;
     });
   }
 
   virtual void processedStoreUnit(StoreUnitInfo unitInfo) override {
-    Queue.dispatch([this, unitInfo]{
-      for (auto &other : Others)
-        other->processedStoreUnit(unitInfo);
+    addToBatch([&](State &state) {
+      state.BatchedUnits.push_back(UnitEvent{std::move(unitInfo), nullptr});
+    });
+  }
+
+  virtual void processedStoreUnits(ArrayRef<StoreUnitInfo> unitInfos) override {
+    addToBatch([&](State &state) {
+      for (const StoreUnitInfo &unitInfo : unitInfos)
+        state.BatchedUnits.push_back(UnitEvent{unitInfo, nullptr});
     });
   }
 
   virtual void unitIsOutOfDate(StoreUnitInfo unitInfo,
                                OutOfDateFileTriggerRef trigger,
                                bool synchronous) override {
+    OutOfDateUnit unit{std::move(unitInfo), std::move(trigger)};
+    unitsAreOutOfDate(unit, synchronous);
+  }
+
+  virtual void unitsAreOutOfDate(ArrayRef<OutOfDateUnit> units,
+                                 bool synchronous) override {
     if (synchronous) {
-      Queue.dispatchSync(
-          [this, unitInfo = std::move(unitInfo), trigger = std::move(trigger)] {
-            for (auto &other : Others)
-              other->unitIsOutOfDate(unitInfo, trigger, /*synchronous*/ true);
-          });
+      Queue.dispatchSync([&] {
+        // Keep the order with the events before these.
+        S->flush();
+        for (auto &other : S->Others)
+          other->unitsAreOutOfDate(units, /*synchronous*/ true);
+      });
       return;
     }
 
-    Queue.dispatch(
-        [this, unitInfo = std::move(unitInfo), trigger = std::move(trigger)] {
-          for (auto &other : Others)
-            other->unitIsOutOfDate(unitInfo, trigger, /*synchronous*/ false);
-        });
+    addToBatch([&](State &state) {
+      for (const OutOfDateUnit &unit : units)
+        state.BatchedUnits.push_back(UnitEvent{unit.UnitInfo, unit.Trigger});
+    });
   }
 
 public:
   /// Public for Testing. Wait for any outstanding async work to finish.
   void _wait() {
-    Queue.dispatchSync([]{});
+    Queue.dispatchSync([this]{
+      S->flush();
+    });
+  }
+};
+
+void AsyncIndexDelegate::State::flush() {
+  std::vector<UnitEvent> units;
+  unsigned numCompleted;
+  {
+    llvm::sys::ScopedLock L(BatchMtx);
+    units = std::move(BatchedUnits);
+    BatchedUnits.clear();
+    numCompleted = BatchedCompleted;
+    BatchedCompleted = 0;
+    FlushScheduled = false;
+  }
+
+  // Deliver the runs of processed and out-of-date units in the order they
+  // came in.
+  for (auto it = units.begin(), end = units.end(); it != end;) {
+    bool isOutOfDate = it->Trigger != nullptr;
+    auto runEnd = std::find_if(it, end, [&](const UnitEvent &unit) {
+      return (unit.Trigger != nullptr) != isOutOfDate;
+    });
+    if (isOutOfDate) {
+      std::vector<OutOfDateUnit> outOfDateUnits;
+      outOfDateUnits.reserve(runEnd - it);
+      for (; it != runEnd; ++it)
+        outOfDateUnits.push_back(OutOfDateUnit{std::move(it->UnitInfo), std::move(it->Trigger)});
+      for (auto &other : Others)
+        other->unitsAreOutOfDate(outOfDateUnits, /*synchronous*/ false);
+    } else {
+      std::vector<StoreUnitInfo> unitInfos;
+      unitInfos.reserve(runEnd - it);
+      for (; it != runEnd; ++it)
+        unitInfos.push_back(std::move(it->UnitInfo));
+      for (auto &other : Others)
+        other->processedStoreUnits(unitInfos);
+    }
+  }
+
+  if (numCompleted) {
+    assert(numCompleted <= PendingActions);
+    PendingActions -= numCompleted;
+    for (auto &other : Others)
+      other->processingCompleted(numCompleted);
+  }
+}
+
+/// Trims the caches to fit the memory budget whenever all the pending unit
+/// imports are done, which is when they have grown the most.
+class MemoryBudgetDelegate : public IndexSystemDelegate {
+  std::weak_ptr<MemoryGovernor> Governor;
+  unsigned PendingActions = 0;
+
+public:
+  MemoryBudgetDelegate(std::shared_ptr<MemoryGovernor> governor)
+    : Governor(std::move(governor)) {}
+
+private:
+  virtual void processingAddedPending(unsigned NumActions) override {
+    PendingActions += NumActions;
+  }
+
+  virtual void processingCompleted(unsigned NumActions) override {
+    PendingActions -= NumActions;
+    if (PendingActions != 0)
+      return;
+    if (auto governor = Governor.lock())
+      governor->enforceBudget();
   }
 };
 
@@ -127,6 +265,7 @@ class IndexSystemImpl {
   SymbolIndexRef SymIndex;
   FilePathIndexRef PathIndex;
   std::shared_ptr<FileVisibilityChecker> VisibilityChecker;
+  std::shared_ptr<MemoryGovernor> Governor;
 
   std::unique_ptr<IndexDatastore> IndexStore;
 
@@ -148,13 +287,21 @@ public:
 
   void addUnitOutFilePaths(ArrayRef<StringRef> filePaths, bool waitForProcessing);
   void removeUnitOutFilePaths(ArrayRef<StringRef> filePaths, bool waitForProcessing);
+  void setUnitOutFilePaths(ArrayRef<StringRef> filePaths, bool waitForProcessing);
+
+  void prioritizeFiles(ArrayRef<StringRef> filePaths);
 
   void purgeStaleData();
 
+  std::vector<MemoryUsage> getMemoryUsage();
+  void trimMemory(MemoryTrimLevel level);
+
   /// *For Testing* Poll for any changes to units and wait until they have been registered.
   void pollForUnitChangesAndWait(bool isInitialScan);
 
   void printStats(raw_ostream &OS);
+  bool exportSnapshot(StringRef destPath, const PathPrefixMap &prefixMap, std::string &error);
+  void writeMetricsJSON(raw_ostream &OS);
 
   void dumpProviderFileAssociations(raw_ostream &OS);
 
@@ -167,22 +314,35 @@ public:
                                          function_ref<bool(SymbolOccurrenceRef Occur)> Receiver);
 
   bool foreachSymbolOccurrenceByUSR(StringRef USR, SymbolRoleSet RoleSet,
-                                    function_ref<bool(SymbolOccurrenceRef Occur)> Receiver);
+                                    function_ref<bool(SymbolOccurrenceRef Occur)> Receiver,
+                                    CancellationTokenRef CancelToken = nullptr);
+
+  bool foreachSymbolOccurrenceViewByUSR(StringRef USR, SymbolRoleSet RoleSet,
+                                        function_ref<bool(const SymbolOccurrenceView &Occur)> Receiver,
+                                        CancellationTokenRef CancelToken);
+
+  bool foreachRelatedSymbolOccurrenceViewByUSR(StringRef USR, SymbolRoleSet RoleSet,
+                                               function_ref<bool(const SymbolOccurrenceView &Occur)> Receiver,
+                                               CancellationTokenRef CancelToken);
 
   bool foreachCanonicalSymbolOccurrenceContainingPattern(StringRef Pattern,
                                                 bool AnchorStart,
                                                 bool AnchorEnd,
                                                 bool Subsequence,
                                                 bool IgnoreCase,
-                              function_ref<bool(SymbolOccurrenceRef)> Receiver);
+                              function_ref<bool(SymbolOccurrenceRef)> Receiver,
+                              CancellationTokenRef CancelToken);
 
   bool foreachCanonicalSymbolOccurrenceByName(StringRef name,
-                        function_ref<bool(SymbolOccurrenceRef Occur)> receiver);
+                        function_ref<bool(SymbolOccurrenceRef Occur)> receiver,
+                        CancellationTokenRef cancelToken);
 
-  bool foreachSymbolName(function_ref<bool(StringRef name)> receiver);
+  bool foreachSymbolName(function_ref<bool(StringRef name)> receiver,
+                         CancellationTokenRef cancelToken);
 
   bool foreachRelatedSymbolOccurrenceByUSR(StringRef USR, SymbolRoleSet RoleSet,
-                                    function_ref<bool(SymbolOccurrenceRef Occur)> Receiver);
+                                    function_ref<bool(SymbolOccurrenceRef Occur)> Receiver,
+                                    CancellationTokenRef CancelToken = nullptr);
 
   bool foreachCanonicalSymbolOccurrenceByUSR(StringRef USR,
                         function_ref<bool(SymbolOccurrenceRef occur)> receiver);
@@ -190,27 +350,35 @@ public:
   bool foreachSymbolCallOccurrence(SymbolOccurrenceRef Callee,
                         function_ref<bool(SymbolOccurrenceRef Occur)> Receiver);
 
+  SymbolOccurrenceCount countSymbolOccurrencesByUSR(StringRef USR, SymbolRoleSet RoleSet);
+  SymbolOccurrenceCount countRelatedSymbolOccurrencesByUSR(StringRef USR, SymbolRoleSet RoleSet);
+
   size_t countOfCanonicalSymbolsWithKind(SymbolKind symKind, bool workspaceOnly);
+  size_t estimateCountOfSymbolsWithKind(SymbolKind symKind);
   bool foreachCanonicalSymbolOccurrenceByKind(SymbolKind symKind, bool workspaceOnly,
-                                              function_ref<bool(SymbolOccurrenceRef Occur)> Receiver);
+                                              function_ref<bool(SymbolOccurrenceRef Occur)> Receiver,
+                                              CancellationTokenRef CancelToken);
 
   std::vector<SymbolRef> getBaseMethodsOrClasses(SymbolRef Sym);
 
   bool isKnownFile(StringRef filePath);
 
   bool foreachMainUnitContainingFile(StringRef filePath,
-                                 function_ref<bool(const StoreUnitInfo &unitInfo)> receiver);
+                                 function_ref<bool(const StoreUnitInfo &unitInfo)> receiver,
+                                 CancellationTokenRef cancelToken);
 
   bool foreachFileOfUnit(StringRef unitName,
                          bool followDependencies,
-                         function_ref<bool(CanonicalFilePathRef filePath)> receiver);
+                         function_ref<bool(CanonicalFilePathRef filePath)> receiver,
+                         CancellationTokenRef cancelToken);
 
   bool foreachFilenameContainingPattern(StringRef Pattern,
                                         bool AnchorStart,
                                         bool AnchorEnd,
                                         bool Subsequence,
                                         bool IgnoreCase,
-                               function_ref<bool(CanonicalFilePathRef FilePath)> Receiver);
+                               function_ref<bool(CanonicalFilePathRef FilePath)> Receiver,
+                               CancellationTokenRef CancelToken);
 
   bool foreachFileIncludingFile(StringRef TargetPath,
                                 function_ref<bool(CanonicalFilePathRef SourcePath, unsigned Line)> Receiver);
@@ -222,7 +390,8 @@ public:
                             function_ref<bool(CanonicalFilePathRef sourcePath, CanonicalFilePathRef targetPath, unsigned line)> receiver);
 
   bool foreachUnitTestSymbolReferencedByOutputPaths(ArrayRef<CanonicalFilePathRef> FilePaths,
-      function_ref<bool(SymbolOccurrenceRef Occur)> Receiver);
+      function_ref<bool(SymbolOccurrenceRef Occur)> Receiver,
+      CancellationTokenRef CancelToken);
 
   /// Calls `receiver` for every unit test symbol in unit files that reference
   /// one of the main files in `mainFilePaths`.
@@ -230,13 +399,15 @@ public:
   ///  \returns `false` if the receiver returned `false` to stop receiving symbols, `true` otherwise.
   bool foreachUnitTestSymbolReferencedByMainFiles(
       ArrayRef<StringRef> mainFilePaths,
-      function_ref<bool(SymbolOccurrenceRef Occur)> receiver
+      function_ref<bool(SymbolOccurrenceRef Occur)> receiver,
+      CancellationTokenRef cancelToken
   );
 
   /// Calls `receiver` for every unit test symbol in the index.
   ///
   ///  \returns `false` if the receiver returned `false` to stop receiving symbols, `true` otherwise.
-  bool foreachUnitTestSymbol(function_ref<bool(SymbolOccurrenceRef Occur)> receiver);
+  bool foreachUnitTestSymbol(function_ref<bool(SymbolOccurrenceRef Occur)> receiver,
+                             CancellationTokenRef cancelToken);
 
   /// Returns the latest modification date of a unit that contains the given source file.
   ///
@@ -255,9 +426,18 @@ bool IndexSystemImpl::init(StringRef StorePath,
                            std::string &Error) {
   this->StorePath = StorePath;
   this->DBasePath = dbasePath;
-  this->DelegateWrap = std::make_shared<AsyncIndexDelegate>(Delegate);
+  this->DelegateWrap = std::make_shared<AsyncIndexDelegate>(Delegate, options.delegateBatchInterval);
+
+  if (!options.readonly && !options.snapshotPath.empty()) {
+    // Without the snapshot the database gets filled by the initial scan.
+    std::string seedError;
+    if (db::Database::seedFromSnapshot(dbasePath, options.snapshotPath, options.snapshotPrefixMap, seedError))
+      LOG_WARN_FUNC("failed seeding database: " << seedError);
+  }
 
-  auto dbase = db::Database::create(dbasePath, options.readonly, initialDBSize, Error);
+  auto dbase = options.shareDatabase
+    ? db::Database::createShared(dbasePath, options.readonly, initialDBSize, Error)
+    : db::Database::create(dbasePath, options.readonly, initialDBSize, Error);
   if (!dbase)
     return true;
 
@@ -282,10 +462,12 @@ bool IndexSystemImpl::init(StringRef StorePath,
   auto canonPathCache = std::make_shared<CanonicalPathCache>();
 
   this->VisibilityChecker = std::make_shared<FileVisibilityChecker>(dbase, canonPathCache, options.useExplicitOutputUnits);
-  this->SymIndex = std::make_shared<SymbolIndex>(dbase, idxStore, this->VisibilityChecker);
+  this->SymIndex = std::make_shared<SymbolIndex>(dbase, idxStore, this->VisibilityChecker,
+                                                 options.recordOccurrenceCounts);
   this->PathIndex = std::make_shared<FilePathIndex>(dbase, idxStore, this->VisibilityChecker,
                                                     canonPathCache);
   this->IndexStore = IndexDatastore::create(idxStore,
+                                            StorePath,
                                             this->SymIndex,
                                             this->DelegateWrap,
                                             canonPathCache,
@@ -294,6 +476,29 @@ bool IndexSystemImpl::init(StringRef StorePath,
 
   if (!this->IndexStore)
     return true;
+
+  this->Governor = std::make_shared<MemoryGovernor>(options.memoryBudget);
+  std::weak_ptr<CanonicalPathCache> weakCanonPathCache = canonPathCache;
+  this->Governor->addConsumer("canonical_paths", [weakCanonPathCache]() -> size_t {
+    if (auto canonPathCache = weakCanonPathCache.lock())
+      return canonPathCache->getMemoryUsage();
+    return 0;
+  }, [weakCanonPathCache](MemoryTrimLevel level) {
+    if (auto canonPathCache = weakCanonPathCache.lock())
+      canonPathCache->clear();
+  });
+  std::weak_ptr<FileVisibilityChecker> weakVisibilityChecker = this->VisibilityChecker;
+  this->Governor->addConsumer("unit_visibility", [weakVisibilityChecker]() -> size_t {
+    if (auto visibilityChecker = weakVisibilityChecker.lock())
+      return visibilityChecker->getMemoryUsage();
+    return 0;
+  }, [weakVisibilityChecker](MemoryTrimLevel level) {
+    if (auto visibilityChecker = weakVisibilityChecker.lock())
+      visibilityChecker->clearUnitVisibilityCache();
+  });
+  this->IndexStore->addMemoryConsumers(*this->Governor);
+  if (options.memoryBudget != 0)
+    this->DelegateWrap->addDelegate(std::make_shared<MemoryBudgetDelegate>(this->Governor));
   return false;
 }
 
@@ -310,11 +515,13 @@ void IndexSystemImpl::checkUnitContainingFileIsOutOfDate(StringRef file) {
 }
 
 void IndexSystemImpl::registerMainFiles(ArrayRef<StringRef> filePaths, StringRef productName) {
-  return VisibilityChecker->registerMainFiles(filePaths, productName);
+  VisibilityChecker->registerMainFiles(filePaths, productName);
+  IndexStore->prioritizeFiles(filePaths, /*remember=*/true);
 }
 
 void IndexSystemImpl::unregisterMainFiles(ArrayRef<StringRef> filePaths, StringRef productName) {
-  return VisibilityChecker->unregisterMainFiles(filePaths, productName);
+  VisibilityChecker->unregisterMainFiles(filePaths, productName);
+  IndexStore->unprioritizeFiles(filePaths);
 }
 
 void IndexSystemImpl::addUnitOutFilePaths(ArrayRef<StringRef> filePaths, bool waitForProcessing) {
@@ -327,6 +534,15 @@ void IndexSystemImpl::removeUnitOutFilePaths(ArrayRef<StringRef> filePaths, bool
   IndexStore->removeUnitOutFilePaths(filePaths, waitForProcessing);
 }
 
+void IndexSystemImpl::setUnitOutFilePaths(ArrayRef<StringRef> filePaths, bool waitForProcessing) {
+  VisibilityChecker->setUnitOutFilePaths(filePaths);
+  IndexStore->setUnitOutFilePaths(filePaths, waitForProcessing);
+}
+
+void IndexSystemImpl::prioritizeFiles(ArrayRef<StringRef> filePaths) {
+  IndexStore->prioritizeFiles(filePaths, /*remember=*/false);
+}
+
 void IndexSystemImpl::purgeStaleData() {
   IndexStore->purgeStaleData();
 }
@@ -336,8 +552,56 @@ void IndexSystemImpl::pollForUnitChangesAndWait(bool isInitialScan) {
   DelegateWrap->_wait();
 }
 
+std::vector<MemoryUsage> IndexSystemImpl::getMemoryUsage() {
+  return Governor->getMemoryUsage();
+}
+
+void IndexSystemImpl::trimMemory(MemoryTrimLevel level) {
+  Governor->trimMemory(level);
+}
+
 void IndexSystemImpl::printStats(raw_ostream &OS) {
   SymIndex->printStats(OS);
+  metrics::Registry::get().print(OS);
+}
+
+bool IndexSystemImpl::exportSnapshot(StringRef destPath, const PathPrefixMap &prefixMap, std::string &error) {
+  return SymIndex->getDBase()->exportSnapshot(destPath, prefixMap, error);
+}
+
+void IndexSystemImpl::writeMetricsJSON(raw_ostream &OS) {
+  llvm::json::Value metricsJSON = metrics::Registry::get().toJSON();
+  db::DatabaseStats stats = SymIndex->getDBase()->getStats();
+  llvm::json::Array tables;
+  for (const auto &table : stats.Tables) {
+    tables.push_back(llvm::json::Object{
+      {"name", table.Name},
+      {"depth", table.Depth},
+      {"branch_pages", int64_t(table.BranchPages)},
+      {"leaf_pages", int64_t(table.LeafPages)},
+      {"overflow_pages", int64_t(table.OverflowPages)},
+      {"entries", int64_t(table.Entries)},
+    });
+  }
+  metricsJSON.getAsObject()->try_emplace("database", llvm::json::Object{
+    {"map_size", int64_t(stats.MapSize)},
+    {"page_size", stats.PageSize},
+    {"tables", std::move(tables)},
+  });
+  if (auto processing = IndexStore ? IndexStore->getUnitProcessingStats() : None) {
+    auto toMicroseconds = [](std::chrono::nanoseconds duration) -> int64_t {
+      return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+    };
+    metricsJSON.getAsObject()->try_emplace("unit_processing", llvm::json::Object{
+      {"weight", int64_t(processing->Weight)},
+      {"queued_work", int64_t(processing->QueuedWork)},
+      {"scheduled_work", int64_t(processing->ScheduledWork)},
+      {"total_wait_us", toMicroseconds(processing->TotalWaitTime)},
+      {"max_wait_us", toMicroseconds(processing->MaxWaitTime)},
+      {"total_run_us", toMicroseconds(processing->TotalRunTime)},
+    });
+  }
+  OS << llvm::formatv("{0:2}", metricsJSON) << '\n';
 }
 
 void IndexSystemImpl::dumpProviderFileAssociations(raw_ostream &OS) {
@@ -350,14 +614,30 @@ void IndexSystemImpl::addDelegate(std::shared_ptr<IndexSystemDelegate> Delegate)
 
 bool IndexSystemImpl::foreachSymbolOccurrenceByUSR(StringRef USR,
                                                     SymbolRoleSet RoleSet,
-                       function_ref<bool(SymbolOccurrenceRef Occur)> Receiver) {
-  return SymIndex->foreachSymbolOccurrenceByUSR(USR, RoleSet, std::move(Receiver));
+                       function_ref<bool(SymbolOccurrenceRef Occur)> Receiver,
+                       CancellationTokenRef CancelToken) {
+  return SymIndex->foreachSymbolOccurrenceByUSR(USR, RoleSet, std::move(Receiver), std::move(CancelToken));
 }
 
 bool IndexSystemImpl::foreachRelatedSymbolOccurrenceByUSR(StringRef USR,
                                                     SymbolRoleSet RoleSet,
-                       function_ref<bool(SymbolOccurrenceRef Occur)> Receiver) {
-  return SymIndex->foreachRelatedSymbolOccurrenceByUSR(USR, RoleSet, std::move(Receiver));
+                       function_ref<bool(SymbolOccurrenceRef Occur)> Receiver,
+                       CancellationTokenRef CancelToken) {
+  return SymIndex->foreachRelatedSymbolOccurrenceByUSR(USR, RoleSet, std::move(Receiver), std::move(CancelToken));
+}
+
+bool IndexSystemImpl::foreachSymbolOccurrenceViewByUSR(StringRef USR,
+                                                        SymbolRoleSet RoleSet,
+                       function_ref<bool(const SymbolOccurrenceView &Occur)> Receiver,
+                       CancellationTokenRef CancelToken) {
+  return SymIndex->foreachSymbolOccurrenceViewByUSR(USR, RoleSet, std::move(Receiver), std::move(CancelToken));
+}
+
+bool IndexSystemImpl::foreachRelatedSymbolOccurrenceViewByUSR(StringRef USR,
+                                                               SymbolRoleSet RoleSet,
+                       function_ref<bool(const SymbolOccurrenceView &Occur)> Receiver,
+                       CancellationTokenRef CancelToken) {
+  return SymIndex->foreachRelatedSymbolOccurrenceViewByUSR(USR, RoleSet, std::move(Receiver), std::move(CancelToken));
 }
 
 bool IndexSystemImpl::foreachCanonicalSymbolOccurrenceContainingPattern(StringRef Pattern,
@@ -365,19 +645,22 @@ bool IndexSystemImpl::foreachCanonicalSymbolOccurrenceContainingPattern(StringRe
                                                                bool AnchorEnd,
                                                                bool Subsequence,
                                                                bool IgnoreCase,
-                             function_ref<bool(SymbolOccurrenceRef)> Receiver) {
+                             function_ref<bool(SymbolOccurrenceRef)> Receiver,
+                             CancellationTokenRef CancelToken) {
   return SymIndex->foreachCanonicalSymbolOccurrenceContainingPattern(Pattern, AnchorStart, AnchorEnd,
                                                             Subsequence, IgnoreCase,
-                                                            std::move(Receiver));
+                                                            std::move(Receiver), std::move(CancelToken));
 }
 
 bool IndexSystemImpl::foreachCanonicalSymbolOccurrenceByName(StringRef name,
-                       function_ref<bool(SymbolOccurrenceRef Occur)> receiver) {
-  return SymIndex->foreachCanonicalSymbolOccurrenceByName(name, std::move(receiver));
+                       function_ref<bool(SymbolOccurrenceRef Occur)> receiver,
+                       CancellationTokenRef cancelToken) {
+  return SymIndex->foreachCanonicalSymbolOccurrenceByName(name, std::move(receiver), std::move(cancelToken));
 }
 
-bool IndexSystemImpl::foreachSymbolName(function_ref<bool(StringRef name)> receiver) {
-  return SymIndex->foreachSymbolName(std::move(receiver));
+bool IndexSystemImpl::foreachSymbolName(function_ref<bool(StringRef name)> receiver,
+                                        CancellationTokenRef cancelToken) {
+  return SymIndex->foreachSymbolName(std::move(receiver), std::move(cancelToken));
 }
 
 bool IndexSystemImpl::foreachCanonicalSymbolOccurrenceByUSR(StringRef USR,
@@ -549,13 +832,26 @@ bool IndexSystemImpl::foreachSymbolCallOccurrence(SymbolOccurrenceRef Callee,
   return true;
 }
 
+SymbolOccurrenceCount IndexSystemImpl::countSymbolOccurrencesByUSR(StringRef USR, SymbolRoleSet RoleSet) {
+  return SymIndex->countSymbolOccurrencesByUSR(USR, RoleSet);
+}
+
+SymbolOccurrenceCount IndexSystemImpl::countRelatedSymbolOccurrencesByUSR(StringRef USR, SymbolRoleSet RoleSet) {
+  return SymIndex->countRelatedSymbolOccurrencesByUSR(USR, RoleSet);
+}
+
 size_t IndexSystemImpl::countOfCanonicalSymbolsWithKind(SymbolKind symKind, bool workspaceOnly) {
   return SymIndex->countOfCanonicalSymbolsWithKind(symKind, workspaceOnly);
 }
 
+size_t IndexSystemImpl::estimateCountOfSymbolsWithKind(SymbolKind symKind) {
+  return SymIndex->estimateCountOfSymbolsWithKind(symKind);
+}
+
 bool IndexSystemImpl::foreachCanonicalSymbolOccurrenceByKind(SymbolKind symKind, bool workspaceOnly,
-                                                             function_ref<bool(SymbolOccurrenceRef Occur)> Receiver) {
-  return SymIndex->foreachCanonicalSymbolOccurrenceByKind(symKind, workspaceOnly, std::move(Receiver));
+                                                             function_ref<bool(SymbolOccurrenceRef Occur)> Receiver,
+                                                             CancellationTokenRef CancelToken) {
+  return SymIndex->foreachCanonicalSymbolOccurrenceByKind(symKind, workspaceOnly, std::move(Receiver), std::move(CancelToken));
 }
 
 std::vector<SymbolRef>
@@ -571,27 +867,34 @@ bool IndexSystemImpl::isKnownFile(StringRef filePath) {
 }
 
 bool IndexSystemImpl::foreachMainUnitContainingFile(StringRef filePath,
-                                                    function_ref<bool(const StoreUnitInfo &unitInfo)> receiver) {
+                                                    function_ref<bool(const StoreUnitInfo &unitInfo)> receiver,
+                                                    CancellationTokenRef cancelToken) {
+    // A file that is being queried is likely open in an editor, import its
+    // pending units first.
+    IndexStore->prioritizeFiles(filePath, /*remember=*/false);
     auto canonPath = PathIndex->getCanonicalPath(filePath);
-    return PathIndex->foreachMainUnitContainingFile(canonPath, std::move(receiver));
+    return PathIndex->foreachMainUnitContainingFile(canonPath, std::move(receiver), std::move(cancelToken));
 }
 
 bool IndexSystemImpl::foreachSymbolInFilePath(StringRef filePath,
                                               function_ref<bool(const SymbolRef &symbol)> receiver) {
+    IndexStore->prioritizeFiles(filePath, /*remember=*/false);
     auto canonPath = PathIndex->getCanonicalPath(filePath);
     return SymIndex->foreachSymbolInFilePath(canonPath, std::move(receiver));
 }
 
 bool IndexSystemImpl::foreachSymbolOccurrenceInFilePath(StringRef filePath,
                                                         function_ref<bool(SymbolOccurrenceRef Occur)> Receiver) {
+  IndexStore->prioritizeFiles(filePath, /*remember=*/false);
   auto canonPath = PathIndex->getCanonicalPath(filePath);
   return SymIndex->foreachSymbolOccurrenceInFilePath(canonPath, std::move(Receiver));
 }
 
 bool IndexSystemImpl::foreachFileOfUnit(StringRef unitName,
                                         bool followDependencies,
-                                        function_ref<bool(CanonicalFilePathRef filePath)> receiver) {
-  return PathIndex->foreachFileOfUnit(unitName, followDependencies, std::move(receiver));
+                                        function_ref<bool(CanonicalFilePathRef filePath)> receiver,
+                                        CancellationTokenRef cancelToken) {
+  return PathIndex->foreachFileOfUnit(unitName, followDependencies, std::move(receiver), std::move(cancelToken));
 }
 
 bool IndexSystemImpl::foreachFilenameContainingPattern(StringRef Pattern,
@@ -599,11 +902,12 @@ bool IndexSystemImpl::foreachFilenameContainingPattern(StringRef Pattern,
                                                        bool AnchorEnd,
                                                        bool Subsequence,
                                                        bool IgnoreCase,
-                              function_ref<bool(CanonicalFilePathRef FilePath)> Receiver) {
+                              function_ref<bool(CanonicalFilePathRef FilePath)> Receiver,
+                              CancellationTokenRef CancelToken) {
   return PathIndex->foreachFilenameContainingPattern(Pattern, AnchorStart,
                                                      AnchorEnd,
                                                      Subsequence, IgnoreCase,
-                                                     std::move(Receiver));
+                                                     std::move(Receiver), std::move(CancelToken));
 }
 
 bool IndexSystemImpl::foreachFileIncludingFile(StringRef TargetPath,
@@ -623,23 +927,26 @@ bool IndexSystemImpl::foreachIncludeOfUnit(StringRef unitName,
   return PathIndex->foreachIncludeOfUnit(unitName, receiver);
 }
 
-bool IndexSystemImpl::foreachUnitTestSymbolReferencedByOutputPaths(ArrayRef<CanonicalFilePathRef> FilePaths, function_ref<bool(SymbolOccurrenceRef Occur)> Receiver) {
-  return SymIndex->foreachUnitTestSymbolReferencedByOutputPaths(FilePaths, std::move(Receiver));
+bool IndexSystemImpl::foreachUnitTestSymbolReferencedByOutputPaths(ArrayRef<CanonicalFilePathRef> FilePaths, function_ref<bool(SymbolOccurrenceRef Occur)> Receiver,
+                                                                   CancellationTokenRef CancelToken) {
+  return SymIndex->foreachUnitTestSymbolReferencedByOutputPaths(FilePaths, std::move(Receiver), std::move(CancelToken));
 }
 
 bool IndexSystemImpl::foreachUnitTestSymbolReferencedByMainFiles(
     ArrayRef<StringRef> mainFilePaths,
-    function_ref<bool(SymbolOccurrenceRef Occur)> receiver
+    function_ref<bool(SymbolOccurrenceRef Occur)> receiver,
+    CancellationTokenRef cancelToken
 ) {
   std::vector<CanonicalFilePath> canonicalMainFilesPaths;
   for (StringRef mainFilePath : mainFilePaths) {
     canonicalMainFilesPaths.push_back(PathIndex->getCanonicalPath(mainFilePath));
   }
-  return SymIndex->foreachUnitTestSymbolReferencedByMainFiles(canonicalMainFilesPaths, std::move(receiver));
+  return SymIndex->foreachUnitTestSymbolReferencedByMainFiles(canonicalMainFilesPaths, std::move(receiver), std::move(cancelToken));
 }
 
-bool IndexSystemImpl::foreachUnitTestSymbol(function_ref<bool(SymbolOccurrenceRef Occur)> receiver) {
-  return SymIndex->foreachUnitTestSymbol(std::move(receiver));
+bool IndexSystemImpl::foreachUnitTestSymbol(function_ref<bool(SymbolOccurrenceRef Occur)> receiver,
+                                            CancellationTokenRef cancelToken) {
+  return SymIndex->foreachUnitTestSymbol(std::move(receiver), std::move(cancelToken));
 }
 
 llvm::Optional<llvm::sys::TimePoint<>> IndexSystemImpl::timestampOfLatestUnitForFile(StringRef filePath) {
@@ -674,10 +981,60 @@ IndexSystem::create(StringRef StorePath,
 
 #define IMPL static_cast<IndexSystemImpl*>(Impl)
 
+// Latencies of the queries as seen by clients, including the time spent in
+// their receivers.
+static metrics::Histogram SymbolOccurrencesByUSRLatency("query.symbol_occurrences_by_usr", "Latency of foreachSymbolOccurrenceByUSR");
+static metrics::Histogram RelatedSymbolOccurrencesByUSRLatency("query.related_symbol_occurrences_by_usr", "Latency of foreachRelatedSymbolOccurrenceByUSR");
+static metrics::Histogram SymbolOccurrenceViewsByUSRLatency("query.symbol_occurrence_views_by_usr", "Latency of foreachSymbolOccurrenceViewByUSR");
+static metrics::Histogram RelatedSymbolOccurrenceViewsByUSRLatency("query.related_symbol_occurrence_views_by_usr", "Latency of foreachRelatedSymbolOccurrenceViewByUSR");
+static metrics::Histogram CanonicalOccurrencesContainingPatternLatency("query.canonical_occurrences_containing_pattern", "Latency of foreachCanonicalSymbolOccurrenceContainingPattern");
+static metrics::Histogram CanonicalOccurrencesByNameLatency("query.canonical_occurrences_by_name", "Latency of foreachCanonicalSymbolOccurrenceByName");
+static metrics::Histogram CanonicalOccurrencesByUSRLatency("query.canonical_occurrences_by_usr", "Latency of foreachCanonicalSymbolOccurrenceByUSR");
+static metrics::Histogram CanonicalOccurrencesByKindLatency("query.canonical_occurrences_by_kind", "Latency of foreachCanonicalSymbolOccurrenceByKind");
+static metrics::Histogram SymbolOccurrencesInFileLatency("query.symbol_occurrences_in_file", "Latency of foreachSymbolOccurrenceInFilePath");
+static metrics::Histogram MainUnitsContainingFileLatency("query.main_units_containing_file", "Latency of foreachMainUnitContainingFile");
+static metrics::Histogram FilenamesContainingPatternLatency("query.filenames_containing_pattern", "Latency of foreachFilenameContainingPattern");
+
+/// Runs \p query on the query executor and delivers the occurrences that it
+/// reports to \p receiver in batches. The query retains \p index.
+static AsyncQueryRef foreachOccurrenceAsync(std::shared_ptr<IndexSystem> index,
+                                            const AsyncQueryOptions &options,
+    std::function<bool(IndexSystem &index, function_ref<bool(SymbolOccurrenceRef)> receiver,
+                       CancellationTokenRef cancelToken)> query,
+                                            SymbolOccurrenceBatchReceiver receiver,
+                                            AsyncQueryCompletion completion) {
+  size_t batchSize = std::max(options.BatchSize, size_t(1));
+  auto run = [index = std::move(index), query = std::move(query),
+              receiver = std::move(receiver), batchSize](const CancellationTokenRef &cancelToken) -> bool {
+    std::vector<SymbolOccurrenceRef> batch;
+    batch.reserve(batchSize);
+    bool finished = query(*index, [&](SymbolOccurrenceRef occur) -> bool {
+      batch.push_back(std::move(occur));
+      if (batch.size() < batchSize)
+        return true;
+      bool shouldContinue = receiver(batch);
+      batch.clear();
+      return shouldContinue;
+    }, cancelToken);
+    if (!finished || batch.empty())
+      return finished;
+    return receiver(batch);
+  };
+  return QueryExecutor::getShared().enqueue(options, std::move(run), std::move(completion));
+}
+
 IndexSystem::~IndexSystem() {
   delete IMPL;
 }
 
+void IndexSystem::setUnitProcessingConcurrency(unsigned concurrency) {
+  UnitProcessingScheduler::getShared().setConcurrency(concurrency);
+}
+
+void IndexSystem::setAsyncQueryConcurrency(unsigned concurrency) {
+  QueryExecutor::getShared().setConcurrency(concurrency);
+}
+
 bool IndexSystem::isUnitOutOfDate(StringRef unitOutputPath, ArrayRef<StringRef> dirtyFiles) {
   return IMPL->isUnitOutOfDate(unitOutputPath, dirtyFiles);
 }
@@ -706,6 +1063,14 @@ void IndexSystem::removeUnitOutFilePaths(ArrayRef<StringRef> filePaths, bool wai
   return IMPL->removeUnitOutFilePaths(filePaths, waitForProcessing);
 }
 
+void IndexSystem::setUnitOutFilePaths(ArrayRef<StringRef> filePaths, bool waitForProcessing) {
+  return IMPL->setUnitOutFilePaths(filePaths, waitForProcessing);
+}
+
+void IndexSystem::prioritizeFiles(ArrayRef<StringRef> filePaths) {
+  return IMPL->prioritizeFiles(filePaths);
+}
+
 void IndexSystem::purgeStaleData() {
   return IMPL->purgeStaleData();
 }
@@ -714,10 +1079,26 @@ void IndexSystem::pollForUnitChangesAndWait(bool isInitialScan) {
   IMPL->pollForUnitChangesAndWait(isInitialScan);
 }
 
+std::vector<MemoryUsage> IndexSystem::getMemoryUsage() {
+  return IMPL->getMemoryUsage();
+}
+
+void IndexSystem::trimMemory(MemoryTrimLevel level) {
+  return IMPL->trimMemory(level);
+}
+
 void IndexSystem::printStats(raw_ostream &OS) {
   return IMPL->printStats(OS);
 }
 
+bool IndexSystem::exportSnapshot(StringRef destPath, const PathPrefixMap &prefixMap, std::string &error) {
+  return IMPL->exportSnapshot(destPath, prefixMap, error);
+}
+
+void IndexSystem::writeMetricsJSON(raw_ostream &OS) {
+  return IMPL->writeMetricsJSON(OS);
+}
+
 void IndexSystem::dumpProviderFileAssociations(raw_ostream &OS) {
   return IMPL->dumpProviderFileAssociations(OS);
 }
@@ -732,14 +1113,34 @@ void IndexSystem::addDelegate(std::shared_ptr<IndexSystemDelegate> Delegate) {
 
 bool IndexSystem::foreachSymbolOccurrenceByUSR(StringRef USR,
                                                 SymbolRoleSet RoleSet,
-                       function_ref<bool(SymbolOccurrenceRef Occur)> Receiver) {
-  return IMPL->foreachSymbolOccurrenceByUSR(USR, RoleSet, std::move(Receiver));
+                       function_ref<bool(SymbolOccurrenceRef Occur)> Receiver,
+                       CancellationTokenRef CancelToken) {
+  metrics::Histogram::Timer timer(SymbolOccurrencesByUSRLatency);
+  return IMPL->foreachSymbolOccurrenceByUSR(USR, RoleSet, std::move(Receiver), std::move(CancelToken));
 }
 
 bool IndexSystem::foreachRelatedSymbolOccurrenceByUSR(StringRef USR,
                                                       SymbolRoleSet RoleSet,
-                       function_ref<bool(SymbolOccurrenceRef Occur)> Receiver) {
-  return IMPL->foreachRelatedSymbolOccurrenceByUSR(USR, RoleSet, std::move(Receiver));
+                       function_ref<bool(SymbolOccurrenceRef Occur)> Receiver,
+                       CancellationTokenRef CancelToken) {
+  metrics::Histogram::Timer timer(RelatedSymbolOccurrencesByUSRLatency);
+  return IMPL->foreachRelatedSymbolOccurrenceByUSR(USR, RoleSet, std::move(Receiver), std::move(CancelToken));
+}
+
+bool IndexSystem::foreachSymbolOccurrenceViewByUSR(StringRef USR,
+                                                    SymbolRoleSet RoleSet,
+                       function_ref<bool(const SymbolOccurrenceView &Occur)> Receiver,
+                       CancellationTokenRef CancelToken) {
+  metrics::Histogram::Timer timer(SymbolOccurrenceViewsByUSRLatency);
+  return IMPL->foreachSymbolOccurrenceViewByUSR(USR, RoleSet, std::move(Receiver), std::move(CancelToken));
+}
+
+bool IndexSystem::foreachRelatedSymbolOccurrenceViewByUSR(StringRef USR,
+                                                           SymbolRoleSet RoleSet,
+                       function_ref<bool(const SymbolOccurrenceView &Occur)> Receiver,
+                       CancellationTokenRef CancelToken) {
+  metrics::Histogram::Timer timer(RelatedSymbolOccurrenceViewsByUSRLatency);
+  return IMPL->foreachRelatedSymbolOccurrenceViewByUSR(USR, RoleSet, std::move(Receiver), std::move(CancelToken));
 }
 
 bool IndexSystem::foreachCanonicalSymbolOccurrenceContainingPattern(StringRef Pattern,
@@ -747,23 +1148,29 @@ bool IndexSystem::foreachCanonicalSymbolOccurrenceContainingPattern(StringRef Pa
                                                            bool AnchorEnd,
                                                            bool Subsequence,
                                                            bool IgnoreCase,
-                             function_ref<bool(SymbolOccurrenceRef)> Receiver) {
+                             function_ref<bool(SymbolOccurrenceRef)> Receiver,
+                             CancellationTokenRef CancelToken) {
+  metrics::Histogram::Timer timer(CanonicalOccurrencesContainingPatternLatency);
   return IMPL->foreachCanonicalSymbolOccurrenceContainingPattern(Pattern, AnchorStart, AnchorEnd,
                                                         Subsequence, IgnoreCase,
-                                                        std::move(Receiver));
+                                                        std::move(Receiver), std::move(CancelToken));
 }
 
 bool IndexSystem::foreachCanonicalSymbolOccurrenceByName(StringRef name,
-                       function_ref<bool(SymbolOccurrenceRef Occur)> receiver) {
-  return IMPL->foreachCanonicalSymbolOccurrenceByName(name, std::move(receiver));
+                       function_ref<bool(SymbolOccurrenceRef Occur)> receiver,
+                       CancellationTokenRef cancelToken) {
+  metrics::Histogram::Timer timer(CanonicalOccurrencesByNameLatency);
+  return IMPL->foreachCanonicalSymbolOccurrenceByName(name, std::move(receiver), std::move(cancelToken));
 }
 
-bool IndexSystem::foreachSymbolName(function_ref<bool(StringRef name)> receiver) {
-  return IMPL->foreachSymbolName(std::move(receiver));
+bool IndexSystem::foreachSymbolName(function_ref<bool(StringRef name)> receiver,
+                                    CancellationTokenRef cancelToken) {
+  return IMPL->foreachSymbolName(std::move(receiver), std::move(cancelToken));
 }
 
 bool IndexSystem::foreachCanonicalSymbolOccurrenceByUSR(StringRef USR,
                        function_ref<bool(SymbolOccurrenceRef occur)> receiver) {
+  metrics::Histogram::Timer timer(CanonicalOccurrencesByUSRLatency);
   return IMPL->foreachCanonicalSymbolOccurrenceByUSR(USR, std::move(receiver));
 }
 
@@ -773,13 +1180,88 @@ bool IndexSystem::foreachSymbolCallOccurrence(SymbolOccurrenceRef Callee,
                                            std::move(Receiver));
 }
 
+SymbolOccurrenceCount IndexSystem::countSymbolOccurrencesByUSR(StringRef USR, SymbolRoleSet RoleSet) {
+  return IMPL->countSymbolOccurrencesByUSR(USR, RoleSet);
+}
+
+SymbolOccurrenceCount IndexSystem::countRelatedSymbolOccurrencesByUSR(StringRef USR, SymbolRoleSet RoleSet) {
+  return IMPL->countRelatedSymbolOccurrencesByUSR(USR, RoleSet);
+}
+
 size_t IndexSystem::countOfCanonicalSymbolsWithKind(SymbolKind symKind, bool workspaceOnly) {
   return IMPL->countOfCanonicalSymbolsWithKind(symKind, workspaceOnly);
 }
 
+size_t IndexSystem::estimateCountOfSymbolsWithKind(SymbolKind symKind) {
+  return IMPL->estimateCountOfSymbolsWithKind(symKind);
+}
+
 bool IndexSystem::foreachCanonicalSymbolOccurrenceByKind(SymbolKind symKind, bool workspaceOnly,
-                                                         function_ref<bool(SymbolOccurrenceRef Occur)> Receiver) {
-  return IMPL->foreachCanonicalSymbolOccurrenceByKind(symKind, workspaceOnly, std::move(Receiver));
+                                                         function_ref<bool(SymbolOccurrenceRef Occur)> Receiver,
+                                                         CancellationTokenRef CancelToken) {
+  metrics::Histogram::Timer timer(CanonicalOccurrencesByKindLatency);
+  return IMPL->foreachCanonicalSymbolOccurrenceByKind(symKind, workspaceOnly, std::move(Receiver), std::move(CancelToken));
+}
+
+AsyncQueryRef IndexSystem::foreachSymbolOccurrenceByUSRAsync(StringRef USR, SymbolRoleSet RoleSet,
+                                                             const AsyncQueryOptions &Options,
+                                                             SymbolOccurrenceBatchReceiver Receiver,
+                                                             AsyncQueryCompletion Completion) {
+  return foreachOccurrenceAsync(shared_from_this(), Options,
+      [USR = USR.str(), RoleSet](IndexSystem &index, function_ref<bool(SymbolOccurrenceRef)> receiver,
+                                 CancellationTokenRef cancelToken) -> bool {
+    return index.foreachSymbolOccurrenceByUSR(USR, RoleSet, receiver, std::move(cancelToken));
+  }, std::move(Receiver), std::move(Completion));
+}
+
+AsyncQueryRef IndexSystem::foreachRelatedSymbolOccurrenceByUSRAsync(StringRef USR, SymbolRoleSet RoleSet,
+                                                                    const AsyncQueryOptions &Options,
+                                                                    SymbolOccurrenceBatchReceiver Receiver,
+                                                                    AsyncQueryCompletion Completion) {
+  return foreachOccurrenceAsync(shared_from_this(), Options,
+      [USR = USR.str(), RoleSet](IndexSystem &index, function_ref<bool(SymbolOccurrenceRef)> receiver,
+                                 CancellationTokenRef cancelToken) -> bool {
+    return index.foreachRelatedSymbolOccurrenceByUSR(USR, RoleSet, receiver, std::move(cancelToken));
+  }, std::move(Receiver), std::move(Completion));
+}
+
+AsyncQueryRef IndexSystem::foreachCanonicalSymbolOccurrenceContainingPatternAsync(StringRef Pattern,
+                                                                       bool AnchorStart,
+                                                                       bool AnchorEnd,
+                                                                       bool Subsequence,
+                                                                       bool IgnoreCase,
+                                                                       const AsyncQueryOptions &Options,
+                                                                       SymbolOccurrenceBatchReceiver Receiver,
+                                                                       AsyncQueryCompletion Completion) {
+  return foreachOccurrenceAsync(shared_from_this(), Options,
+      [Pattern = Pattern.str(), AnchorStart, AnchorEnd, Subsequence, IgnoreCase](IndexSystem &index,
+          function_ref<bool(SymbolOccurrenceRef)> receiver, CancellationTokenRef cancelToken) -> bool {
+    return index.foreachCanonicalSymbolOccurrenceContainingPattern(Pattern, AnchorStart, AnchorEnd,
+                                                                   Subsequence, IgnoreCase,
+                                                                   receiver, std::move(cancelToken));
+  }, std::move(Receiver), std::move(Completion));
+}
+
+AsyncQueryRef IndexSystem::foreachCanonicalSymbolOccurrenceByNameAsync(StringRef name,
+                                                                       const AsyncQueryOptions &options,
+                                                                       SymbolOccurrenceBatchReceiver receiver,
+                                                                       AsyncQueryCompletion completion) {
+  return foreachOccurrenceAsync(shared_from_this(), options,
+      [name = name.str()](IndexSystem &index, function_ref<bool(SymbolOccurrenceRef)> receiver,
+                          CancellationTokenRef cancelToken) -> bool {
+    return index.foreachCanonicalSymbolOccurrenceByName(name, receiver, std::move(cancelToken));
+  }, std::move(receiver), std::move(completion));
+}
+
+AsyncQueryRef IndexSystem::foreachCanonicalSymbolOccurrenceByKindAsync(SymbolKind symKind, bool workspaceOnly,
+                                                                       const AsyncQueryOptions &Options,
+                                                                       SymbolOccurrenceBatchReceiver Receiver,
+                                                                       AsyncQueryCompletion Completion) {
+  return foreachOccurrenceAsync(shared_from_this(), Options,
+      [symKind, workspaceOnly](IndexSystem &index, function_ref<bool(SymbolOccurrenceRef)> receiver,
+                               CancellationTokenRef cancelToken) -> bool {
+    return index.foreachCanonicalSymbolOccurrenceByKind(symKind, workspaceOnly, receiver, std::move(cancelToken));
+  }, std::move(Receiver), std::move(Completion));
 }
 
 bool IndexSystem::foreachSymbolInFilePath(StringRef FilePath,
@@ -789,6 +1271,7 @@ bool IndexSystem::foreachSymbolInFilePath(StringRef FilePath,
 
 bool IndexSystem::foreachSymbolOccurrenceInFilePath(StringRef FilePath,
                                                     function_ref<bool(SymbolOccurrenceRef Occur)> Receiver) {
+  metrics::Histogram::Timer timer(SymbolOccurrencesInFileLatency);
   return IMPL->foreachSymbolOccurrenceInFilePath(FilePath, std::move(Receiver));
 }
 
@@ -797,14 +1280,17 @@ bool IndexSystem::isKnownFile(StringRef filePath) {
 }
 
 bool IndexSystem::foreachMainUnitContainingFile(StringRef filePath,
-                                            function_ref<bool(const StoreUnitInfo &unitInfo)> receiver) {
-  return IMPL->foreachMainUnitContainingFile(filePath, std::move(receiver));
+                                            function_ref<bool(const StoreUnitInfo &unitInfo)> receiver,
+                                                    CancellationTokenRef cancelToken) {
+  metrics::Histogram::Timer timer(MainUnitsContainingFileLatency);
+  return IMPL->foreachMainUnitContainingFile(filePath, std::move(receiver), std::move(cancelToken));
 }
 
 bool IndexSystem::foreachFileOfUnit(StringRef unitName,
                                     bool followDependencies,
-                                    function_ref<bool(CanonicalFilePathRef filePath)> receiver) {
-  return IMPL->foreachFileOfUnit(unitName, followDependencies, std::move(receiver));
+                                    function_ref<bool(CanonicalFilePathRef filePath)> receiver,
+                                    CancellationTokenRef cancelToken) {
+  return IMPL->foreachFileOfUnit(unitName, followDependencies, std::move(receiver), std::move(cancelToken));
 }
 
 bool IndexSystem::foreachFilenameContainingPattern(StringRef Pattern,
@@ -812,10 +1298,12 @@ bool IndexSystem::foreachFilenameContainingPattern(StringRef Pattern,
                                                    bool AnchorEnd,
                                                    bool Subsequence,
                                                    bool IgnoreCase,
-                              function_ref<bool(CanonicalFilePathRef FilePath)> Receiver) {
+                              function_ref<bool(CanonicalFilePathRef FilePath)> Receiver,
+                              CancellationTokenRef CancelToken) {
+  metrics::Histogram::Timer timer(FilenamesContainingPatternLatency);
   return IMPL->foreachFilenameContainingPattern(Pattern, AnchorStart, AnchorEnd,
                                                 Subsequence, IgnoreCase,
-                                                std::move(Receiver));
+                                                std::move(Receiver), std::move(CancelToken));
 }
 
 bool IndexSystem::foreachFileIncludingFile(StringRef TargetPath,
@@ -834,19 +1322,22 @@ bool IndexSystem::foreachIncludeOfUnit(StringRef unitName,
 }
 
 bool IndexSystem::foreachUnitTestSymbolReferencedByOutputPaths(ArrayRef<CanonicalFilePathRef> FilePaths,
-    function_ref<bool(SymbolOccurrenceRef Occur)> Receiver) {
-  return IMPL->foreachUnitTestSymbolReferencedByOutputPaths(FilePaths, std::move(Receiver));
+    function_ref<bool(SymbolOccurrenceRef Occur)> Receiver,
+    CancellationTokenRef CancelToken) {
+  return IMPL->foreachUnitTestSymbolReferencedByOutputPaths(FilePaths, std::move(Receiver), std::move(CancelToken));
 }
 
 bool IndexSystem::foreachUnitTestSymbolReferencedByMainFiles(
    ArrayRef<StringRef> mainFilePaths,
-   function_ref<bool(SymbolOccurrenceRef Occur)> receiver
+   function_ref<bool(SymbolOccurrenceRef Occur)> receiver,
+   CancellationTokenRef cancelToken
 ) {
-  return IMPL->foreachUnitTestSymbolReferencedByMainFiles(mainFilePaths, std::move(receiver));
+  return IMPL->foreachUnitTestSymbolReferencedByMainFiles(mainFilePaths, std::move(receiver), std::move(cancelToken));
 }
 
-bool IndexSystem::foreachUnitTestSymbol(function_ref<bool(SymbolOccurrenceRef Occur)> receiver) {
-  return IMPL->foreachUnitTestSymbol(std::move(receiver));
+bool IndexSystem::foreachUnitTestSymbol(function_ref<bool(SymbolOccurrenceRef Occur)> receiver,
+                                        CancellationTokenRef cancelToken) {
+  return IMPL->foreachUnitTestSymbol(std::move(receiver), std::move(cancelToken));
 }
 
 llvm::Optional<llvm::sys::TimePoint<>> IndexSystem::timestampOfLatestUnitForFile(StringRef filePath) {
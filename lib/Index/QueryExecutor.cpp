@@ -0,0 +1,85 @@
+//===--- QueryExecutor.cpp ------------------------------------------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2018 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://swift.org/LICENSE.txt for license information
+// See https://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#include "QueryExecutor.h"
+#include "IndexStoreDB/Support/Metrics.h"
+#include <algorithm>
+#include <thread>
+
+using namespace IndexStoreDB;
+using namespace IndexStoreDB::index;
+
+static metrics::Gauge NumQueuedAsyncQueries("query.queued_async_queries",
+                                            "Asynchronous queries waiting for their turn on the query executor");
+static metrics::Histogram AsyncQueryWaitLatency("query.async_query_wait_latency",
+                                                "Time that the asynchronous queries wait for their turn");
+
+QueryExecutor &QueryExecutor::getShared() {
+  // Never destroyed, queries may still be running at exit.
+  static QueryExecutor *executor = new QueryExecutor();
+  return *executor;
+}
+
+QueryExecutor::QueryExecutor()
+  : Concurrency(std::max(std::thread::hardware_concurrency(), 2u)) {}
+
+void QueryExecutor::setConcurrency(unsigned concurrency) {
+  llvm::sys::ScopedLock L(StateMtx);
+  Concurrency = std::max(concurrency, 1u);
+  startReadyWork();
+}
+
+AsyncQueryRef QueryExecutor::enqueue(const AsyncQueryOptions &options, QueryFn query,
+                                     AsyncQueryCompletion completion) {
+  auto asyncQuery = std::make_shared<AsyncQuery>(options.CancelToken);
+  unsigned lane = std::min(unsigned(options.Priority), NumPriorities - 1);
+  llvm::sys::ScopedLock L(StateMtx);
+  Pending[lane].push_back(WorkItem{asyncQuery, std::move(query), std::move(completion),
+                                   std::chrono::steady_clock::now()});
+  NumQueuedAsyncQueries.add(1);
+  startReadyWork();
+  return asyncQuery;
+}
+
+void QueryExecutor::startReadyWork() {
+  for (unsigned lane = 0; lane != NumPriorities && NumRunning < Concurrency; ++lane) {
+    while (!Pending[lane].empty() && NumRunning < Concurrency) {
+      WorkItem item = std::move(Pending[lane].front());
+      Pending[lane].pop_front();
+      ++NumRunning;
+      NumQueuedAsyncQueries.add(-1);
+      AsyncQueryWaitLatency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - item.EnqueueTime));
+
+      WorkQueue::dispatchConcurrent([this, item = std::move(item)]() mutable {
+        run(std::move(item));
+      }, WorkQueue::Priority(lane));
+    }
+  }
+}
+
+void QueryExecutor::run(WorkItem item) {
+  bool result = false;
+  if (!item.Query->isCancelled())
+    result = item.Run(item.Query->getCancellationToken());
+  // Release what the query retains, its index in particular, before it is
+  // reported as finished so that the client can tear the index down then.
+  item.Run = nullptr;
+  if (item.Completion)
+    item.Completion(result);
+  item.Completion = nullptr;
+  item.Query->setFinished();
+
+  llvm::sys::ScopedLock L(StateMtx);
+  --NumRunning;
+  startReadyWork();
+}
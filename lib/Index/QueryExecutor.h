@@ -0,0 +1,72 @@
+//===--- QueryExecutor.h ----------------------------------------*- C++ -*-===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2018 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://swift.org/LICENSE.txt for license information
+// See https://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef INDEXSTOREDB_LIB_INDEX_QUERYEXECUTOR_H
+#define INDEXSTOREDB_LIB_INDEX_QUERYEXECUTOR_H
+
+#include "IndexStoreDB/Index/AsyncQuery.h"
+#include "llvm/Support/Mutex.h"
+#include <chrono>
+#include <deque>
+#include <functional>
+
+namespace IndexStoreDB {
+namespace index {
+
+/// Runs the asynchronous queries of the indexes of the process.
+///
+/// Up to the concurrency of the executor, the number of cores by default,
+/// queries run at the same time, each at its priority. The others wait in
+/// order of priority, and then of submission, so that a burst of background
+/// queries doesn't hold back the interactive ones.
+class QueryExecutor {
+public:
+  /// Runs the query with the cancellation token of the query and returns
+  /// what it should report to the completion.
+  typedef std::function<bool(const CancellationTokenRef &token)> QueryFn;
+
+  static QueryExecutor &getShared();
+
+  void setConcurrency(unsigned concurrency);
+
+  /// Runs \p query once it gets its turn and then \p completion with its
+  /// result. A query that is cancelled before its turn doesn't run and
+  /// completes with false.
+  AsyncQueryRef enqueue(const AsyncQueryOptions &options, QueryFn query,
+                        AsyncQueryCompletion completion);
+
+private:
+  QueryExecutor();
+
+  struct WorkItem {
+    AsyncQueryRef Query;
+    QueryFn Run;
+    AsyncQueryCompletion Completion;
+    std::chrono::steady_clock::time_point EnqueueTime;
+  };
+
+  static const unsigned NumPriorities = 4;
+
+  void startReadyWork();
+  void run(WorkItem item);
+
+  llvm::sys::Mutex StateMtx;
+  unsigned Concurrency;
+  unsigned NumRunning = 0;
+  /// The queries waiting for their turn, by \c WorkQueue::Priority.
+  std::deque<WorkItem> Pending[NumPriorities];
+};
+
+} // namespace index
+} // namespace IndexStoreDB
+
+#endif
@@ -13,9 +13,13 @@
 #include "StoreSymbolRecord.h"
 #include "IndexDatastore.h"
 #include "IndexStoreDB/Database/Database.h"
+#include "IndexStoreDB/Index/SymbolOccurrenceView.h"
 #include "IndexStoreDB/Support/Logging.h"
+#include "IndexStoreDB/Support/Metrics.h"
 #include "IndexStoreDB/Support/Path.h"
+#include "IndexStoreDB/Support/QueryProfile.h"
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/raw_ostream.h"
@@ -157,6 +161,10 @@ static SymbolRef convertSymbol(IndexRecordSymbol sym) {
     sym.getName(), sym.getUSR());
 }
 
+static SymbolView convertSymbolView(IndexRecordSymbol sym) {
+  return SymbolView(getSymbolInfo(sym), sym.getName(), sym.getUSR());
+}
+
 static SymbolRoleSet convertFromIndexStoreRoles(uint64_t Roles, bool isCanonical) {
   SymbolRoleSet newRoles = SymbolRoleSet(Roles);
   if (isCanonical)
@@ -192,23 +200,59 @@ StoreSymbolRecord::create(IndexStoreRef store,
   return Rec;
 }
 
+static metrics::Counter NumRecordsOpened("records.opened",
+                                         "Record files that were opened");
+static metrics::Counter NumRecordOpenFailures("records.open_failures",
+                                              "Record files that failed to open");
+static metrics::Histogram RecordOpenLatency("records.open_latency",
+                                            "Time to open a record file");
+
 bool StoreSymbolRecord::doForData(function_ref<void(IndexRecordReader &)> Action) {
   // FIXME: Cache this using libcache ? We may need to repeat searches.
+  QueryProfile::PhaseTimer timer(QueryProfile::Phase::ReadRecords);
   std::string Error;
-  auto Reader = IndexRecordReader(*Store, RecordName, Error);
+  auto Reader = [&]{
+    metrics::Histogram::Timer openTimer(RecordOpenLatency);
+    return IndexRecordReader(*Store, RecordName, Error);
+  }();
   if (!Reader) {
+    NumRecordOpenFailures.add();
     LOG_WARN_FUNC("error reading record '"<< RecordName <<"': " << Error);
     return true;
   }
 
+  QueryProfile::count(QueryProfile::Counter::RecordsOpened);
+  NumRecordsOpened.add();
   Action(Reader);
   return false;
 }
 
+//===----------------------------------------------------------------------===//
+// SymbolOccurrenceView
+//===----------------------------------------------------------------------===//
+
+bool SymbolOccurrenceView::foreachRelation(function_ref<bool(SymbolRoleSet Roles, const SymbolView &Sym)> Receiver) const {
+  return RecOccur.foreachRelation([&](IndexSymbolRelation Rel) -> bool {
+    SymbolRoleSet Roles = convertFromIndexStoreRoles(Rel.getRoles(), /*isCanonical=*/false);
+    return Receiver(Roles, convertSymbolView(Rel.getSymbol()));
+  });
+}
+
+SymbolOccurrenceRef SymbolOccurrenceView::copy() const {
+  SmallVector<SymbolRelation, 4> Relations;
+  foreachRelation([&](SymbolRoleSet Roles, const SymbolView &RelSym) -> bool {
+    Relations.emplace_back(Roles, RelSym.copy());
+    return true;
+  });
+  return std::make_shared<SymbolOccurrence>(Sym.copy(), Roles,
+                                            SymbolLocation(Path, Line, Column),
+                                            ProviderKind, Target.str(), Relations);
+}
+
 namespace {
 class OccurrenceConverter {
   function_ref<bool(SymbolOccurrenceRef Occur)> Receiver;
-  std::vector<FileAndTarget> FileAndTargetRefs;
+  ArrayRef<FileAndTarget> FileAndTargetRefs;
   SymbolProviderKind SymProviderKind;
 
 public:
@@ -220,6 +264,7 @@ public:
     }
 
   bool operator()(IndexRecordOccurrence RecSym) {
+    QueryProfile::count(QueryProfile::Counter::OccurrencesDecoded);
     auto Sym = convertSymbol(RecSym.getSymbol());
     SymbolRoleSet OccurRoles = convertFromIndexStoreRoles(RecSym.getRoles(), Sym->getSymbolInfo());
     SmallVector<SymbolRelation, 4> Relations;
@@ -245,14 +290,45 @@ public:
   }
 };
 
+/// Reports the occurrences as views, only the record reader and the file
+/// references of the record back them.
+class OccurrenceViewConverter {
+  function_ref<bool(const SymbolOccurrenceView &Occur)> Receiver;
+  ArrayRef<FileAndTarget> FileAndTargetRefs;
+  SymbolProviderKind SymProviderKind;
+
+public:
+  OccurrenceViewConverter(StoreSymbolRecord &SymRecord,
+    function_ref<bool(const SymbolOccurrenceView &Occur)> Receiver)
+    : Receiver(std::move(Receiver)),
+      FileAndTargetRefs(SymRecord.getSourceFileReferencesAndTargets()),
+      SymProviderKind(SymRecord.getProviderKind()) {}
+
+  bool operator()(IndexRecordOccurrence RecSym) {
+    QueryProfile::count(QueryProfile::Counter::OccurrencesDecoded);
+    SymbolView Sym = convertSymbolView(RecSym.getSymbol());
+    SymbolRoleSet OccurRoles = convertFromIndexStoreRoles(RecSym.getRoles(), Sym.getSymbolInfo());
+    auto LineCol = RecSym.getLineCol();
+    for (auto &FileRef : FileAndTargetRefs) {
+      SymbolOccurrenceView Occur(RecSym, Sym, OccurRoles, FileRef.Path, FileRef.Target,
+                                 LineCol.first, LineCol.second, SymProviderKind);
+      if (!Receiver(Occur))
+        return false;
+    }
+    return true;
+  }
+};
+
+template <typename ConverterTy>
 class PredOccurrenceConverter {
   function_ref<bool(IndexRecordOccurrence)> Predicate;
-  OccurrenceConverter Converter;
+  ConverterTy Converter;
 
 public:
+  template <typename ReceiverTy>
   PredOccurrenceConverter(StoreSymbolRecord &SymRecord,
     function_ref<bool(IndexRecordOccurrence)> Predicate,
-    function_ref<bool(SymbolOccurrenceRef Occur)> Receiver)
+    ReceiverTy Receiver)
     : Predicate(std::move(Predicate)),
       Converter(SymRecord, Receiver) { }
 
@@ -289,12 +365,45 @@ bool StoreSymbolRecord::foreachCoreSymbolData(function_ref<bool(StringRef USR,
   return !Err && Finished;
 }
 
+bool StoreSymbolRecord::foreachSymbolOccurrenceCount(function_ref<bool(StringRef USR,
+                                                                       unsigned NumOccurrences,
+                                                                       unsigned NumRelatedOccurrences)> Receiver) {
+  bool Finished = true;
+  bool Err = doForData([&](IndexRecordReader &Reader) {
+    StringMap<std::pair<unsigned, unsigned>> CountsByUSR;
+    Reader.foreachOccurrence([&](IndexRecordOccurrence RecOccur) -> bool {
+      ++CountsByUSR[RecOccur.getSymbol().getUSR()].first;
+      // An occurrence is reported once by a related-symbol lookup, even if it
+      // has multiple relations to the same symbol.
+      SmallVector<StringRef, 4> RelatedUSRs;
+      RecOccur.foreachRelation([&](IndexSymbolRelation Rel) -> bool {
+        StringRef RelUSR = Rel.getSymbol().getUSR();
+        if (std::find(RelatedUSRs.begin(), RelatedUSRs.end(), RelUSR) == RelatedUSRs.end()) {
+          RelatedUSRs.push_back(RelUSR);
+          ++CountsByUSR[RelUSR].second;
+        }
+        return true;
+      });
+      return true;
+    });
+
+    for (auto &Entry : CountsByUSR) {
+      if (!Receiver(Entry.getKey(), Entry.getValue().first, Entry.getValue().second)) {
+        Finished = false;
+        return;
+      }
+    }
+  });
+
+  return !Err && Finished;
+}
+
 bool StoreSymbolRecord::foreachSymbolOccurrence(function_ref<bool(SymbolOccurrenceRef Occur)> Receiver) {
   bool Finished;
   bool Err = doForData([&](IndexRecordReader &Reader) {
     // Return all occurrences.
     auto Pred = [](IndexRecordOccurrence) -> bool { return true; };
-    PredOccurrenceConverter Converter(*this, Pred, Receiver);
+    PredOccurrenceConverter<OccurrenceConverter> Converter(*this, Pred, Receiver);
     Finished = Reader.foreachOccurrence(/*symbolsFilter=*/None,
                                         /*relatedSymbolsFilter=*/None,
                                         Converter);
@@ -345,50 +454,62 @@ public:
 };
 }
 
-bool StoreSymbolRecord::foreachSymbolOccurrenceByUSR(ArrayRef<db::IDCode> USRs,
-                                                     SymbolRoleSet RoleSet,
-                       function_ref<bool(SymbolOccurrenceRef Occur)> Receiver) {
+/// Reports the occurrences of \p USRs, or the occurrences related to them if
+/// \p related, that have one of the roles in \p roleSet.
+template <typename ConverterTy, typename ReceiverTy>
+static bool foreachOccurrenceOfUSRs(StoreSymbolRecord &record,
+                                    ArrayRef<db::IDCode> USRs,
+                                    SymbolRoleSet roleSet,
+                                    bool related,
+                                    ReceiverTy receiver) {
   assert(!USRs.empty() && "did not set any USR!");
-  assert(RoleSet && "did not set any role!");
+  assert(roleSet && "did not set any role!");
 
   bool Finished = true;
-  bool Err = doForData([&](IndexRecordReader &Reader) {
+  bool Err = record.doForData([&](IndexRecordReader &Reader) {
     SmallVector<IndexRecordSymbol, 8> FoundDecls;
     searchDeclsByUSR(Reader, USRs, FoundDecls);
     if (FoundDecls.empty())
       return;
 
-    CheckIndexStoreRolesPredicate Pred(RoleSet);
-    PredOccurrenceConverter Converter(*this, Pred, Receiver);
-    Finished = Reader.foreachOccurrence(/*DeclsFilter=*/FoundDecls,
-                                        /*RelatedDeclsFilter=*/None,
-                                        Converter);
+    CheckIndexStoreRolesPredicate Pred(roleSet);
+    PredOccurrenceConverter<ConverterTy> Converter(record, Pred, receiver);
+    if (related) {
+      Finished = Reader.foreachOccurrence(/*DeclsFilter=*/None,
+                                          /*RelatedDeclsFilter=*/FoundDecls,
+                                          Converter);
+    } else {
+      Finished = Reader.foreachOccurrence(/*DeclsFilter=*/FoundDecls,
+                                          /*RelatedDeclsFilter=*/None,
+                                          Converter);
+    }
   });
 
   return !Err && Finished;
 }
 
-bool StoreSymbolRecord::foreachRelatedSymbolOccurrenceByUSR(ArrayRef<db::IDCode> USRs,
+bool StoreSymbolRecord::foreachSymbolOccurrenceByUSR(ArrayRef<db::IDCode> USRs,
                                                      SymbolRoleSet RoleSet,
                        function_ref<bool(SymbolOccurrenceRef Occur)> Receiver) {
-  assert(!USRs.empty() && "did not set any USR!");
-  assert(RoleSet && "did not set any role!");
+  return foreachOccurrenceOfUSRs<OccurrenceConverter>(*this, USRs, RoleSet, /*related=*/false, Receiver);
+}
 
-  bool Finished = true;
-  bool Err = doForData([&](IndexRecordReader &Reader) {
-    SmallVector<IndexRecordSymbol, 8> FoundDecls;
-    searchDeclsByUSR(Reader, USRs, FoundDecls);
-    if (FoundDecls.empty())
-      return;
+bool StoreSymbolRecord::foreachRelatedSymbolOccurrenceByUSR(ArrayRef<db::IDCode> USRs,
+                                                     SymbolRoleSet RoleSet,
+                       function_ref<bool(SymbolOccurrenceRef Occur)> Receiver) {
+  return foreachOccurrenceOfUSRs<OccurrenceConverter>(*this, USRs, RoleSet, /*related=*/true, Receiver);
+}
 
-    CheckIndexStoreRolesPredicate Pred(RoleSet);
-    PredOccurrenceConverter Converter(*this, Pred, Receiver);
-    Finished = Reader.foreachOccurrence(/*DeclsFilter=*/None,
-                                        /*RelatedDeclsFilter=*/FoundDecls,
-                                        Converter);
-  });
+bool StoreSymbolRecord::foreachSymbolOccurrenceViewByUSR(ArrayRef<db::IDCode> USRs,
+                                                         SymbolRoleSet RoleSet,
+                       function_ref<bool(const SymbolOccurrenceView &Occur)> Receiver) {
+  return foreachOccurrenceOfUSRs<OccurrenceViewConverter>(*this, USRs, RoleSet, /*related=*/false, Receiver);
+}
 
-  return !Err && Finished;
+bool StoreSymbolRecord::foreachRelatedSymbolOccurrenceViewByUSR(ArrayRef<db::IDCode> USRs,
+                                                                SymbolRoleSet RoleSet,
+                       function_ref<bool(const SymbolOccurrenceView &Occur)> Receiver) {
+  return foreachOccurrenceOfUSRs<OccurrenceViewConverter>(*this, USRs, RoleSet, /*related=*/true, Receiver);
 }
 
 bool StoreSymbolRecord::foreachUnitTestSymbolOccurrence(function_ref<bool(SymbolOccurrenceRef Occur)> Receiver) {
@@ -408,7 +529,7 @@ bool StoreSymbolRecord::foreachUnitTestSymbolOccurrence(function_ref<bool(Symbol
 
     // Return all occurrences.
     auto Pred = [](IndexRecordOccurrence) -> bool { return true; };
-    PredOccurrenceConverter Converter(*this, Pred, Receiver);
+    PredOccurrenceConverter<OccurrenceConverter> Converter(*this, Pred, Receiver);
     Finished = Reader.foreachOccurrence(/*symbolsFilter=*/FoundDecls,
                                         /*relatedSymbolsFilter=*/None,
                                         Converter);
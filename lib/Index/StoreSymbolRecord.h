@@ -75,6 +75,10 @@ public:
                                                        SymbolRoleSet Roles,
                                                        SymbolRoleSet RelatedRoles)> Receiver) override;
 
+  virtual bool foreachSymbolOccurrenceCount(function_ref<bool(StringRef USR,
+                                                              unsigned NumOccurrences,
+                                                              unsigned NumRelatedOccurrences)> Receiver) override;
+
   virtual bool foreachSymbolOccurrence(function_ref<bool(SymbolOccurrenceRef Occur)> Receiver) override;
 
   virtual bool foreachSymbolOccurrenceByUSR(ArrayRef<db::IDCode> USRs,
@@ -85,6 +89,14 @@ public:
                                             SymbolRoleSet RoleSet,
                function_ref<bool(SymbolOccurrenceRef Occur)> Receiver) override;
 
+  virtual bool foreachSymbolOccurrenceViewByUSR(ArrayRef<db::IDCode> USRs,
+                                                SymbolRoleSet RoleSet,
+               function_ref<bool(const SymbolOccurrenceView &Occur)> Receiver) override;
+
+  virtual bool foreachRelatedSymbolOccurrenceViewByUSR(ArrayRef<db::IDCode> USRs,
+                                                       SymbolRoleSet RoleSet,
+               function_ref<bool(const SymbolOccurrenceView &Occur)> Receiver) override;
+
   virtual bool foreachUnitTestSymbolOccurrence(
                function_ref<bool(SymbolOccurrenceRef Occur)> Receiver) override;
 
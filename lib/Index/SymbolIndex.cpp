@@ -14,10 +14,13 @@
 #include "IndexStoreDB/Index/SymbolIndex.h"
 #include "IndexStoreDB/Index/StoreUnitInfo.h"
 #include "IndexStoreDB/Index/SymbolDataProvider.h"
+#include "IndexStoreDB/Index/SymbolOccurrenceCount.h"
+#include "IndexStoreDB/Index/SymbolOccurrenceView.h"
 #include "StoreSymbolRecord.h"
 #include "IndexStoreDB/Database/Database.h"
 #include "IndexStoreDB/Database/ImportTransaction.h"
 #include "IndexStoreDB/Database/ReadTransaction.h"
+#include "IndexStoreDB/Support/QueryProfile.h"
 #include "FileVisibilityChecker.h"
 
 #include "indexstore/IndexStoreCXX.h"
@@ -40,6 +43,7 @@ class SymbolIndexImpl {
   DatabaseRef DBase;
   indexstore::IndexStoreRef IdxStore;
   std::shared_ptr<FileVisibilityChecker> VisibilityChecker;
+  bool RecordOccurrenceCounts;
 
   // Statistics tracking.
   std::atomic<unsigned> NumProvidersAdded{0};
@@ -50,8 +54,10 @@ class SymbolIndexImpl {
 
 public:
   SymbolIndexImpl(DatabaseRef dbase, indexstore::IndexStoreRef indexStore,
-                  std::shared_ptr<FileVisibilityChecker> visibilityChecker)
-    : DBase(std::move(dbase)), IdxStore(std::move(indexStore)), VisibilityChecker(std::move(visibilityChecker)) {}
+                  std::shared_ptr<FileVisibilityChecker> visibilityChecker,
+                  bool recordOccurrenceCounts)
+    : DBase(std::move(dbase)), IdxStore(std::move(indexStore)), VisibilityChecker(std::move(visibilityChecker)),
+      RecordOccurrenceCounts(recordOccurrenceCounts) {}
 
   DatabaseRef getDBase() const { return DBase; }
 
@@ -61,17 +67,27 @@ public:
   void dumpProviderFileAssociations(raw_ostream &OS);
 
   bool foreachSymbolOccurrenceByUSR(StringRef USR, SymbolRoleSet RoleSet,
-                        function_ref<bool(SymbolOccurrenceRef Occur)> Receiver);
+                        function_ref<bool(SymbolOccurrenceRef Occur)> Receiver,
+                        CancellationTokenRef CancelToken);
   bool foreachRelatedSymbolOccurrenceByUSR(StringRef USR, SymbolRoleSet RoleSet,
-                        function_ref<bool(SymbolOccurrenceRef Occur)> Receiver);
+                        function_ref<bool(SymbolOccurrenceRef Occur)> Receiver,
+                        CancellationTokenRef CancelToken);
+  bool foreachSymbolOccurrenceViewByUSR(StringRef USR, SymbolRoleSet RoleSet,
+                        function_ref<bool(const SymbolOccurrenceView &Occur)> Receiver,
+                        CancellationTokenRef CancelToken);
+  bool foreachRelatedSymbolOccurrenceViewByUSR(StringRef USR, SymbolRoleSet RoleSet,
+                        function_ref<bool(const SymbolOccurrenceView &Occur)> Receiver,
+                        CancellationTokenRef CancelToken);
   bool foreachCanonicalSymbolOccurrenceContainingPattern(StringRef Pattern,
                                                 bool AnchorStart,
                                                 bool AnchorEnd,
                                                 bool Subsequence,
                                                 bool IgnoreCase,
-                              function_ref<bool(SymbolOccurrenceRef)> Receiver);
+                              function_ref<bool(SymbolOccurrenceRef)> Receiver,
+                              CancellationTokenRef CancelToken);
   bool foreachCanonicalSymbolOccurrenceByName(StringRef name,
-                        function_ref<bool(SymbolOccurrenceRef Occur)> receiver);
+                        function_ref<bool(SymbolOccurrenceRef Occur)> receiver,
+                        CancellationTokenRef cancelToken);
 
   bool foreachSymbolInFilePath(CanonicalFilePathRef filePath,
                                function_ref<bool(SymbolRef Symbol)> Receiver);
@@ -79,15 +95,21 @@ public:
   bool foreachSymbolOccurrenceInFilePath(CanonicalFilePathRef filePath,
                                          function_ref<bool(SymbolOccurrenceRef Occur)> Receiver);
 
-  bool foreachSymbolName(function_ref<bool(StringRef name)> receiver);
+  bool foreachSymbolName(function_ref<bool(StringRef name)> receiver,
+                         CancellationTokenRef cancelToken);
 
   bool foreachCanonicalSymbolOccurrenceByUSR(StringRef USR,
                         function_ref<bool(SymbolOccurrenceRef occur)> receiver);
+  SymbolOccurrenceCount countSymbolOccurrencesByUSR(StringRef USR, SymbolRoleSet RoleSet);
+  SymbolOccurrenceCount countRelatedSymbolOccurrencesByUSR(StringRef USR, SymbolRoleSet RoleSet);
   size_t countOfCanonicalSymbolsWithKind(SymbolKind symKind, bool workspaceOnly);
+  size_t estimateCountOfSymbolsWithKind(SymbolKind symKind);
   bool foreachCanonicalSymbolOccurrenceByKind(SymbolKind symKind, bool workspaceOnly,
-                                              function_ref<bool(SymbolOccurrenceRef Occur)> Receiver);
+                                              function_ref<bool(SymbolOccurrenceRef Occur)> Receiver,
+                                              CancellationTokenRef CancelToken);
   bool foreachUnitTestSymbolReferencedByOutputPaths(ArrayRef<CanonicalFilePathRef> FilePaths,
-      function_ref<bool(SymbolOccurrenceRef Occur)> Receiver);
+      function_ref<bool(SymbolOccurrenceRef Occur)> Receiver,
+      CancellationTokenRef CancelToken);
 
   /// Calls `receiver` for every unit test symbol in unit files that reference
   /// one of the main files in `mainFilePaths`.
@@ -95,12 +117,14 @@ public:
   /// \returns `false` if the receiver returned `false` to stop receiving symbols, `true` otherwise.
   bool foreachUnitTestSymbolReferencedByMainFiles(
       ArrayRef<CanonicalFilePath> mainFilePaths,
-      function_ref<bool(SymbolOccurrenceRef Occur)> receiver
+      function_ref<bool(SymbolOccurrenceRef Occur)> receiver,
+      CancellationTokenRef cancelToken
   );
   /// Calls `receiver` for every unit test symbol in the index.
   ///
   /// \returns `false` if the receiver returned `false` to stop receiving symbols, `true` otherwise.
-  bool foreachUnitTestSymbol(function_ref<bool(SymbolOccurrenceRef Occur)> receiver);
+  bool foreachUnitTestSymbol(function_ref<bool(SymbolOccurrenceRef Occur)> receiver,
+                             CancellationTokenRef cancelToken);
 
   /// Returns the latest modification date of a unit that contains the given source file.
   ///
@@ -114,18 +138,36 @@ private:
   /// Calls `receiver` for every unit test contained by a provider in `providers`.
   ///
   /// \returns `false` if the receiver returned `false` to stop receiving symbols, `true` otherwise.
-  bool foreachUnitTestSymbolOccurrence(const std::vector<SymbolDataProviderRef> &providers, function_ref<bool(SymbolOccurrenceRef Occur)> receiver);
+  bool foreachUnitTestSymbolOccurrence(const std::vector<SymbolDataProviderRef> &providers, function_ref<bool(SymbolOccurrenceRef Occur)> receiver,
+                                       const CancellationTokenRef &cancelToken);
 
   bool foreachCanonicalSymbolImpl(bool workspaceOnly,
                                   function_ref<bool(ReadTransaction &, function_ref<bool(ArrayRef<IDCode> usrCode)> usrConsumer)> usrProducer,
-                                  function_ref<bool(SymbolDataProviderRef, std::vector<std::pair<IDCode, bool>> USRs)> receiver);
+                                  function_ref<bool(SymbolDataProviderRef, std::vector<std::pair<IDCode, bool>> USRs)> receiver,
+                                  const CancellationTokenRef &cancelToken);
   bool foreachCanonicalSymbolOccurrenceImpl(bool workspaceOnly,
                                             function_ref<bool(ReadTransaction &, function_ref<bool(ArrayRef<IDCode> usrCode)> usrConsumer)> usrProducer,
-                                            function_ref<bool(SymbolOccurrenceRef)> Receiver);
-  std::vector<SymbolDataProviderRef> lookupProvidersForUSR(StringRef USR, SymbolRoleSet roles, SymbolRoleSet relatedRoles);
+                                            function_ref<bool(SymbolOccurrenceRef)> Receiver,
+                                            const CancellationTokenRef &cancelToken);
+  /// \returns false if \p cancelToken cancelled the lookup, \p providers is
+  /// incomplete then.
+  bool lookupProvidersForUSR(StringRef USR, SymbolRoleSet roles, SymbolRoleSet relatedRoles,
+                             const CancellationTokenRef &cancelToken,
+                             std::vector<SymbolDataProviderRef> &providers);
   std::vector<std::pair<SymbolDataProviderRef, bool>> findCanonicalProvidersForUSR(IDCode usrCode);
   SymbolDataProviderRef createVisibleProviderForCode(IDCode providerCode, ReadTransaction &reader);
   SymbolDataProviderRef createProviderForCode(IDCode providerCode, ReadTransaction &reader, function_ref<bool(const UnitInfo &)> unitFilter);
+
+  /// What \c createVisibleProviderForCode would produce, without creating the provider.
+  struct VisibleProviderInfo {
+    /// Codes of the visible source files of the provider; empty if the provider is not visible.
+    SmallVector<IDCode, 4> FileCodes;
+    bool IsSystem = false;
+
+    bool isVisible() const { return !FileCodes.empty(); }
+  };
+  VisibleProviderInfo getVisibleProviderInfo(IDCode providerCode, ReadTransaction &reader);
+  SymbolOccurrenceCount countOccurrencesImpl(StringRef USR, SymbolRoleSet RoleSet, bool related);
 };
 
 } // anonymous namespace
@@ -164,11 +206,28 @@ void SymbolIndexImpl::importSymbols(ImportTransaction &import, SymbolDataProvide
     return true;
   });
 
+  // Pairs of (occurrences, related occurrences).
+  StringMap<std::pair<unsigned, unsigned>> OccurrenceCounts;
+  if (RecordOccurrenceCounts) {
+    Provider->foreachSymbolOccurrenceCount([&](StringRef USR, unsigned NumOccurrences, unsigned NumRelatedOccurrences) -> bool {
+      OccurrenceCounts[USR] = {NumOccurrences, NumRelatedOccurrences};
+      return true;
+    });
+  }
+
   IDCode providerCode = import.addProviderName(Provider->getIdentifier());
   bool hasTestSymbols = false;
   for (auto &coreSym : CoreSymbols) {
+    Optional<unsigned> occurrenceCount;
+    Optional<unsigned> relatedOccurrenceCount;
+    if (RecordOccurrenceCounts) {
+      auto countIt = OccurrenceCounts.find(coreSym.first());
+      occurrenceCount = countIt != OccurrenceCounts.end() ? countIt->second.first : 0;
+      relatedOccurrenceCount = countIt != OccurrenceCounts.end() ? countIt->second.second : 0;
+    }
     import.addSymbolInfo(providerCode, coreSym.first(), coreSym.second.Name,
-                         coreSym.second.SymInfo, coreSym.second.Roles, coreSym.second.RelatedRoles);
+                         coreSym.second.SymInfo, coreSym.second.Roles, coreSym.second.RelatedRoles,
+                         occurrenceCount, relatedOccurrenceCount);
     if (coreSym.second.SymInfo.Properties.contains(SymbolProperty::UnitTest) &&
         coreSym.second.Roles.contains(SymbolRole::Definition)) {
       hasTestSymbols = true;
@@ -215,6 +274,7 @@ SymbolDataProviderRef SymbolIndexImpl::createVisibleProviderForCode(IDCode provi
 }
 
 SymbolDataProviderRef SymbolIndexImpl::createProviderForCode(IDCode providerCode, ReadTransaction &reader, function_ref<bool(const UnitInfo &)> unitFilter) {
+  QueryProfile::PhaseTimer timer(QueryProfile::Phase::ResolveProviders);
   StringRef recordName = reader.getProviderName(providerCode);
   if (recordName.empty()) {
     ++NumMissingProvidersLookedUp;
@@ -253,27 +313,59 @@ SymbolDataProviderRef SymbolIndexImpl::createProviderForCode(IDCode providerCode
   if (fileRefs.empty())
     return nullptr;
 
+  QueryProfile::count(QueryProfile::Counter::ProvidersResolved);
   return StoreSymbolRecord::create(IdxStore, recordName, providerCode, providerKind.getValue(), fileRefs);
 }
 
-std::vector<SymbolDataProviderRef>
-SymbolIndexImpl::lookupProvidersForUSR(StringRef USR, SymbolRoleSet roles, SymbolRoleSet relatedRoles) {
-  std::vector<SymbolDataProviderRef> providers;
-  ReadTransaction reader(DBase);
-  reader.lookupProvidersForUSR(USR, roles, relatedRoles, [&](IDCode providerCode, SymbolRoleSet roles, SymbolRoleSet relatedRoles) -> bool {
+SymbolIndexImpl::VisibleProviderInfo SymbolIndexImpl::getVisibleProviderInfo(IDCode providerCode, ReadTransaction &reader) {
+  QueryProfile::PhaseTimer timer(QueryProfile::Phase::ResolveProviders);
+  VisibleProviderInfo info;
+  if (reader.getProviderName(providerCode).empty()) {
+    ++NumMissingProvidersLookedUp;
+    return info;
+  }
+
+  auto unitCodeFilter = [&](IDCode unitCode) -> bool {
+    auto unitInfo = reader.getUnitInfo(unitCode);
+    if (unitInfo.isInvalid())
+      return false;
+    return VisibilityChecker->isUnitVisible(unitInfo, reader);
+  };
+  reader.getProviderFileCodeReferences(providerCode, unitCodeFilter, [&](IDCode pathCode, IDCode unitCode, llvm::sys::TimePoint<> modTime, IDCode moduleNameCode, bool isSystem) -> bool {
+    if (info.FileCodes.empty())
+      info.IsSystem = isSystem;
+    info.FileCodes.push_back(pathCode);
+    return true;
+  });
+  return info;
+}
+
+bool SymbolIndexImpl::lookupProvidersForUSR(StringRef USR, SymbolRoleSet roles, SymbolRoleSet relatedRoles,
+                                            const CancellationTokenRef &cancelToken,
+                                            std::vector<SymbolDataProviderRef> &providers) {
+  QueryProfile::PhaseTimer timer(QueryProfile::Phase::LookupProviders);
+  ReadTransaction reader(DBase, cancelToken);
+  bool cont = reader.lookupProvidersForUSR(USR, roles, relatedRoles, [&](IDCode providerCode, SymbolRoleSet roles, SymbolRoleSet relatedRoles) -> bool {
     if (auto prov = createVisibleProviderForCode(providerCode, reader))
       providers.push_back(prov);
     return true;
   });
-  return providers;
+  // The scan only checks the token periodically, a USR with few providers may
+  // not have reached a check.
+  return cont && !reader.isCancelled();
 }
 
 bool SymbolIndexImpl::foreachSymbolOccurrenceByUSR(StringRef USR,
                                                     SymbolRoleSet RoleSet,
-                       function_ref<bool(SymbolOccurrenceRef Occur)> Receiver) {
+                       function_ref<bool(SymbolOccurrenceRef Occur)> Receiver,
+                       CancellationTokenRef CancelToken) {
   assert(RoleSet && "did not set any role!");
-  auto providers = lookupProvidersForUSR(USR, RoleSet, None);
+  std::vector<SymbolDataProviderRef> providers;
+  if (!lookupProvidersForUSR(USR, RoleSet, None, CancelToken, providers))
+    return false;
   for (auto &prov : providers) {
+    if (CancelToken && CancelToken->isCancelled())
+      return false;
     bool Continue = prov->foreachSymbolOccurrenceByUSR(makeIDCodeFromString(USR), RoleSet,
       [&](SymbolOccurrenceRef Occur)->bool {
         return Receiver(std::move(Occur));
@@ -288,10 +380,15 @@ bool SymbolIndexImpl::foreachSymbolOccurrenceByUSR(StringRef USR,
 
 bool SymbolIndexImpl::foreachRelatedSymbolOccurrenceByUSR(StringRef USR,
                                                     SymbolRoleSet RoleSet,
-                       function_ref<bool(SymbolOccurrenceRef Occur)> Receiver) {
+                       function_ref<bool(SymbolOccurrenceRef Occur)> Receiver,
+                       CancellationTokenRef CancelToken) {
   assert(RoleSet && "did not set any role!");
-  auto providers = lookupProvidersForUSR(USR, None, RoleSet);
+  std::vector<SymbolDataProviderRef> providers;
+  if (!lookupProvidersForUSR(USR, None, RoleSet, CancelToken, providers))
+    return false;
   for (auto &prov : providers) {
+    if (CancelToken && CancelToken->isCancelled())
+      return false;
     bool Continue = prov->foreachRelatedSymbolOccurrenceByUSR(makeIDCodeFromString(USR), RoleSet,
       [&](SymbolOccurrenceRef Occur)->bool {
         return Receiver(std::move(Occur));
@@ -304,9 +401,50 @@ bool SymbolIndexImpl::foreachRelatedSymbolOccurrenceByUSR(StringRef USR,
   return true;
 }
 
+bool SymbolIndexImpl::foreachSymbolOccurrenceViewByUSR(StringRef USR,
+                                                        SymbolRoleSet RoleSet,
+                       function_ref<bool(const SymbolOccurrenceView &Occur)> Receiver,
+                       CancellationTokenRef CancelToken) {
+  assert(RoleSet && "did not set any role!");
+  std::vector<SymbolDataProviderRef> providers;
+  if (!lookupProvidersForUSR(USR, RoleSet, None, CancelToken, providers))
+    return false;
+  for (auto &prov : providers) {
+    if (CancelToken && CancelToken->isCancelled())
+      return false;
+    bool Continue = prov->foreachSymbolOccurrenceViewByUSR(makeIDCodeFromString(USR), RoleSet, Receiver);
+    ++NumProviderForeachSymbolOccurrenceByUSR;
+    if (!Continue)
+      return false;
+  }
+
+  return true;
+}
+
+bool SymbolIndexImpl::foreachRelatedSymbolOccurrenceViewByUSR(StringRef USR,
+                                                               SymbolRoleSet RoleSet,
+                       function_ref<bool(const SymbolOccurrenceView &Occur)> Receiver,
+                       CancellationTokenRef CancelToken) {
+  assert(RoleSet && "did not set any role!");
+  std::vector<SymbolDataProviderRef> providers;
+  if (!lookupProvidersForUSR(USR, None, RoleSet, CancelToken, providers))
+    return false;
+  for (auto &prov : providers) {
+    if (CancelToken && CancelToken->isCancelled())
+      return false;
+    bool Continue = prov->foreachRelatedSymbolOccurrenceViewByUSR(makeIDCodeFromString(USR), RoleSet, Receiver);
+    ++NumProviderForeachRelatedSymbolOccurrenceByUSR;
+    if (!Continue)
+      return false;
+  }
+
+  return true;
+}
+
 bool SymbolIndexImpl::foreachCanonicalSymbolImpl(bool workspaceOnly,
                                                  function_ref<bool(ReadTransaction &, function_ref<bool(ArrayRef<IDCode> usrCode)> usrConsumer)> usrProducer,
-                                                 function_ref<bool(SymbolDataProviderRef, std::vector<std::pair<IDCode, bool>> USRs)> receiver) {
+                                                 function_ref<bool(SymbolDataProviderRef, std::vector<std::pair<IDCode, bool>> USRs)> receiver,
+                                                 const CancellationTokenRef &cancelToken) {
   SymbolRoleSet DeclOrCanon = SymbolRoleSet(SymbolRole::Declaration) | SymbolRole::Canonical;
 
   struct PerProviderInfo {
@@ -316,9 +454,12 @@ bool SymbolIndexImpl::foreachCanonicalSymbolImpl(bool workspaceOnly,
   };
   std::unordered_map<IDCode, PerProviderInfo> InfoByProvider;
   {
-    ReadTransaction reader(DBase);
+    QueryProfile::PhaseTimer timer(QueryProfile::Phase::LookupProviders);
+    ReadTransaction reader(DBase, cancelToken);
     bool cont = usrProducer(reader, [&](ArrayRef<IDCode> usrCodes) -> bool {
       for (IDCode usrCode : usrCodes) {
+        if (reader.isCancelled())
+          return false;
         // Pairs of (IDCode, isCanon), canonicals go at the front.
         std::deque<std::pair<IDCode, bool>> providerCodes;
         reader.lookupProvidersForUSR(usrCode, DeclOrCanon, None, [&](IDCode providerCode, SymbolRoleSet roles, SymbolRoleSet relatedRoles) -> bool {
@@ -366,6 +507,8 @@ bool SymbolIndexImpl::foreachCanonicalSymbolImpl(bool workspaceOnly,
       continue;
     if (workspaceOnly && provInfo.Provider->isSystem())
       continue;
+    if (cancelToken && cancelToken->isCancelled())
+      return false;
     if (!receiver(std::move(provInfo.Provider), std::move(provInfo.USRs)))
       return false;
   }
@@ -375,7 +518,8 @@ bool SymbolIndexImpl::foreachCanonicalSymbolImpl(bool workspaceOnly,
 
 bool SymbolIndexImpl::foreachCanonicalSymbolOccurrenceImpl(bool workspaceOnly,
                                                            function_ref<bool(ReadTransaction &, function_ref<bool(ArrayRef<IDCode> usrCode)> usrConsumer)> usrProducer,
-                                                           function_ref<bool(SymbolOccurrenceRef)> Receiver) {
+                                                           function_ref<bool(SymbolOccurrenceRef)> Receiver,
+                                                           const CancellationTokenRef &cancelToken) {
   SymbolRoleSet DeclOrCanon = SymbolRoleSet(SymbolRole::Declaration) | SymbolRole::Canonical;
   return foreachCanonicalSymbolImpl(workspaceOnly, usrProducer, [&](SymbolDataProviderRef Prov, std::vector<std::pair<IDCode, bool>> USRsInfo) -> bool {
     SmallVector<IDCode, 16> USRs;
@@ -407,7 +551,7 @@ bool SymbolIndexImpl::foreachCanonicalSymbolOccurrenceImpl(bool workspaceOnly,
     ++NumProviderForeachSymbolOccurrenceByUSR;
 
     return !ReceiverStopped;
-  });
+  }, cancelToken);
 }
 
 bool SymbolIndexImpl::foreachCanonicalSymbolOccurrenceContainingPattern(StringRef Pattern,
@@ -415,25 +559,28 @@ bool SymbolIndexImpl::foreachCanonicalSymbolOccurrenceContainingPattern(StringRe
                                                                bool AnchorEnd,
                                                                bool Subsequence,
                                                                bool IgnoreCase,
-                             function_ref<bool(SymbolOccurrenceRef)> Receiver) {
+                             function_ref<bool(SymbolOccurrenceRef)> Receiver,
+                             CancellationTokenRef CancelToken) {
   return foreachCanonicalSymbolOccurrenceImpl(/*workspaceOnly=*/false,
                                               [=](ReadTransaction &reader,
                                                  function_ref<bool (ArrayRef<IDCode>)> usrConsumer) -> bool {
     return reader.findUSRsWithNameContaining(Pattern, AnchorStart, AnchorEnd, Subsequence, IgnoreCase, usrConsumer);
-  }, Receiver);
+  }, Receiver, CancelToken);
 }
 
 bool SymbolIndexImpl::foreachCanonicalSymbolOccurrenceByName(StringRef name,
-                             function_ref<bool(SymbolOccurrenceRef)> receiver) {
+                             function_ref<bool(SymbolOccurrenceRef)> receiver,
+                             CancellationTokenRef cancelToken) {
   return foreachCanonicalSymbolOccurrenceImpl(/*workspaceOnly=*/false,
                                               [=](ReadTransaction &reader,
                                                  function_ref<bool (ArrayRef<IDCode>)> usrConsumer) -> bool {
     return reader.foreachUSRBySymbolName(name, usrConsumer);
-  }, receiver);
+  }, receiver, cancelToken);
 }
 
-bool SymbolIndexImpl::foreachSymbolName(function_ref<bool(StringRef name)> receiver) {
-  ReadTransaction reader(DBase);
+bool SymbolIndexImpl::foreachSymbolName(function_ref<bool(StringRef name)> receiver,
+                                        CancellationTokenRef cancelToken) {
+  ReadTransaction reader(DBase, cancelToken);
   return reader.foreachSymbolName(std::move(receiver));
 }
 
@@ -452,19 +599,113 @@ bool SymbolIndexImpl::foreachCanonicalSymbolOccurrenceByUSR(StringRef USR,
   return true;
 }
 
+SymbolOccurrenceCount SymbolIndexImpl::countSymbolOccurrencesByUSR(StringRef USR, SymbolRoleSet RoleSet) {
+  assert(RoleSet && "did not set any role!");
+  return countOccurrencesImpl(USR, RoleSet, /*related=*/false);
+}
+
+SymbolOccurrenceCount SymbolIndexImpl::countRelatedSymbolOccurrencesByUSR(StringRef USR, SymbolRoleSet RoleSet) {
+  assert(RoleSet && "did not set any role!");
+  return countOccurrencesImpl(USR, RoleSet, /*related=*/true);
+}
+
+SymbolOccurrenceCount SymbolIndexImpl::countOccurrencesImpl(StringRef USR, SymbolRoleSet RoleSet, bool related) {
+  SymbolOccurrenceCount result;
+  Optional<size_t> occurrenceCount = 0;
+  std::unordered_set<IDCode> fileCodes;
+  QueryProfile::PhaseTimer timer(QueryProfile::Phase::LookupProviders);
+  ReadTransaction reader(DBase);
+  reader.lookupProviderOccurrenceCountsForUSR(makeIDCodeFromString(USR),
+                                              related ? SymbolRoleSet() : RoleSet,
+                                              related ? RoleSet : SymbolRoleSet(),
+      [&](IDCode providerCode, SymbolRoleSet roles, SymbolRoleSet relatedRoles,
+          Optional<unsigned> numOccurrences, Optional<unsigned> numRelatedOccurrences) -> bool {
+    auto provInfo = getVisibleProviderInfo(providerCode, reader);
+    if (!provInfo.isVisible())
+      return true;
+
+    ++result.ProviderCount;
+    fileCodes.insert(provInfo.FileCodes.begin(), provInfo.FileCodes.end());
+
+    // The occurrences are reported once for each source file of the record.
+    Optional<unsigned> providerCount = related ? numRelatedOccurrences : numOccurrences;
+    if (occurrenceCount.hasValue() && providerCount.hasValue())
+      occurrenceCount = occurrenceCount.getValue() + size_t(providerCount.getValue()) * provInfo.FileCodes.size();
+    else
+      occurrenceCount = None;
+
+    // If all the roles of the symbol in the record are requested then every occurrence matches. The canonical role
+    // is derived from the declaration or definition role so it doesn't affect the check, unless it is requested.
+    // For related occurrences the relation roles are also part of the roles of the occurrence.
+    SymbolRoleSet providerRoles = related ? relatedRoles : roles;
+    uint64_t unrequestedRoles = providerRoles.toRaw() & ~RoleSet.toRaw() & ~uint64_t(SymbolRole::Canonical);
+    if (unrequestedRoles != 0)
+      result.IsExact = false;
+    return true;
+  });
+
+  result.FileCount = fileCodes.size();
+  result.OccurrenceCount = occurrenceCount;
+  return result;
+}
+
 size_t SymbolIndexImpl::countOfCanonicalSymbolsWithKind(SymbolKind symKind, bool workspaceOnly) {
+  // Follows the provider selection of foreachCanonicalSymbolImpl but only checks the visibility of providers in the
+  // database, it doesn't create them.
+  SymbolRoleSet DeclOrCanon = SymbolRoleSet(SymbolRole::Declaration) | SymbolRole::Canonical;
+
   size_t totalCount = 0;
-  foreachCanonicalSymbolImpl(workspaceOnly,
-                                    [=](ReadTransaction &reader, function_ref<bool (ArrayRef<IDCode>)> usrConsumer) -> bool {
-    return reader.foreachUSROfGlobalSymbolKind(symKind, usrConsumer);
-  }, [&totalCount](SymbolDataProviderRef Prov, std::vector<std::pair<IDCode, bool>> USRsInfo) -> bool {
-    totalCount += USRsInfo.size();
+  QueryProfile::PhaseTimer timer(QueryProfile::Phase::LookupProviders);
+  ReadTransaction reader(DBase);
+  if (reader.countUSRsOfGlobalSymbolKind(symKind) == 0)
+    return 0;
+
+  std::unordered_map<IDCode, VisibleProviderInfo> InfoByProvider;
+  auto getProvInfo = [&](IDCode provCode) -> const VisibleProviderInfo & {
+    auto found = InfoByProvider.find(provCode);
+    if (found != InfoByProvider.end())
+      return found->second;
+    return InfoByProvider.emplace(provCode, getVisibleProviderInfo(provCode, reader)).first->second;
+  };
+
+  reader.foreachUSROfGlobalSymbolKind(symKind, [&](ArrayRef<IDCode> usrCodes) -> bool {
+    for (IDCode usrCode : usrCodes) {
+      // Pairs of (IDCode, isCanon), canonicals go at the front.
+      std::deque<std::pair<IDCode, bool>> providerCodes;
+      reader.lookupProvidersForUSR(usrCode, DeclOrCanon, None, [&](IDCode providerCode, SymbolRoleSet roles, SymbolRoleSet relatedRoles) -> bool {
+        if (roles.contains(SymbolRole::Canonical))
+          providerCodes.push_front({providerCode, true});
+        else
+          providerCodes.push_back({providerCode, false});
+        return true;
+      });
+
+      bool foundCanon = false;
+      for (auto &pair : providerCodes) {
+        IDCode provCode = pair.first;
+        bool isCanon = pair.second;
+        if (!isCanon && foundCanon)
+          break;
+        auto &provInfo = getProvInfo(provCode);
+        if (!provInfo.isVisible())
+          continue;
+        foundCanon = foundCanon || isCanon;
+        if (workspaceOnly && provInfo.IsSystem)
+          continue;
+        ++totalCount;
+      }
+    }
     return true;
   });
 
   return totalCount;
 }
 
+size_t SymbolIndexImpl::estimateCountOfSymbolsWithKind(SymbolKind symKind) {
+  ReadTransaction reader(DBase);
+  return reader.countUSRsOfGlobalSymbolKind(symKind);
+}
+
 bool SymbolIndexImpl::foreachSymbolInFilePath(CanonicalFilePathRef filePath,
                                               function_ref<bool(SymbolRef Symbol)> Receiver) {
     bool didFinish = true;
@@ -531,11 +772,12 @@ bool SymbolIndexImpl::foreachSymbolOccurrenceInFilePath(CanonicalFilePathRef fil
 }
 
 bool SymbolIndexImpl::foreachCanonicalSymbolOccurrenceByKind(SymbolKind symKind, bool workspaceOnly,
-                                                             function_ref<bool(SymbolOccurrenceRef Occur)> Receiver) {
+                                                             function_ref<bool(SymbolOccurrenceRef Occur)> Receiver,
+                                                             CancellationTokenRef CancelToken) {
   return foreachCanonicalSymbolOccurrenceImpl(workspaceOnly,
                                               [=](ReadTransaction &reader, function_ref<bool (ArrayRef<IDCode>)> usrConsumer) -> bool {
     return reader.foreachUSROfGlobalSymbolKind(symKind, usrConsumer);
-  }, Receiver);
+  }, Receiver, CancelToken);
 }
 
 std::vector<std::pair<SymbolDataProviderRef, bool>>
@@ -543,6 +785,7 @@ SymbolIndexImpl::findCanonicalProvidersForUSR(IDCode usrCode) {
   std::vector<std::pair<SymbolDataProviderRef, bool>> foundProvs;
 
   SymbolRoleSet DeclOrCanon = SymbolRoleSet(SymbolRole::Declaration) | SymbolRole::Canonical;
+  QueryProfile::PhaseTimer timer(QueryProfile::Phase::LookupProviders);
   ReadTransaction reader(DBase);
   // Pairs of (IDCode, isCanon), definitions go at the front.
   std::deque<std::pair<IDCode, bool>> provCodes;
@@ -569,10 +812,11 @@ SymbolIndexImpl::findCanonicalProvidersForUSR(IDCode usrCode) {
   return foundProvs;
 }
 
-bool SymbolIndexImpl::foreachUnitTestSymbolReferencedByOutputPaths(ArrayRef<CanonicalFilePathRef> outFilePaths, function_ref<bool(SymbolOccurrenceRef Occur)> receiver) {
+bool SymbolIndexImpl::foreachUnitTestSymbolReferencedByOutputPaths(ArrayRef<CanonicalFilePathRef> outFilePaths, function_ref<bool(SymbolOccurrenceRef Occur)> receiver,
+                                                                   CancellationTokenRef cancelToken) {
   std::vector<SymbolDataProviderRef> providers;
   {
-    ReadTransaction reader(DBase);
+    ReadTransaction reader(DBase, cancelToken);
 
     std::unordered_set<IDCode> outFileCodes;
     for (const CanonicalFilePathRef &path : outFilePaths) {
@@ -584,13 +828,14 @@ bool SymbolIndexImpl::foreachUnitTestSymbolReferencedByOutputPaths(ArrayRef<Cano
     });
   }
 
-  return foreachUnitTestSymbolOccurrence(providers, receiver);
+  return foreachUnitTestSymbolOccurrence(providers, receiver, cancelToken);
 }
 
-bool SymbolIndexImpl::foreachUnitTestSymbolReferencedByMainFiles(ArrayRef<CanonicalFilePath> mainFilePaths, function_ref<bool(SymbolOccurrenceRef Occur)> receiver) {
+bool SymbolIndexImpl::foreachUnitTestSymbolReferencedByMainFiles(ArrayRef<CanonicalFilePath> mainFilePaths, function_ref<bool(SymbolOccurrenceRef Occur)> receiver,
+                                                                 CancellationTokenRef cancelToken) {
   std::vector<SymbolDataProviderRef> providers;
   {
-    ReadTransaction reader(DBase);
+    ReadTransaction reader(DBase, cancelToken);
 
     std::unordered_set<IDCode> fileCodes;
     for (const CanonicalFilePathRef &path : mainFilePaths) {
@@ -601,19 +846,21 @@ bool SymbolIndexImpl::foreachUnitTestSymbolReferencedByMainFiles(ArrayRef<Canoni
       return fileCodes.count(unitInfo.MainFileCode);
     });
   }
-  return foreachUnitTestSymbolOccurrence(providers, receiver);
+  return foreachUnitTestSymbolOccurrence(providers, receiver, cancelToken);
 }
 
-bool SymbolIndexImpl::foreachUnitTestSymbol(function_ref<bool(SymbolOccurrenceRef Occur)> receiver) {
+bool SymbolIndexImpl::foreachUnitTestSymbol(function_ref<bool(SymbolOccurrenceRef Occur)> receiver,
+                                            CancellationTokenRef cancelToken) {
   std::vector<SymbolDataProviderRef> providers;
   {
-    ReadTransaction reader(DBase);
+    ReadTransaction reader(DBase, cancelToken);
     providers = providersContainingTestCases(reader, [&](const UnitInfo &unitInfo) -> bool { return true; });
   }
-  return foreachUnitTestSymbolOccurrence(providers, receiver);
+  return foreachUnitTestSymbolOccurrence(providers, receiver, cancelToken);
 }
 
 std::vector<SymbolDataProviderRef> SymbolIndexImpl::providersContainingTestCases(ReadTransaction &reader, function_ref<bool(const UnitInfo &)> unitFilter) {
+  QueryProfile::PhaseTimer timer(QueryProfile::Phase::LookupProviders);
   std::vector<SymbolDataProviderRef> providers;
   reader.foreachProviderContainingTestSymbols([&](IDCode providerCode) -> bool {
     if (auto provider = createProviderForCode(providerCode, reader, unitFilter)) {
@@ -624,8 +871,11 @@ std::vector<SymbolDataProviderRef> SymbolIndexImpl::providersContainingTestCases
   return providers;
 }
 
-bool SymbolIndexImpl::foreachUnitTestSymbolOccurrence(const std::vector<SymbolDataProviderRef> &providers, function_ref<bool(SymbolOccurrenceRef Occur)> receiver) {
+bool SymbolIndexImpl::foreachUnitTestSymbolOccurrence(const std::vector<SymbolDataProviderRef> &providers, function_ref<bool(SymbolOccurrenceRef Occur)> receiver,
+                                                      const CancellationTokenRef &cancelToken) {
   for (SymbolDataProviderRef provider : providers) {
+    if (cancelToken && cancelToken->isCancelled())
+      return false;
     bool cont = provider->foreachUnitTestSymbolOccurrence(receiver);
     if (!cont) return false;
   }
@@ -659,8 +909,10 @@ llvm::Optional<sys::TimePoint<>> SymbolIndexImpl::timestampOfLatestUnitForFile(C
 void SymbolDataProvider::anchor() {}
 
 SymbolIndex::SymbolIndex(DatabaseRef dbase, indexstore::IndexStoreRef indexStore,
-                         std::shared_ptr<FileVisibilityChecker> visibilityChecker) {
-  Impl = new SymbolIndexImpl(std::move(dbase), std::move(indexStore), std::move(visibilityChecker));
+                         std::shared_ptr<FileVisibilityChecker> visibilityChecker,
+                         bool recordOccurrenceCounts) {
+  Impl = new SymbolIndexImpl(std::move(dbase), std::move(indexStore), std::move(visibilityChecker),
+                             recordOccurrenceCounts);
 }
 
 #define IMPL static_cast<SymbolIndexImpl*>(Impl)
@@ -687,14 +939,30 @@ void SymbolIndex::dumpProviderFileAssociations(raw_ostream &OS) {
 
 bool SymbolIndex::foreachSymbolOccurrenceByUSR(StringRef USR,
                                                 SymbolRoleSet RoleSet,
-                       function_ref<bool(SymbolOccurrenceRef Occur)> Receiver) {
-  return IMPL->foreachSymbolOccurrenceByUSR(USR, RoleSet, std::move(Receiver));
+                       function_ref<bool(SymbolOccurrenceRef Occur)> Receiver,
+                       CancellationTokenRef CancelToken) {
+  return IMPL->foreachSymbolOccurrenceByUSR(USR, RoleSet, std::move(Receiver), std::move(CancelToken));
 }
 
 bool SymbolIndex::foreachRelatedSymbolOccurrenceByUSR(StringRef USR,
                                                 SymbolRoleSet RoleSet,
-                       function_ref<bool(SymbolOccurrenceRef Occur)> Receiver) {
-  return IMPL->foreachRelatedSymbolOccurrenceByUSR(USR, RoleSet, std::move(Receiver));
+                       function_ref<bool(SymbolOccurrenceRef Occur)> Receiver,
+                       CancellationTokenRef CancelToken) {
+  return IMPL->foreachRelatedSymbolOccurrenceByUSR(USR, RoleSet, std::move(Receiver), std::move(CancelToken));
+}
+
+bool SymbolIndex::foreachSymbolOccurrenceViewByUSR(StringRef USR,
+                                                    SymbolRoleSet RoleSet,
+                       function_ref<bool(const SymbolOccurrenceView &Occur)> Receiver,
+                       CancellationTokenRef CancelToken) {
+  return IMPL->foreachSymbolOccurrenceViewByUSR(USR, RoleSet, std::move(Receiver), std::move(CancelToken));
+}
+
+bool SymbolIndex::foreachRelatedSymbolOccurrenceViewByUSR(StringRef USR,
+                                                           SymbolRoleSet RoleSet,
+                       function_ref<bool(const SymbolOccurrenceView &Occur)> Receiver,
+                       CancellationTokenRef CancelToken) {
+  return IMPL->foreachRelatedSymbolOccurrenceViewByUSR(USR, RoleSet, std::move(Receiver), std::move(CancelToken));
 }
 
 bool SymbolIndex::foreachCanonicalSymbolOccurrenceContainingPattern(StringRef Pattern,
@@ -702,19 +970,23 @@ bool SymbolIndex::foreachCanonicalSymbolOccurrenceContainingPattern(StringRef Pa
                                                            bool AnchorEnd,
                                                            bool Subsequence,
                                                            bool IgnoreCase,
-                             function_ref<bool(SymbolOccurrenceRef)> Receiver) {
+                             function_ref<bool(SymbolOccurrenceRef)> Receiver,
+                             CancellationTokenRef CancelToken) {
   return IMPL->foreachCanonicalSymbolOccurrenceContainingPattern(Pattern, AnchorStart, AnchorEnd,
                                                         Subsequence, IgnoreCase,
-                                                        std::move(Receiver));
+                                                        std::move(Receiver),
+                                                        std::move(CancelToken));
 }
 
 bool SymbolIndex::foreachCanonicalSymbolOccurrenceByName(StringRef name,
-                       function_ref<bool(SymbolOccurrenceRef Occur)> receiver) {
-  return IMPL->foreachCanonicalSymbolOccurrenceByName(name, std::move(receiver));
+                       function_ref<bool(SymbolOccurrenceRef Occur)> receiver,
+                       CancellationTokenRef cancelToken) {
+  return IMPL->foreachCanonicalSymbolOccurrenceByName(name, std::move(receiver), std::move(cancelToken));
 }
 
-bool SymbolIndex::foreachSymbolName(function_ref<bool(StringRef name)> receiver) {
-  return IMPL->foreachSymbolName(std::move(receiver));
+bool SymbolIndex::foreachSymbolName(function_ref<bool(StringRef name)> receiver,
+                                    CancellationTokenRef cancelToken) {
+  return IMPL->foreachSymbolName(std::move(receiver), std::move(cancelToken));
 }
 
 bool SymbolIndex::foreachCanonicalSymbolOccurrenceByUSR(StringRef USR,
@@ -722,13 +994,26 @@ bool SymbolIndex::foreachCanonicalSymbolOccurrenceByUSR(StringRef USR,
   return IMPL->foreachCanonicalSymbolOccurrenceByUSR(USR, std::move(receiver));
 }
 
+SymbolOccurrenceCount SymbolIndex::countSymbolOccurrencesByUSR(StringRef USR, SymbolRoleSet RoleSet) {
+  return IMPL->countSymbolOccurrencesByUSR(USR, RoleSet);
+}
+
+SymbolOccurrenceCount SymbolIndex::countRelatedSymbolOccurrencesByUSR(StringRef USR, SymbolRoleSet RoleSet) {
+  return IMPL->countRelatedSymbolOccurrencesByUSR(USR, RoleSet);
+}
+
 size_t SymbolIndex::countOfCanonicalSymbolsWithKind(SymbolKind symKind, bool workspaceOnly) {
   return IMPL->countOfCanonicalSymbolsWithKind(symKind, workspaceOnly);
 }
 
+size_t SymbolIndex::estimateCountOfSymbolsWithKind(SymbolKind symKind) {
+  return IMPL->estimateCountOfSymbolsWithKind(symKind);
+}
+
 bool SymbolIndex::foreachCanonicalSymbolOccurrenceByKind(SymbolKind symKind, bool workspaceOnly,
-                                                         function_ref<bool(SymbolOccurrenceRef Occur)> Receiver) {
-  return IMPL->foreachCanonicalSymbolOccurrenceByKind(symKind, workspaceOnly, std::move(Receiver));
+                                                         function_ref<bool(SymbolOccurrenceRef Occur)> Receiver,
+                                                         CancellationTokenRef CancelToken) {
+  return IMPL->foreachCanonicalSymbolOccurrenceByKind(symKind, workspaceOnly, std::move(Receiver), std::move(CancelToken));
 }
 
 bool SymbolIndex::foreachSymbolInFilePath(CanonicalFilePathRef filePath,
@@ -742,19 +1027,22 @@ bool SymbolIndex::foreachSymbolOccurrenceInFilePath(CanonicalFilePathRef filePat
 }
 
 bool SymbolIndex::foreachUnitTestSymbolReferencedByOutputPaths(ArrayRef<CanonicalFilePathRef> FilePaths,
-    function_ref<bool(SymbolOccurrenceRef Occur)> Receiver) {
-  return IMPL->foreachUnitTestSymbolReferencedByOutputPaths(FilePaths, std::move(Receiver));
+    function_ref<bool(SymbolOccurrenceRef Occur)> Receiver,
+    CancellationTokenRef CancelToken) {
+  return IMPL->foreachUnitTestSymbolReferencedByOutputPaths(FilePaths, std::move(Receiver), std::move(CancelToken));
 }
 
 bool SymbolIndex::foreachUnitTestSymbolReferencedByMainFiles(
      ArrayRef<CanonicalFilePath> mainFilePaths,
-     function_ref<bool(SymbolOccurrenceRef Occur)> receiver
+     function_ref<bool(SymbolOccurrenceRef Occur)> receiver,
+     CancellationTokenRef cancelToken
  ) {
-  return IMPL->foreachUnitTestSymbolReferencedByMainFiles(mainFilePaths, std::move(receiver));
+  return IMPL->foreachUnitTestSymbolReferencedByMainFiles(mainFilePaths, std::move(receiver), std::move(cancelToken));
 }
 
-bool SymbolIndex::foreachUnitTestSymbol(function_ref<bool(SymbolOccurrenceRef Occur)> receiver) {
-  return IMPL->foreachUnitTestSymbol(std::move(receiver));
+bool SymbolIndex::foreachUnitTestSymbol(function_ref<bool(SymbolOccurrenceRef Occur)> receiver,
+                                        CancellationTokenRef cancelToken) {
+  return IMPL->foreachUnitTestSymbol(std::move(receiver), std::move(cancelToken));
 }
 
 llvm::Optional<llvm::sys::TimePoint<>> SymbolIndex::timestampOfLatestUnitForFile(CanonicalFilePathRef filePath) {
@@ -0,0 +1,136 @@
+//===--- UnitEventQueue.cpp -----------------------------------------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2018 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://swift.org/LICENSE.txt for license information
+// See https://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#include "UnitEventQueue.h"
+#include "IndexStoreDB/Database/Database.h"
+#include "IndexStoreDB/Support/Metrics.h"
+
+using namespace IndexStoreDB;
+using namespace IndexStoreDB::db;
+using namespace IndexStoreDB::index;
+using namespace indexstore;
+using namespace llvm;
+
+static metrics::Gauge NumPendingUnitEvents("import.pending_unit_events",
+                                           "Unit events waiting to be processed");
+static metrics::Counter NumCoalescedUnitEvents("import.coalesced_unit_events",
+                                               "Unit events merged into a pending event of the same unit");
+
+constexpr std::chrono::seconds UnitEventQueue::HighPriorityHeadStart;
+
+bool UnitEventQueue::isCurrent(const Entry &entry) const {
+  if (entry.NonUnitEvent)
+    return true;
+  auto found = PendingUnits.find(entry.UnitCode);
+  return found != PendingUnits.end() && found->second.Sequence == entry.Sequence;
+}
+
+void UnitEventQueue::dropStaleEntries(std::deque<Entry> &events) {
+  while (!events.empty() && !isCurrent(events.front()))
+    events.pop_front();
+}
+
+unsigned UnitEventQueue::addEvents(ArrayRef<UnitEventInfo> evts) {
+  auto now = std::chrono::steady_clock::now();
+  sys::ScopedLock L(StateMtx);
+  unsigned numCoalesced = 0;
+  for (const UnitEventInfo &evt : evts) {
+    if (evt.kind == IndexStore::UnitEvent::Kind::DirectoryDeleted) {
+      getEvents(evt.priority).push_back(Entry{IDCode(), 0, now, evt});
+      ++NumPending;
+      continue;
+    }
+
+    IDCode unitCode = makeIDCodeFromString(evt.name);
+    auto inserted = PendingUnits.insert(std::make_pair(unitCode, PendingUnit{evt, 0}));
+    PendingUnit &pending = inserted.first->second;
+    if (inserted.second) {
+      ++NumPending;
+    } else {
+      ++numCoalesced;
+      UnitEventInfo &info = pending.Info;
+      // Added and Modified are processed the same way, the latest kind tells
+      // whether the unit still exists.
+      info.kind = evt.kind;
+      info.isInitialScan |= evt.isInitialScan;
+      info.isDependency |= evt.isDependency;
+      info.modTime = evt.modTime;
+      if (info.priority == UnitEventPriority::High || evt.priority != UnitEventPriority::High)
+        continue; // Keeps its place in the queue.
+      info.priority = UnitEventPriority::High;
+    }
+    pending.Sequence = NextSequence++;
+    getEvents(pending.Info.priority).push_back(Entry{unitCode, pending.Sequence, now, None});
+  }
+  NumPendingUnitEvents.add(evts.size() - numCoalesced);
+  NumCoalescedUnitEvents.add(numCoalesced);
+  return numCoalesced;
+}
+
+std::vector<UnitEventInfo> UnitEventQueue::popFront(unsigned N) {
+  sys::ScopedLock L(StateMtx);
+  std::vector<UnitEventInfo> evts;
+  while (evts.size() < N) {
+    dropStaleEntries(HighPriorityEvents);
+    dropStaleEntries(NormalPriorityEvents);
+    bool takeHighPriority;
+    if (HighPriorityEvents.empty() && NormalPriorityEvents.empty()) {
+      break;
+    } else if (HighPriorityEvents.empty()) {
+      takeHighPriority = false;
+    } else if (NormalPriorityEvents.empty()) {
+      takeHighPriority = true;
+    } else {
+      takeHighPriority = HighPriorityEvents.front().EnqueueTime - HighPriorityHeadStart <=
+                         NormalPriorityEvents.front().EnqueueTime;
+    }
+
+    auto &events = takeHighPriority ? HighPriorityEvents : NormalPriorityEvents;
+    Entry entry = std::move(events.front());
+    events.pop_front();
+    if (entry.NonUnitEvent) {
+      evts.push_back(std::move(entry.NonUnitEvent.getValue()));
+    } else {
+      auto found = PendingUnits.find(entry.UnitCode);
+      evts.push_back(std::move(found->second.Info));
+      PendingUnits.erase(found);
+    }
+    --NumPending;
+  }
+  NumPendingUnitEvents.add(-int64_t(evts.size()));
+  return evts;
+}
+
+void UnitEventQueue::prioritize(const std::unordered_set<IDCode> &unitCodes) {
+  auto now = std::chrono::steady_clock::now();
+  sys::ScopedLock L(StateMtx);
+  for (IDCode unitCode : unitCodes) {
+    auto found = PendingUnits.find(unitCode);
+    if (found == PendingUnits.end() || found->second.Info.priority == UnitEventPriority::High)
+      continue;
+    PendingUnit &pending = found->second;
+    pending.Info.priority = UnitEventPriority::High;
+    pending.Sequence = NextSequence++;
+    HighPriorityEvents.push_front(Entry{unitCode, pending.Sequence, now, None});
+  }
+}
+
+bool UnitEventQueue::empty() const {
+  sys::ScopedLock L(StateMtx);
+  return NumPending == 0;
+}
+
+bool UnitEventQueue::hasEnqueuedUnitDependency(StringRef unitName) const {
+  sys::ScopedLock L(StateMtx);
+  auto found = PendingUnits.find(makeIDCodeFromString(unitName));
+  return found != PendingUnits.end() && found->second.Info.isDependency;
+}
@@ -0,0 +1,119 @@
+//===--- UnitEventQueue.h ---------------------------------------*- C++ -*-===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2018 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://swift.org/LICENSE.txt for license information
+// See https://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef INDEXSTOREDB_LIB_INDEX_UNITEVENTQUEUE_H
+#define INDEXSTOREDB_LIB_INDEX_UNITEVENTQUEUE_H
+
+#include "IndexStoreDB/Database/IDCode.h"
+#include "IndexStoreDB/Support/LLVM.h"
+#include "indexstore/IndexStoreCXX.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Chrono.h"
+#include "llvm/Support/Mutex.h"
+#include <chrono>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace IndexStoreDB {
+namespace index {
+
+enum class UnitEventPriority : uint8_t {
+  Normal,
+  /// Units that the user is likely waiting for: units of registered main
+  /// files or of explicit output files, and units of files that were boosted
+  /// or queried while the units were pending.
+  High,
+};
+
+struct UnitEventInfo {
+  indexstore::IndexStore::UnitEvent::Kind kind;
+  std::string name;
+  /// Whether this is from the initial unit scan.
+  bool isInitialScan;
+  /// Whether this is an explicit enqueue of a dependency unit for processing, while `UseExplicitOutputUnits` is enabled.
+  bool isDependency;
+  /// The modification time of the unit, if the event source already got it.
+  Optional<llvm::sys::TimePoint<>> modTime;
+  UnitEventPriority priority = UnitEventPriority::Normal;
+
+  UnitEventInfo(indexstore::IndexStore::UnitEvent::Kind kind, std::string name, bool isInitialScan, bool isDependency = false)
+  : kind(kind), name(std::move(name)), isInitialScan(isInitialScan), isDependency(isDependency) {}
+};
+
+/// Queue of the unit events waiting to be processed, which serves the high
+/// priority events first.
+///
+/// Events are coalesced per unit: a unit has at most one pending event, which
+/// reflects the latest event received for it, so a unit that changes many
+/// times before being processed is only imported once.
+///
+/// Normal priority events age so that they don't starve: an event is served
+/// before the high priority events that were enqueued more than
+/// \c HighPriorityHeadStart after it.
+class UnitEventQueue {
+public:
+  static constexpr std::chrono::seconds HighPriorityHeadStart{30};
+
+  /// \returns the number of events that were coalesced with a pending event
+  /// of the same unit.
+  unsigned addEvents(ArrayRef<UnitEventInfo> evts);
+
+  std::vector<UnitEventInfo> popFront(unsigned N);
+
+  /// Moves the normal priority events of \p unitCodes ahead of all the other
+  /// events.
+  void prioritize(const std::unordered_set<db::IDCode> &unitCodes);
+
+  bool empty() const;
+
+  bool hasEnqueuedUnitDependency(StringRef unitName) const;
+
+private:
+  struct Entry {
+    db::IDCode UnitCode;
+    /// Matches \c PendingUnit::Sequence while the entry is the current place
+    /// of the unit in the queue; entries left behind by a boost are skipped.
+    uint64_t Sequence;
+    std::chrono::steady_clock::time_point EnqueueTime;
+    /// Set for events that are not about a unit, which are not coalesced.
+    Optional<UnitEventInfo> NonUnitEvent;
+  };
+
+  struct PendingUnit {
+    UnitEventInfo Info;
+    uint64_t Sequence;
+  };
+
+  std::deque<Entry> &getEvents(UnitEventPriority priority) {
+    return priority == UnitEventPriority::High ? HighPriorityEvents : NormalPriorityEvents;
+  }
+
+  bool isCurrent(const Entry &entry) const;
+  void dropStaleEntries(std::deque<Entry> &events);
+
+  std::deque<Entry> HighPriorityEvents;
+  std::deque<Entry> NormalPriorityEvents;
+  std::unordered_map<db::IDCode, PendingUnit> PendingUnits;
+  uint64_t NextSequence = 1;
+  size_t NumPending = 0;
+  mutable llvm::sys::Mutex StateMtx;
+};
+
+} // namespace index
+} // namespace IndexStoreDB
+
+#endif
@@ -0,0 +1,200 @@
+//===--- UnitMonitorTable.cpp ---------------------------------------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2018 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://swift.org/LICENSE.txt for license information
+// See https://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#include "UnitMonitorTable.h"
+#include "IndexStoreDB/Support/MemoryGovernor.h"
+
+using namespace IndexStoreDB;
+using namespace IndexStoreDB::db;
+using namespace IndexStoreDB::index;
+using namespace llvm;
+
+/// The arena is compacted when more than this many bytes of it are unused and
+/// they are the most of it.
+static const size_t MinUnusedArenaBytesToCompact = 1024 * 1024;
+
+UnitMonitorTable::Slot UnitMonitorTable::add(IDCode unitCode, StringRef unitName, sys::TimePoint<> modTime,
+                                             ArrayRef<StringRef> directories,
+                                             std::vector<std::string> &addedDirectories,
+                                             std::vector<std::string> &removedDirectories) {
+  // Retain the new directories first, so that the ones the unit still has are
+  // not reported as removed and added again.
+  auto unitDirectories = retainDirectories(directories, addedDirectories);
+
+  Slot slot;
+  auto found = SlotsByCode.find(unitCode);
+  if (found != SlotsByCode.end()) {
+    slot = found->second;
+    releaseDirectories(slot, removedDirectories);
+    UnusedArenaBytes += Directories[slot].size() * sizeof(DirectoryEntry *);
+    Triggers.erase(slot);
+  } else {
+    if (!FreeSlots.empty()) {
+      slot = FreeSlots.back();
+      FreeSlots.pop_back();
+    } else {
+      slot = UnitCodes.size();
+      UnitCodes.emplace_back();
+      ModTimes.emplace_back();
+      UnitNames.emplace_back();
+      Directories.emplace_back();
+    }
+    char *name = Arena.Allocate<char>(unitName.size());
+    std::copy(unitName.begin(), unitName.end(), name);
+    UnitCodes[slot] = unitCode;
+    UnitNames[slot] = StringRef(name, unitName.size());
+    SlotsByCode[unitCode] = slot;
+  }
+  ModTimes[slot] = modTime;
+  Directories[slot] = unitDirectories;
+
+  compactIfMostlyUnused();
+  return slot;
+}
+
+void UnitMonitorTable::remove(IDCode unitCode, std::vector<std::string> &removedDirectories) {
+  auto found = SlotsByCode.find(unitCode);
+  if (found == SlotsByCode.end())
+    return;
+  Slot slot = found->second;
+  SlotsByCode.erase(found);
+
+  releaseDirectories(slot, removedDirectories);
+  UnusedArenaBytes += getArenaBytes(slot);
+  Triggers.erase(slot);
+  UnitCodes[slot] = IDCode();
+  UnitNames[slot] = StringRef();
+  Directories[slot] = ArrayRef<DirectoryEntry *>();
+  FreeSlots.push_back(slot);
+
+  compactIfMostlyUnused();
+}
+
+Optional<UnitMonitorTable::Slot> UnitMonitorTable::find(IDCode unitCode) const {
+  auto found = SlotsByCode.find(unitCode);
+  if (found == SlotsByCode.end())
+    return None;
+  return found->second;
+}
+
+ArrayRef<OutOfDateFileTriggerRef> UnitMonitorTable::getTriggers(Slot slot) const {
+  auto found = Triggers.find(slot);
+  if (found == Triggers.end())
+    return None;
+  return found->second;
+}
+
+bool UnitMonitorTable::isOutOfDateWith(Slot slot, StringRef filePath, sys::TimePoint<> modTime) const {
+  if (ModTimes[slot] >= modTime)
+    return false;
+  for (const auto &trigger : getTriggers(slot)) {
+    // Already marked as out-of-date related to this trigger file.
+    if (trigger->getPathRef() == filePath)
+      return trigger->getModTime() < modTime;
+  }
+  return true;
+}
+
+bool UnitMonitorTable::addTrigger(Slot slot, OutOfDateFileTriggerRef trigger) {
+  if (!isOutOfDateWith(slot, trigger->getPathRef(), trigger->getModTime()))
+    return false;
+  auto &triggers = Triggers[slot];
+  for (auto &existing : triggers) {
+    if (existing->getPathRef() == trigger->getPathRef()) {
+      existing = std::move(trigger);
+      return true;
+    }
+  }
+  triggers.push_back(std::move(trigger));
+  return true;
+}
+
+std::vector<std::string> UnitMonitorTable::getDirectories() const {
+  std::vector<std::string> directories;
+  directories.reserve(DirectoryCounts.size());
+  for (const auto &entry : DirectoryCounts)
+    directories.push_back(entry.getKey().str());
+  return directories;
+}
+
+ArrayRef<UnitMonitorTable::DirectoryEntry *>
+UnitMonitorTable::retainDirectories(ArrayRef<StringRef> directories,
+                                    std::vector<std::string> &addedDirectories) {
+  if (directories.empty())
+    return None;
+  auto **entries = Arena.Allocate<DirectoryEntry *>(directories.size());
+  for (size_t i = 0, e = directories.size(); i != e; ++i) {
+    auto &entry = *DirectoryCounts.try_emplace(directories[i], 0).first;
+    if (entry.getValue()++ == 0)
+      addedDirectories.push_back(directories[i].str());
+    entries[i] = &entry;
+  }
+  return makeArrayRef(entries, directories.size());
+}
+
+void UnitMonitorTable::releaseDirectories(Slot slot, std::vector<std::string> &removedDirectories) {
+  for (DirectoryEntry *entry : Directories[slot]) {
+    if (--entry->getValue() != 0)
+      continue;
+    removedDirectories.push_back(entry->getKey().str());
+    DirectoryCounts.erase(DirectoryCounts.find(entry->getKey()));
+  }
+}
+
+size_t UnitMonitorTable::getArenaBytes(Slot slot) const {
+  return UnitNames[slot].size() + Directories[slot].size() * sizeof(DirectoryEntry *);
+}
+
+size_t UnitMonitorTable::getMemoryUsage() const {
+  size_t bytes = getHashContainerMemoryUsage(SlotsByCode) +
+                 UnitCodes.capacity() * sizeof(IDCode) +
+                 ModTimes.capacity() * sizeof(sys::TimePoint<>) +
+                 UnitNames.capacity() * sizeof(StringRef) +
+                 Directories.capacity() * sizeof(ArrayRef<DirectoryEntry *>) +
+                 FreeSlots.capacity() * sizeof(Slot) +
+                 getHashContainerMemoryUsage(Triggers) +
+                 Arena.getTotalMemory();
+  bytes += DirectoryCounts.getNumBuckets() * (sizeof(void *) + sizeof(unsigned));
+  for (const auto &entry : DirectoryCounts)
+    bytes += sizeof(entry) + entry.getKeyLength() + 1;
+  // The out-of-date triggers are usually shared with other units and not
+  // counted.
+  return bytes;
+}
+
+void UnitMonitorTable::compact() {
+  llvm::BumpPtrAllocator arena;
+  for (const auto &entry : SlotsByCode) {
+    Slot slot = entry.second;
+    StringRef name = UnitNames[slot];
+    char *nameCopy = arena.Allocate<char>(name.size());
+    std::copy(name.begin(), name.end(), nameCopy);
+    UnitNames[slot] = StringRef(nameCopy, name.size());
+
+    ArrayRef<DirectoryEntry *> directories = Directories[slot];
+    if (directories.empty())
+      continue;
+    auto **directoriesCopy = arena.Allocate<DirectoryEntry *>(directories.size());
+    std::copy(directories.begin(), directories.end(), directoriesCopy);
+    Directories[slot] = makeArrayRef(directoriesCopy, directories.size());
+  }
+  Arena = std::move(arena);
+  UnusedArenaBytes = 0;
+  SlotsByCode.rehash(0);
+  Triggers.rehash(0);
+}
+
+void UnitMonitorTable::compactIfMostlyUnused() {
+  if (UnusedArenaBytes > MinUnusedArenaBytesToCompact &&
+      UnusedArenaBytes > Arena.getBytesAllocated() / 2)
+    compact();
+}
@@ -0,0 +1,108 @@
+//===--- UnitMonitorTable.h -------------------------------------*- C++ -*-===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2018 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://swift.org/LICENSE.txt for license information
+// See https://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef INDEXSTOREDB_LIB_INDEX_UNITMONITORTABLE_H
+#define INDEXSTOREDB_LIB_INDEX_UNITMONITORTABLE_H
+
+#include "IndexStoreDB/Database/IDCode.h"
+#include "IndexStoreDB/Index/IndexSystemDelegate.h"
+#include "IndexStoreDB/Support/LLVM.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/Chrono.h"
+#include <unordered_map>
+#include <vector>
+
+namespace IndexStoreDB {
+namespace index {
+
+/// The units that are monitored for out-of-date checks, as a table of columns
+/// indexed by the slot of the unit.
+///
+/// The names of the units and the lists of their directories are allocated in
+/// an arena, and only the units that are out of date have triggers. The table
+/// is not thread-safe.
+class UnitMonitorTable {
+public:
+  typedef uint32_t Slot;
+
+private:
+  typedef llvm::StringMapEntry<unsigned> DirectoryEntry;
+
+  std::unordered_map<db::IDCode, Slot> SlotsByCode;
+  std::vector<db::IDCode> UnitCodes;
+  std::vector<llvm::sys::TimePoint<>> ModTimes;
+  std::vector<StringRef> UnitNames;
+  /// The directories of the user files of each unit.
+  std::vector<ArrayRef<DirectoryEntry *>> Directories;
+  std::vector<Slot> FreeSlots;
+
+  /// The out-of-date files of each unit that is out of date.
+  std::unordered_map<Slot, llvm::SmallVector<OutOfDateFileTriggerRef, 1>> Triggers;
+
+  /// Number of units with user files directly in each directory.
+  llvm::StringMap<unsigned> DirectoryCounts;
+
+  llvm::BumpPtrAllocator Arena;
+  /// Bytes of the arena used by units that were removed or replaced.
+  size_t UnusedArenaBytes = 0;
+
+public:
+  /// Adds the monitor of a unit, or replaces it with no triggers.
+  ///
+  /// \param directories the unique directories of the user files of the unit.
+  /// \param addedDirectories gets the directories that no other unit had.
+  /// \param removedDirectories gets the directories of the replaced monitor
+  /// that no unit has anymore.
+  Slot add(db::IDCode unitCode, StringRef unitName, llvm::sys::TimePoint<> modTime,
+           ArrayRef<StringRef> directories,
+           std::vector<std::string> &addedDirectories,
+           std::vector<std::string> &removedDirectories);
+
+  void remove(db::IDCode unitCode, std::vector<std::string> &removedDirectories);
+
+  Optional<Slot> find(db::IDCode unitCode) const;
+  size_t size() const { return SlotsByCode.size(); }
+
+  StringRef getUnitName(Slot slot) const { return UnitNames[slot]; }
+  llvm::sys::TimePoint<> getModTime(Slot slot) const { return ModTimes[slot]; }
+  ArrayRef<OutOfDateFileTriggerRef> getTriggers(Slot slot) const;
+
+  /// \returns true if a change of \p filePath at \p modTime makes the unit out
+  /// of date and was not recorded yet.
+  bool isOutOfDateWith(Slot slot, StringRef filePath, llvm::sys::TimePoint<> modTime) const;
+  /// Records \p trigger for the unit if it makes the unit out of date.
+  /// \returns true if it was recorded.
+  bool addTrigger(Slot slot, OutOfDateFileTriggerRef trigger);
+
+  std::vector<std::string> getDirectories() const;
+
+  size_t getMemoryUsage() const;
+  /// Copies the arena allocations of the current units into a new arena and
+  /// releases the unused capacity of the maps.
+  void compact();
+
+private:
+  ArrayRef<DirectoryEntry *> retainDirectories(ArrayRef<StringRef> directories,
+                                               std::vector<std::string> &addedDirectories);
+  void releaseDirectories(Slot slot, std::vector<std::string> &removedDirectories);
+  size_t getArenaBytes(Slot slot) const;
+  void compactIfMostlyUnused();
+};
+
+} // namespace index
+} // namespace IndexStoreDB
+
+#endif
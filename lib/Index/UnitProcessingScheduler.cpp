@@ -0,0 +1,129 @@
+//===--- UnitProcessingScheduler.cpp --------------------------------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2018 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://swift.org/LICENSE.txt for license information
+// See https://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#include "UnitProcessingScheduler.h"
+#include "IndexStoreDB/Support/Concurrency.h"
+#include "IndexStoreDB/Support/Metrics.h"
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+
+using namespace IndexStoreDB;
+using namespace IndexStoreDB::index;
+
+static metrics::Gauge NumQueuedProcessingWork("import.queued_unit_processing_work",
+                                              "Unit processing work items of all the indexes waiting for their turn");
+static metrics::Histogram ProcessingWaitLatency("import.unit_processing_wait_latency",
+                                                "Time that the unit processing work items wait for their turn");
+
+UnitProcessingScheduler &UnitProcessingScheduler::getShared() {
+  // Never destroyed, the work of the indexes may still be running at exit.
+  static UnitProcessingScheduler *scheduler = new UnitProcessingScheduler();
+  return *scheduler;
+}
+
+void UnitProcessingScheduler::setConcurrency(unsigned concurrency) {
+  llvm::sys::ScopedLock L(StateMtx);
+  Concurrency = std::max(concurrency, 1u);
+  startReadyWork();
+}
+
+std::shared_ptr<UnitProcessingScheduler::Queue>
+UnitProcessingScheduler::createQueue(StringRef label, unsigned weight) {
+  return std::make_shared<Queue>(*this, label, weight);
+}
+
+void UnitProcessingScheduler::enqueue(std::shared_ptr<Queue> queue, std::function<void()> work) {
+  llvm::sys::ScopedLock L(StateMtx);
+  queue->Items.push_back(Queue::WorkItem{std::move(work), std::chrono::steady_clock::now()});
+  NumQueuedProcessingWork.add(1);
+  if (!queue->Running && queue->Items.size() == 1)
+    makeReady(std::move(queue));
+  startReadyWork();
+}
+
+void UnitProcessingScheduler::makeReady(std::shared_ptr<Queue> queue) {
+  queue->VirtualTime = std::max(queue->VirtualTime, VirtualTime);
+  ReadyQueues.push_back(std::move(queue));
+}
+
+void UnitProcessingScheduler::startReadyWork() {
+  while (NumRunning < Concurrency && !ReadyQueues.empty()) {
+    // There are only a few indexes in a process, a scan is cheaper than
+    // keeping a heap up to date.
+    auto next = std::min_element(ReadyQueues.begin(), ReadyQueues.end(),
+                                 [](const std::shared_ptr<Queue> &lhs, const std::shared_ptr<Queue> &rhs) {
+      return lhs->VirtualTime < rhs->VirtualTime;
+    });
+    std::shared_ptr<Queue> queue = std::move(*next);
+    ReadyQueues.erase(next);
+    VirtualTime = std::max(VirtualTime, queue->VirtualTime);
+
+    Queue::WorkItem item = std::move(queue->Items.front());
+    queue->Items.pop_front();
+    queue->Running = true;
+    ++NumRunning;
+    NumQueuedProcessingWork.add(-1);
+
+    auto startTime = std::chrono::steady_clock::now();
+    auto waitTime = std::chrono::duration_cast<std::chrono::nanoseconds>(startTime - item.EnqueueTime);
+    ProcessingWaitLatency.record(waitTime);
+    queue->Stats.TotalWaitTime += waitTime;
+    queue->Stats.MaxWaitTime = std::max(queue->Stats.MaxWaitTime, waitTime);
+    ++queue->Stats.ScheduledWork;
+
+    // This may do a lot of I/O, run it at low priority so that it doesn't
+    // wedge the system.
+    WorkQueue::dispatchConcurrent([this, queue, work = std::move(item.Work), startTime] {
+      work();
+      finished(queue, std::chrono::steady_clock::now() - startTime);
+    }, WorkQueue::Priority::Low);
+  }
+}
+
+void UnitProcessingScheduler::finished(std::shared_ptr<Queue> queue, std::chrono::nanoseconds runTime) {
+  llvm::sys::ScopedLock L(StateMtx);
+  --NumRunning;
+  queue->Running = false;
+  queue->Stats.TotalRunTime += runTime;
+  queue->VirtualTime += std::chrono::duration<double>(runTime).count() / queue->Weight;
+  if (!queue->Items.empty())
+    makeReady(std::move(queue));
+  startReadyWork();
+}
+
+void UnitProcessingScheduler::Queue::dispatch(std::function<void()> work) {
+  Scheduler.enqueue(shared_from_this(), std::move(work));
+}
+
+void UnitProcessingScheduler::Queue::dispatchSync(function_ref<void()> work) {
+  std::mutex doneMtx;
+  std::condition_variable doneCV;
+  bool done = false;
+  dispatch([&] {
+    work();
+    std::lock_guard<std::mutex> L(doneMtx);
+    done = true;
+    doneCV.notify_one();
+  });
+  WorkQueue::BlockingScope blocking;
+  std::unique_lock<std::mutex> L(doneMtx);
+  doneCV.wait(L, [&] { return done; });
+}
+
+UnitProcessingStats UnitProcessingScheduler::Queue::getStats() const {
+  llvm::sys::ScopedLock L(Scheduler.StateMtx);
+  UnitProcessingStats stats = Stats;
+  stats.Weight = Weight;
+  stats.QueuedWork = Items.size();
+  return stats;
+}
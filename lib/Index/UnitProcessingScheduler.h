@@ -0,0 +1,122 @@
+//===--- UnitProcessingScheduler.h ------------------------------*- C++ -*-===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2018 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://swift.org/LICENSE.txt for license information
+// See https://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef INDEXSTOREDB_LIB_INDEX_UNITPROCESSINGSCHEDULER_H
+#define INDEXSTOREDB_LIB_INDEX_UNITPROCESSINGSCHEDULER_H
+
+#include "IndexStoreDB/Support/LLVM.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Mutex.h"
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace IndexStoreDB {
+namespace index {
+
+/// Statistics of the unit processing queue of an index.
+struct UnitProcessingStats {
+  unsigned Weight = 0;
+  /// Work items waiting for their turn.
+  size_t QueuedWork = 0;
+  /// Work items that ran, and the time they waited and ran in total.
+  uint64_t ScheduledWork = 0;
+  std::chrono::nanoseconds TotalWaitTime{0};
+  std::chrono::nanoseconds MaxWaitTime{0};
+  std::chrono::nanoseconds TotalRunTime{0};
+};
+
+/// Runs the unit processing of the indexes of the process.
+///
+/// Each index has a queue whose work runs in order, one item at a time. The
+/// queues with pending work take turns in proportion to their weight, by the
+/// time that their work takes to run, so that the initial scan of an index
+/// doesn't hold back the incremental updates of the others. Up to the
+/// concurrency of the scheduler, 1 by default to keep the I/O of opening
+/// several indexes down, the work of different queues runs at the same time.
+class UnitProcessingScheduler {
+public:
+  class Queue;
+
+  /// The indexes of the process share \c getShared(), a scheduler of its own
+  /// is for testing.
+  UnitProcessingScheduler() = default;
+
+  static UnitProcessingScheduler &getShared();
+
+  void setConcurrency(unsigned concurrency);
+
+  /// \param weight the share of the processing time that the queue gets
+  /// while other queues have work as well.
+  std::shared_ptr<Queue> createQueue(StringRef label, unsigned weight);
+
+private:
+  void enqueue(std::shared_ptr<Queue> queue, std::function<void()> work);
+  void makeReady(std::shared_ptr<Queue> queue);
+  void startReadyWork();
+  void finished(std::shared_ptr<Queue> queue, std::chrono::nanoseconds runTime);
+
+  /// Guards the state of the scheduler and of its queues.
+  mutable llvm::sys::Mutex StateMtx;
+  unsigned Concurrency = 1;
+  unsigned NumRunning = 0;
+  /// Never behind the virtual time of the queues that are ready or running,
+  /// a queue that becomes ready starts from it so that it can't make up for
+  /// the time that it was idle.
+  double VirtualTime = 0;
+  /// The queues that have work and none running.
+  std::vector<std::shared_ptr<Queue>> ReadyQueues;
+};
+
+class UnitProcessingScheduler::Queue : public std::enable_shared_from_this<Queue> {
+public:
+  Queue(UnitProcessingScheduler &scheduler, StringRef label, unsigned weight)
+    : Scheduler(scheduler), Label(label), Weight(std::max(weight, 1u)) {}
+
+  StringRef getLabel() const { return Label; }
+
+  void dispatch(std::function<void()> work);
+  /// Runs \p work in turn and waits for it; don't call it from the work of
+  /// the same queue.
+  void dispatchSync(function_ref<void()> work);
+
+  UnitProcessingStats getStats() const;
+
+private:
+  friend class UnitProcessingScheduler;
+
+  struct WorkItem {
+    std::function<void()> Work;
+    std::chrono::steady_clock::time_point EnqueueTime;
+  };
+
+  UnitProcessingScheduler &Scheduler;
+  const std::string Label;
+  const unsigned Weight;
+
+  // Guarded by the StateMtx of the scheduler.
+  std::deque<WorkItem> Items;
+  bool Running = false;
+  /// The processing time of the queue divided by its weight.
+  double VirtualTime = 0;
+  UnitProcessingStats Stats;
+};
+
+} // namespace index
+} // namespace IndexStoreDB
+
+#endif
@@ -0,0 +1,30 @@
+//===--- Cancellation.cpp -------------------------------------------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2018 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://swift.org/LICENSE.txt for license information
+// See https://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#include "IndexStoreDB/Support/Cancellation.h"
+
+using namespace IndexStoreDB;
+
+std::shared_ptr<CancellationToken>
+CancellationToken::createWithTimeout(std::chrono::nanoseconds timeout) {
+  auto deadline = std::chrono::steady_clock::now() +
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(timeout);
+  return std::make_shared<CancellationToken>(deadline);
+}
+
+bool CancellationToken::isCancelled() const {
+  if (Cancelled.load(std::memory_order_relaxed))
+    return true;
+  if (TheDeadline == Deadline::max())
+    return false;
+  return std::chrono::steady_clock::now() >= TheDeadline;
+}
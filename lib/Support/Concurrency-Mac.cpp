@@ -10,7 +10,10 @@
 //
 //===----------------------------------------------------------------------===//
 
+#if !INDEXSTOREDB_NATIVE_WORK_QUEUE
+
 #include "IndexStoreDB/Support/Concurrency.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/SmallString.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/Threading.h"
@@ -110,6 +113,17 @@ void WorkQueue::Impl::dispatchSync(Ty Obj, const DispatchData &Fn) {
   dispatch_sync_f(queue, Context, CFn);
 }
 
+void WorkQueue::Impl::dispatchAfter(Ty Obj, std::chrono::nanoseconds Delay,
+                                    const DispatchData &Fn) {
+  void *Context;
+  WorkQueue::DispatchFn CFn;
+  std::tie(Context, CFn) = toCFunction(Fn.getContext(), Fn.getFunction(),
+                                       Fn.isStackDeep());
+  dispatch_queue_t queue = dispatch_queue_t(Obj);
+  dispatch_after_f(dispatch_time(DISPATCH_TIME_NOW, Delay.count()), queue,
+                   Context, CFn);
+}
+
 void WorkQueue::Impl::dispatchBarrier(Ty Obj, const DispatchData &Fn) {
   void *Context;
   WorkQueue::DispatchFn CFn;
@@ -144,6 +158,32 @@ void WorkQueue::Impl::dispatchConcurrent(Priority Prio, const DispatchData &Fn)
   dispatch_async_f(getDispatchGlobalQueue(Prio), Context, CFn);
 }
 
+namespace {
+struct ConcurrentPerformInfo {
+  llvm::function_ref<void(size_t)> Fn;
+};
+}
+
+static void concurrentPerformIteration(void *Data, size_t Index) {
+  static_cast<ConcurrentPerformInfo *>(Data)->Fn(Index);
+}
+
+void WorkQueue::concurrentPerform(size_t Iterations,
+                                  llvm::function_ref<void(size_t)> Fn,
+                                  Priority Prio) {
+  ConcurrentPerformInfo Info{Fn};
+  dispatch_apply_f(Iterations, getDispatchGlobalQueue(Prio), &Info,
+                   concurrentPerformIteration);
+}
+
+// libdispatch manages the width of its thread pool on its own.
+void WorkQueue::Impl::beginBlocking() {}
+void WorkQueue::Impl::endBlocking() {}
+
+llvm::StringRef WorkQueue::Impl::getExecutorName() {
+  return "libdispatch";
+}
+
 void WorkQueue::Impl::suspend(Ty Obj) {
   dispatch_queue_t queue = dispatch_queue_t(Obj);
   dispatch_suspend(queue);
@@ -173,3 +213,5 @@ void WorkQueue::Impl::release(Ty Obj) {
   dispatch_queue_t queue = dispatch_queue_t(Obj);
   dispatch_release(queue);
 }
+
+#endif
@@ -0,0 +1,597 @@
+//===--- Concurrency-ThreadPool.cpp ---------------------------------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2018 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://swift.org/LICENSE.txt for license information
+// See https://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+//
+// WorkQueue over a native work-stealing thread pool, used instead of
+// libdispatch when built with INDEXSTOREDB_NATIVE_WORK_QUEUE.
+//
+// Each worker has a deque of tasks for each priority and runs the newest task
+// of its own deques first. When those are empty it takes the oldest task of
+// the shared deques, where the threads outside of the pool submit, and then
+// steals the oldest task of the other workers. The higher priorities are
+// looked at first everywhere. A work queue keeps its own items and submits
+// them to the pool as their order allows, one at a time for a serial queue.
+//
+// A task may wait for other tasks, in dispatchSync or concurrentPerform for
+// instance. The pool starts an extra worker for each pool thread that waits,
+// so that the tasks it waits for can't be stuck behind it; the extra workers
+// only take shared and stolen tasks, and stop once they run out of tasks
+// while fewer threads wait.
+//
+//===----------------------------------------------------------------------===//
+
+#if INDEXSTOREDB_NATIVE_WORK_QUEUE
+
+#include "IndexStoreDB/Support/Concurrency.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/Threading.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace IndexStoreDB;
+
+namespace {
+
+const unsigned NumPriorities = 4;
+
+unsigned toLane(WorkQueue::Priority Prio) {
+  switch (Prio) {
+  case WorkQueue::Priority::High: return 0;
+  case WorkQueue::Priority::Default: return 1;
+  case WorkQueue::Priority::Low: return 2;
+  case WorkQueue::Priority::Background: return 3;
+  }
+  llvm_unreachable("Invalid priority");
+}
+
+struct Task {
+  void *Context;
+  WorkQueue::DispatchFn Fn;
+  bool IsStackDeep;
+};
+
+struct LargeStackCall {
+  void *Context;
+  WorkQueue::DispatchFn Fn;
+};
+
+/// The index of the worker of the calling thread, or -1 outside of the pool
+/// and on the extra workers.
+thread_local int CurrentWorker = -1;
+/// Whether the calling thread runs the tasks of the pool, its waits hold up
+/// the pool.
+thread_local bool IsPoolThread = false;
+
+void callOnLargeStack(void *Data) {
+  // Runs the task in place of the pool thread, which waits for it.
+  IsPoolThread = true;
+  auto Call = static_cast<LargeStackCall *>(Data);
+  Call->Fn(Call->Context);
+}
+
+void runTask(const Task &T) {
+  if (!T.IsStackDeep)
+    return T.Fn(T.Context);
+  static const size_t ThreadStackSize = 8 << 20; // 8 MB.
+  LargeStackCall Call{T.Context, T.Fn};
+  llvm::llvm_execute_on_thread(callOnLargeStack, &Call, ThreadStackSize);
+}
+
+/// The deques of tasks of a worker, one for each priority.
+class TaskDeques {
+  std::mutex Mtx;
+  std::deque<Task> Lanes[NumPriorities];
+  /// Lets the other workers skip the empty deques without locking.
+  std::atomic<size_t> Sizes[NumPriorities] = {};
+
+public:
+  void push(unsigned Lane, const Task &T) {
+    std::lock_guard<std::mutex> L(Mtx);
+    Lanes[Lane].push_back(T);
+    Sizes[Lane].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  bool popBack(unsigned Lane, Task &T) {
+    if (Sizes[Lane].load(std::memory_order_relaxed) == 0)
+      return false;
+    std::lock_guard<std::mutex> L(Mtx);
+    if (Lanes[Lane].empty())
+      return false;
+    T = Lanes[Lane].back();
+    Lanes[Lane].pop_back();
+    Sizes[Lane].fetch_sub(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  bool popFront(unsigned Lane, Task &T) {
+    if (Sizes[Lane].load(std::memory_order_relaxed) == 0)
+      return false;
+    std::lock_guard<std::mutex> L(Mtx);
+    if (Lanes[Lane].empty())
+      return false;
+    T = Lanes[Lane].front();
+    Lanes[Lane].pop_front();
+    Sizes[Lane].fetch_sub(1, std::memory_order_relaxed);
+    return true;
+  }
+};
+
+class ThreadPool {
+  std::vector<std::unique_ptr<TaskDeques>> Workers;
+  TaskDeques Shared;
+  /// At least the number of tasks in the deques, it's incremented before a
+  /// push and decremented after a pop.
+  std::atomic<size_t> NumPending{0};
+  std::mutex SleepMtx;
+  std::condition_variable SleepCV;
+  std::atomic<unsigned> NumSleeping{0};
+  /// Guards the pool threads that wait for other tasks and the extra workers
+  /// that stand in for them; there are at least as many extra workers as
+  /// waiting threads.
+  std::mutex BlockingMtx;
+  unsigned NumBlocked = 0;
+  unsigned NumExtraWorkers = 0;
+
+public:
+  /// The pool is never destroyed, its workers run past the static destructors.
+  static ThreadPool &get() {
+    static ThreadPool *Pool = new ThreadPool();
+    return *Pool;
+  }
+
+  unsigned getNumWorkers() const { return Workers.size(); }
+
+  void submit(unsigned Lane, const Task &T) {
+    NumPending.fetch_add(1);
+    if (CurrentWorker >= 0)
+      Workers[CurrentWorker]->push(Lane, T);
+    else
+      Shared.push(Lane, T);
+    if (NumSleeping.load() != 0) {
+      std::lock_guard<std::mutex> L(SleepMtx);
+      SleepCV.notify_one();
+    }
+  }
+
+  /// Called before the calling thread waits for other tasks, it only counts
+  /// for the threads of the pool.
+  void beginBlocking() {
+    if (!IsPoolThread)
+      return;
+    std::lock_guard<std::mutex> L(BlockingMtx);
+    if (++NumBlocked > NumExtraWorkers) {
+      ++NumExtraWorkers;
+      std::thread([this] { extraWorkerMain(); }).detach();
+    }
+  }
+
+  void endBlocking() {
+    if (!IsPoolThread)
+      return;
+    std::lock_guard<std::mutex> L(BlockingMtx);
+    --NumBlocked;
+  }
+
+private:
+  ThreadPool() {
+    // INDEXSTOREDB_WORKER_THREADS overrides the number of workers. A worker
+    // may wait for other tasks, so there are always at least two.
+    unsigned NumWorkers = llvm::hardware_concurrency();
+    if (const char *EnvOpt = ::getenv("INDEXSTOREDB_WORKER_THREADS")) {
+      unsigned Val;
+      if (!llvm::StringRef(EnvOpt).getAsInteger(10, Val) && Val != 0)
+        NumWorkers = Val;
+    }
+    NumWorkers = std::max(NumWorkers, 2u);
+    for (unsigned I = 0; I != NumWorkers; ++I)
+      Workers.emplace_back(new TaskDeques());
+    for (unsigned I = 0; I != NumWorkers; ++I)
+      std::thread([this, I] { workerMain(I); }).detach();
+  }
+
+  /// \param Self the index of the calling worker, -1 for an extra worker.
+  bool findTask(int Self, Task &T) {
+    unsigned NumWorkers = Workers.size();
+    for (unsigned Lane = 0; Lane != NumPriorities; ++Lane) {
+      if (Self >= 0 && Workers[Self]->popBack(Lane, T))
+        return true;
+      if (Shared.popFront(Lane, T))
+        return true;
+      for (unsigned I = 0; I != NumWorkers; ++I) {
+        unsigned Victim = unsigned(Self + 1 + I) % NumWorkers;
+        if (int(Victim) != Self && Workers[Victim]->popFront(Lane, T))
+          return true;
+      }
+    }
+    return false;
+  }
+
+  void workerMain(unsigned Index) {
+    CurrentWorker = Index;
+    IsPoolThread = true;
+    llvm::set_thread_name("isdb-worker");
+    while (true) {
+      Task T;
+      if (findTask(Index, T)) {
+        NumPending.fetch_sub(1);
+        runTask(T);
+        continue;
+      }
+      std::unique_lock<std::mutex> L(SleepMtx);
+      NumSleeping.fetch_add(1);
+      SleepCV.wait(L, [&] { return NumPending.load() != 0; });
+      NumSleeping.fetch_sub(1);
+    }
+  }
+
+  /// \returns true if the calling extra worker is no longer needed and was
+  /// removed from the count.
+  bool retireExtraWorker() {
+    std::lock_guard<std::mutex> L(BlockingMtx);
+    if (NumExtraWorkers <= NumBlocked)
+      return false;
+    --NumExtraWorkers;
+    return true;
+  }
+
+  void extraWorkerMain() {
+    IsPoolThread = true;
+    llvm::set_thread_name("isdb-worker");
+    while (true) {
+      Task T;
+      if (findTask(-1, T)) {
+        NumPending.fetch_sub(1);
+        runTask(T);
+        continue;
+      }
+      if (retireExtraWorker())
+        return;
+      // Wakes up now and then to check whether it's still needed.
+      std::unique_lock<std::mutex> L(SleepMtx);
+      NumSleeping.fetch_add(1);
+      SleepCV.wait_for(L, std::chrono::milliseconds(100),
+                       [&] { return NumPending.load() != 0; });
+      NumSleeping.fetch_sub(1);
+    }
+  }
+};
+
+/// Blocks a \c dispatchSync caller until the queue lets its item run.
+class SyncWaiter {
+  std::mutex Mtx;
+  std::condition_variable CV;
+  bool Granted = false;
+
+public:
+  void grant() {
+    std::lock_guard<std::mutex> L(Mtx);
+    Granted = true;
+    CV.notify_one();
+  }
+
+  void wait() {
+    std::unique_lock<std::mutex> L(Mtx);
+    CV.wait(L, [&] { return Granted; });
+  }
+};
+
+class Queue {
+  struct Item {
+    Task Fn;
+    bool IsBarrier;
+    /// Set for the item of a \c dispatchSync, which runs on the caller thread.
+    SyncWaiter *Waiter;
+  };
+
+  struct RunningItem {
+    Queue *Q;
+    Item I;
+  };
+
+  std::atomic<unsigned> RefCount{1};
+  std::atomic<unsigned> Lane;
+  const bool IsSerial;
+  const std::string Label;
+
+  std::mutex Mtx;
+  std::deque<Item> Items;
+  unsigned NumRunning = 0;
+  /// Whether the running item excludes the others, either a barrier or any
+  /// item of a serial queue.
+  bool ExclusiveRunning = false;
+  unsigned SuspendCount = 0;
+
+public:
+  Queue(bool isSerial, WorkQueue::Priority Prio, llvm::StringRef label)
+    : Lane(toLane(Prio)), IsSerial(isSerial), Label(label) {}
+
+  llvm::StringRef getLabel() const { return Label; }
+  void setPriority(WorkQueue::Priority Prio) { Lane = toLane(Prio); }
+
+  void retain() { RefCount.fetch_add(1); }
+  void release() {
+    if (RefCount.fetch_sub(1) == 1)
+      delete this;
+  }
+
+  void dispatch(const Task &Fn, bool IsBarrier) {
+    enqueue(Item{Fn, IsBarrier, nullptr});
+  }
+
+  void dispatchSync(const Task &Fn, bool IsBarrier) {
+    SyncWaiter Waiter;
+    Item I{Fn, IsBarrier, &Waiter};
+    enqueue(I);
+    {
+      WorkQueue::BlockingScope Blocking;
+      Waiter.wait();
+    }
+    runTask(I.Fn);
+    finished(I);
+  }
+
+  void suspend() {
+    std::lock_guard<std::mutex> L(Mtx);
+    ++SuspendCount;
+  }
+
+  void resume() {
+    std::lock_guard<std::mutex> L(Mtx);
+    assert(SuspendCount != 0 && "resuming a queue that is not suspended");
+    --SuspendCount;
+    startItems();
+  }
+
+private:
+  bool isExclusive(const Item &I) const { return IsSerial || I.IsBarrier; }
+
+  void enqueue(const Item &I) {
+    // The pending items keep the queue alive, like with libdispatch.
+    retain();
+    std::lock_guard<std::mutex> L(Mtx);
+    Items.push_back(I);
+    startItems();
+  }
+
+  /// Starts the items at the front that may run next to the running ones.
+  void startItems() {
+    while (!Items.empty() && SuspendCount == 0 && !ExclusiveRunning) {
+      const Item &Next = Items.front();
+      if (isExclusive(Next) && NumRunning != 0)
+        break;
+      ++NumRunning;
+      ExclusiveRunning = isExclusive(Next);
+      if (Next.Waiter) {
+        Next.Waiter->grant();
+      } else {
+        auto Running = new RunningItem{this, Next};
+        ThreadPool::get().submit(Lane, Task{Running, runItem, false});
+      }
+      Items.pop_front();
+    }
+  }
+
+  void finished(const Item &I) {
+    {
+      std::lock_guard<std::mutex> L(Mtx);
+      --NumRunning;
+      if (isExclusive(I))
+        ExclusiveRunning = false;
+      startItems();
+    }
+    release();
+  }
+
+  static void runItem(void *Ctx) {
+    std::unique_ptr<RunningItem> Running(static_cast<RunningItem *>(Ctx));
+    runTask(Running->I.Fn);
+    Running->Q->finished(Running->I);
+  }
+};
+
+/// Dispatches the items of \c dispatchAfter when they are due, from a thread
+/// that is started on first use.
+class DelayedDispatcher {
+  typedef std::chrono::steady_clock Clock;
+
+  std::mutex Mtx;
+  std::condition_variable CV;
+  std::multimap<Clock::time_point, std::pair<Queue *, Task>> Pending;
+  bool Started = false;
+
+public:
+  static DelayedDispatcher &get() {
+    static DelayedDispatcher *Dispatcher = new DelayedDispatcher();
+    return *Dispatcher;
+  }
+
+  void schedule(std::chrono::nanoseconds Delay, Queue *Q, const Task &Fn) {
+    Q->retain();
+    std::lock_guard<std::mutex> L(Mtx);
+    Pending.emplace(Clock::now() + Delay, std::make_pair(Q, Fn));
+    if (!Started) {
+      Started = true;
+      std::thread([this] { run(); }).detach();
+    }
+    CV.notify_one();
+  }
+
+private:
+  void run() {
+    llvm::set_thread_name("isdb-timer");
+    std::unique_lock<std::mutex> L(Mtx);
+    while (true) {
+      if (Pending.empty()) {
+        CV.wait(L);
+        continue;
+      }
+      auto First = Pending.begin();
+      if (First->first > Clock::now()) {
+        CV.wait_until(L, First->first);
+        continue;
+      }
+      auto Entry = First->second;
+      Pending.erase(First);
+      L.unlock();
+      Entry.first->dispatch(Entry.second, /*IsBarrier=*/false);
+      Entry.first->release();
+      L.lock();
+    }
+  }
+};
+
+struct ConcurrentPerformState {
+  std::atomic<size_t> Next{0};
+  std::atomic<size_t> Done{0};
+  const size_t Iterations;
+  llvm::function_ref<void(size_t)> Fn;
+  std::mutex Mtx;
+  std::condition_variable CV;
+
+  ConcurrentPerformState(size_t Iterations, llvm::function_ref<void(size_t)> Fn)
+    : Iterations(Iterations), Fn(Fn) {}
+
+  /// Runs iterations until they are all claimed. \c Fn is only called for a
+  /// claimed iteration, so a helper that starts late doesn't touch it after
+  /// \c concurrentPerform has returned.
+  void perform() {
+    size_t Index;
+    while ((Index = Next.fetch_add(1)) < Iterations) {
+      Fn(Index);
+      if (Done.fetch_add(1) + 1 == Iterations) {
+        std::lock_guard<std::mutex> L(Mtx);
+        CV.notify_all();
+      }
+    }
+  }
+
+  static void performHelper(void *Ctx) {
+    std::unique_ptr<std::shared_ptr<ConcurrentPerformState>> State(
+        static_cast<std::shared_ptr<ConcurrentPerformState> *>(Ctx));
+    (*State)->perform();
+  }
+};
+
+} // anonymous namespace
+
+static Queue *getQueue(void *Obj) { return static_cast<Queue *>(Obj); }
+
+
+void *WorkQueue::Impl::create(Dequeuing DeqKind, Priority Prio,
+                              llvm::StringRef Label) {
+  return new Queue(DeqKind == Dequeuing::Serial, Prio, Label);
+}
+
+void WorkQueue::Impl::dispatch(Ty Obj, const DispatchData &Fn) {
+  getQueue(Obj)->dispatch(Task{Fn.getContext(), Fn.getFunction(), Fn.isStackDeep()}, /*IsBarrier=*/false);
+}
+
+void WorkQueue::Impl::dispatchSync(Ty Obj, const DispatchData &Fn) {
+  getQueue(Obj)->dispatchSync(Task{Fn.getContext(), Fn.getFunction(), Fn.isStackDeep()}, /*IsBarrier=*/false);
+}
+
+void WorkQueue::Impl::dispatchAfter(Ty Obj, std::chrono::nanoseconds Delay,
+                                    const DispatchData &Fn) {
+  DelayedDispatcher::get().schedule(Delay, getQueue(Obj), Task{Fn.getContext(), Fn.getFunction(), Fn.isStackDeep()});
+}
+
+void WorkQueue::Impl::dispatchBarrier(Ty Obj, const DispatchData &Fn) {
+  getQueue(Obj)->dispatch(Task{Fn.getContext(), Fn.getFunction(), Fn.isStackDeep()}, /*IsBarrier=*/true);
+}
+
+void WorkQueue::Impl::dispatchBarrierSync(Ty Obj, const DispatchData &Fn) {
+  getQueue(Obj)->dispatchSync(Task{Fn.getContext(), Fn.getFunction(), Fn.isStackDeep()}, /*IsBarrier=*/true);
+}
+
+void WorkQueue::Impl::dispatchOnMain(const DispatchData &Fn) {
+  // There is no main loop to drain without libdispatch, the work for the main
+  // queue runs in order on the pool instead.
+  static Queue *MainQueue = new Queue(/*isSerial=*/true, Priority::High,
+                                      "indexstoredb.main");
+  MainQueue->dispatch(Task{Fn.getContext(), Fn.getFunction(), Fn.isStackDeep()}, /*IsBarrier=*/false);
+}
+
+void WorkQueue::Impl::dispatchConcurrent(Priority Prio, const DispatchData &Fn) {
+  ThreadPool::get().submit(toLane(Prio), Task{Fn.getContext(), Fn.getFunction(), Fn.isStackDeep()});
+}
+
+void WorkQueue::concurrentPerform(size_t Iterations,
+                                  llvm::function_ref<void(size_t)> Fn,
+                                  Priority Prio) {
+  if (Iterations == 0)
+    return;
+  if (Iterations == 1)
+    return Fn(0);
+
+  ThreadPool &Pool = ThreadPool::get();
+  auto State = std::make_shared<ConcurrentPerformState>(Iterations, Fn);
+  // The calling thread is one of the participants.
+  size_t NumHelpers = std::min<size_t>(Iterations, Pool.getNumWorkers()) - 1;
+  for (size_t I = 0; I != NumHelpers; ++I) {
+    Pool.submit(toLane(Prio),
+                Task{new std::shared_ptr<ConcurrentPerformState>(State),
+                     ConcurrentPerformState::performHelper, false});
+  }
+  State->perform();
+  BlockingScope Blocking;
+  std::unique_lock<std::mutex> L(State->Mtx);
+  State->CV.wait(L, [&] { return State->Done.load() == Iterations; });
+}
+
+void WorkQueue::Impl::beginBlocking() {
+  ThreadPool::get().beginBlocking();
+}
+
+void WorkQueue::Impl::endBlocking() {
+  ThreadPool::get().endBlocking();
+}
+
+llvm::StringRef WorkQueue::Impl::getExecutorName() {
+  return "native";
+}
+
+void WorkQueue::Impl::suspend(Ty Obj) {
+  getQueue(Obj)->suspend();
+}
+
+void WorkQueue::Impl::resume(Ty Obj) {
+  getQueue(Obj)->resume();
+}
+
+void WorkQueue::Impl::setPriority(Ty Obj, Priority Prio) {
+  getQueue(Obj)->setPriority(Prio);
+}
+
+llvm::StringRef WorkQueue::Impl::getLabel(const Ty Obj) {
+  return getQueue(Obj)->getLabel();
+}
+
+void WorkQueue::Impl::retain(Ty Obj) {
+  getQueue(Obj)->retain();
+}
+
+void WorkQueue::Impl::release(Ty Obj) {
+  getQueue(Obj)->release();
+}
+
+#endif
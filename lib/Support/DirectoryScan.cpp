@@ -0,0 +1,97 @@
+//===--- DirectoryScan.cpp ------------------------------------------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2018 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://swift.org/LICENSE.txt for license information
+// See https://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#include "IndexStoreDB/Support/DirectoryScan.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#if !defined(_WIN32)
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+using namespace IndexStoreDB;
+using namespace llvm;
+
+#if defined(_WIN32)
+
+bool IndexStoreDB::scanDirectoryModificationTimes(StringRef dirPath,
+                                                  function_ref<void(StringRef name, sys::TimePoint<> modTime)> receiver,
+                                                  std::string &error) {
+  std::error_code EC;
+  for (sys::fs::directory_iterator I(dirPath, EC), E; !EC && I != E; I.increment(EC)) {
+    auto status = I->status();
+    if (!status || status->type() != sys::fs::file_type::regular_file)
+      continue;
+    receiver(sys::path::filename(I->path()), status->getLastModificationTime());
+  }
+  if (EC) {
+    raw_string_ostream(error) << "failed reading directory '" << dirPath << "': " << EC.message();
+    return true;
+  }
+  return false;
+}
+
+#else
+
+bool IndexStoreDB::scanDirectoryModificationTimes(StringRef dirPath,
+                                                  function_ref<void(StringRef name, sys::TimePoint<> modTime)> receiver,
+                                                  std::string &error) {
+  SmallString<256> pathBuf = dirPath;
+  DIR *dir = opendir(pathBuf.c_str());
+  if (!dir) {
+    raw_string_ostream(error) << "failed opening directory '" << dirPath << "': " << strerror(errno);
+    return true;
+  }
+
+  int dirFD = dirfd(dir);
+  int readErrno = 0;
+  while (true) {
+    errno = 0;
+    struct dirent *entry = readdir(dir);
+    if (!entry) {
+      readErrno = errno;
+      break;
+    }
+    // Skips '.', '..' and sub-directories without a stat when the file system
+    // reports the type of the entries.
+    if (entry->d_type != DT_REG && entry->d_type != DT_UNKNOWN)
+      continue;
+
+    struct stat st;
+    if (fstatat(dirFD, entry->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+      continue; // Removed since it was listed.
+    if (!S_ISREG(st.st_mode))
+      continue;
+#if defined(__APPLE__)
+    const struct timespec &mtime = st.st_mtimespec;
+#else
+    const struct timespec &mtime = st.st_mtim;
+#endif
+    auto modTime = std::chrono::time_point_cast<std::chrono::nanoseconds>(sys::toTimePoint(mtime.tv_sec));
+    modTime += std::chrono::nanoseconds(mtime.tv_nsec);
+    receiver(entry->d_name, modTime);
+  }
+  closedir(dir);
+
+  if (readErrno) {
+    raw_string_ostream(error) << "failed reading directory '" << dirPath << "': " << strerror(readErrno);
+    return true;
+  }
+  return false;
+}
+
+#endif
@@ -28,11 +28,19 @@ struct FilePathWatcher::Implementation {
                           dispatch_queue_t queue);
   void stopFSEventStream();
 
+  // The stream watches all of root.
+  void addDirectories(ArrayRef<std::string> directories) {}
+  void removeDirectories(ArrayRef<std::string> directories) {}
+
   ~Implementation() {
     stopFSEventStream();
   };
 };
 
+bool FilePathWatcher::watchesIndividualDirectories() {
+  return false;
+}
+
 FilePathWatcher::Implementation::Implementation(FileEventsReceiverTy pathsReceiver) {
   std::vector<std::string> pathsToWatch;
   // FIXME: We should do something smarter than watching all of root.
@@ -120,16 +128,322 @@ void FilePathWatcher::Implementation::stopFSEventStream() {
   EventStream = nullptr;
 }
 
+#elif defined(__linux__)
+#include "IndexStoreDB/Support/Concurrency.h"
+#include "IndexStoreDB/Support/Metrics.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/ADT/Twine.h"
+#include "llvm/Support/Mutex.h"
+#include "llvm/Support/Threading.h"
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <thread>
+
+using namespace IndexStoreDB;
+using namespace llvm;
+
+static metrics::Counter NumOverflowRescans("file_watcher.overflow_rescans",
+                                           "Times the inotify queue overflowed and all the watched directories were reported");
+
+/// The events of a directory are coalesced for this long, like the latency of
+/// the FSEvents stream.
+static const std::chrono::seconds EventLatency(1);
+/// How often the directories that couldn't be watched are tried again.
+static const std::chrono::seconds UnwatchedRetryInterval(1);
+
+static const uint32_t WatchMask = IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MODIFY |
+                                  IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+namespace {
+/// The watches of an inotify instance. The work of its queue only keeps weak
+/// references, so that it doesn't report anything after the watcher is gone.
+class InotifyState : public std::enable_shared_from_this<InotifyState> {
+  const int FD;
+  const FilePathWatcher::FileEventsReceiverTy PathsReceiver;
+  WorkQueue Queue;
+
+  llvm::sys::Mutex StateMtx;
+  /// The watch descriptor of each directory, or -1 if it couldn't be watched,
+  /// e.g. because it doesn't exist yet or was removed. Those are tried again
+  /// every \c UnwatchedRetryInterval.
+  llvm::StringMap<int> WatchesByDir;
+  llvm::DenseMap<int, std::string> DirsByWatch;
+  /// Directories with events that were not reported yet.
+  llvm::StringSet<> PendingDirs;
+  bool Overflowed = false;
+  bool FlushScheduled = false;
+  bool RetryScheduled = false;
+
+public:
+  InotifyState(int fd, FilePathWatcher::FileEventsReceiverTy pathsReceiver)
+    : FD(fd), PathsReceiver(std::move(pathsReceiver)),
+      Queue(WorkQueue::Dequeuing::Serial, "IndexStoreDB.inotify", WorkQueue::Priority::Low) {}
+
+  void addDirectories(ArrayRef<std::string> directories);
+  void removeDirectories(ArrayRef<std::string> directories);
+
+  /// Reads the available events, on the reader thread of the watcher.
+  void readEvents();
+  /// Reports the directories of the events since the last flush, on \c Queue.
+  void flush();
+  /// Tries to watch the directories that are not watched, on \c Queue. The
+  /// ones that can be watched now are reported, their files may have changed
+  /// in the meantime.
+  void retryUnwatched();
+
+private:
+  int addWatch(StringRef directory, bool retrying = false);
+  void scheduleFlush();
+  void scheduleRetry();
+};
+} // anonymous namespace
+
+int InotifyState::addWatch(StringRef directory, bool retrying) {
+  int wd = inotify_add_watch(FD, directory.str().c_str(), WatchMask);
+  if (wd < 0) {
+    if (errno != ENOENT && !retrying)
+      LOG_WARN_FUNC("inotify_add_watch failed for '" << directory << "': " << strerror(errno));
+    return -1;
+  }
+  DirsByWatch[wd] = directory.str();
+  return wd;
+}
+
+void InotifyState::addDirectories(ArrayRef<std::string> directories) {
+  sys::ScopedLock L(StateMtx);
+  for (const std::string &directory : directories) {
+    auto inserted = WatchesByDir.try_emplace(directory, -1);
+    if (!inserted.second)
+      continue;
+    inserted.first->second = addWatch(directory);
+    if (inserted.first->second < 0)
+      scheduleRetry();
+  }
+}
+
+void InotifyState::removeDirectories(ArrayRef<std::string> directories) {
+  sys::ScopedLock L(StateMtx);
+  for (const std::string &directory : directories) {
+    auto found = WatchesByDir.find(directory);
+    if (found == WatchesByDir.end())
+      continue;
+    if (found->second >= 0) {
+      // The IN_IGNORED event of the watch is dropped, since it's no longer
+      // mapped to the directory.
+      inotify_rm_watch(FD, found->second);
+      DirsByWatch.erase(found->second);
+    }
+    WatchesByDir.erase(found);
+  }
+}
+
+void InotifyState::readEvents() {
+  alignas(struct inotify_event) char buf[16 * 1024];
+  while (true) {
+    ssize_t len = read(FD, buf, sizeof(buf));
+    if (len < 0 && errno == EINTR)
+      continue;
+    if (len <= 0)
+      break;
+
+    sys::ScopedLock L(StateMtx);
+    for (char *ptr = buf; ptr < buf + len;) {
+      auto *event = reinterpret_cast<const struct inotify_event *>(ptr);
+      ptr += sizeof(struct inotify_event) + event->len;
+      if (event->mask & IN_Q_OVERFLOW) {
+        Overflowed = true;
+        continue;
+      }
+      auto found = DirsByWatch.find(event->wd);
+      if (found == DirsByWatch.end())
+        continue;
+      PendingDirs.insert(found->second);
+      if (event->mask & IN_IGNORED) {
+        // The directory was removed; it's watched again once it's back.
+        auto dirIt = WatchesByDir.find(found->second);
+        if (dirIt != WatchesByDir.end())
+          dirIt->second = -1;
+        DirsByWatch.erase(found);
+        scheduleRetry();
+      }
+    }
+    scheduleFlush();
+  }
+}
+
+void InotifyState::scheduleFlush() {
+  if (FlushScheduled)
+    return;
+  FlushScheduled = true;
+  std::weak_ptr<InotifyState> weakThis = shared_from_this();
+  Queue.dispatchAfter(EventLatency, [weakThis] {
+    if (auto state = weakThis.lock())
+      state->flush();
+  });
+}
+
+void InotifyState::scheduleRetry() {
+  if (RetryScheduled)
+    return;
+  RetryScheduled = true;
+  std::weak_ptr<InotifyState> weakThis = shared_from_this();
+  Queue.dispatchAfter(UnwatchedRetryInterval, [weakThis] {
+    if (auto state = weakThis.lock())
+      state->retryUnwatched();
+  });
+}
+
+void InotifyState::retryUnwatched() {
+  sys::ScopedLock L(StateMtx);
+  RetryScheduled = false;
+  bool anyUnwatched = false;
+  for (auto &entry : WatchesByDir) {
+    if (entry.second >= 0)
+      continue;
+    entry.second = addWatch(entry.getKey(), /*retrying=*/true);
+    if (entry.second < 0) {
+      anyUnwatched = true;
+      continue;
+    }
+    PendingDirs.insert(entry.getKey());
+    scheduleFlush();
+  }
+  if (anyUnwatched)
+    scheduleRetry();
+}
+
+void InotifyState::flush() {
+  std::vector<std::string> directories;
+  {
+    sys::ScopedLock L(StateMtx);
+    FlushScheduled = false;
+    if (Overflowed) {
+      // Events were dropped, report all the directories so that their files
+      // get checked again.
+      NumOverflowRescans.add();
+      LOG_INFO_FUNC(High, "inotify queue overflowed, rescanning " << WatchesByDir.size() << " directories");
+      Overflowed = false;
+      PendingDirs.clear();
+      for (auto &entry : WatchesByDir) {
+        // The removals of directories may be among the dropped events; this
+        // gets the current watch of each, or -1 if it's gone.
+        int wd = addWatch(entry.getKey(), /*retrying=*/true);
+        if (entry.second >= 0 && entry.second != wd)
+          DirsByWatch.erase(entry.second);
+        entry.second = wd;
+        if (wd < 0)
+          scheduleRetry();
+        directories.push_back(entry.getKey().str());
+      }
+    } else {
+      for (const auto &entry : PendingDirs) {
+        if (WatchesByDir.count(entry.getKey()))
+          directories.push_back(entry.getKey().str());
+      }
+      PendingDirs.clear();
+    }
+  }
+  if (!directories.empty())
+    PathsReceiver(std::move(directories));
+}
+
+struct FilePathWatcher::Implementation {
+  std::shared_ptr<InotifyState> State;
+  int InotifyFD = -1;
+  /// Wakes up the reader thread to stop it.
+  int StopFD = -1;
+  std::thread Reader;
+
+  explicit Implementation(FileEventsReceiverTy pathsReceiver);
+  ~Implementation();
+
+  /// Waits for events on the inotify descriptor, until \c StopFD is signaled.
+  static void readerMain(std::shared_ptr<InotifyState> state, int inotifyFD, int stopFD);
+
+  void addDirectories(ArrayRef<std::string> directories) {
+    if (State)
+      State->addDirectories(directories);
+  }
+  void removeDirectories(ArrayRef<std::string> directories) {
+    if (State)
+      State->removeDirectories(directories);
+  }
+};
+
+FilePathWatcher::Implementation::Implementation(FileEventsReceiverTy pathsReceiver) {
+  int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd < 0) {
+    LOG_WARN_FUNC("inotify_init1 failed: " << strerror(errno));
+    return;
+  }
+
+  int stopFD = eventfd(0, EFD_CLOEXEC);
+  if (stopFD < 0) {
+    LOG_WARN_FUNC("eventfd failed: " << strerror(errno));
+    close(fd);
+    return;
+  }
+  InotifyFD = fd;
+  StopFD = stopFD;
+  State = std::make_shared<InotifyState>(fd, std::move(pathsReceiver));
+  Reader = std::thread(readerMain, State, fd, stopFD);
+}
+
+FilePathWatcher::Implementation::~Implementation() {
+  if (!State)
+    return;
+  uint64_t one = 1;
+  while (write(StopFD, &one, sizeof(one)) < 0 && errno == EINTR) {}
+  Reader.join();
+  close(StopFD);
+  close(InotifyFD);
+}
+
+void FilePathWatcher::Implementation::readerMain(std::shared_ptr<InotifyState> state,
+                                                 int inotifyFD, int stopFD) {
+  llvm::set_thread_name("isdb-inotify");
+  struct pollfd fds[2] = {{inotifyFD, POLLIN, 0}, {stopFD, POLLIN, 0}};
+  while (true) {
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      LOG_WARN_FUNC("poll failed: " << strerror(errno));
+      return;
+    }
+    if (fds[1].revents)
+      return;
+    if (fds[0].revents)
+      state->readEvents();
+  }
+}
+
+bool FilePathWatcher::watchesIndividualDirectories() {
+  return true;
+}
+
 #else
 
 using namespace IndexStoreDB;
 using namespace llvm;
 
-// TODO: implement for platforms without CoreServices.
+// TODO: implement for platforms without CoreServices or inotify.
 struct FilePathWatcher::Implementation {
   explicit Implementation(FileEventsReceiverTy pathsReceiver) {}
+
+  void addDirectories(ArrayRef<std::string> directories) {}
+  void removeDirectories(ArrayRef<std::string> directories) {}
 };
 
+bool FilePathWatcher::watchesIndividualDirectories() {
+  return false;
+}
+
 #endif
 
 FilePathWatcher::FilePathWatcher(FileEventsReceiverTy pathsReceiver)
@@ -141,3 +455,11 @@ FilePathWatcher::~FilePathWatcher() {
   delete &Impl;
 }
 
+void FilePathWatcher::addDirectories(ArrayRef<std::string> directories) {
+  Impl.addDirectories(directories);
+}
+
+void FilePathWatcher::removeDirectories(ArrayRef<std::string> directories) {
+  Impl.removeDirectories(directories);
+}
+
@@ -16,8 +16,6 @@
 #include "llvm/Support/Format.h"
 #include "llvm/Support/Threading.h"
 
-#include <dispatch/dispatch.h>
-
 using namespace IndexStoreDB;
 
 void IndexStoreDB::writeEscaped(StringRef Str, raw_ostream &OS) {
@@ -0,0 +1,119 @@
+//===--- MemoryGovernor.cpp -----------------------------------------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2018 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://swift.org/LICENSE.txt for license information
+// See https://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#include "IndexStoreDB/Support/MemoryGovernor.h"
+#include "IndexStoreDB/Support/Logging.h"
+#include "IndexStoreDB/Support/Metrics.h"
+#include "llvm/Support/Mutex.h"
+
+using namespace IndexStoreDB;
+
+static metrics::Counter NumMemoryTrims("memory.trims",
+                                       "Times the caches were trimmed, on request or to fit the budget");
+static metrics::Counter NumBudgetTrims("memory.budget_trims",
+                                       "Times the caches were trimmed because they went over the budget");
+
+namespace {
+class MemoryGovernorImpl {
+  struct Consumer {
+    std::string Name;
+    MemoryGovernor::UsageFn Usage;
+    MemoryGovernor::TrimFn Trim;
+  };
+
+  const size_t Budget;
+  mutable llvm::sys::Mutex StateMtx;
+  std::vector<Consumer> Consumers;
+
+  std::vector<Consumer> getConsumers() const {
+    llvm::sys::ScopedLock L(StateMtx);
+    return Consumers;
+  }
+
+  size_t getTotalBytes() const {
+    size_t total = 0;
+    for (const auto &consumer : getConsumers())
+      total += consumer.Usage();
+    return total;
+  }
+
+public:
+  explicit MemoryGovernorImpl(size_t budget) : Budget(budget) {}
+
+  size_t getBudget() const { return Budget; }
+
+  void addConsumer(StringRef name, MemoryGovernor::UsageFn usage, MemoryGovernor::TrimFn trim) {
+    llvm::sys::ScopedLock L(StateMtx);
+    Consumers.push_back(Consumer{name.str(), std::move(usage), std::move(trim)});
+  }
+
+  std::vector<MemoryUsage> getMemoryUsage() const {
+    std::vector<MemoryUsage> usage;
+    for (const auto &consumer : getConsumers())
+      usage.push_back(MemoryUsage{consumer.Name, consumer.Usage()});
+    return usage;
+  }
+
+  void trimMemory(MemoryTrimLevel level) {
+    NumMemoryTrims.add();
+    for (const auto &consumer : getConsumers())
+      consumer.Trim(level);
+  }
+
+  bool enforceBudget() {
+    if (Budget == 0)
+      return true;
+    size_t total = getTotalBytes();
+    if (total <= Budget)
+      return true;
+
+    NumBudgetTrims.add();
+    LOG_INFO_FUNC(Low, "caches use " << total << " bytes, over the budget of " << Budget);
+    for (auto level : {MemoryTrimLevel::Moderate, MemoryTrimLevel::Critical}) {
+      trimMemory(level);
+      if (getTotalBytes() <= Budget)
+        return true;
+    }
+    return false;
+  }
+};
+} // anonymous namespace
+
+#define IMPL static_cast<MemoryGovernorImpl*>(Impl)
+
+MemoryGovernor::MemoryGovernor(size_t budget) {
+  Impl = new MemoryGovernorImpl(budget);
+}
+
+MemoryGovernor::~MemoryGovernor() {
+  delete IMPL;
+}
+
+size_t MemoryGovernor::getBudget() const {
+  return IMPL->getBudget();
+}
+
+void MemoryGovernor::addConsumer(StringRef name, UsageFn usage, TrimFn trim) {
+  IMPL->addConsumer(name, std::move(usage), std::move(trim));
+}
+
+std::vector<MemoryUsage> MemoryGovernor::getMemoryUsage() const {
+  return IMPL->getMemoryUsage();
+}
+
+void MemoryGovernor::trimMemory(MemoryTrimLevel level) {
+  IMPL->trimMemory(level);
+}
+
+bool MemoryGovernor::enforceBudget() {
+  return IMPL->enforceBudget();
+}
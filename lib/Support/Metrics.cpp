@@ -0,0 +1,188 @@
+//===--- Metrics.cpp ------------------------------------------------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2018 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://swift.org/LICENSE.txt for license information
+// See https://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#include "IndexStoreDB/Support/Metrics.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/Casting.h"
+#include "llvm/Support/FormatVariadic.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/Mutex.h"
+#include "llvm/Support/raw_ostream.h"
+#include <vector>
+
+using namespace IndexStoreDB;
+using namespace IndexStoreDB::metrics;
+using namespace llvm;
+
+std::atomic<bool> Registry::Enabled{false};
+
+namespace {
+class RegistryImpl {
+  mutable llvm::sys::Mutex StateMtx;
+  std::vector<Metric *> Metrics;
+
+public:
+  void registerMetric(Metric *metric) {
+    sys::ScopedLock L(StateMtx);
+    Metrics.push_back(metric);
+  }
+
+  /// \returns the metrics sorted by name.
+  std::vector<Metric *> getMetrics() const {
+    std::vector<Metric *> metrics;
+    {
+      sys::ScopedLock L(StateMtx);
+      metrics = Metrics;
+    }
+    llvm::sort(metrics, [](const Metric *LHS, const Metric *RHS) {
+      return LHS->getName() < RHS->getName();
+    });
+    return metrics;
+  }
+};
+} // anonymous namespace
+
+Metric::Metric(Kind kind, StringRef name, StringRef description)
+  : TheKind(kind), Name(name), Description(description) {
+  Registry::get().registerMetric(this);
+}
+
+Registry::Registry() {
+  Impl = new RegistryImpl();
+}
+
+Registry &Registry::get() {
+  // Intentionally leaked, metrics are static objects that may register or be
+  // updated during the destruction of other static objects.
+  static Registry *registry = new Registry();
+  return *registry;
+}
+
+void Registry::setEnabled(bool enabled) {
+  Enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void Registry::registerMetric(Metric *metric) {
+  static_cast<RegistryImpl*>(Impl)->registerMetric(metric);
+}
+
+void Registry::reset() {
+  for (Metric *metric : static_cast<RegistryImpl*>(Impl)->getMetrics()) {
+    if (auto *counter = dyn_cast<Counter>(metric))
+      counter->reset();
+    else if (auto *hist = dyn_cast<Histogram>(metric))
+      hist->reset();
+  }
+}
+
+json::Value Registry::toJSON() const {
+  json::Object counters;
+  json::Object gauges;
+  json::Object histograms;
+  for (Metric *metric : static_cast<RegistryImpl*>(Impl)->getMetrics()) {
+    switch (metric->getKind()) {
+    case Metric::Kind::Counter:
+      counters[metric->getName()] = int64_t(cast<Counter>(metric)->getValue());
+      break;
+    case Metric::Kind::Gauge:
+      gauges[metric->getName()] = cast<Gauge>(metric)->getValue();
+      break;
+    case Metric::Kind::Histogram: {
+      auto *hist = cast<Histogram>(metric);
+      json::Array buckets;
+      for (unsigned i = 0; i != Histogram::NumBuckets; ++i) {
+        if (uint64_t count = hist->getBucketCount(i))
+          buckets.push_back(json::Object{{"upper_us", int64_t(i == 0 ? 1 : 1ULL << i)},
+                                          {"count", int64_t(count)}});
+      }
+      histograms[metric->getName()] = json::Object{
+        {"count", int64_t(hist->getCount())},
+        {"total_us", int64_t(hist->getTotalMicroseconds())},
+        {"max_us", int64_t(hist->getMaxMicroseconds())},
+        {"p50_us", int64_t(hist->getPercentileMicroseconds(50))},
+        {"p90_us", int64_t(hist->getPercentileMicroseconds(90))},
+        {"p99_us", int64_t(hist->getPercentileMicroseconds(99))},
+        {"buckets", std::move(buckets)},
+      };
+      break;
+    }
+    }
+  }
+  return json::Object{
+    {"enabled", isEnabled()},
+    {"counters", std::move(counters)},
+    {"gauges", std::move(gauges)},
+    {"histograms", std::move(histograms)},
+  };
+}
+
+void Registry::writeJSON(raw_ostream &OS) const {
+  OS << formatv("{0:2}", toJSON()) << '\n';
+}
+
+void Registry::print(raw_ostream &OS) const {
+  OS << "\n*** Metrics" << (isEnabled() ? "" : " (collection disabled)") << '\n';
+  for (Metric *metric : static_cast<RegistryImpl*>(Impl)->getMetrics()) {
+    OS << metric->getName() << ": ";
+    switch (metric->getKind()) {
+    case Metric::Kind::Counter:
+      OS << cast<Counter>(metric)->getValue();
+      break;
+    case Metric::Kind::Gauge:
+      OS << cast<Gauge>(metric)->getValue();
+      break;
+    case Metric::Kind::Histogram: {
+      auto *hist = cast<Histogram>(metric);
+      OS << "count " << hist->getCount()
+         << ", p50 " << hist->getPercentileMicroseconds(50) << "us"
+         << ", p99 " << hist->getPercentileMicroseconds(99) << "us"
+         << ", max " << hist->getMaxMicroseconds() << "us";
+      break;
+    }
+    }
+    OS << " (" << metric->getDescription() << ")\n";
+  }
+}
+
+void Histogram::recordImpl(std::chrono::nanoseconds latency) {
+  uint64_t micros = std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+  unsigned bucket = micros == 0 ? 0 : std::min(Log2_64(micros) + 1, NumBuckets - 1);
+  Buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+  Count.fetch_add(1, std::memory_order_relaxed);
+  TotalMicroseconds.fetch_add(micros, std::memory_order_relaxed);
+  uint64_t prevMax = MaxMicroseconds.load(std::memory_order_relaxed);
+  while (prevMax < micros &&
+         !MaxMicroseconds.compare_exchange_weak(prevMax, micros, std::memory_order_relaxed)) {}
+}
+
+uint64_t Histogram::getPercentileMicroseconds(double percentile) const {
+  uint64_t count = getCount();
+  if (count == 0)
+    return 0;
+  uint64_t rank = std::max<uint64_t>(1, uint64_t(count * percentile / 100.0 + 0.5));
+  uint64_t seen = 0;
+  for (unsigned i = 0; i != NumBuckets; ++i) {
+    seen += getBucketCount(i);
+    if (seen >= rank)
+      return std::min<uint64_t>(i == 0 ? 1 : 1ULL << i, getMaxMicroseconds());
+  }
+  return getMaxMicroseconds();
+}
+
+void Histogram::reset() {
+  for (auto &bucket : Buckets)
+    bucket.store(0, std::memory_order_relaxed);
+  Count.store(0, std::memory_order_relaxed);
+  TotalMicroseconds.store(0, std::memory_order_relaxed);
+  MaxMicroseconds.store(0, std::memory_order_relaxed);
+}
@@ -11,17 +11,21 @@
 //===----------------------------------------------------------------------===//
 
 #include "IndexStoreDB/Support/Path.h"
+#include "IndexStoreDB/Support/Metrics.h"
+#include "llvm/ADT/Optional.h"
 #include "llvm/ADT/StringMap.h"
+#include "llvm/Support/DJB.h"
 #include "llvm/Support/Allocator.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/FileSystem.h"
-#include "llvm/Support/Mutex.h"
 #if defined(_WIN32)
 #include <Windows.h>
 #else
 #include <unistd.h>
 #endif
 #include <limits.h>
+#include <mutex>
+#include <shared_mutex>
 #include <stdlib.h>
 
 #if defined(_WIN32)
@@ -30,14 +34,46 @@
 
 using namespace IndexStoreDB;
 
+static metrics::Counter NumCanonPathLookups("path_cache.lookups",
+                                            "Paths, and parent directories of paths, looked up in the cache");
+static metrics::Counter NumCanonPathHits("path_cache.hits",
+                                         "Canonicalized paths that were found in the cache");
+static metrics::Histogram RealPathLatency("path_cache.real_path_latency",
+                                          "Time to resolve a path that was not in the cache");
+
 namespace {
+/// Thread-safe map of absolute paths to their canonical path.
+///
+/// The paths are spread over independently locked shards and lookups only take
+/// a shared lock, so that concurrent import workers and queries don't contend.
+///
+/// Directories are cached like files, so canonicalizing a file that is not in
+/// the cache usually costs a lookup of its parent directory plus an \c lstat
+/// of the file, instead of resolving every component of the path again.
 class CanonicalPathCacheImpl {
-  llvm::StringMap<CanonicalFilePathRef, llvm::BumpPtrAllocator> CanonPaths;
-  mutable llvm::sys::Mutex StateMtx;
+  struct Shard {
+    llvm::StringMap<CanonicalFilePathRef, llvm::BumpPtrAllocator> CanonPaths;
+    mutable std::shared_mutex StateMtx;
+  };
+
+  static const unsigned NumShards = 16;
+  Shard Shards[NumShards];
+
+  Shard &getShard(StringRef AbsPath) {
+    return Shards[llvm::djbHash(AbsPath) % NumShards];
+  }
+
+  /// \returns the canonical path of the absolute path \p AbsPath, or \c None
+  /// if it could not be resolved.
+  Optional<CanonicalFilePath> getCanonicalAbsolutePath(StringRef AbsPath);
+  Optional<CanonicalFilePath> resolvePath(StringRef AbsPath);
 
 public:
   CanonicalFilePath getCanonicalPath(StringRef Path,
                                      StringRef WorkingDir = StringRef());
+
+  size_t getMemoryUsage() const;
+  void clear();
 };
 }
 
@@ -56,42 +92,100 @@ CanonicalPathCacheImpl::getCanonicalPath(StringRef Path, StringRef WorkingDir) {
     AbsPath += Path;
   }
 
+  if (auto CanonPath = getCanonicalAbsolutePath(AbsPath))
+    return std::move(*CanonPath);
+  return CanonicalFilePathRef::getAsCanonicalPath(AbsPath);
+}
+
+Optional<CanonicalFilePath>
+CanonicalPathCacheImpl::getCanonicalAbsolutePath(StringRef AbsPath) {
+  NumCanonPathLookups.add();
+  Shard &S = getShard(AbsPath);
   {
-    llvm::sys::ScopedLock L(StateMtx);
-    auto It = CanonPaths.find(AbsPath);
-    if (It != CanonPaths.end())
-      return It->second;
+    std::shared_lock<std::shared_mutex> L(S.StateMtx);
+    auto It = S.CanonPaths.find(AbsPath);
+    if (It != S.CanonPaths.end()) {
+      NumCanonPathHits.add();
+      return CanonicalFilePath(It->second);
+    }
   }
 
-  llvm::SmallString<PATH_MAX> Buffer;
-  if (llvm::sys::fs::real_path(AbsPath.c_str(), Buffer, false)) {
-    return CanonicalFilePathRef::getAsCanonicalPath(AbsPath);
+  auto CanonPath = resolvePath(AbsPath);
+  if (!CanonPath)
+    return None;
+
+  std::unique_lock<std::shared_mutex> L(S.StateMtx);
+  auto Pair = S.CanonPaths.insert(std::make_pair(AbsPath, CanonicalFilePathRef()));
+  auto &It = Pair.first;
+  bool WasInserted = Pair.second;
+  if (!WasInserted)
+    return CanonicalFilePath(It->second);
+
+  StringRef CanonPathStr = CanonPath->getPath();
+  if (CanonPathStr == It->first()) {
+    It->second = CanonicalFilePathRef::getAsCanonicalPath(It->first());
+  } else {
+    auto &Alloc = S.CanonPaths.getAllocator();
+    char *CopyPtr = Alloc.Allocate<char>(CanonPathStr.size());
+    std::uninitialized_copy(CanonPathStr.begin(), CanonPathStr.end(), CopyPtr);
+    It->second = CanonicalFilePathRef::getAsCanonicalPath(StringRef(CopyPtr, CanonPathStr.size()));
   }
-  StringRef CanonPath = Buffer;
+  return CanonPath;
+}
 
-  {
-    llvm::sys::ScopedLock L(StateMtx);
-    auto Pair = CanonPaths.insert(std::make_pair(AbsPath.str(), CanonicalFilePathRef()));
-    auto &It = Pair.first;
-    bool WasInserted = Pair.second;
-    if (!WasInserted)
-      return It->second;
-
-    CanonicalFilePathRef CanonPathRef;
-    if (CanonPath == It->first()) {
-      CanonPathRef = CanonicalFilePathRef::getAsCanonicalPath(It->first());
-    } else {
-      auto &Alloc = CanonPaths.getAllocator();
-      char *CopyPtr = Alloc.Allocate<char>(CanonPath.size());
-      std::uninitialized_copy(CanonPath.begin(), CanonPath.end(), CopyPtr);
-      StringRef CopyCanonPath(CopyPtr, CanonPath.size());
-      CanonPathRef = CanonicalFilePathRef::getAsCanonicalPath(CopyCanonPath);
-    }
-    It->second = CanonPathRef;
-    return CanonPathRef;
+Optional<CanonicalFilePath>
+CanonicalPathCacheImpl::resolvePath(StringRef AbsPath) {
+  auto realPath = [&]() -> Optional<CanonicalFilePath> {
+    llvm::SmallString<PATH_MAX> Buffer;
+    metrics::Histogram::Timer timer(RealPathLatency);
+    if (llvm::sys::fs::real_path(AbsPath, Buffer, false))
+      return None;
+    return CanonicalFilePath(CanonicalFilePathRef::getAsCanonicalPath(Buffer));
+  };
+
+#if defined(_WIN32)
+  // real_path also normalizes the drive letter and the case of the path, which
+  // can't be done one component at a time.
+  return realPath();
+#else
+  StringRef ParentPath = llvm::sys::path::parent_path(AbsPath);
+  StringRef Name = llvm::sys::path::filename(AbsPath);
+  if (ParentPath.empty() || Name == "." || Name == ".." ||
+      llvm::sys::path::is_separator(AbsPath.back()))
+    return realPath();
+
+  auto CanonParentPath = getCanonicalAbsolutePath(ParentPath);
+  if (!CanonParentPath)
+    return None;
+
+  SmallString<PATH_MAX> CanonPath(CanonParentPath->getPath());
+  llvm::sys::path::append(CanonPath, Name);
+  llvm::sys::fs::file_status Status;
+  if (llvm::sys::fs::status(CanonPath, Status, /*follow=*/false))
+    return None;
+  if (Status.type() == llvm::sys::fs::file_type::symlink_file)
+    return realPath();
+  return CanonicalFilePath(CanonicalFilePathRef::getAsCanonicalPath(CanonPath));
+#endif
+}
+size_t CanonicalPathCacheImpl::getMemoryUsage() const {
+  size_t bytes = 0;
+  for (const Shard &S : Shards) {
+    std::shared_lock<std::shared_mutex> L(S.StateMtx);
+    // The entries and the canonical paths are allocated from the allocator,
+    // the table holds a pointer and a hash per bucket.
+    bytes += S.CanonPaths.getAllocator().getTotalMemory() +
+             S.CanonPaths.getNumBuckets() * (sizeof(void *) + sizeof(unsigned));
   }
+  return bytes;
 }
 
+void CanonicalPathCacheImpl::clear() {
+  for (Shard &S : Shards) {
+    std::unique_lock<std::shared_mutex> L(S.StateMtx);
+    S.CanonPaths = llvm::StringMap<CanonicalFilePathRef, llvm::BumpPtrAllocator>();
+  }
+}
 
 CanonicalPathCache::CanonicalPathCache() {
   Impl = new CanonicalPathCacheImpl();
@@ -104,3 +198,29 @@ CanonicalFilePath
 CanonicalPathCache::getCanonicalPath(StringRef Path, StringRef WorkingDir) {
   return static_cast<CanonicalPathCacheImpl*>(Impl)->getCanonicalPath(Path, WorkingDir);
 }
+
+size_t CanonicalPathCache::getMemoryUsage() const {
+  return static_cast<CanonicalPathCacheImpl*>(Impl)->getMemoryUsage();
+}
+
+void CanonicalPathCache::clear() {
+  static_cast<CanonicalPathCacheImpl*>(Impl)->clear();
+}
+
+bool PathPrefixMap::remap(StringRef path, SmallVectorImpl<char> &result) const {
+  for (const auto &mapping : prefixMap) {
+    StringRef orig = mapping.first;
+    if (orig.empty() || !path.startswith(orig))
+      continue;
+    StringRef rest = path.substr(orig.size());
+    if (!rest.empty() && !llvm::sys::path::is_separator(rest.front()) &&
+        !llvm::sys::path::is_separator(orig.back()))
+      continue; // '/src' doesn't match '/srcroot'.
+    result.clear();
+    result.append(mapping.second.begin(), mapping.second.end());
+    result.append(rest.begin(), rest.end());
+    return true;
+  }
+  result.assign(path.begin(), path.end());
+  return false;
+}
@@ -0,0 +1,92 @@
+//===--- QueryProfile.cpp -------------------------------------------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2018 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://swift.org/LICENSE.txt for license information
+// See https://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#include "IndexStoreDB/Support/QueryProfile.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace IndexStoreDB;
+
+static thread_local QueryProfile *ActiveProfile = nullptr;
+
+QueryProfile *QueryProfile::getActive() {
+  return ActiveProfile;
+}
+
+void QueryProfile::reset() {
+  assert(ActivePhase == NoPhase && "resetting while a phase is timed");
+  *this = QueryProfile();
+}
+
+StringRef QueryProfile::getCounterName(Counter counter) {
+  switch (counter) {
+  case Counter::ReadTransactions: return "read-transactions";
+  case Counter::DBLookups: return "db-lookups";
+  case Counter::DBCursorSteps: return "db-cursor-steps";
+  case Counter::ProvidersResolved: return "providers-resolved";
+  case Counter::RecordsOpened: return "records-opened";
+  case Counter::OccurrencesDecoded: return "occurrences-decoded";
+  case Counter::VisibilityChecks: return "visibility-checks";
+  case Counter::VisibilityCacheHits: return "visibility-cache-hits";
+  }
+  llvm_unreachable("unhandled counter");
+}
+
+StringRef QueryProfile::getPhaseName(Phase phase) {
+  switch (phase) {
+  case Phase::LookupProviders: return "lookup-providers";
+  case Phase::ResolveProviders: return "resolve-providers";
+  case Phase::ReadRecords: return "read-records";
+  }
+  llvm_unreachable("unhandled phase");
+}
+
+void QueryProfile::print(raw_ostream &OS) const {
+  auto toMicroseconds = [](std::chrono::nanoseconds time) -> uint64_t {
+    return std::chrono::duration_cast<std::chrono::microseconds>(time).count();
+  };
+  for (unsigned i = 0; i != NumCounters; ++i)
+    OS << getCounterName(Counter(i)) << ": " << Counters[i] << '\n';
+  for (unsigned i = 0; i != NumPhases; ++i)
+    OS << getPhaseName(Phase(i)) << ": " << toMicroseconds(PhaseTimes[i]) << "us\n";
+  OS << "total: " << toMicroseconds(TotalTime) << "us\n";
+}
+
+QueryProfile::Scope::Scope(QueryProfile &profile)
+  : Profile(profile), Previous(ActiveProfile), Start(std::chrono::steady_clock::now()) {
+  ActiveProfile = &Profile;
+}
+
+QueryProfile::Scope::~Scope() {
+  Profile.TotalTime += std::chrono::steady_clock::now() - Start;
+  ActiveProfile = Previous;
+}
+
+QueryProfile::PhaseTimer::PhaseTimer(Phase phase) : Profile(ActiveProfile) {
+  if (!Profile)
+    return;
+  auto now = std::chrono::steady_clock::now();
+  OuterPhase = Profile->ActivePhase;
+  if (OuterPhase != NoPhase)
+    Profile->PhaseTimes[OuterPhase] += now - Profile->ActivePhaseStart;
+  Profile->ActivePhase = unsigned(phase);
+  Profile->ActivePhaseStart = now;
+}
+
+QueryProfile::PhaseTimer::~PhaseTimer() {
+  if (!Profile)
+    return;
+  auto now = std::chrono::steady_clock::now();
+  Profile->PhaseTimes[Profile->ActivePhase] += now - Profile->ActivePhaseStart;
+  Profile->ActivePhase = OuterPhase;
+  Profile->ActivePhaseStart = now;
+}
@@ -0,0 +1,1198 @@
+//===--- SyntheticIndexStore.cpp ------------------------------------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2018 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://swift.org/LICENSE.txt for license information
+// See https://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#include "IndexStoreDB/SyntheticStore/SyntheticIndexStore.h"
+#include "indexstore/IndexStoreCXX.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Mutex.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <unordered_set>
+
+using namespace IndexStoreDB;
+using namespace IndexStoreDB::index;
+using namespace llvm;
+
+//===----------------------------------------------------------------------===//
+// ZipfDistribution
+//===----------------------------------------------------------------------===//
+
+ZipfDistribution::ZipfDistribution(unsigned N, double s) {
+  CDF.reserve(N);
+  double sum = 0;
+  for (unsigned k = 0; k != N; ++k) {
+    sum += 1.0 / std::pow(double(k + 1), s);
+    CDF.push_back(sum);
+  }
+}
+
+unsigned ZipfDistribution::operator()(std::mt19937_64 &rng) const {
+  assert(!CDF.empty() && "sampling from an empty distribution");
+  std::uniform_real_distribution<double> uniform(0, CDF.back());
+  auto It = std::upper_bound(CDF.begin(), CDF.end(), uniform(rng));
+  return std::min(unsigned(It - CDF.begin()), unsigned(CDF.size() - 1));
+}
+
+//===----------------------------------------------------------------------===//
+// Synthetic store data
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+struct SymbolInfo {
+  std::string USR;
+  std::string Name;
+  indexstore_symbol_kind_t Kind;
+  uint64_t Properties;
+};
+
+struct RecordSymbol {
+  const SymbolInfo *Info;
+  uint64_t Roles = 0;
+  uint64_t RelatedRoles = 0;
+};
+
+struct Relation {
+  uint64_t Roles = 0;
+  const RecordSymbol *Symbol = nullptr;
+};
+
+struct Occurrence {
+  const RecordSymbol *Symbol;
+  uint64_t Roles;
+  unsigned Line;
+  unsigned Column;
+  Relation Rel;
+};
+
+/// Immutable once created; readers keep it alive while they use it.
+struct Record {
+  std::string Name;
+  std::vector<RecordSymbol> Symbols;
+  /// Sorted by line.
+  std::vector<Occurrence> Occurrences;
+};
+
+struct Dependency {
+  indexstore_unit_dependency_kind_t Kind;
+  bool IsSystem;
+  std::string FilePath;
+  std::string ModuleName;
+  std::string Name;
+};
+
+struct Include {
+  std::string SourcePath;
+  std::string TargetPath;
+  unsigned Line;
+};
+
+/// Immutable once created; modifying a unit replaces it.
+struct Unit {
+  std::string Name;
+  std::string MainFile;
+  std::string OutputFile;
+  std::string WorkingDir;
+  int64_t ModTimeSeconds;
+  int64_t ModTimeNanoseconds;
+  unsigned Version;
+  std::vector<Dependency> Dependencies;
+  std::vector<Include> Includes;
+};
+
+struct UnitEvent {
+  indexstore_unit_event_kind_t Kind;
+  std::string UnitName;
+};
+
+struct UnitEventNotification {
+  bool IsInitial;
+  std::vector<UnitEvent> Events;
+};
+
+struct StoreHandle;
+
+static uint64_t hashCombine(uint64_t hash, uint64_t value) {
+  // FNV-1a over the bytes of the value.
+  for (unsigned i = 0; i != 8; ++i) {
+    hash ^= (value >> (i * 8)) & 0xff;
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+static uint64_t hashString(StringRef str) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (char c : str) {
+    hash ^= (unsigned char)c;
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+static std::mt19937_64 makeRNG(uint64_t seed, uint64_t a, uint64_t b) {
+  return std::mt19937_64(hashCombine(hashCombine(hashCombine(14695981039346656037ULL, seed), a), b));
+}
+
+static std::string makeHashedName(StringRef baseName, uint64_t hash) {
+  SmallString<64> name = baseName;
+  name += '-';
+  raw_svector_ostream OS(name);
+  OS.write_hex(hash);
+  return std::string(name.str());
+}
+
+static std::string unitNameFromOutputPath(StringRef outputPath) {
+  return makeHashedName(sys::path::filename(outputPath), hashString(outputPath));
+}
+
+} // anonymous namespace
+
+//===----------------------------------------------------------------------===//
+// SyntheticIndexStore::Implementation
+//===----------------------------------------------------------------------===//
+
+class SyntheticIndexStore::Implementation {
+public:
+  SyntheticStoreOptions Options;
+  std::string StorePath;
+  std::vector<SymbolInfo> Symbols;
+  ZipfDistribution USRDistribution;
+  ZipfDistribution HeaderDistribution;
+
+  mutable sys::Mutex StateMtx;
+  std::vector<std::shared_ptr<const Unit>> Units;
+  StringMap<unsigned> UnitIndexByName;
+  StringMap<std::shared_ptr<const Record>> RecordsByName;
+  uint64_t Generation = 0;
+
+  sys::Mutex ListenersMtx;
+  std::vector<StoreHandle *> Listeners;
+
+  Implementation(StringRef storePath, const SyntheticStoreOptions &options)
+    : Options(options), StorePath(storePath),
+      USRDistribution(std::max(options.numUSRs, 1u), options.zipfExponent),
+      HeaderDistribution(std::max(options.numHeaders, 1u), options.zipfExponent) {}
+
+  void generate();
+
+  std::string getMainFilePath(unsigned unitIndex) const;
+  std::string getOutputFilePath(unsigned unitIndex) const;
+  std::string getHeaderPath(unsigned headerIndex) const;
+
+  std::shared_ptr<const Record> generateRecord(StringRef fileName,
+                                               unsigned homeSlot,
+                                               std::mt19937_64 &rng) const;
+  std::shared_ptr<const Record> generateMainRecord(unsigned unitIndex, unsigned version) const;
+  std::shared_ptr<const Unit> makeUnit(unsigned unitIndex, unsigned version,
+                                       const std::shared_ptr<const Record> &mainRecord,
+                                       std::vector<Dependency> headerDeps,
+                                       std::vector<Include> includes) const;
+
+  std::vector<unsigned> modifyUnits(unsigned count, std::mt19937_64 &rng);
+
+  std::shared_ptr<const Unit> getUnit(StringRef unitName) const {
+    sys::ScopedLock L(StateMtx);
+    auto It = UnitIndexByName.find(unitName);
+    if (It == UnitIndexByName.end())
+      return nullptr;
+    return Units[It->second];
+  }
+
+  std::shared_ptr<const Record> getRecord(StringRef recordName) const {
+    sys::ScopedLock L(StateMtx);
+    auto It = RecordsByName.find(recordName);
+    if (It == RecordsByName.end())
+      return nullptr;
+    return It->second;
+  }
+
+  std::vector<std::string> getUnitNames() const {
+    sys::ScopedLock L(StateMtx);
+    std::vector<std::string> names;
+    names.reserve(Units.size());
+    for (const auto &unit : Units)
+      names.push_back(unit->Name);
+    return names;
+  }
+
+  void addListener(StoreHandle *handle);
+  void removeListener(StoreHandle *handle);
+  void notifyListeners(const UnitEventNotification &notification);
+};
+
+namespace {
+
+/// What \c store_create returns.
+struct StoreHandle {
+  std::shared_ptr<SyntheticIndexStore::Implementation> Store;
+  void *HandlerContext = nullptr;
+  void (*Handler)(void *, indexstore_unit_event_notification_t) = nullptr;
+  void (*Finalizer)(void *) = nullptr;
+
+  void resetHandler() {
+    if (Finalizer)
+      Finalizer(HandlerContext);
+    HandlerContext = nullptr;
+    Handler = nullptr;
+    Finalizer = nullptr;
+  }
+};
+
+} // anonymous namespace
+
+static const char *const NameWords[] = {
+  "get", "set", "update", "load", "parse", "render", "index", "record",
+  "symbol", "buffer", "stream", "cache", "path", "query", "token", "value",
+};
+static const unsigned NumNameWords = sizeof(NameWords) / sizeof(NameWords[0]);
+
+void SyntheticIndexStore::Implementation::generate() {
+  // Symbol vocabulary.
+  Symbols.reserve(Options.numUSRs);
+  for (unsigned i = 0; i != Options.numUSRs; ++i) {
+    std::mt19937_64 rng = makeRNG(Options.seed, 0, i);
+    SymbolInfo info;
+    info.Properties = 0;
+    std::string baseName = std::string(NameWords[rng() % NumNameWords]) +
+      NameWords[rng() % NumNameWords] + std::to_string(i);
+    const char *usrPrefix;
+    if (i % 100 < Options.unitTestSymbolPercent) {
+      info.Kind = INDEXSTORE_SYMBOL_KIND_INSTANCEMETHOD;
+      info.Properties = INDEXSTORE_SYMBOL_PROPERTY_UNITTEST;
+      baseName[0] = toupper(baseName[0]);
+      baseName = "test" + baseName;
+      usrPrefix = "c:objc(cs)SyntheticTests(im)";
+    } else {
+      switch (rng() % 20) {
+      case 0: case 1: case 2: case 3: case 4: case 5: case 6: case 7:
+        info.Kind = INDEXSTORE_SYMBOL_KIND_FUNCTION;
+        usrPrefix = "c:@F@";
+        break;
+      case 8: case 9: case 10:
+        info.Kind = INDEXSTORE_SYMBOL_KIND_CLASS;
+        baseName[0] = toupper(baseName[0]);
+        usrPrefix = "c:@S@";
+        break;
+      case 11: case 12: case 13: case 14: case 15:
+        info.Kind = INDEXSTORE_SYMBOL_KIND_INSTANCEMETHOD;
+        usrPrefix = "c:@S@Synthetic@F@";
+        break;
+      case 16: case 17:
+        info.Kind = INDEXSTORE_SYMBOL_KIND_VARIABLE;
+        usrPrefix = "c:@";
+        break;
+      case 18:
+        info.Kind = INDEXSTORE_SYMBOL_KIND_ENUM;
+        baseName[0] = toupper(baseName[0]);
+        usrPrefix = "c:@E@";
+        break;
+      default:
+        info.Kind = INDEXSTORE_SYMBOL_KIND_FIELD;
+        usrPrefix = "c:@S@Synthetic@FI@";
+        break;
+      }
+    }
+    info.Name = baseName;
+    info.USR = usrPrefix + baseName;
+    Symbols.push_back(std::move(info));
+  }
+
+  // Header records, shared between units.
+  std::vector<std::shared_ptr<const Record>> headerRecords;
+  headerRecords.reserve(Options.numHeaders);
+  for (unsigned h = 0; h != Options.numHeaders; ++h) {
+    std::mt19937_64 rng = makeRNG(Options.seed, 1, h);
+    std::string path = getHeaderPath(h);
+    headerRecords.push_back(generateRecord(sys::path::filename(path), Options.numUnits + h, rng));
+  }
+
+  // Units, each with its own main file record.
+  unsigned headersPerUnit = std::min(Options.recordsPerUnit ? Options.recordsPerUnit - 1 : 0,
+                                     Options.numHeaders);
+  sys::ScopedLock L(StateMtx);
+  Units.reserve(Options.numUnits);
+  for (unsigned u = 0; u != Options.numUnits; ++u) {
+    std::mt19937_64 rng = makeRNG(Options.seed, 2, u);
+    std::string mainFile = getMainFilePath(u);
+    std::vector<Dependency> headerDeps;
+    std::vector<Include> includes;
+    std::unordered_set<unsigned> picked;
+    auto addHeader = [&](unsigned h) {
+      if (!picked.insert(h).second)
+        return;
+      const auto &record = headerRecords[h];
+      std::string headerPath = getHeaderPath(h);
+      headerDeps.push_back(Dependency{INDEXSTORE_UNIT_DEPENDENCY_RECORD, /*IsSystem=*/false,
+                                      headerPath, /*ModuleName=*/"", record->Name});
+      includes.push_back(Include{mainFile, headerPath, unsigned(includes.size() + 1)});
+      RecordsByName[record->Name] = record;
+    };
+    for (unsigned attempts = 0; picked.size() < headersPerUnit && attempts < headersPerUnit * 8; ++attempts)
+      addHeader(HeaderDistribution(rng));
+    // With a steep distribution and nearly all the headers wanted, drawing
+    // the rare ones takes forever; take the most likely of the rest instead.
+    for (unsigned h = 0; picked.size() < headersPerUnit; ++h)
+      addHeader(h);
+
+    auto mainRecord = generateMainRecord(u, /*version=*/0);
+    RecordsByName[mainRecord->Name] = mainRecord;
+    auto unit = makeUnit(u, /*version=*/0, mainRecord, std::move(headerDeps), std::move(includes));
+    UnitIndexByName[unit->Name] = u;
+    Units.push_back(std::move(unit));
+  }
+}
+
+std::string SyntheticIndexStore::Implementation::getMainFilePath(unsigned unitIndex) const {
+  return Options.sourceRoot + "/src/module" + std::to_string(unitIndex % 32) +
+    "/file" + std::to_string(unitIndex) + ".cpp";
+}
+
+std::string SyntheticIndexStore::Implementation::getOutputFilePath(unsigned unitIndex) const {
+  return Options.sourceRoot + "/build/file" + std::to_string(unitIndex) + ".o";
+}
+
+std::string SyntheticIndexStore::Implementation::getHeaderPath(unsigned headerIndex) const {
+  return Options.sourceRoot + "/include/header" + std::to_string(headerIndex) + ".h";
+}
+
+std::shared_ptr<const Record>
+SyntheticIndexStore::Implementation::generateRecord(StringRef fileName,
+                                                    unsigned homeSlot,
+                                                    std::mt19937_64 &rng) const {
+  auto record = std::make_shared<Record>();
+  if (Symbols.empty()) {
+    record->Name = makeHashedName(fileName, rng());
+    return record;
+  }
+
+  // Every symbol has a home record that defines it, the rest of the symbols
+  // of a record are references.
+  unsigned numSlots = Options.numUnits + Options.numHeaders;
+  std::vector<unsigned> symbolIndices;
+  std::unordered_set<unsigned> picked;
+  unsigned maxDefinitions = std::max(Options.symbolsPerRecord / 2, 1u);
+  for (unsigned i = homeSlot; i < Symbols.size() && symbolIndices.size() < maxDefinitions; i += numSlots) {
+    symbolIndices.push_back(i);
+    picked.insert(i);
+  }
+  unsigned numDefinitions = symbolIndices.size();
+  unsigned wanted = std::min(Options.symbolsPerRecord, unsigned(Symbols.size()));
+  for (unsigned attempts = 0; symbolIndices.size() < wanted && attempts < wanted * 8; ++attempts) {
+    unsigned i = USRDistribution(rng);
+    if (picked.insert(i).second)
+      symbolIndices.push_back(i);
+  }
+
+  record->Symbols.reserve(symbolIndices.size());
+  for (unsigned i : symbolIndices)
+    record->Symbols.push_back(RecordSymbol{&Symbols[i]});
+
+  // References are attributed to the first function that the record defines.
+  RecordSymbol *container = nullptr;
+  for (unsigned i = 0; i != numDefinitions; ++i) {
+    auto kind = record->Symbols[i].Info->Kind;
+    if (kind == INDEXSTORE_SYMBOL_KIND_FUNCTION || kind == INDEXSTORE_SYMBOL_KIND_INSTANCEMETHOD) {
+      container = &record->Symbols[i];
+      break;
+    }
+  }
+
+  unsigned numLines = std::max(unsigned(record->Symbols.size()) * Options.occurrencesPerSymbol * 2, 1u);
+  record->Occurrences.reserve(record->Symbols.size() * Options.occurrencesPerSymbol);
+  for (unsigned s = 0, e = record->Symbols.size(); s != e; ++s) {
+    RecordSymbol &sym = record->Symbols[s];
+    bool isDefinition = s < numDefinitions;
+    bool isCallable = sym.Info->Kind == INDEXSTORE_SYMBOL_KIND_FUNCTION ||
+                      sym.Info->Kind == INDEXSTORE_SYMBOL_KIND_INSTANCEMETHOD;
+    for (unsigned o = 0; o != Options.occurrencesPerSymbol; ++o) {
+      Occurrence occur{&sym, 0, unsigned(1 + rng() % numLines), unsigned(1 + rng() % 80), {}};
+      if (isDefinition && o == 0) {
+        occur.Roles = INDEXSTORE_SYMBOL_ROLE_DECLARATION | INDEXSTORE_SYMBOL_ROLE_DEFINITION;
+      } else {
+        occur.Roles = INDEXSTORE_SYMBOL_ROLE_REFERENCE;
+        if (isCallable)
+          occur.Roles |= INDEXSTORE_SYMBOL_ROLE_CALL;
+        if (container && container != &sym) {
+          occur.Rel.Roles = INDEXSTORE_SYMBOL_ROLE_REL_CONTAINEDBY;
+          if (isCallable)
+            occur.Rel.Roles |= INDEXSTORE_SYMBOL_ROLE_REL_CALLEDBY;
+          occur.Rel.Symbol = container;
+          occur.Roles |= occur.Rel.Roles;
+          container->RelatedRoles |= occur.Rel.Roles;
+        }
+      }
+      sym.Roles |= occur.Roles;
+      record->Occurrences.push_back(occur);
+    }
+  }
+  std::sort(record->Occurrences.begin(), record->Occurrences.end(),
+            [](const Occurrence &LHS, const Occurrence &RHS) {
+    return std::tie(LHS.Line, LHS.Column) < std::tie(RHS.Line, RHS.Column);
+  });
+
+  record->Name = makeHashedName(fileName, rng());
+  return record;
+}
+
+std::shared_ptr<const Record>
+SyntheticIndexStore::Implementation::generateMainRecord(unsigned unitIndex, unsigned version) const {
+  std::mt19937_64 rng = makeRNG(Options.seed, 3, (uint64_t(unitIndex) << 32) | version);
+  std::string mainFile = getMainFilePath(unitIndex);
+  return generateRecord(sys::path::filename(mainFile), unitIndex, rng);
+}
+
+std::shared_ptr<const Unit>
+SyntheticIndexStore::Implementation::makeUnit(unsigned unitIndex, unsigned version,
+                                              const std::shared_ptr<const Record> &mainRecord,
+                                              std::vector<Dependency> headerDeps,
+                                              std::vector<Include> includes) const {
+  auto unit = std::make_shared<Unit>();
+  unit->MainFile = getMainFilePath(unitIndex);
+  unit->OutputFile = getOutputFilePath(unitIndex);
+  unit->Name = unitNameFromOutputPath(unit->OutputFile);
+  unit->WorkingDir = Options.sourceRoot;
+  // Recent enough to be newer than anything the out-of-date checks could find
+  // for the non-existent source files.
+  unit->ModTimeSeconds = 2000000000 + Generation;
+  unit->ModTimeNanoseconds = unitIndex % 1000000000;
+  unit->Version = version;
+  unit->Dependencies.push_back(Dependency{INDEXSTORE_UNIT_DEPENDENCY_RECORD, /*IsSystem=*/false,
+                                          unit->MainFile, /*ModuleName=*/"", mainRecord->Name});
+  for (auto &dep : headerDeps)
+    unit->Dependencies.push_back(std::move(dep));
+  unit->Includes = std::move(includes);
+  return unit;
+}
+
+std::vector<unsigned>
+SyntheticIndexStore::Implementation::modifyUnits(unsigned count, std::mt19937_64 &rng) {
+  std::vector<unsigned> modified;
+  UnitEventNotification notification{/*IsInitial=*/false, {}};
+  {
+    sys::ScopedLock L(StateMtx);
+    if (Units.empty())
+      return modified;
+    ++Generation;
+    count = std::min(count, unsigned(Units.size()));
+    std::unordered_set<unsigned> picked;
+    std::uniform_int_distribution<unsigned> unitDistribution(0, Units.size() - 1);
+    while (picked.size() < count) {
+      unsigned u = unitDistribution(rng);
+      if (picked.insert(u).second)
+        modified.push_back(u);
+    }
+
+    for (unsigned u : modified) {
+      std::shared_ptr<const Unit> oldUnit = Units[u];
+      unsigned version = oldUnit->Version + 1;
+      auto mainRecord = generateMainRecord(u, version);
+      RecordsByName.erase(oldUnit->Dependencies.front().Name);
+      RecordsByName[mainRecord->Name] = mainRecord;
+      std::vector<Dependency> headerDeps(oldUnit->Dependencies.begin() + 1, oldUnit->Dependencies.end());
+      Units[u] = makeUnit(u, version, mainRecord, std::move(headerDeps), oldUnit->Includes);
+      notification.Events.push_back(UnitEvent{INDEXSTORE_UNIT_EVENT_MODIFIED, Units[u]->Name});
+    }
+  }
+
+  notifyListeners(notification);
+  return modified;
+}
+
+void SyntheticIndexStore::Implementation::addListener(StoreHandle *handle) {
+  sys::ScopedLock L(ListenersMtx);
+  if (std::find(Listeners.begin(), Listeners.end(), handle) == Listeners.end())
+    Listeners.push_back(handle);
+}
+
+void SyntheticIndexStore::Implementation::removeListener(StoreHandle *handle) {
+  sys::ScopedLock L(ListenersMtx);
+  Listeners.erase(std::remove(Listeners.begin(), Listeners.end(), handle), Listeners.end());
+}
+
+void SyntheticIndexStore::Implementation::notifyListeners(const UnitEventNotification &notification) {
+  if (notification.Events.empty())
+    return;
+  sys::ScopedLock L(ListenersMtx);
+  for (StoreHandle *handle : Listeners) {
+    if (handle->Handler)
+      handle->Handler(handle->HandlerContext, (indexstore_unit_event_notification_t)&notification);
+  }
+}
+
+//===----------------------------------------------------------------------===//
+// SyntheticIndexStore
+//===----------------------------------------------------------------------===//
+
+namespace {
+/// Synthetic stores by store path, for \c store_create.
+struct StoreRegistry {
+  sys::Mutex Mtx;
+  StringMap<std::weak_ptr<SyntheticIndexStore::Implementation>> Stores;
+
+  static StoreRegistry &get() {
+    static StoreRegistry registry;
+    return registry;
+  }
+};
+} // anonymous namespace
+
+std::shared_ptr<SyntheticIndexStore>
+SyntheticIndexStore::create(StringRef storePath, const SyntheticStoreOptions &options) {
+  auto impl = std::make_shared<Implementation>(storePath, options);
+  impl->generate();
+
+  auto &registry = StoreRegistry::get();
+  {
+    sys::ScopedLock L(registry.Mtx);
+    registry.Stores[storePath] = impl;
+  }
+
+  std::shared_ptr<SyntheticIndexStore> store(new SyntheticIndexStore());
+  store->Impl = std::move(impl);
+  return store;
+}
+
+SyntheticIndexStore::~SyntheticIndexStore() {
+  auto &registry = StoreRegistry::get();
+  sys::ScopedLock L(registry.Mtx);
+  auto It = registry.Stores.find(Impl->StorePath);
+  if (It != registry.Stores.end() && It->second.lock() == Impl)
+    registry.Stores.erase(It);
+}
+
+const SyntheticStoreOptions &SyntheticIndexStore::getOptions() const {
+  return Impl->Options;
+}
+
+StringRef SyntheticIndexStore::getStorePath() const {
+  return Impl->StorePath;
+}
+
+unsigned SyntheticIndexStore::getNumRecords() const {
+  sys::ScopedLock L(Impl->StateMtx);
+  return Impl->RecordsByName.size();
+}
+
+uint64_t SyntheticIndexStore::getNumOccurrences() const {
+  sys::ScopedLock L(Impl->StateMtx);
+  uint64_t count = 0;
+  for (const auto &entry : Impl->RecordsByName)
+    count += entry.getValue()->Occurrences.size();
+  return count;
+}
+
+StringRef SyntheticIndexStore::getSymbolUSR(unsigned symbolIndex) const {
+  return Impl->Symbols[symbolIndex].USR;
+}
+
+StringRef SyntheticIndexStore::getSymbolName(unsigned symbolIndex) const {
+  return Impl->Symbols[symbolIndex].Name;
+}
+
+std::string SyntheticIndexStore::getMainFilePath(unsigned unitIndex) const {
+  return Impl->getMainFilePath(unitIndex);
+}
+
+std::string SyntheticIndexStore::getOutputFilePath(unsigned unitIndex) const {
+  return Impl->getOutputFilePath(unitIndex);
+}
+
+std::string SyntheticIndexStore::getHeaderPath(unsigned headerIndex) const {
+  return Impl->getHeaderPath(headerIndex);
+}
+
+std::vector<unsigned> SyntheticIndexStore::modifyUnits(unsigned count, std::mt19937_64 &rng) {
+  return Impl->modifyUnits(count, rng);
+}
+
+//===----------------------------------------------------------------------===//
+// indexstore_functions_t implementation
+//===----------------------------------------------------------------------===//
+
+namespace {
+
+static indexstore_string_ref_t toStringRef(StringRef str) {
+  return indexstore_string_ref_t{str.data(), str.size()};
+}
+
+static indexstore_error_t makeError(const Twine &description) {
+  return new std::string(description.str());
+}
+
+static const char *error_get_description(indexstore_error_t err) {
+  return static_cast<std::string *>(err)->c_str();
+}
+
+static void error_dispose(indexstore_error_t err) {
+  delete static_cast<std::string *>(err);
+}
+
+static unsigned format_version(void) {
+  return 5;
+}
+
+static unsigned version(void) {
+  return INDEXSTORE_VERSION;
+}
+
+static indexstore_creation_options_t creation_options_create(void) {
+  return new std::vector<std::pair<std::string, std::string>>();
+}
+
+static void creation_options_dispose(indexstore_creation_options_t options) {
+  delete static_cast<std::vector<std::pair<std::string, std::string>> *>(options);
+}
+
+static void creation_options_add_prefix_mapping(indexstore_creation_options_t options,
+                                                const char *path_prefix,
+                                                const char *remapped_path_prefix) {
+  static_cast<std::vector<std::pair<std::string, std::string>> *>(options)->emplace_back(
+    path_prefix, remapped_path_prefix);
+}
+
+static indexstore_t store_create(const char *store_path, indexstore_error_t *error) {
+  auto &registry = StoreRegistry::get();
+  sys::ScopedLock L(registry.Mtx);
+  auto It = registry.Stores.find(store_path);
+  std::shared_ptr<SyntheticIndexStore::Implementation> store;
+  if (It != registry.Stores.end())
+    store = It->second.lock();
+  if (!store) {
+    if (error)
+      *error = makeError(Twine("no synthetic index store at '") + store_path + "'");
+    return nullptr;
+  }
+  auto handle = new StoreHandle();
+  handle->Store = std::move(store);
+  return handle;
+}
+
+static indexstore_t store_create_with_options(const char *store_path,
+                                              indexstore_creation_options_t options,
+                                              indexstore_error_t *error) {
+  return store_create(store_path, error);
+}
+
+static void store_stop_unit_event_listening(indexstore_t store);
+
+static void store_dispose(indexstore_t store) {
+  if (!store)
+    return;
+  auto handle = static_cast<StoreHandle *>(store);
+  store_stop_unit_event_listening(store);
+  handle->resetHandler();
+  delete handle;
+}
+
+static bool store_units_apply_f(indexstore_t store, unsigned sorted, void *context,
+                                bool(*applier)(void *context, indexstore_string_ref_t unit_name)) {
+  auto names = static_cast<StoreHandle *>(store)->Store->getUnitNames();
+  if (sorted)
+    std::sort(names.begin(), names.end());
+  for (const auto &name : names) {
+    if (!applier(context, toStringRef(name)))
+      return false;
+  }
+  return true;
+}
+
+static size_t unit_event_notification_get_events_count(indexstore_unit_event_notification_t note) {
+  return static_cast<UnitEventNotification *>(note)->Events.size();
+}
+
+static indexstore_unit_event_t unit_event_notification_get_event(indexstore_unit_event_notification_t note,
+                                                                 size_t index) {
+  return &static_cast<UnitEventNotification *>(note)->Events[index];
+}
+
+static bool unit_event_notification_is_initial(indexstore_unit_event_notification_t note) {
+  return static_cast<UnitEventNotification *>(note)->IsInitial;
+}
+
+static indexstore_unit_event_kind_t unit_event_get_kind(indexstore_unit_event_t evt) {
+  return static_cast<UnitEvent *>(evt)->Kind;
+}
+
+static indexstore_string_ref_t unit_event_get_unit_name(indexstore_unit_event_t evt) {
+  return toStringRef(static_cast<UnitEvent *>(evt)->UnitName);
+}
+
+static void store_set_unit_event_handler_f(indexstore_t store, void *context,
+                        void(*handler)(void *context, indexstore_unit_event_notification_t),
+                        void(*finalizer)(void *context)) {
+  auto handle = static_cast<StoreHandle *>(store);
+  sys::ScopedLock L(handle->Store->ListenersMtx);
+  handle->resetHandler();
+  handle->HandlerContext = context;
+  handle->Handler = handler;
+  handle->Finalizer = finalizer;
+}
+
+static bool store_start_unit_event_listening(indexstore_t store,
+                                             indexstore_unit_event_listen_options_t *,
+                                             size_t listen_options_struct_size,
+                                             indexstore_error_t *error) {
+  auto handle = static_cast<StoreHandle *>(store);
+  // The initial set is always reported before returning, which satisfies
+  // both values of \c wait_initial_sync.
+  UnitEventNotification notification{/*IsInitial=*/true, {}};
+  for (auto &name : handle->Store->getUnitNames())
+    notification.Events.push_back(UnitEvent{INDEXSTORE_UNIT_EVENT_ADDED, std::move(name)});
+  {
+    sys::ScopedLock L(handle->Store->ListenersMtx);
+    if (handle->Handler)
+      handle->Handler(handle->HandlerContext, &notification);
+  }
+  handle->Store->addListener(handle);
+  return false;
+}
+
+static void store_stop_unit_event_listening(indexstore_t store) {
+  auto handle = static_cast<StoreHandle *>(store);
+  handle->Store->removeListener(handle);
+}
+
+static void store_discard_unit(indexstore_t store, const char *unit_name) {}
+
+static void store_discard_record(indexstore_t store, const char *record_name) {}
+
+static void store_purge_stale_data(indexstore_t store) {}
+
+static size_t store_get_unit_name_from_output_path(indexstore_t store,
+                                                   const char *output_path,
+                                                   char *name_buf,
+                                                   size_t buf_size) {
+  std::string name = unitNameFromOutputPath(output_path);
+  if (buf_size) {
+    size_t toCopy = std::min(name.size(), buf_size - 1);
+    memcpy(name_buf, name.data(), toCopy);
+    name_buf[toCopy] = '\0';
+  }
+  return name.size();
+}
+
+static bool store_get_unit_modification_time(indexstore_t store,
+                                             const char *unit_name,
+                                             int64_t *seconds,
+                                             int64_t *nanoseconds,
+                                             indexstore_error_t *error) {
+  auto unit = static_cast<StoreHandle *>(store)->Store->getUnit(unit_name);
+  if (!unit) {
+    if (error)
+      *error = makeError(Twine("unit '") + unit_name + "' does not exist");
+    return true;
+  }
+  *seconds = unit->ModTimeSeconds;
+  *nanoseconds = unit->ModTimeNanoseconds;
+  return false;
+}
+
+static const RecordSymbol *getSymbol(indexstore_symbol_t sym) {
+  return static_cast<const RecordSymbol *>(sym);
+}
+
+static indexstore_symbol_language_t symbol_get_language(indexstore_symbol_t sym) {
+  return INDEXSTORE_SYMBOL_LANG_CXX;
+}
+
+static indexstore_symbol_kind_t symbol_get_kind(indexstore_symbol_t sym) {
+  return getSymbol(sym)->Info->Kind;
+}
+
+static indexstore_symbol_subkind_t symbol_get_subkind(indexstore_symbol_t sym) {
+  return INDEXSTORE_SYMBOL_SUBKIND_NONE;
+}
+
+static uint64_t symbol_get_properties(indexstore_symbol_t sym) {
+  return getSymbol(sym)->Info->Properties;
+}
+
+static uint64_t symbol_get_roles(indexstore_symbol_t sym) {
+  return getSymbol(sym)->Roles;
+}
+
+static uint64_t symbol_get_related_roles(indexstore_symbol_t sym) {
+  return getSymbol(sym)->RelatedRoles;
+}
+
+static indexstore_string_ref_t symbol_get_name(indexstore_symbol_t sym) {
+  return toStringRef(getSymbol(sym)->Info->Name);
+}
+
+static indexstore_string_ref_t symbol_get_usr(indexstore_symbol_t sym) {
+  return toStringRef(getSymbol(sym)->Info->USR);
+}
+
+static indexstore_string_ref_t symbol_get_codegen_name(indexstore_symbol_t sym) {
+  return toStringRef(StringRef());
+}
+
+static uint64_t symbol_relation_get_roles(indexstore_symbol_relation_t rel) {
+  return static_cast<const Relation *>(rel)->Roles;
+}
+
+static indexstore_symbol_t symbol_relation_get_symbol(indexstore_symbol_relation_t rel) {
+  return const_cast<RecordSymbol *>(static_cast<const Relation *>(rel)->Symbol);
+}
+
+static const Occurrence *getOccurrence(indexstore_occurrence_t occur) {
+  return static_cast<const Occurrence *>(occur);
+}
+
+static indexstore_symbol_t occurrence_get_symbol(indexstore_occurrence_t occur) {
+  return const_cast<RecordSymbol *>(getOccurrence(occur)->Symbol);
+}
+
+static bool occurrence_relations_apply_f(indexstore_occurrence_t occur, void *context,
+                            bool(*applier)(void *context, indexstore_symbol_relation_t symbol_rel)) {
+  const Relation &rel = getOccurrence(occur)->Rel;
+  if (!rel.Symbol)
+    return true;
+  return applier(context, const_cast<Relation *>(&rel));
+}
+
+static uint64_t occurrence_get_roles(indexstore_occurrence_t occur) {
+  return getOccurrence(occur)->Roles;
+}
+
+static void occurrence_get_line_col(indexstore_occurrence_t occur, unsigned *line, unsigned *column) {
+  *line = getOccurrence(occur)->Line;
+  *column = getOccurrence(occur)->Column;
+}
+
+typedef std::shared_ptr<const Record> RecordReader;
+
+static const Record &getRecord(indexstore_record_reader_t reader) {
+  return **static_cast<RecordReader *>(reader);
+}
+
+static indexstore_record_reader_t record_reader_create(indexstore_t store, const char *record_name,
+                                                       indexstore_error_t *error) {
+  auto record = static_cast<StoreHandle *>(store)->Store->getRecord(record_name);
+  if (!record) {
+    if (error)
+      *error = makeError(Twine("record '") + record_name + "' does not exist");
+    return nullptr;
+  }
+  return new RecordReader(std::move(record));
+}
+
+static void record_reader_dispose(indexstore_record_reader_t reader) {
+  delete static_cast<RecordReader *>(reader);
+}
+
+static bool record_reader_search_symbols_f(indexstore_record_reader_t reader,
+                                           void *filter_ctx,
+          bool(*filter)(void *filter_ctx, indexstore_symbol_t symbol, bool *stop),
+                                           void *receiver_ctx,
+          void(*receiver)(void *receiver_ctx, indexstore_symbol_t symbol)) {
+  for (const RecordSymbol &sym : getRecord(reader).Symbols) {
+    bool stop = false;
+    auto c_sym = const_cast<RecordSymbol *>(&sym);
+    if (filter(filter_ctx, c_sym, &stop))
+      receiver(receiver_ctx, c_sym);
+    if (stop)
+      break;
+  }
+  return true;
+}
+
+static bool record_reader_symbols_apply_f(indexstore_record_reader_t reader,
+                                          bool nocache,
+                                          void *context,
+                      bool(*applier)(void *context, indexstore_symbol_t symbol)) {
+  for (const RecordSymbol &sym : getRecord(reader).Symbols) {
+    if (!applier(context, const_cast<RecordSymbol *>(&sym)))
+      return false;
+  }
+  return true;
+}
+
+static bool record_reader_occurrences_apply_f(indexstore_record_reader_t reader,
+                                              void *context,
+                   bool(*applier)(void *context, indexstore_occurrence_t occur)) {
+  for (const Occurrence &occur : getRecord(reader).Occurrences) {
+    if (!applier(context, const_cast<Occurrence *>(&occur)))
+      return false;
+  }
+  return true;
+}
+
+static bool record_reader_occurrences_in_line_range_apply_f(indexstore_record_reader_t reader,
+                                                            unsigned line_start,
+                                                            unsigned line_count,
+                                                            void *context,
+                   bool(*applier)(void *context, indexstore_occurrence_t occur)) {
+  const auto &occurrences = getRecord(reader).Occurrences;
+  auto It = std::lower_bound(occurrences.begin(), occurrences.end(), line_start,
+                             [](const Occurrence &occur, unsigned line) {
+    return occur.Line < line;
+  });
+  for (; It != occurrences.end() && It->Line < line_start + line_count; ++It) {
+    if (!applier(context, const_cast<Occurrence *>(&*It)))
+      return false;
+  }
+  return true;
+}
+
+static bool record_reader_occurrences_of_symbols_apply_f(indexstore_record_reader_t reader,
+        indexstore_symbol_t *symbols, size_t symbols_count,
+        indexstore_symbol_t *related_symbols, size_t related_symbols_count,
+        void *context,
+        bool(*applier)(void *context, indexstore_occurrence_t occur)) {
+  if (symbols_count == 0 && related_symbols_count == 0)
+    return record_reader_occurrences_apply_f(reader, context, applier);
+
+  ArrayRef<indexstore_symbol_t> symbolsFilter(symbols, symbols_count);
+  ArrayRef<indexstore_symbol_t> relatedFilter(related_symbols, related_symbols_count);
+  auto contains = [](ArrayRef<indexstore_symbol_t> filter, const RecordSymbol *sym) {
+    return sym && std::find(filter.begin(), filter.end(), sym) != filter.end();
+  };
+  for (const Occurrence &occur : getRecord(reader).Occurrences) {
+    if (!contains(symbolsFilter, occur.Symbol) && !contains(relatedFilter, occur.Rel.Symbol))
+      continue;
+    if (!applier(context, const_cast<Occurrence *>(&occur)))
+      return false;
+  }
+  return true;
+}
+
+typedef std::shared_ptr<const Unit> UnitReader;
+
+static const Unit &getUnit(indexstore_unit_reader_t reader) {
+  return **static_cast<UnitReader *>(reader);
+}
+
+static indexstore_unit_reader_t unit_reader_create(indexstore_t store, const char *unit_name,
+                                                   indexstore_error_t *error) {
+  auto unit = static_cast<StoreHandle *>(store)->Store->getUnit(unit_name);
+  if (!unit) {
+    if (error)
+      *error = makeError(Twine("unit '") + unit_name + "' does not exist");
+    return nullptr;
+  }
+  return new UnitReader(std::move(unit));
+}
+
+static void unit_reader_dispose(indexstore_unit_reader_t reader) {
+  delete static_cast<UnitReader *>(reader);
+}
+
+static indexstore_string_ref_t unit_reader_get_provider_identifier(indexstore_unit_reader_t reader) {
+  return toStringRef("clang");
+}
+
+static indexstore_string_ref_t unit_reader_get_provider_version(indexstore_unit_reader_t reader) {
+  return toStringRef("synthetic");
+}
+
+static void unit_reader_get_modification_time(indexstore_unit_reader_t reader,
+                                              int64_t *seconds,
+                                              int64_t *nanoseconds) {
+  *seconds = getUnit(reader).ModTimeSeconds;
+  *nanoseconds = getUnit(reader).ModTimeNanoseconds;
+}
+
+static bool unit_reader_is_system_unit(indexstore_unit_reader_t reader) {
+  return false;
+}
+
+static bool unit_reader_is_module_unit(indexstore_unit_reader_t reader) {
+  return false;
+}
+
+static bool unit_reader_is_debug_compilation(indexstore_unit_reader_t reader) {
+  return true;
+}
+
+static bool unit_reader_has_main_file(indexstore_unit_reader_t reader) {
+  return true;
+}
+
+static indexstore_string_ref_t unit_reader_get_main_file(indexstore_unit_reader_t reader) {
+  return toStringRef(getUnit(reader).MainFile);
+}
+
+static indexstore_string_ref_t unit_reader_get_module_name(indexstore_unit_reader_t reader) {
+  return toStringRef(StringRef());
+}
+
+static indexstore_string_ref_t unit_reader_get_working_dir(indexstore_unit_reader_t reader) {
+  return toStringRef(getUnit(reader).WorkingDir);
+}
+
+static indexstore_string_ref_t unit_reader_get_output_file(indexstore_unit_reader_t reader) {
+  return toStringRef(getUnit(reader).OutputFile);
+}
+
+static indexstore_string_ref_t unit_reader_get_sysroot_path(indexstore_unit_reader_t reader) {
+  return toStringRef(StringRef());
+}
+
+static indexstore_string_ref_t unit_reader_get_target(indexstore_unit_reader_t reader) {
+  return toStringRef("x86_64-unknown-linux-gnu");
+}
+
+static const Dependency *getDependency(indexstore_unit_dependency_t dep) {
+  return static_cast<const Dependency *>(dep);
+}
+
+static indexstore_unit_dependency_kind_t unit_dependency_get_kind(indexstore_unit_dependency_t dep) {
+  return getDependency(dep)->Kind;
+}
+
+static bool unit_dependency_is_system(indexstore_unit_dependency_t dep) {
+  return getDependency(dep)->IsSystem;
+}
+
+static indexstore_string_ref_t unit_dependency_get_filepath(indexstore_unit_dependency_t dep) {
+  return toStringRef(getDependency(dep)->FilePath);
+}
+
+static indexstore_string_ref_t unit_dependency_get_modulename(indexstore_unit_dependency_t dep) {
+  return toStringRef(getDependency(dep)->ModuleName);
+}
+
+static indexstore_string_ref_t unit_dependency_get_name(indexstore_unit_dependency_t dep) {
+  return toStringRef(getDependency(dep)->Name);
+}
+
+static const Include *getInclude(indexstore_unit_include_t inc) {
+  return static_cast<const Include *>(inc);
+}
+
+static indexstore_string_ref_t unit_include_get_source_path(indexstore_unit_include_t inc) {
+  return toStringRef(getInclude(inc)->SourcePath);
+}
+
+static indexstore_string_ref_t unit_include_get_target_path(indexstore_unit_include_t inc) {
+  return toStringRef(getInclude(inc)->TargetPath);
+}
+
+static unsigned unit_include_get_source_line(indexstore_unit_include_t inc) {
+  return getInclude(inc)->Line;
+}
+
+static bool unit_reader_dependencies_apply_f(indexstore_unit_reader_t reader,
+                                             void *context,
+                    bool(*applier)(void *context, indexstore_unit_dependency_t)) {
+  for (const Dependency &dep : getUnit(reader).Dependencies) {
+    if (!applier(context, const_cast<Dependency *>(&dep)))
+      return false;
+  }
+  return true;
+}
+
+static bool unit_reader_includes_apply_f(indexstore_unit_reader_t reader,
+                                         void *context,
+                    bool(*applier)(void *context, indexstore_unit_include_t)) {
+  for (const Include &inc : getUnit(reader).Includes) {
+    if (!applier(context, const_cast<Include *>(&inc)))
+      return false;
+  }
+  return true;
+}
+
+} // anonymous namespace
+
+IndexStoreLibraryRef index::getSyntheticIndexStoreLibrary() {
+  static IndexStoreLibraryRef library = []() {
+    // The block-based entry points are left null; IndexStoreCXX.h only calls
+    // the function pointer based ones.
+    indexstore_functions_t api = {};
+#define SYNTHETIC_FUNCTION(func) api.func = func;
+    SYNTHETIC_FUNCTION(creation_options_add_prefix_mapping)
+    SYNTHETIC_FUNCTION(creation_options_create)
+    SYNTHETIC_FUNCTION(creation_options_dispose)
+    SYNTHETIC_FUNCTION(error_get_description)
+    SYNTHETIC_FUNCTION(error_dispose)
+    SYNTHETIC_FUNCTION(format_version)
+    SYNTHETIC_FUNCTION(version)
+    SYNTHETIC_FUNCTION(store_create)
+    SYNTHETIC_FUNCTION(store_create_with_options)
+    SYNTHETIC_FUNCTION(store_dispose)
+    SYNTHETIC_FUNCTION(store_units_apply_f)
+    SYNTHETIC_FUNCTION(unit_event_notification_get_events_count)
+    SYNTHETIC_FUNCTION(unit_event_notification_get_event)
+    SYNTHETIC_FUNCTION(unit_event_notification_is_initial)
+    SYNTHETIC_FUNCTION(unit_event_get_kind)
+    SYNTHETIC_FUNCTION(unit_event_get_unit_name)
+    SYNTHETIC_FUNCTION(store_set_unit_event_handler_f)
+    SYNTHETIC_FUNCTION(store_start_unit_event_listening)
+    SYNTHETIC_FUNCTION(store_stop_unit_event_listening)
+    SYNTHETIC_FUNCTION(store_discard_unit)
+    SYNTHETIC_FUNCTION(store_discard_record)
+    SYNTHETIC_FUNCTION(store_purge_stale_data)
+    SYNTHETIC_FUNCTION(store_get_unit_name_from_output_path)
+    SYNTHETIC_FUNCTION(store_get_unit_modification_time)
+    SYNTHETIC_FUNCTION(symbol_get_language)
+    SYNTHETIC_FUNCTION(symbol_get_kind)
+    SYNTHETIC_FUNCTION(symbol_get_subkind)
+    SYNTHETIC_FUNCTION(symbol_get_properties)
+    SYNTHETIC_FUNCTION(symbol_get_roles)
+    SYNTHETIC_FUNCTION(symbol_get_related_roles)
+    SYNTHETIC_FUNCTION(symbol_get_name)
+    SYNTHETIC_FUNCTION(symbol_get_usr)
+    SYNTHETIC_FUNCTION(symbol_get_codegen_name)
+    SYNTHETIC_FUNCTION(symbol_relation_get_roles)
+    SYNTHETIC_FUNCTION(symbol_relation_get_symbol)
+    SYNTHETIC_FUNCTION(occurrence_get_symbol)
+    SYNTHETIC_FUNCTION(occurrence_relations_apply_f)
+    SYNTHETIC_FUNCTION(occurrence_get_roles)
+    SYNTHETIC_FUNCTION(occurrence_get_line_col)
+    SYNTHETIC_FUNCTION(record_reader_create)
+    SYNTHETIC_FUNCTION(record_reader_dispose)
+    SYNTHETIC_FUNCTION(record_reader_search_symbols_f)
+    SYNTHETIC_FUNCTION(record_reader_symbols_apply_f)
+    SYNTHETIC_FUNCTION(record_reader_occurrences_apply_f)
+    SYNTHETIC_FUNCTION(record_reader_occurrences_in_line_range_apply_f)
+    SYNTHETIC_FUNCTION(record_reader_occurrences_of_symbols_apply_f)
+    SYNTHETIC_FUNCTION(unit_reader_create)
+    SYNTHETIC_FUNCTION(unit_reader_dispose)
+    SYNTHETIC_FUNCTION(unit_reader_get_provider_identifier)
+    SYNTHETIC_FUNCTION(unit_reader_get_provider_version)
+    SYNTHETIC_FUNCTION(unit_reader_get_modification_time)
+    SYNTHETIC_FUNCTION(unit_reader_is_system_unit)
+    SYNTHETIC_FUNCTION(unit_reader_is_module_unit)
+    SYNTHETIC_FUNCTION(unit_reader_is_debug_compilation)
+    SYNTHETIC_FUNCTION(unit_reader_has_main_file)
+    SYNTHETIC_FUNCTION(unit_reader_get_main_file)
+    SYNTHETIC_FUNCTION(unit_reader_get_module_name)
+    SYNTHETIC_FUNCTION(unit_reader_get_working_dir)
+    SYNTHETIC_FUNCTION(unit_reader_get_output_file)
+    SYNTHETIC_FUNCTION(unit_reader_get_sysroot_path)
+    SYNTHETIC_FUNCTION(unit_reader_get_target)
+    SYNTHETIC_FUNCTION(unit_dependency_get_kind)
+    SYNTHETIC_FUNCTION(unit_dependency_is_system)
+    SYNTHETIC_FUNCTION(unit_dependency_get_filepath)
+    SYNTHETIC_FUNCTION(unit_dependency_get_modulename)
+    SYNTHETIC_FUNCTION(unit_dependency_get_name)
+    SYNTHETIC_FUNCTION(unit_include_get_source_path)
+    SYNTHETIC_FUNCTION(unit_include_get_target_path)
+    SYNTHETIC_FUNCTION(unit_include_get_source_line)
+    SYNTHETIC_FUNCTION(unit_reader_dependencies_apply_f)
+    SYNTHETIC_FUNCTION(unit_reader_includes_apply_f)
+#undef SYNTHETIC_FUNCTION
+    return std::make_shared<IndexStoreLibrary>(api);
+  }();
+  return library;
+}
+
+IndexStoreLibraryRef SyntheticIndexStoreLibraryProvider::getLibraryForStorePath(StringRef storePath) {
+  return getSyntheticIndexStoreLibrary();
+}
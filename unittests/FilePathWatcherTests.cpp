@@ -0,0 +1,113 @@
+//===--- FilePathWatcherTests.cpp -----------------------------------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2018 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://swift.org/LICENSE.txt for license information
+// See https://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#include "UnitTest.h"
+#include "IndexStoreDB/Support/FilePathWatcher.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+using namespace IndexStoreDB;
+
+namespace {
+/// Records the directories that a watcher reports.
+class ReportedDirs {
+  std::mutex Mtx;
+  std::condition_variable CV;
+  llvm::StringSet<> Dirs;
+
+public:
+  FilePathWatcher::FileEventsReceiverTy receiver() {
+    return [this](std::vector<std::string> dirs) {
+      std::lock_guard<std::mutex> L(Mtx);
+      for (auto &dir : dirs)
+        Dirs.insert(dir);
+      CV.notify_all();
+    };
+  }
+
+  void clear() {
+    std::lock_guard<std::mutex> L(Mtx);
+    Dirs.clear();
+  }
+
+  /// Waits until \p dir is reported, for up to 10 seconds.
+  bool waitFor(StringRef dir) {
+    std::unique_lock<std::mutex> L(Mtx);
+    return CV.wait_for(L, std::chrono::seconds(10), [&] { return Dirs.count(dir); });
+  }
+};
+} // anonymous namespace
+
+static std::string makeTempDir() {
+  SmallString<128> path;
+  llvm::sys::fs::createUniqueDirectory("isdb-watcher-test", path);
+  return path.str();
+}
+
+static void writeFile(StringRef dir, StringRef name) {
+  SmallString<128> path(dir);
+  llvm::sys::path::append(path, name);
+  std::error_code ec;
+  llvm::raw_fd_ostream OS(path, ec, llvm::sys::fs::OF_None);
+  OS << "contents";
+}
+
+ISDB_TEST(FilePathWatcher, DirectoryCreatedAfterAdding) {
+  if (!FilePathWatcher::watchesIndividualDirectories())
+    return;
+  std::string root = makeTempDir();
+  SmallString<128> dir(root);
+  llvm::sys::path::append(dir, "later");
+
+  ReportedDirs reported;
+  {
+    FilePathWatcher watcher(reported.receiver());
+    watcher.addDirectories({dir.str().str()});
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    llvm::sys::fs::create_directory(dir);
+    writeFile(dir, "a.o");
+    ISDB_EXPECT(reported.waitFor(dir));
+  }
+  llvm::sys::fs::remove_directories(root);
+}
+
+ISDB_TEST(FilePathWatcher, DirectoryRecreatedAfterFlush) {
+  if (!FilePathWatcher::watchesIndividualDirectories())
+    return;
+  std::string root = makeTempDir();
+  SmallString<128> dir(root);
+  llvm::sys::path::append(dir, "units");
+  llvm::sys::fs::create_directory(dir);
+
+  ReportedDirs reported;
+  {
+    FilePathWatcher watcher(reported.receiver());
+    watcher.addDirectories({dir.str().str()});
+    llvm::sys::fs::remove_directories(dir);
+    // The removal is reported once the events are flushed.
+    ISDB_EXPECT(reported.waitFor(dir));
+    reported.clear();
+    // Well after the flush that reported the removal.
+    std::this_thread::sleep_for(std::chrono::milliseconds(2500));
+    llvm::sys::fs::create_directory(dir);
+    writeFile(dir, "a.o");
+    ISDB_EXPECT(reported.waitFor(dir));
+  }
+  llvm::sys::fs::remove_directories(root);
+}
@@ -0,0 +1,275 @@
+//===--- SharedDatabaseTests.cpp ------------------------------------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2018 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://swift.org/LICENSE.txt for license information
+// See https://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+// The other processes of these tests only use lmdb directly, the library
+// isn't safe to use after a fork.
+#if !defined(_WIN32)
+
+#include "UnitTest.h"
+#include "DatabaseImpl.h"
+#include "IndexStoreDB/Database/ImportTransaction.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/file.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace IndexStoreDB;
+using namespace IndexStoreDB::db;
+
+namespace {
+/// A forked process that talks to the test through a pair of pipes.
+class ChildProcess {
+  pid_t PID = -1;
+  int ToChild = -1;
+  int FromChild = -1;
+
+public:
+  /// Runs \p body in the child with the ends of the pipes, and exits with
+  /// its result.
+  explicit ChildProcess(std::function<int(int in, int out)> body) {
+    int toChild[2], fromChild[2];
+    if (pipe(toChild) || pipe(fromChild))
+      return;
+    PID = fork();
+    if (PID == 0) {
+      close(toChild[1]);
+      close(fromChild[0]);
+      _exit(body(toChild[0], fromChild[1]));
+    }
+    close(toChild[0]);
+    close(fromChild[1]);
+    ToChild = toChild[1];
+    FromChild = fromChild[0];
+  }
+  ~ChildProcess() {
+    if (PID > 0)
+      kill(PID, SIGKILL);
+    wait();
+    close(ToChild);
+    close(FromChild);
+  }
+
+  pid_t getPID() const { return PID; }
+  bool isRunning() const { return PID > 0; }
+
+  void send(uint64_t value) { write(ToChild, &value, sizeof(value)); }
+  uint64_t receive() {
+    uint64_t value = ~0ULL;
+    read(FromChild, &value, sizeof(value));
+    return value;
+  }
+
+  /// \returns the exit status of the child, or -1 if it didn't exit normally.
+  int wait() {
+    if (PID <= 0)
+      return -1;
+    int status;
+    waitpid(PID, &status, 0);
+    PID = -1;
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+  }
+};
+} // anonymous namespace
+
+static void sendToParent(int out, uint64_t value) { write(out, &value, sizeof(value)); }
+static uint64_t receiveFromParent(int in) {
+  uint64_t value = ~0ULL;
+  read(in, &value, sizeof(value));
+  return value;
+}
+
+static std::string makeTempDir() {
+  SmallString<128> path;
+  llvm::sys::fs::createUniqueDirectory("isdb-shared-db-test", path);
+  return path.str();
+}
+
+static std::string getSharedEnvPath(StringRef dbPath) {
+  SmallString<128> path;
+  Database::Implementation::getVersionedPath(dbPath, path);
+  llvm::sys::path::append(path, "shared");
+  return path.str();
+}
+
+static void addProviders(DatabaseRef db, unsigned begin, unsigned end) {
+  ImportTransaction import(db);
+  for (unsigned i = begin; i != end; ++i)
+    import.addProviderName("provider-" + std::to_string(i));
+  import.commit();
+}
+
+/// Opens the shared environment at \p path without the library, the way
+/// another process of a different build would.
+static MDB_env *openEnv(StringRef path, unsigned flags) {
+  MDB_env *env;
+  if (mdb_env_create(&env))
+    return nullptr;
+  mdb_env_set_maxdbs(env, 16);
+  if (mdb_env_open(env, path.str().c_str(), flags, 0664)) {
+    mdb_env_close(env);
+    return nullptr;
+  }
+  return env;
+}
+
+/// \returns the number of providers seen by \p txn, or ~0 on error.
+static uint64_t countProviders(MDB_txn *txn) {
+  MDB_dbi dbi;
+  MDB_stat stat;
+  if (mdb_dbi_open(txn, "providers", MDB_INTEGERKEY, &dbi) || mdb_stat(txn, dbi, &stat))
+    return ~0ULL;
+  return stat.ms_entries;
+}
+
+static int noteReaderPID(const char *msg, void *ctx) {
+  int pid;
+  if (sscanf(msg, "%d", &pid) == 1)
+    static_cast<std::vector<int> *>(ctx)->push_back(pid);
+  return 0;
+}
+
+/// \returns the processes that have a reader slot in \p db.
+static std::vector<int> getReaderPIDs(DatabaseRef db) {
+  std::vector<int> pids;
+  mdb_reader_list(db->impl().getDBEnv(), noteReaderPID, &pids);
+  return pids;
+}
+
+ISDB_TEST(SharedDatabase, ReaderOfAnotherProcessDuringCommitAndResize) {
+  std::string root = makeTempDir();
+  std::string envPath = getSharedEnvPath(root);
+
+  ChildProcess reader([&](int in, int out) -> int {
+    // Wait for the writer to create the environment.
+    receiveFromParent(in);
+    MDB_env *env = openEnv(envPath, MDB_RDONLY);
+    MDB_txn *txn;
+    if (!env || mdb_txn_begin(env, nullptr, MDB_RDONLY, &txn))
+      return 1;
+    sendToParent(out, countProviders(txn));
+    // The writer commits and grows the map meanwhile.
+    receiveFromParent(in);
+    sendToParent(out, countProviders(txn));
+    mdb_txn_abort(txn);
+
+    int rc = mdb_txn_begin(env, nullptr, MDB_RDONLY, &txn);
+    if (rc == MDB_MAP_RESIZED) {
+      mdb_env_set_mapsize(env, 0);
+      rc = mdb_txn_begin(env, nullptr, MDB_RDONLY, &txn);
+    }
+    if (rc)
+      return 1;
+    sendToParent(out, countProviders(txn));
+    mdb_txn_abort(txn);
+    mdb_env_close(env);
+    return 0;
+  });
+  ISDB_EXPECT(reader.isRunning());
+  if (!reader.isRunning())
+    return;
+
+  std::string error;
+  DatabaseRef db = Database::createShared(root, /*readonly=*/false, llvm::None, error);
+  ISDB_EXPECT(db && db->isWriter());
+  if (!db)
+    return;
+  addProviders(db, 0, 10);
+  reader.send(0);
+  ISDB_EXPECT_EQ(reader.receive(), 10u);
+
+  // Neither waits for the read transaction of the other process.
+  addProviders(db, 10, 20);
+  db->increaseMapSize();
+  addProviders(db, 20, 30);
+  reader.send(0);
+  // The transaction that was open keeps its snapshot, the next one sees the
+  // commits of the grown map.
+  ISDB_EXPECT_EQ(reader.receive(), 10u);
+  ISDB_EXPECT_EQ(reader.receive(), 30u);
+  ISDB_EXPECT_EQ(reader.wait(), 0);
+
+  db.reset();
+  llvm::sys::fs::remove_directories(root);
+}
+
+ISDB_TEST(SharedDatabase, TakeoverAfterTheWriterExits) {
+  std::string root = makeTempDir();
+  SmallString<128> versionPath;
+  Database::Implementation::getVersionedPath(root, versionPath);
+  std::string envPath = getSharedEnvPath(root);
+  llvm::sys::fs::create_directories(envPath);
+  SmallString<128> lockPath(versionPath);
+  llvm::sys::path::append(lockPath, "shared-writer.lock");
+
+  // The writer is killed in the middle of a read transaction.
+  ChildProcess writer([&](int in, int out) -> int {
+    int fd = open(lockPath.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0 || flock(fd, LOCK_EX))
+      return 1;
+    MDB_env *env = openEnv(envPath, MDB_NOMEMINIT | MDB_WRITEMAP | MDB_NOSYNC);
+    MDB_txn *txn;
+    if (!env || mdb_txn_begin(env, nullptr, MDB_RDONLY, &txn))
+      return 1;
+    sendToParent(out, 1);
+    receiveFromParent(in);
+    return 0;
+  });
+  ISDB_EXPECT(writer.isRunning());
+  if (!writer.isRunning())
+    return;
+  ISDB_EXPECT_EQ(writer.receive(), 1u);
+
+  std::string error;
+  DatabaseRef db = Database::createShared(root, /*readonly=*/false, llvm::None, error);
+  ISDB_EXPECT(db && !db->isWriter());
+  if (!db)
+    return;
+  std::mutex mtx;
+  std::condition_variable cv;
+  bool tookOver = false;
+  ISDB_EXPECT(db->deferUntilWriter([&] {
+    std::lock_guard<std::mutex> L(mtx);
+    tookOver = true;
+    cv.notify_all();
+  }));
+
+  pid_t writerPID = writer.getPID();
+  std::vector<int> readerPIDs = getReaderPIDs(db);
+  ISDB_EXPECT(std::count(readerPIDs.begin(), readerPIDs.end(), writerPID) == 1);
+  kill(writerPID, SIGKILL);
+  ISDB_EXPECT_EQ(writer.wait(), -1);
+  {
+    std::unique_lock<std::mutex> L(mtx);
+    ISDB_EXPECT(cv.wait_for(L, std::chrono::seconds(10), [&] { return tookOver; }));
+  }
+  ISDB_EXPECT(db->isWriter());
+  // The reader slot of the killed writer is freed.
+  readerPIDs = getReaderPIDs(db);
+  ISDB_EXPECT(std::count(readerPIDs.begin(), readerPIDs.end(), writerPID) == 0);
+  addProviders(db, 0, 10);
+
+  db.reset();
+  llvm::sys::fs::remove_directories(root);
+}
+
+#endif
@@ -0,0 +1,176 @@
+//===--- SymbolOccurrenceViewTests.cpp ------------------------------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2018 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://swift.org/LICENSE.txt for license information
+// See https://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#include "UnitTest.h"
+#include "IndexStoreDB/Core/Symbol.h"
+#include "IndexStoreDB/Index/IndexSystem.h"
+#include "IndexStoreDB/Index/IndexSystemDelegate.h"
+#include "IndexStoreDB/Index/SymbolOccurrenceView.h"
+#include "IndexStoreDB/SyntheticStore/SyntheticIndexStore.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+
+using namespace IndexStoreDB;
+using namespace IndexStoreDB::index;
+using namespace llvm;
+
+namespace {
+
+class TestDelegate : public IndexSystemDelegate {};
+
+/// A synthetic store and an index over it, in a temporary directory that is
+/// removed with it.
+class SyntheticIndex {
+  SmallString<128> WorkDir;
+
+public:
+  SyntheticIndexStoreRef Store;
+  std::shared_ptr<IndexSystem> Index;
+
+  SyntheticIndex() {
+    if (std::error_code EC = sys::fs::createUniqueDirectory("isdb-unittest", WorkDir)) {
+      ISDB_EXPECT_EQ(EC.message(), std::string());
+      return;
+    }
+    SmallString<128> storePath = WorkDir;
+    sys::path::append(storePath, "store");
+    SmallString<128> dbasePath = WorkDir;
+    sys::path::append(dbasePath, "db");
+
+    SyntheticStoreOptions storeOptions;
+    storeOptions.numUnits = 20;
+    storeOptions.recordsPerUnit = 4;
+    storeOptions.numHeaders = 10;
+    storeOptions.symbolsPerRecord = 20;
+    storeOptions.numUSRs = 100;
+    Store = SyntheticIndexStore::create(storePath, storeOptions);
+
+    CreationOptions options;
+    options.wait = true;
+    options.listenToUnitEvents = false;
+    std::string error;
+    Index = IndexSystem::create(storePath, dbasePath,
+                                std::make_shared<SyntheticIndexStoreLibraryProvider>(),
+                                std::make_shared<TestDelegate>(),
+                                options, /*initialDBSize=*/None, error);
+    ISDB_EXPECT_EQ(error, std::string());
+  }
+
+  ~SyntheticIndex() {
+    Index.reset();
+    if (!WorkDir.empty())
+      sys::fs::remove_directories(WorkDir);
+  }
+};
+
+} // anonymous namespace
+
+static void describeLocation(raw_ostream &OS, StringRef usr, SymbolRoleSet roles,
+                             StringRef path, unsigned line, unsigned column) {
+  OS << usr << " roles:" << roles.toRaw() << " " << path << ":" << line << ":" << column;
+}
+
+static std::string describeOccurrence(const SymbolOccurrenceRef &occur) {
+  std::string str;
+  raw_string_ostream OS(str);
+  describeLocation(OS, occur->getSymbol()->getUSR(), occur->getRoles(),
+                   occur->getLocation().getPath().getPathString(),
+                   occur->getLocation().getLine(), occur->getLocation().getColumn());
+  for (const SymbolRelation &rel : occur->getRelations())
+    OS << " rel:" << rel.getRoles().toRaw() << ":" << rel.getSymbol()->getUSR();
+  return OS.str();
+}
+
+/// Describes \p occur from its own accessors, without copying it.
+static std::string describeView(const SymbolOccurrenceView &occur) {
+  std::string str;
+  raw_string_ostream OS(str);
+  describeLocation(OS, occur.getSymbol().getUSR(), occur.getRoles(),
+                   occur.getPath().getPathString(), occur.getLine(), occur.getColumn());
+  occur.foreachRelation([&](SymbolRoleSet roles, const SymbolView &sym) -> bool {
+    OS << " rel:" << roles.toRaw() << ":" << sym.getUSR();
+    return true;
+  });
+  return OS.str();
+}
+
+static const SymbolRoleSet AllRoles = SymbolRoleSet(SymbolRole::Declaration) |
+    SymbolRole::Definition | SymbolRole::Reference | SymbolRole::Call |
+    SymbolRole::RelationContainedBy | SymbolRole::RelationCalledBy;
+
+ISDB_TEST(SymbolOccurrenceView, CopyMatchesOccurrences) {
+  SyntheticIndex synthetic;
+  if (!synthetic.Index)
+    return;
+  IndexSystem &index = *synthetic.Index;
+
+  size_t numOccurrences = 0;
+  size_t numRelated = 0;
+  for (unsigned i = 0, e = synthetic.Store->getOptions().numUSRs; i != e; ++i) {
+    StringRef usr = synthetic.Store->getSymbolUSR(i);
+    for (bool related : {false, true}) {
+      std::vector<std::string> expected;
+      auto receiver = [&](SymbolOccurrenceRef occur) -> bool {
+        expected.push_back(describeOccurrence(occur));
+        return true;
+      };
+      std::vector<std::string> copied;
+      std::vector<std::string> viewed;
+      auto viewReceiver = [&](const SymbolOccurrenceView &occur) -> bool {
+        copied.push_back(describeOccurrence(occur.copy()));
+        viewed.push_back(describeView(occur));
+        return true;
+      };
+      if (related) {
+        ISDB_EXPECT(index.foreachRelatedSymbolOccurrenceByUSR(usr, AllRoles, receiver));
+        ISDB_EXPECT(index.foreachRelatedSymbolOccurrenceViewByUSR(usr, AllRoles, viewReceiver));
+        numRelated += expected.size();
+      } else {
+        ISDB_EXPECT(index.foreachSymbolOccurrenceByUSR(usr, AllRoles, receiver));
+        ISDB_EXPECT(index.foreachSymbolOccurrenceViewByUSR(usr, AllRoles, viewReceiver));
+        numOccurrences += expected.size();
+      }
+      ISDB_EXPECT(copied == expected);
+      ISDB_EXPECT(viewed == expected);
+    }
+  }
+  ISDB_EXPECT(numOccurrences > 0);
+  ISDB_EXPECT(numRelated > 0);
+}
+
+ISDB_TEST(SymbolOccurrenceView, StopsEarly) {
+  SyntheticIndex synthetic;
+  if (!synthetic.Index)
+    return;
+  IndexSystem &index = *synthetic.Index;
+
+  // The most referenced symbols have occurrences in several records.
+  StringRef usr = synthetic.Store->getSymbolUSR(0);
+  std::vector<std::string> expected;
+  index.foreachSymbolOccurrenceByUSR(usr, AllRoles, [&](SymbolOccurrenceRef occur) -> bool {
+    expected.push_back(describeOccurrence(occur));
+    return true;
+  });
+  ISDB_EXPECT(expected.size() > 1);
+
+  std::vector<std::string> copied;
+  bool finished = index.foreachSymbolOccurrenceViewByUSR(usr, AllRoles,
+      [&](const SymbolOccurrenceView &occur) -> bool {
+    copied.push_back(describeOccurrence(occur.copy()));
+    return false;
+  });
+  ISDB_EXPECT(!finished);
+  ISDB_EXPECT_EQ(copied.size(), size_t(1));
+  if (!copied.empty() && !expected.empty())
+    ISDB_EXPECT_EQ(copied.front(), expected.front());
+}
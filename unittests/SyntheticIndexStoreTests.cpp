@@ -0,0 +1,31 @@
+//===--- SyntheticIndexStoreTests.cpp -------------------------------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2018 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://swift.org/LICENSE.txt for license information
+// See https://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#include "UnitTest.h"
+#include "IndexStoreDB/SyntheticStore/SyntheticIndexStore.h"
+
+using namespace IndexStoreDB;
+using namespace IndexStoreDB::index;
+
+ISDB_TEST(SyntheticIndexStore, SteepDistributionWithAllTheHeaders) {
+  // Each unit includes every header, and the last ones are all but never
+  // drawn from the distribution.
+  SyntheticStoreOptions options;
+  options.numUnits = 4;
+  options.numHeaders = 30;
+  options.recordsPerUnit = 31;
+  options.symbolsPerRecord = 4;
+  options.numUSRs = 100;
+  options.zipfExponent = 8;
+  auto store = SyntheticIndexStore::create("/synthetic-unittest-store", options);
+  ISDB_EXPECT_EQ(store->getNumRecords(), options.numUnits + options.numHeaders);
+}
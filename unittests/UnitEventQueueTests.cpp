@@ -0,0 +1,97 @@
+//===--- UnitEventQueueTests.cpp ------------------------------------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2018 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://swift.org/LICENSE.txt for license information
+// See https://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#include "UnitEventQueue.h"
+#include "UnitTest.h"
+#include "IndexStoreDB/Database/Database.h"
+
+using namespace IndexStoreDB;
+using namespace IndexStoreDB::index;
+using namespace indexstore;
+
+typedef IndexStore::UnitEvent::Kind EventKind;
+
+static UnitEventInfo makeEvent(EventKind kind, StringRef unitName,
+                               UnitEventPriority priority = UnitEventPriority::Normal) {
+  UnitEventInfo evt(kind, unitName.str(), /*isInitialScan=*/false);
+  evt.priority = priority;
+  return evt;
+}
+
+/// Describes \p evts as "unit:kind" entries, in order.
+static std::string describeEvents(ArrayRef<UnitEventInfo> evts) {
+  std::string str;
+  for (const UnitEventInfo &evt : evts) {
+    if (!str.empty())
+      str += ",";
+    str += evt.name + ":";
+    switch (evt.kind) {
+    case EventKind::Added: str += "added"; break;
+    case EventKind::Removed: str += "removed"; break;
+    case EventKind::Modified: str += "modified"; break;
+    case EventKind::DirectoryDeleted: str += "directory-deleted"; break;
+    }
+  }
+  return str;
+}
+
+ISDB_TEST(UnitEventQueue, RemovedThenAddedInOneBatch) {
+  UnitEventQueue queue;
+  ISDB_EXPECT_EQ(queue.addEvents({makeEvent(EventKind::Removed, "a"),
+                                  makeEvent(EventKind::Added, "a")}), 1u);
+  ISDB_EXPECT_EQ(describeEvents(queue.popFront(10)), std::string("a:added"));
+  ISDB_EXPECT(queue.empty());
+}
+
+ISDB_TEST(UnitEventQueue, AddedThenRemoved) {
+  UnitEventQueue queue;
+  ISDB_EXPECT_EQ(queue.addEvents({makeEvent(EventKind::Added, "a")}), 0u);
+  ISDB_EXPECT_EQ(queue.addEvents({makeEvent(EventKind::Modified, "a"),
+                                  makeEvent(EventKind::Removed, "a")}), 2u);
+  ISDB_EXPECT_EQ(describeEvents(queue.popFront(10)), std::string("a:removed"));
+  ISDB_EXPECT(queue.empty());
+}
+
+ISDB_TEST(UnitEventQueue, KeepsOrderAcrossUnits) {
+  UnitEventQueue queue;
+  queue.addEvents({makeEvent(EventKind::Added, "a"),
+                   makeEvent(EventKind::Added, "b"),
+                   makeEvent(EventKind::DirectoryDeleted, "dir"),
+                   makeEvent(EventKind::Added, "c")});
+  // Coalesced events keep the place of the first event of their unit,
+  // directory events are never coalesced.
+  ISDB_EXPECT_EQ(queue.addEvents({makeEvent(EventKind::Modified, "c"),
+                                  makeEvent(EventKind::Removed, "a"),
+                                  makeEvent(EventKind::DirectoryDeleted, "dir"),
+                                  makeEvent(EventKind::Added, "d")}), 2u);
+  ISDB_EXPECT_EQ(describeEvents(queue.popFront(3)),
+                 std::string("a:removed,b:added,dir:directory-deleted"));
+  // A unit that was popped starts over at the back.
+  queue.addEvents({makeEvent(EventKind::Modified, "a")});
+  ISDB_EXPECT_EQ(describeEvents(queue.popFront(10)),
+                 std::string("c:modified,dir:directory-deleted,d:added,a:modified"));
+  ISDB_EXPECT(queue.empty());
+}
+
+ISDB_TEST(UnitEventQueue, HighPriorityGoesFirst) {
+  UnitEventQueue queue;
+  queue.addEvents({makeEvent(EventKind::Added, "a"),
+                   makeEvent(EventKind::Added, "b"),
+                   makeEvent(EventKind::Added, "c"),
+                   makeEvent(EventKind::Added, "d")});
+  // A high priority event moves its pending unit ahead, and so does a boost.
+  queue.addEvents({makeEvent(EventKind::Modified, "c", UnitEventPriority::High)});
+  queue.prioritize({db::makeIDCodeFromString("b")});
+  ISDB_EXPECT_EQ(describeEvents(queue.popFront(10)),
+                 std::string("b:added,c:modified,a:added,d:added"));
+  ISDB_EXPECT(queue.empty());
+}
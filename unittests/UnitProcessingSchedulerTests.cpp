@@ -0,0 +1,134 @@
+//===--- UnitProcessingSchedulerTests.cpp ---------------------------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2018 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://swift.org/LICENSE.txt for license information
+// See https://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#include "UnitProcessingScheduler.h"
+#include "UnitTest.h"
+#include "llvm/ADT/ArrayRef.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+using namespace IndexStoreDB;
+using namespace IndexStoreDB::index;
+
+namespace {
+
+/// Records the order in which the work of the queues runs.
+class WorkLog {
+public:
+  /// Enqueues \p count work items on \p queue that take about 2ms each.
+  void enqueueWork(UnitProcessingScheduler::Queue &queue, unsigned count) {
+    std::lock_guard<std::mutex> L(Mtx);
+    NumExpected += count;
+    for (unsigned i = 0; i != count; ++i) {
+      queue.dispatch([this, label = queue.getLabel().str()] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        std::lock_guard<std::mutex> L(Mtx);
+        Labels.push_back(label);
+        CV.notify_all();
+      });
+    }
+  }
+
+  /// Holds \p queue, and the other queues while the concurrency is 1, until
+  /// \c openGate().
+  void enqueueGate(UnitProcessingScheduler::Queue &queue) {
+    queue.dispatch([this] {
+      std::unique_lock<std::mutex> L(Mtx);
+      CV.wait(L, [&] { return GateOpen; });
+      GateOpen = false;
+    });
+  }
+
+  void openGate() {
+    std::lock_guard<std::mutex> L(Mtx);
+    GateOpen = true;
+    CV.notify_all();
+  }
+
+  /// Waits for all the work so far and \returns the labels of the work in the
+  /// order it ran, then starts over.
+  std::vector<std::string> waitForWork() {
+    std::unique_lock<std::mutex> L(Mtx);
+    bool finished = CV.wait_for(L, std::chrono::seconds(30), [&] { return Labels.size() == NumExpected; });
+    ISDB_EXPECT(finished);
+    NumExpected = 0;
+    return std::move(Labels);
+  }
+
+private:
+  std::mutex Mtx;
+  std::condition_variable CV;
+  bool GateOpen = false;
+  size_t NumExpected = 0;
+  std::vector<std::string> Labels;
+};
+
+} // anonymous namespace
+
+/// Never destroyed, like the shared scheduler, the pool may still be finishing
+/// the last work item when the test returns.
+static UnitProcessingScheduler &makeScheduler() {
+  return *new UnitProcessingScheduler();
+}
+
+static unsigned countLabel(ArrayRef<std::string> labels, StringRef label) {
+  return std::count(labels.begin(), labels.end(), label);
+}
+
+ISDB_TEST(UnitProcessingScheduler, SharesByWeight) {
+  UnitProcessingScheduler &scheduler = makeScheduler();
+  auto gate = scheduler.createQueue("gate", 1);
+  auto light = scheduler.createQueue("light", 1);
+  auto heavy = scheduler.createQueue("heavy", 3);
+  WorkLog log;
+
+  log.enqueueGate(*gate);
+  log.enqueueWork(*light, 40);
+  log.enqueueWork(*heavy, 120);
+  log.openGate();
+  std::vector<std::string> labels = log.waitForWork();
+  ISDB_EXPECT_EQ(labels.size(), size_t(160));
+
+  // While both have work, the heavy queue gets about 3 of every 4 turns.
+  ArrayRef<std::string> contended = ArrayRef<std::string>(labels).take_front(80);
+  unsigned numLight = countLabel(contended, "light");
+  ISDB_EXPECT(numLight >= 12 && numLight <= 28);
+  ISDB_EXPECT_EQ(light->getStats().ScheduledWork, uint64_t(40));
+  ISDB_EXPECT_EQ(heavy->getStats().ScheduledWork, uint64_t(120));
+}
+
+ISDB_TEST(UnitProcessingScheduler, IdleQueueDoesntBuildUpCredit) {
+  UnitProcessingScheduler &scheduler = makeScheduler();
+  auto gate = scheduler.createQueue("gate", 1);
+  auto busy = scheduler.createQueue("busy", 1);
+  auto idle = scheduler.createQueue("idle", 1);
+  WorkLog log;
+
+  log.enqueueWork(*busy, 50);
+  log.waitForWork();
+
+  // The queue that was idle doesn't get to make up for the time that the
+  // other one ran alone, they take turns right away.
+  log.enqueueGate(*gate);
+  log.enqueueWork(*busy, 40);
+  log.enqueueWork(*idle, 40);
+  log.openGate();
+  std::vector<std::string> labels = log.waitForWork();
+  ISDB_EXPECT_EQ(labels.size(), size_t(80));
+
+  ArrayRef<std::string> contended = ArrayRef<std::string>(labels).take_front(40);
+  unsigned numBusy = countLabel(contended, "busy");
+  ISDB_EXPECT(numBusy >= 14 && numBusy <= 26);
+}
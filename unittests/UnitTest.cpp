@@ -0,0 +1,70 @@
+//===--- UnitTest.cpp - Runs the C++ unit tests ---------------------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2018 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://swift.org/LICENSE.txt for license information
+// See https://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#include "UnitTest.h"
+#include "llvm/ADT/StringRef.h"
+#include <vector>
+
+using namespace IndexStoreDB;
+using namespace IndexStoreDB::unittest;
+
+namespace {
+
+struct Test {
+  const char *Suite;
+  const char *Name;
+  TestFn Run;
+};
+
+} // anonymous namespace
+
+static std::vector<Test> &getTests() {
+  static std::vector<Test> tests;
+  return tests;
+}
+
+static unsigned NumFailures = 0;
+
+TestRegistration::TestRegistration(const char *suite, const char *name, TestFn fn) {
+  getTests().push_back(Test{suite, name, fn});
+}
+
+void unittest::reportFailure(const char *file, unsigned line, const std::string &message) {
+  ++NumFailures;
+  llvm::errs() << file << ":" << line << ": " << message << "\n";
+}
+
+/// Runs all the tests, or the ones whose "Suite.Name" contains the first
+/// argument.
+int main(int argc, char **argv) {
+  llvm::StringRef filter = argc > 1 ? argv[1] : "";
+  unsigned numRun = 0;
+  unsigned numFailed = 0;
+  for (const Test &test : getTests()) {
+    std::string fullName = std::string(test.Suite) + "." + test.Name;
+    if (!llvm::StringRef(fullName).contains(filter))
+      continue;
+    llvm::outs() << "[ RUN      ] " << fullName << "\n";
+    llvm::outs().flush();
+    unsigned failuresBefore = NumFailures;
+    test.Run();
+    ++numRun;
+    if (NumFailures == failuresBefore) {
+      llvm::outs() << "[       OK ] " << fullName << "\n";
+    } else {
+      ++numFailed;
+      llvm::outs() << "[  FAILED  ] " << fullName << "\n";
+    }
+  }
+  llvm::outs() << numRun << " tests ran, " << numFailed << " failed\n";
+  return numFailed == 0 ? 0 : 1;
+}
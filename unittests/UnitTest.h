@@ -0,0 +1,69 @@
+//===--- UnitTest.h - Checks for the C++ unit tests -------------*- C++ -*-===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2018 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://swift.org/LICENSE.txt for license information
+// See https://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+//
+// The C++ unit tests cover the internal components that the Swift tests can't
+// drive directly. Each test is a function registered with ISDB_TEST; a failed
+// check reports its location and the test carries on.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef INDEXSTOREDB_UNITTESTS_UNITTEST_H
+#define INDEXSTOREDB_UNITTESTS_UNITTEST_H
+
+#include "llvm/Support/raw_ostream.h"
+#include <string>
+
+namespace IndexStoreDB {
+namespace unittest {
+
+typedef void (*TestFn)();
+
+struct TestRegistration {
+  TestRegistration(const char *suite, const char *name, TestFn fn);
+};
+
+/// Marks the running test as failed.
+void reportFailure(const char *file, unsigned line, const std::string &message);
+
+template <typename T>
+std::string describe(const T &value) {
+  std::string str;
+  llvm::raw_string_ostream OS(str);
+  OS << value;
+  return OS.str();
+}
+
+} // namespace unittest
+} // namespace IndexStoreDB
+
+#define ISDB_TEST(SUITE, NAME) \
+  static void SUITE##_##NAME(); \
+  static ::IndexStoreDB::unittest::TestRegistration SUITE##_##NAME##_registration(#SUITE, #NAME, SUITE##_##NAME); \
+  static void SUITE##_##NAME()
+
+#define ISDB_EXPECT(COND) \
+  do { \
+    if (!(COND)) \
+      ::IndexStoreDB::unittest::reportFailure(__FILE__, __LINE__, "expected " #COND); \
+  } while (0)
+
+#define ISDB_EXPECT_EQ(LHS, RHS) \
+  do { \
+    const auto &lhs_ = (LHS); \
+    const auto &rhs_ = (RHS); \
+    if (!(lhs_ == rhs_)) \
+      ::IndexStoreDB::unittest::reportFailure(__FILE__, __LINE__, \
+          "expected " #LHS " == " #RHS ", got '" + ::IndexStoreDB::unittest::describe(lhs_) + \
+          "' and '" + ::IndexStoreDB::unittest::describe(rhs_) + "'"); \
+  } while (0)
+
+#endif
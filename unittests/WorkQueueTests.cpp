@@ -0,0 +1,84 @@
+//===--- WorkQueueTests.cpp -----------------------------------------------===//
+//
+// This source file is part of the Swift.org open source project
+//
+// Copyright (c) 2014 - 2018 Apple Inc. and the Swift project authors
+// Licensed under Apache License v2.0 with Runtime Library Exception
+//
+// See https://swift.org/LICENSE.txt for license information
+// See https://swift.org/CONTRIBUTORS.txt for the list of Swift project authors
+//
+//===----------------------------------------------------------------------===//
+
+#include "UnitTest.h"
+#include "IndexStoreDB/Support/Concurrency.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/Support/Threading.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+using namespace IndexStoreDB;
+
+/// Waits until \p cond holds, for up to 10 seconds.
+template <typename Cond>
+static bool waitFor(std::mutex &mtx, std::condition_variable &cv, Cond cond) {
+  std::unique_lock<std::mutex> L(mtx);
+  return cv.wait_for(L, std::chrono::seconds(10), cond);
+}
+
+ISDB_TEST(WorkQueue, BlockedTasksDontStarveThePool) {
+  // More tasks block in dispatchSync than the pool has workers; the serial
+  // queue only lets them through once all of them are blocked.
+  unsigned numTasks = 4 * std::max(llvm::hardware_concurrency(), 2u);
+  WorkQueue serial(WorkQueue::Dequeuing::Serial, "isdb.test.serial");
+  WorkQueue concurrent(WorkQueue::Dequeuing::Concurrent, "isdb.test.concurrent");
+  std::mutex mtx;
+  std::condition_variable cv;
+  unsigned numEntered = 0;
+  unsigned numDone = 0;
+  bool allEntered = false;
+
+  serial.dispatch([&] {
+    allEntered = waitFor(mtx, cv, [&] { return numEntered == numTasks; });
+  });
+  for (unsigned i = 0; i != numTasks; ++i) {
+    concurrent.dispatch([&] {
+      {
+        std::lock_guard<std::mutex> L(mtx);
+        ++numEntered;
+        cv.notify_all();
+      }
+      serial.dispatchSync([] {});
+      std::lock_guard<std::mutex> L(mtx);
+      ++numDone;
+      cv.notify_all();
+    });
+  }
+
+  ISDB_EXPECT(waitFor(mtx, cv, [&] { return numDone == numTasks; }));
+  ISDB_EXPECT(allEntered);
+}
+
+ISDB_TEST(WorkQueue, NestedConcurrentPerform) {
+  unsigned numOuter = 4 * std::max(llvm::hardware_concurrency(), 2u);
+  std::atomic<unsigned> numInner{0};
+  std::mutex mtx;
+  std::condition_variable cv;
+  unsigned numDone = 0;
+
+  WorkQueue concurrent(WorkQueue::Dequeuing::Concurrent, "isdb.test.concurrent");
+  for (unsigned i = 0; i != numOuter; ++i) {
+    concurrent.dispatch([&] {
+      WorkQueue::concurrentPerform(8, [&](size_t) { ++numInner; });
+      std::lock_guard<std::mutex> L(mtx);
+      ++numDone;
+      cv.notify_all();
+    });
+  }
+
+  ISDB_EXPECT(waitFor(mtx, cv, [&] { return numDone == numOuter; }));
+  ISDB_EXPECT_EQ(numInner.load(), numOuter * 8);
+}